@@ -0,0 +1,165 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the cost of reading and writing the frequency of all the cores:
+ * one system call per core through the cores, the bulk interface with plain
+ * system calls and the bulk interface with io_uring batches. The cost of the
+ * governor switches, by name and by id, is measured too. The cores are
+ * simulated by a fake sysfs tree, so the measure is the cost of the system
+ * calls themselves rather than the one of the cpufreq driver.
+ */
+
+#include "test_fakesys.h"
+
+#include <time.h>
+
+#include "libdvfs.h"
+
+#define CHECK_ERROR(fct,message) { int result = fct; \
+    if (result != DVFS_SUCCESS) { \
+        printf(message" (%s).\n",dvfs_strerror(result)); \
+        return EXIT_FAILURE; \
+    }}
+
+static double now_sec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, unsigned int nb_cores, unsigned int nb_rounds, double elapsed)
+{
+   printf("%-24s %6u cores %8u rounds %8.3f s %10.1f us/round %8.1f ns/core\n",
+          name, nb_cores, nb_rounds, elapsed, elapsed * 1e6 / nb_rounds,
+          elapsed * 1e9 / nb_rounds / nb_cores);
+}
+
+static int run_bulk(dvfs_unit *unit, unsigned int *freqs, unsigned int nb_rounds, bool use_uring)
+{
+   dvfs_bulk *bulk = NULL;
+   unsigned int i;
+
+   CHECK_ERROR(dvfs_bulk_open(&bulk, 1, &unit, use_uring),"Open bulk");
+   if (use_uring && bulk->uring == NULL) {
+      printf("io_uring unavailable, skipped.\n");
+      dvfs_bulk_close(bulk);
+      return EXIT_SUCCESS;
+   }
+
+   double start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      CHECK_ERROR(dvfs_bulk_read_freqs(bulk, freqs),"Read frequencies");
+   }
+   report(use_uring ? "bulk io_uring read" : "bulk read", unit->nb_cores, nb_rounds, now_sec() - start);
+
+   start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      CHECK_ERROR(dvfs_bulk_set_freq(bulk, (i & 1) ? 2000000 : 1200000),"Set frequency");
+   }
+   report(use_uring ? "bulk io_uring write" : "bulk write", unit->nb_cores, nb_rounds, now_sec() - start);
+
+   dvfs_bulk_close(bulk);
+   return EXIT_SUCCESS;
+}
+
+static int run(unsigned int nb_cores, unsigned int nb_rounds)
+{
+   dvfs_unit *unit = NULL;
+   unsigned int i, j;
+
+   dvfs_core **cores = malloc(nb_cores * sizeof(*cores));
+   unsigned int *freqs = malloc(nb_cores * sizeof(*freqs));
+   if (cores == NULL || freqs == NULL) {
+      printf("Memory allocation failed.\n");
+      return EXIT_FAILURE;
+   }
+
+   for (i = 0; i < nb_cores; i++) {
+      fake_core(i, "userspace", "ondemand userspace", "1200000 2000000", 1200000);
+      CHECK_ERROR(dvfs_core_open(&cores[i], i, false),"Open core");
+   }
+   CHECK_ERROR(dvfs_unit_open(&unit, nb_cores, cores, 0),"Open unit");
+
+   double start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      for (j = 0; j < nb_cores; j++) {
+         CHECK_ERROR(dvfs_core_get_current_freq(cores[j], &freqs[j]),"Read frequency");
+      }
+   }
+   report("per core read", nb_cores, nb_rounds, now_sec() - start);
+
+   start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      for (j = 0; j < nb_cores; j++) {
+         CHECK_ERROR(dvfs_core_set_freq(cores[j], (i & 1) ? 2000000 : 1200000),"Set frequency");
+      }
+   }
+   report("per core write", nb_cores, nb_rounds, now_sec() - start);
+
+   start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      CHECK_ERROR(dvfs_unit_set_gov(unit, (i & 1) ? "ondemand" : "userspace"),"Set governor");
+   }
+   report("governor by name", nb_cores, nb_rounds, now_sec() - start);
+
+   unsigned int govs[2];
+   CHECK_ERROR(dvfs_gov_get_id("userspace", &govs[0]),"Governor id");
+   CHECK_ERROR(dvfs_gov_get_id("ondemand", &govs[1]),"Governor id");
+   start = now_sec();
+   for (i = 0; i < nb_rounds; i++) {
+      CHECK_ERROR(dvfs_unit_set_gov_id(unit, govs[i & 1]),"Set governor");
+   }
+   report("governor by id", nb_cores, nb_rounds, now_sec() - start);
+
+   if (run_bulk(unit, freqs, nb_rounds, false) != EXIT_SUCCESS
+       || run_bulk(unit, freqs, nb_rounds, true) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   dvfs_unit_close(unit);
+   free(freqs);
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int nb_cores = 256;
+   unsigned int nb_rounds = 1000;
+
+   if (argc > 1) {
+      nb_cores = strtoul(argv[1], NULL, 10);
+   }
+   if (argc > 2) {
+      nb_rounds = strtoul(argv[2], NULL, 10);
+   }
+
+   if (nb_cores == 0 || nb_rounds == 0) {
+      printf("Usage: %s [nb_cores [nb_rounds]]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(nb_cores, nb_rounds);
+   fake_root_remove();
+   return ret;
+}
@@ -0,0 +1,197 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the request throughput of the dvfsd daemon (see dvfs_server.h) with
+ * many concurrent clients. The daemon runs in a thread of the benchmark on the
+ * mock backend, each client thread has its own connection, as separate
+ * processes would.
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+typedef struct {
+   const char *path;          //!< Socket of the daemon
+   unsigned int index;        //!< Index of the client
+   unsigned int nb_requests;  //!< Requests to send
+   unsigned int nb_units;     //!< Units of the mock
+   const unsigned int *freqs; //!< Frequencies of the mock
+   unsigned int nb_freqs;     //!< Number of frequencies of the mock
+   pthread_barrier_t *barrier;   //!< Starts the clients together
+   int result;                //!< First error met
+} bench_client;
+
+static double now_sec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *serve(void *arg)
+{
+   dvfs_server_run(arg);
+   return NULL;
+}
+
+static void *client_main(void *arg)
+{
+   bench_client *bc = arg;
+   dvfs_client *client = NULL;
+   unsigned int i;
+
+   bc->result = dvfs_client_open(&client, bc->path);
+   pthread_barrier_wait(bc->barrier);
+   if (bc->result != DVFS_SUCCESS) {
+      return NULL;
+   }
+
+   for (i = 0; i < bc->nb_requests && bc->result == DVFS_SUCCESS; i++) {
+      bc->result = dvfs_client_unit_set_freq(client, (bc->index + i) % bc->nb_units, bc->freqs[(bc->index + i) % bc->nb_freqs]);
+   }
+
+   dvfs_client_close(client);
+   return NULL;
+}
+
+static int run(dvfs_ctx *ctx, dvfs_server *server, const char *path, unsigned int nb_clients, unsigned int nb_requests)
+{
+   bench_client *clients = calloc(nb_clients, sizeof(*clients));
+   pthread_t *threads = calloc(nb_clients, sizeof(*threads));
+   pthread_barrier_t barrier;
+   dvfs_server_stats before, after;
+   unsigned int i;
+   int result = DVFS_SUCCESS;
+
+   if (clients == NULL || threads == NULL) {
+      printf("Memory allocation failed.\n");
+      free(clients);
+      free(threads);
+      return EXIT_FAILURE;
+   }
+
+   pthread_barrier_init(&barrier, NULL, nb_clients + 1);
+   for (i = 0; i < nb_clients; i++) {
+      clients[i].path = path;
+      clients[i].index = i;
+      clients[i].nb_requests = nb_requests;
+      clients[i].nb_units = ctx->nb_units;
+      clients[i].freqs = ctx->units[0]->cores[0]->freqs;
+      clients[i].nb_freqs = ctx->units[0]->cores[0]->nb_freqs;
+      clients[i].barrier = &barrier;
+      pthread_create(&threads[i], NULL, client_main, &clients[i]);
+   }
+
+   // the clients are all connected when the barrier opens
+   pthread_barrier_wait(&barrier);
+   dvfs_server_get_stats(server, &before);
+   double start = now_sec();
+   for (i = 0; i < nb_clients; i++) {
+      pthread_join(threads[i], NULL);
+      if (clients[i].result != DVFS_SUCCESS) {
+         result = clients[i].result;
+      }
+   }
+   double elapsed = now_sec() - start;
+   dvfs_server_get_stats(server, &after);
+   pthread_barrier_destroy(&barrier);
+   free(clients);
+   free(threads);
+
+   if (result != DVFS_SUCCESS) {
+      printf("Request failed (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   unsigned long long nb = (unsigned long long) nb_clients * nb_requests;
+   printf("%4u clients %10llu requests %8.3f s %12.0f requests/s %8.2f us/request %6.1f%% written\n",
+          nb_clients, nb, elapsed, nb / elapsed, elapsed * 1e6 / nb,
+          100.0 * (after.nb_writes - before.nb_writes) / nb);
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int max_clients = 64;
+   unsigned int nb_total = 200000;
+   unsigned int nb_clients;
+   dvfs_ctx *ctx = NULL;
+   dvfs_server *server = NULL;
+   pthread_t thread;
+   char path[64];
+   int ret = EXIT_SUCCESS;
+   dvfs_mock_config config = {
+      .nb_cores = 16,
+      .cores_per_unit = 4,
+      .nb_freqs = 8,
+      .min_freq = 1200000,
+      .freq_step = 200000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   if (argc > 1) {
+      max_clients = strtoul(argv[1], NULL, 10);
+   }
+   if (argc > 2) {
+      nb_total = strtoul(argv[2], NULL, 10);
+   }
+   if (argc > 3 || max_clients == 0 || nb_total == 0) {
+      printf("Usage: %s [max_clients [nb_requests]]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   snprintf(path, sizeof(path), "/tmp/bench_dvfsd.%d.sock", (int) getpid());
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+   int result = dvfs_start_backend(&ctx, false, &dvfs_backend_mock);
+   if (result != DVFS_SUCCESS) {
+      printf("DVFS Start (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+   result = dvfs_server_open(&server, ctx, path);
+   if (result == DVFS_SUCCESS) {
+      result = dvfs_server_set_policy(server, getuid(), 0, UINT_MAX);
+   }
+   if (result != DVFS_SUCCESS) {
+      printf("Server open (%s).\n", dvfs_strerror(result));
+      dvfs_stop(ctx);
+      return EXIT_FAILURE;
+   }
+   pthread_create(&thread, NULL, serve, server);
+
+   // the same number of requests is split among more and more clients
+   for (nb_clients = 1; nb_clients <= max_clients && ret == EXIT_SUCCESS; nb_clients *= 2) {
+      ret = run(ctx, server, path, nb_clients, (nb_total + nb_clients - 1) / nb_clients);
+   }
+
+   dvfs_server_stop(server);
+   pthread_join(thread, NULL);
+   dvfs_server_close(server);
+   dvfs_stop(ctx);
+   return ret;
+}
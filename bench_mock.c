@@ -0,0 +1,124 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the overhead of the library itself: the frequency transitions are
+ * performed on the in-memory mock backend, so no time is spent in the kernel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK_ERROR(ctx,fct,message) { int result = fct; \
+    if (result != DVFS_SUCCESS) { \
+        printf(message" (%s).\n",dvfs_strerror(result)); \
+        dvfs_stop(ctx); \
+        return EXIT_FAILURE; \
+    }}
+
+static double now_sec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int run(bool seq, bool self, unsigned int nb_transitions)
+{
+   unsigned int i;
+   dvfs_ctx *ctx = NULL;
+
+   int id_result = dvfs_start_backend(&ctx, seq, &dvfs_backend_mock);
+   if (id_result != DVFS_SUCCESS) {
+      printf("DVFS Start (%s).\n", dvfs_strerror(id_result));
+      return EXIT_FAILURE;
+   }
+
+   CHECK_ERROR(ctx,dvfs_set_gov(ctx, "userspace"),"Unable to set governor");
+
+   const dvfs_unit *unit = NULL;
+   CHECK_ERROR(ctx,dvfs_get_unit_by_id(ctx, &unit, 0),"Get unit");
+   unsigned int lo = unit->cores[0]->freqs[0];
+   unsigned int hi = unit->cores[0]->freqs[unit->cores[0]->nb_freqs - 1];
+
+   dvfs_mock_reset_stats();
+   double start = now_sec();
+   for (i = 0; i < nb_transitions; i++) {
+      if (self) {
+         // the unit of the calling thread
+         CHECK_ERROR(ctx,dvfs_self_set_freq(ctx, (i & 1) ? hi : lo),"Unable to set freq");
+      } else {
+         CHECK_ERROR(ctx,dvfs_get_unit_by_id(ctx, &unit, i % ctx->nb_units),"Get unit");
+         CHECK_ERROR(ctx,dvfs_unit_set_freq(unit, (i & 1) ? hi : lo),"Unable to set freq");
+      }
+   }
+   double elapsed = now_sec() - start;
+
+   dvfs_mock_stats stats;
+   dvfs_mock_get_stats(&stats);
+   printf("%-16s %10u unit transitions %10llu core writes %8.3f s %12.0f transitions/s %8.1f ns/transition\n",
+          self ? "self" : seq ? "sequentialized" : "unsynchronized", nb_transitions, stats.nb_set_freq,
+          elapsed, nb_transitions / elapsed, elapsed * 1e9 / nb_transitions);
+
+   dvfs_stop(ctx);
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int nb_transitions = 10000000;
+   long nb_cpus = sysconf(_SC_NPROCESSORS_CONF);
+   dvfs_mock_config config = {
+      .nb_cores = 16,
+      .cores_per_unit = 2,
+      .nb_freqs = 12,
+      .min_freq = 1200000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   if (argc > 1) {
+      nb_transitions = strtoul(argv[1], NULL, 10);
+   }
+   if (argc > 2) {
+      config.latency_ns = strtoul(argv[2], NULL, 10);
+   }
+
+   // dvfs_self_set_freq() needs every core the thread may run on
+   if (nb_cpus > 0) {
+      config.nb_cores = (nb_cpus + config.cores_per_unit - 1) / config.cores_per_unit * config.cores_per_unit;
+   }
+
+   if (nb_transitions == 0 || dvfs_mock_configure(&config) != DVFS_SUCCESS) {
+      printf("Usage: %s [nb_transitions [latency_ns]]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (run(false, false, nb_transitions) != EXIT_SUCCESS || run(true, false, nb_transitions) != EXIT_SUCCESS
+       || run(false, true, nb_transitions) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Measures the read throughput of the frequency of a unit with N reader
+ * threads, while a writer thread keeps changing it: through the backend under
+ * the semaphore (dvfs_unit_get_freq()) and through the published state
+ * (dvfs_unit_read_state()). The frequency transitions are performed on the
+ * in-memory mock backend.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libdvfs.h"
+
+#define CHECK_ERROR(ctx,fct,message) { int result = fct; \
+    if (result != DVFS_SUCCESS) { \
+        printf(message" (%s).\n",dvfs_strerror(result)); \
+        dvfs_stop(ctx); \
+        return EXIT_FAILURE; \
+    }}
+
+typedef struct {
+   const dvfs_unit *unit;
+   bool published;
+   volatile bool done;
+   unsigned long long nb_reads;
+   unsigned long long nb_writes;
+} bench;
+
+static double now_sec(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *reader_main(void *arg)
+{
+   bench *b = arg;
+   unsigned long long nb = 0;
+   dvfs_unit_state state;
+   unsigned int freq;
+
+   while (!b->done) {
+      if (b->published) {
+         dvfs_unit_read_state(b->unit, &state);
+      } else {
+         freq = 0;
+         dvfs_unit_get_freq(b->unit, &freq);
+      }
+      nb++;
+   }
+   __atomic_fetch_add(&b->nb_reads, nb, __ATOMIC_RELAXED);
+   return NULL;
+}
+
+static void *writer_main(void *arg)
+{
+   bench *b = arg;
+   const dvfs_core *core = b->unit->cores[0];
+   unsigned long long nb = 0;
+
+   while (!b->done) {
+      dvfs_unit_set_freq(b->unit, core->freqs[nb % core->nb_freqs]);
+      nb++;
+   }
+   b->nb_writes = nb;
+   return NULL;
+}
+
+static int run(const dvfs_unit *unit, bool published, unsigned int nb_readers, unsigned int duration_ms)
+{
+   bench b = { .unit = unit, .published = published };
+   pthread_t writer, readers[nb_readers];
+   unsigned int i;
+
+   double start = now_sec();
+   if (pthread_create(&writer, NULL, writer_main, &b) != 0) {
+      return EXIT_FAILURE;
+   }
+   for (i = 0; i < nb_readers; i++) {
+      if (pthread_create(&readers[i], NULL, reader_main, &b) != 0) {
+         b.done = true;
+         nb_readers = i;
+         break;
+      }
+   }
+
+   struct timespec ts = { .tv_sec = duration_ms / 1000, .tv_nsec = (duration_ms % 1000) * 1000000L };
+   nanosleep(&ts, NULL);
+   b.done = true;
+
+   for (i = 0; i < nb_readers; i++) {
+      pthread_join(readers[i], NULL);
+   }
+   pthread_join(writer, NULL);
+   double elapsed = now_sec() - start;
+
+   printf("%-10s %3u readers %14.0f reads/s %14.0f reads/s/reader %12.0f writes/s\n",
+          published ? "published" : "backend", nb_readers, b.nb_reads / elapsed,
+          b.nb_reads / elapsed / nb_readers, b.nb_writes / elapsed);
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int max_readers = 8, duration_ms = 200, nb;
+   dvfs_ctx *ctx = NULL;
+   dvfs_state *state = NULL;
+   const dvfs_unit *unit = NULL;
+   dvfs_state_config state_config = {
+      .period_us = 0,
+   };
+   dvfs_mock_config config = {
+      .nb_cores = 16,
+      .cores_per_unit = 2,
+      .nb_freqs = 12,
+      .min_freq = 1200000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   if (argc > 1) {
+      max_readers = strtoul(argv[1], NULL, 10);
+   }
+   if (argc > 2) {
+      duration_ms = strtoul(argv[2], NULL, 10);
+   }
+
+   if (max_readers == 0 || duration_ms == 0 || dvfs_mock_configure(&config) != DVFS_SUCCESS) {
+      printf("Usage: %s [max_readers [duration_ms]]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   int id_result = dvfs_start_backend(&ctx, true, &dvfs_backend_mock);
+   if (id_result != DVFS_SUCCESS) {
+      printf("DVFS Start (%s).\n", dvfs_strerror(id_result));
+      return EXIT_FAILURE;
+   }
+
+   CHECK_ERROR(ctx,dvfs_set_gov(ctx, "userspace"),"Unable to set governor");
+   CHECK_ERROR(ctx,dvfs_get_unit_by_id(ctx, &unit, 0),"Get unit");
+
+   for (nb = 1; nb <= max_readers; nb *= 2) {
+      if (run(unit, false, nb, duration_ms) != EXIT_SUCCESS) {
+         dvfs_stop(ctx);
+         return EXIT_FAILURE;
+      }
+   }
+
+   CHECK_ERROR(ctx,dvfs_state_open(&state, ctx, &state_config),"Publish state");
+   for (nb = 1; nb <= max_readers; nb *= 2) {
+      if (run(unit, true, nb, duration_ms) != EXIT_SUCCESS) {
+         dvfs_state_close(state);
+         dvfs_stop(ctx);
+         return EXIT_FAILURE;
+      }
+   }
+
+   dvfs_state_close(state);
+   dvfs_stop(ctx);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "dvfs_async.h"
+#include "dvfs_error.h"
+#include "dvfs_timer.h"
+
+static int execute(const dvfs_async_request *req)
+{
+   switch (req->op)
+   {
+      case DVFS_ASYNC_CORE_SET_FREQ:
+         return dvfs_core_set_freq(req->core, req->freq);
+      case DVFS_ASYNC_CORE_SET_GOV:
+         return dvfs_core_set_gov(req->core, req->gov);
+      case DVFS_ASYNC_UNIT_SET_FREQ:
+         return dvfs_unit_set_freq(req->unit, req->freq);
+      case DVFS_ASYNC_UNIT_SET_GOV:
+         return dvfs_unit_set_gov(req->unit, req->gov);
+      default:
+         return DVFS_ERROR_INVALID_ARG;
+   }
+}
+
+static void *worker_main(void *arg)
+{
+   dvfs_async *async = arg;
+   const uint64_t one = 1;
+
+   pthread_mutex_lock(&async->lock);
+   for (;;)
+   {
+      while (async->nb_requests == 0 && !async->stop)
+      {
+         pthread_cond_wait(&async->cond, &async->lock);
+      }
+
+      if (async->nb_requests == 0)
+      {
+         break;
+      }
+
+      dvfs_async_request req = async->requests[async->req_head];
+      async->req_head = (async->req_head + 1) % async->size;
+      async->nb_requests--;
+      pthread_mutex_unlock(&async->lock);
+
+      unsigned long long start = dvfs_timer_now_ns();
+      int status = execute(&req);
+      unsigned long long end = dvfs_timer_now_ns();
+
+      pthread_mutex_lock(&async->lock);
+
+      // the completion ring cannot overflow, see nb_inflight
+      dvfs_async_result *res = &async->results[(async->res_head + async->nb_results) % async->size];
+      res->id = req.id;
+      res->op = req.op;
+      res->status = status;
+      res->latency_ns = end - req.submit_ns;
+      res->exec_ns = end - start;
+      async->nb_results++;
+
+      // the counter cannot overflow with the queue sizes in use
+      (void) write(async->efd, &one, sizeof(one));
+   }
+   pthread_mutex_unlock(&async->lock);
+
+   return NULL;
+}
+
+/**
+ * Queues a copy of the request and wakes the worker up.
+ */
+static int submit(dvfs_async *async, const dvfs_async_request *req, unsigned long long *pId)
+{
+   pthread_mutex_lock(&async->lock);
+
+   if (async->nb_inflight == async->size)
+   {
+      pthread_mutex_unlock(&async->lock);
+      return DVFS_ERROR_QUEUE_FULL;
+   }
+
+   dvfs_async_request *slot = &async->requests[(async->req_head + async->nb_requests) % async->size];
+   *slot = *req;
+   slot->id = async->next_id++;
+   slot->submit_ns = dvfs_timer_now_ns();
+   async->nb_requests++;
+   async->nb_inflight++;
+
+   if (pId != NULL)
+   {
+      *pId = slot->id;
+   }
+
+   pthread_cond_signal(&async->cond);
+   pthread_mutex_unlock(&async->lock);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_async_open(dvfs_async **ppAsync, unsigned int size)
+{
+   assert(ppAsync != NULL);
+   if (ppAsync == NULL || size == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_async *async = calloc(1, sizeof(*async));
+   if (async == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   async->size = size;
+   async->requests = malloc(size * sizeof(*async->requests));
+   async->results = malloc(size * sizeof(*async->results));
+   if (async->requests == NULL || async->results == NULL)
+   {
+      free(async->requests);
+      free(async->results);
+      free(async);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   async->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (async->efd < 0)
+   {
+      free(async->requests);
+      free(async->results);
+      free(async);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   pthread_mutex_init(&async->lock, NULL);
+   pthread_cond_init(&async->cond, NULL);
+
+   if (pthread_create(&async->worker, NULL, worker_main, async) != 0)
+   {
+      pthread_mutex_destroy(&async->lock);
+      pthread_cond_destroy(&async->cond);
+      close(async->efd);
+      free(async->requests);
+      free(async->results);
+      free(async);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *ppAsync = async;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_async_close(dvfs_async *async)
+{
+   assert(async != NULL);
+   if (async == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&async->lock);
+   async->stop = true;
+   pthread_cond_signal(&async->cond);
+   pthread_mutex_unlock(&async->lock);
+
+   pthread_join(async->worker, NULL);
+
+   pthread_mutex_destroy(&async->lock);
+   pthread_cond_destroy(&async->cond);
+   close(async->efd);
+   free(async->requests);
+   free(async->results);
+   free(async);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_async_get_fd(const dvfs_async *async, int *pFd)
+{
+   assert(async != NULL);
+   assert(pFd != NULL);
+   if (async == NULL || pFd == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *pFd = async->efd;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_async_core_set_freq(dvfs_async *async, const dvfs_core *core, unsigned int freq, unsigned long long *pId)
+{
+   dvfs_async_request req = { .op = DVFS_ASYNC_CORE_SET_FREQ, .core = core, .freq = freq };
+
+   assert(async != NULL);
+   assert(core != NULL);
+   if (async == NULL || core == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return submit(async, &req, pId);
+}
+
+int dvfs_async_core_set_gov(dvfs_async *async, const dvfs_core *core, const char *gov, unsigned long long *pId)
+{
+   dvfs_async_request req = { .op = DVFS_ASYNC_CORE_SET_GOV, .core = core };
+
+   assert(async != NULL);
+   assert(core != NULL);
+   assert(gov != NULL);
+   if (async == NULL || core == NULL || gov == NULL
+       || snprintf(req.gov, sizeof(req.gov), "%s", gov) >= (int) sizeof(req.gov))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return submit(async, &req, pId);
+}
+
+int dvfs_async_unit_set_freq(dvfs_async *async, const dvfs_unit *unit, unsigned int freq, unsigned long long *pId)
+{
+   dvfs_async_request req = { .op = DVFS_ASYNC_UNIT_SET_FREQ, .unit = unit, .freq = freq };
+
+   assert(async != NULL);
+   assert(unit != NULL);
+   if (async == NULL || unit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return submit(async, &req, pId);
+}
+
+int dvfs_async_unit_set_gov(dvfs_async *async, const dvfs_unit *unit, const char *gov, unsigned long long *pId)
+{
+   dvfs_async_request req = { .op = DVFS_ASYNC_UNIT_SET_GOV, .unit = unit };
+
+   assert(async != NULL);
+   assert(unit != NULL);
+   assert(gov != NULL);
+   if (async == NULL || unit == NULL || gov == NULL
+       || snprintf(req.gov, sizeof(req.gov), "%s", gov) >= (int) sizeof(req.gov))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return submit(async, &req, pId);
+}
+
+int dvfs_async_drain(dvfs_async *async, dvfs_async_result *results, unsigned int max, unsigned int *pNb)
+{
+   uint64_t count;
+   const uint64_t one = 1;
+   unsigned int i;
+
+   assert(async != NULL);
+   assert(results != NULL);
+   assert(pNb != NULL);
+   if (async == NULL || results == NULL || pNb == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&async->lock);
+
+   // reset the eventfd, under the lock so no completion gets missed
+   (void) read(async->efd, &count, sizeof(count));
+
+   for (i = 0; i < max && async->nb_results > 0; i++)
+   {
+      results[i] = async->results[async->res_head];
+      async->res_head = (async->res_head + 1) % async->size;
+      async->nb_results--;
+      async->nb_inflight--;
+   }
+   *pNb = i;
+
+   // keep the eventfd readable while completions remain
+   if (async->nb_results > 0)
+   {
+      (void) write(async->efd, &one, sizeof(one));
+   }
+
+   pthread_mutex_unlock(&async->lock);
+
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "dvfs_core.h"
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_async.h
+ *
+ * Asynchronous DVFS operations for event loops. The requests are queued and
+ * executed by a worker thread, so submitting only costs an enqueue and a
+ * wakeup. Completions are signalled through an \c eventfd which can be
+ * registered in epoll (or poll/select): when it becomes readable, call
+ * \c dvfs_async_drain() to get the status and latency of each request.
+ *
+ * The requests are executed in submission order. A queue is meant to be used
+ * by a single submitting thread.
+ */
+
+/**
+ * Operations which can be queued.
+ */
+typedef enum {
+   DVFS_ASYNC_CORE_SET_FREQ = 0, //!< dvfs_core_set_freq()
+   DVFS_ASYNC_CORE_SET_GOV,      //!< dvfs_core_set_gov()
+   DVFS_ASYNC_UNIT_SET_FREQ,     //!< dvfs_unit_set_freq()
+   DVFS_ASYNC_UNIT_SET_GOV,      //!< dvfs_unit_set_gov()
+} dvfs_async_op;
+
+/**
+ * A queued request.
+ */
+typedef struct {
+   unsigned long long id;        //!< Id of the request, given at submission
+   dvfs_async_op op;             //!< Operation
+   const dvfs_core *core;        //!< Target of the core operations
+   const dvfs_unit *unit;        //!< Target of the unit operations
+   unsigned int freq;            //!< Frequency to set
+   char gov[128];                //!< Governor to set
+   unsigned long long submit_ns; //!< Submission date (CLOCK_MONOTONIC)
+} dvfs_async_request;
+
+/**
+ * Completion of a request.
+ */
+typedef struct {
+   unsigned long long id;        //!< Id of the request, given at submission
+   dvfs_async_op op;             //!< Operation
+   int status;                   //!< Return value of the operation
+   unsigned long long latency_ns;   //!< Time from the submission to the completion
+   unsigned long long exec_ns;   //!< Time spent executing the operation
+} dvfs_async_result;
+
+/**
+ * Queue of asynchronous requests and its worker thread.
+ */
+typedef struct {
+   unsigned int size;            //!< Highest number of requests submitted and not drained yet
+   int efd;                      //!< Completion eventfd
+
+   pthread_mutex_t lock;         //!< Protects the rings and the counters
+   pthread_cond_t cond;          //!< Wakes up the worker
+   pthread_t worker;             //!< Worker thread
+   bool stop;                    //!< Tells the worker to exit once the queue is empty
+
+   dvfs_async_request *requests; //!< Ring of the pending requests
+   unsigned int req_head;        //!< Index of the next request to execute
+   unsigned int nb_requests;     //!< Number of pending requests
+
+   dvfs_async_result *results;   //!< Ring of the completions not drained yet
+   unsigned int res_head;        //!< Index of the next completion to drain
+   unsigned int nb_results;      //!< Number of completions not drained yet
+
+   unsigned int nb_inflight;     //!< Number of requests submitted and not drained yet
+
+   unsigned long long next_id;   //!< Id of the next request
+} dvfs_async;
+
+/**
+ * Creates a queue and starts its worker thread.
+ *
+ * @param ppAsync Will be filled with the queue.
+ * @param size The highest number of requests submitted and not drained yet.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppAsync is NULL or \c size is 0.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the eventfd or the thread cannot be created.
+ *
+ * @sa dvfs_async_close()
+ */
+int dvfs_async_open(dvfs_async **ppAsync, unsigned int size);
+
+/**
+ * Executes the pending requests, stops the worker thread and frees the queue.
+ * The completions not drained are lost.
+ *
+ * @param async The queue.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async is NULL.
+ */
+int dvfs_async_close(dvfs_async *async);
+
+/**
+ * Gets the completion eventfd of the queue. It becomes readable when
+ * completions are available. Do not read it, use dvfs_async_drain().
+ *
+ * @param async The queue.
+ * @param pFd Will be filled with the file descriptor.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async or \c pFd are NULL.
+ */
+int dvfs_async_get_fd(const dvfs_async *async, int *pFd);
+
+/**
+ * Queues a frequency change of a core.
+ *
+ * @param async The queue.
+ * @param core The core.
+ * @param freq The frequency to set.
+ * @param pId Will be filled with the id of the request. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async or \c core are NULL.
+ *         \retval DVFS_ERROR_QUEUE_FULL if too many requests are not drained yet.
+ */
+int dvfs_async_core_set_freq(dvfs_async *async, const dvfs_core *core, unsigned int freq, unsigned long long *pId);
+
+/**
+ * Queues a governor change of a core.
+ *
+ * @param async The queue.
+ * @param core The core.
+ * @param gov The governor to set.
+ * @param pId Will be filled with the id of the request. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async, \c core or \c gov are NULL, or \c gov is too long.
+ *         \retval DVFS_ERROR_QUEUE_FULL if too many requests are not drained yet.
+ */
+int dvfs_async_core_set_gov(dvfs_async *async, const dvfs_core *core, const char *gov, unsigned long long *pId);
+
+/**
+ * Queues a frequency change of a DVFS unit.
+ *
+ * @param async The queue.
+ * @param unit The DVFS unit.
+ * @param freq The frequency to set.
+ * @param pId Will be filled with the id of the request. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async or \c unit are NULL.
+ *         \retval DVFS_ERROR_QUEUE_FULL if too many requests are not drained yet.
+ */
+int dvfs_async_unit_set_freq(dvfs_async *async, const dvfs_unit *unit, unsigned int freq, unsigned long long *pId);
+
+/**
+ * Queues a governor change of a DVFS unit.
+ *
+ * @param async The queue.
+ * @param unit The DVFS unit.
+ * @param gov The governor to set.
+ * @param pId Will be filled with the id of the request. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async, \c unit or \c gov are NULL, or \c gov is too long.
+ *         \retval DVFS_ERROR_QUEUE_FULL if too many requests are not drained yet.
+ */
+int dvfs_async_unit_set_gov(dvfs_async *async, const dvfs_unit *unit, const char *gov, unsigned long long *pId);
+
+/**
+ * Gets the completions available, in completion order. Never blocks.
+ *
+ * @param async The queue.
+ * @param results The array to fill.
+ * @param max The size of the array.
+ * @param pNb Will be filled with the number of completions returned.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c async, \c results or \c pNb are NULL.
+ */
+int dvfs_async_drain(dvfs_async *async, dvfs_async_result *results, unsigned int max, unsigned int *pNb);
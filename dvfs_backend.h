@@ -0,0 +1,148 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file dvfs_backend.h
+ *
+ * Backends implement the hardware accesses of the cores. The backend is
+ * selected when starting the library (\c dvfs_start_backend()) and every
+ * core keeps a pointer toward it. The generic code (argument checks,
+ * frequency validation, sequentialization) stays in \c dvfs_core.c.
+ *
+ * Three backends are provided: \c dvfs_backend_sysfs, the default one, relying
+ * on the cpufreq sysfs interface, \c dvfs_backend_msr, writing the P-state
+ * directly in the model specific registers, and \c dvfs_backend_mock, an
+ * in-memory backend recording the calls, used to measure the overhead of the
+ * library itself.
+ */
+
+struct dvfs_core;
+
+/**
+ * Operations of a backend. The operations are called with a core already
+ * checked by the generic code. The set operations are sequentialized by the
+ * generic code when requested.
+ */
+typedef struct dvfs_backend {
+   const char *name;    //!< Name of the backend
+   bool hardware;       //!< True if the backend controls the actual hardware (the other sysfs features, such as uncore domains, are then enabled)
+
+   /** Gets the number of cores of the system */
+   unsigned int (*get_nb_cores)(void);
+   /** Gets the cores sharing the frequency of the given core, the array is allocated with malloc. Sets it to NULL on failure. */
+   void (*get_related_cores)(unsigned int id, unsigned int **cores, unsigned int *nb_cores);
+
+   /** Opens the core: fills the initial state (init_gov, init_freq) and the private data */
+   int (*open)(struct dvfs_core *core);
+   /** Closes the core: releases the private data. The core may be partially opened. */
+   void (*close)(struct dvfs_core *core);
+   /** Fills the frequency table of the core (freqs and nb_freqs) */
+   int (*read_freqs)(struct dvfs_core *core);
+
+   /** Reads the current governor */
+   int (*get_gov)(const struct dvfs_core *core, char *buf, size_t buf_len);
+   /** Sets the governor */
+   int (*set_gov)(const struct dvfs_core *core, const char *gov);
+   /** Sets the frequency, already checked against the frequency table */
+   int (*set_freq)(const struct dvfs_core *core, unsigned int freq);
+   /** Reads the frequency currently set */
+   int (*get_freq)(const struct dvfs_core *core, unsigned int *pFreq);
+   /** Reads the frequency last requested, an entry of the frequency table, NULL if the backend cannot read it back */
+   int (*get_target)(const struct dvfs_core *core, unsigned int *pFreq);
+   /** Sets the frequency limits of a DVFS_CTRL_MINMAX core, NULL if the backend does not handle limits */
+   int (*set_limits)(const struct dvfs_core *core, unsigned int min, unsigned int max);
+   /** Gets the time the hardware takes to switch frequencies (ns), NULL if the backend does not know it */
+   int (*get_latency)(const struct dvfs_core *core, unsigned int *pLatency);
+} dvfs_backend;
+
+/** Backend relying on the cpufreq sysfs interface (default) */
+extern const dvfs_backend dvfs_backend_sysfs;
+
+/**
+ * Backend writing the target P-state ratio in \c IA32_PERF_CTL through
+ * \c /dev/cpu/N/msr (see dvfs_msr.h). A transition costs a single pwrite per
+ * core instead of going through the cpufreq policy lock. The frequency table
+ * is built from the ratios of \c MSR_PLATFORM_INFO. The governors are still
+ * handled by cpufreq, which may overwrite the requested P-state: use a
+ * governor not changing the frequency on its own ("userspace" or
+ * "performance"). Opening a core fails with \c DVFS_ERROR_HWP_ACTIVE when
+ * hardware P-states are enabled, as the processor then ignores the register.
+ */
+extern const dvfs_backend dvfs_backend_msr;
+
+/** In-memory backend recording the calls, see dvfs_mock_configure() */
+extern const dvfs_backend dvfs_backend_mock;
+
+/**
+ * Configuration of the mock backend.
+ */
+typedef struct {
+   unsigned int nb_cores;        //!< Number of simulated cores
+   unsigned int cores_per_unit;  //!< Number of cores sharing a frequency
+   unsigned int nb_freqs;        //!< Number of available frequencies
+   unsigned int min_freq;        //!< Lowest frequency (kHz)
+   unsigned int freq_step;       //!< Step between two frequencies (kHz)
+   unsigned int latency_ns;      //!< Latency injected (busy wait) in every set operation
+   unsigned int error_period;    //!< Every error_period-th set operation fails, 0 to never fail
+   int error_code;               //!< Error code returned by the failing operations
+} dvfs_mock_config;
+
+/**
+ * Calls recorded by the mock backend since the last reset.
+ */
+typedef struct {
+   unsigned long long nb_open;      //!< Number of cores opened
+   unsigned long long nb_get_gov;   //!< Number of governor reads
+   unsigned long long nb_set_gov;   //!< Number of governor changes
+   unsigned long long nb_set_freq;  //!< Number of frequency changes
+   unsigned long long nb_get_freq;  //!< Number of frequency reads
+   unsigned long long nb_errors;    //!< Number of injected errors
+} dvfs_mock_stats;
+
+/**
+ * Configures the mock backend. Must be called before opening the cores
+ * (\c dvfs_start_backend()). By default, the mock simulates 4 cores, each in
+ * its own unit, with 8 frequencies from 1.2 GHz by 200 MHz steps, without
+ * latency nor errors.
+ *
+ * @param config The new configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c config is NULL or describes no core or frequency.
+ */
+int dvfs_mock_configure(const dvfs_mock_config *config);
+
+/**
+ * Gets the calls recorded by the mock backend.
+ *
+ * @param pStats Will be filled with the recorded calls.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c pStats is NULL.
+ */
+int dvfs_mock_get_stats(dvfs_mock_stats *pStats);
+
+/**
+ * Resets the calls recorded by the mock backend.
+ */
+void dvfs_mock_reset_stats(void);
@@ -0,0 +1,278 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dvfs_backend.h"
+#include "dvfs_core.h"
+#include "dvfs_error.h"
+
+// Initial governor of the simulated cores
+#define MOCK_INIT_GOV "ondemand"
+
+/**
+ * State of a simulated core.
+ */
+typedef struct {
+   char gov[128];       //!< Governor currently set
+   unsigned int freq;   //!< Frequency currently set
+} mock_core;
+
+static dvfs_mock_config mock_config = {
+   .nb_cores = 4,
+   .cores_per_unit = 1,
+   .nb_freqs = 8,
+   .min_freq = 1200000,
+   .freq_step = 200000,
+   .latency_ns = 0,
+   .error_period = 0,
+   .error_code = DVFS_ERROR_FILE_ERROR,
+};
+
+static dvfs_mock_stats mock_stats;
+
+// Number of set operations, to inject errors
+static unsigned long long mock_nb_sets;
+
+#define MOCK_RECORD(counter) __atomic_fetch_add(&mock_stats.counter, 1, __ATOMIC_RELAXED)
+
+int dvfs_mock_configure(const dvfs_mock_config *config)
+{
+   if (config == NULL || config->nb_cores == 0 || config->cores_per_unit == 0 || config->nb_freqs == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   mock_config = *config;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_mock_get_stats(dvfs_mock_stats *pStats)
+{
+   if (pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pStats->nb_open = __atomic_load_n(&mock_stats.nb_open, __ATOMIC_RELAXED);
+   pStats->nb_get_gov = __atomic_load_n(&mock_stats.nb_get_gov, __ATOMIC_RELAXED);
+   pStats->nb_set_gov = __atomic_load_n(&mock_stats.nb_set_gov, __ATOMIC_RELAXED);
+   pStats->nb_set_freq = __atomic_load_n(&mock_stats.nb_set_freq, __ATOMIC_RELAXED);
+   pStats->nb_get_freq = __atomic_load_n(&mock_stats.nb_get_freq, __ATOMIC_RELAXED);
+   pStats->nb_errors = __atomic_load_n(&mock_stats.nb_errors, __ATOMIC_RELAXED);
+   return DVFS_SUCCESS;
+}
+
+void dvfs_mock_reset_stats(void)
+{
+   memset(&mock_stats, 0, sizeof(mock_stats));
+   __atomic_store_n(&mock_nb_sets, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Simulates the cost of a hardware access. Busy waits to keep the timing
+ * accurate at the microsecond scale.
+ */
+static void mock_latency(void)
+{
+   struct timespec start, now;
+
+   if (mock_config.latency_ns == 0)
+   {
+      return;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   do
+   {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+   } while ((now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec) < mock_config.latency_ns);
+}
+
+/**
+ * Accounts a set operation and tells if it has to fail.
+ */
+static bool mock_inject_error(void)
+{
+   unsigned long long nb = __atomic_add_fetch(&mock_nb_sets, 1, __ATOMIC_RELAXED);
+
+   if (mock_config.error_period != 0 && nb % mock_config.error_period == 0)
+   {
+      MOCK_RECORD(nb_errors);
+      return true;
+   }
+   return false;
+}
+
+static unsigned int mock_get_nb_cores(void)
+{
+   return mock_config.nb_cores;
+}
+
+static void mock_get_related_cores(unsigned int id, unsigned int **cores, unsigned int *nb_cores)
+{
+   unsigned int i;
+   unsigned int first = id - id % mock_config.cores_per_unit;
+
+   *nb_cores = mock_config.cores_per_unit;
+   if (first + *nb_cores > mock_config.nb_cores)
+   {
+      *nb_cores = mock_config.nb_cores - first;
+   }
+
+   *cores = malloc(*nb_cores * sizeof(**cores));
+   if (*cores == NULL)
+   {
+      return;
+   }
+
+   for (i = 0; i < *nb_cores; i++)
+   {
+      (*cores)[i] = first + i;
+   }
+}
+
+static int mock_open(dvfs_core *core)
+{
+   mock_core *mcore = malloc(sizeof(*mcore));
+   if (mcore == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   snprintf(mcore->gov, sizeof(mcore->gov), "%s", MOCK_INIT_GOV);
+   mcore->freq = mock_config.min_freq;
+   core->priv = mcore;
+
+   snprintf(core->init_gov, sizeof(core->init_gov), "%s", MOCK_INIT_GOV);
+
+   MOCK_RECORD(nb_open);
+   return DVFS_SUCCESS;
+}
+
+static void mock_close(dvfs_core *core)
+{
+   free(core->priv), core->priv = NULL;
+}
+
+static int mock_read_freqs(dvfs_core *core)
+{
+   unsigned int i;
+
+   core->nb_freqs = mock_config.nb_freqs;
+   core->freqs = malloc(core->nb_freqs * sizeof(*core->freqs));
+   if (core->freqs == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < core->nb_freqs; i++)
+   {
+      core->freqs[i] = mock_config.min_freq + i * mock_config.freq_step;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int mock_get_gov(const dvfs_core *core, char *buf, size_t buf_len)
+{
+   const mock_core *mcore = core->priv;
+
+   MOCK_RECORD(nb_get_gov);
+   if (snprintf(buf, buf_len, "%s", mcore->gov) >= (int) buf_len)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+   return DVFS_SUCCESS;
+}
+
+static int mock_set_gov(const dvfs_core *core, const char *gov)
+{
+   mock_core *mcore = core->priv;
+
+   MOCK_RECORD(nb_set_gov);
+   mock_latency();
+   if (mock_inject_error())
+   {
+      return mock_config.error_code;
+   }
+
+   snprintf(mcore->gov, sizeof(mcore->gov), "%s", gov);
+   return DVFS_SUCCESS;
+}
+
+static int mock_set_freq(const dvfs_core *core, unsigned int freq)
+{
+   mock_core *mcore = core->priv;
+
+   MOCK_RECORD(nb_set_freq);
+   mock_latency();
+   if (mock_inject_error())
+   {
+      return mock_config.error_code;
+   }
+
+   mcore->freq = freq;
+   return DVFS_SUCCESS;
+}
+
+static int mock_get_freq(const dvfs_core *core, unsigned int *pFreq)
+{
+   const mock_core *mcore = core->priv;
+
+   MOCK_RECORD(nb_get_freq);
+   *pFreq = mcore->freq;
+   return DVFS_SUCCESS;
+}
+
+static int mock_get_target(const dvfs_core *core, unsigned int *pFreq)
+{
+   const mock_core *mcore = core->priv;
+
+   *pFreq = mcore->freq;
+   return DVFS_SUCCESS;
+}
+
+static int mock_get_latency(const dvfs_core *core, unsigned int *pLatency)
+{
+   (void) core;
+
+   // the transitions take the injected latency
+   *pLatency = mock_config.latency_ns;
+   return DVFS_SUCCESS;
+}
+
+const dvfs_backend dvfs_backend_mock = {
+   .name = "mock",
+   .hardware = false,
+   .get_nb_cores = mock_get_nb_cores,
+   .get_related_cores = mock_get_related_cores,
+   .open = mock_open,
+   .close = mock_close,
+   .read_freqs = mock_read_freqs,
+   .get_gov = mock_get_gov,
+   .set_gov = mock_set_gov,
+   .set_freq = mock_set_freq,
+   .get_freq = mock_get_freq,
+   .get_target = mock_get_target,
+   .get_latency = mock_get_latency,
+};
@@ -0,0 +1,236 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvfs_backend.h"
+#include "dvfs_core.h"
+#include "dvfs_error.h"
+#include "dvfs_features.h"
+#include "dvfs_msr.h"
+
+// Ratio fields of the registers
+#define PERF_RATIO_SHIFT 8
+#define PERF_RATIO_MASK 0xFFULL
+#define PLATFORM_INFO_MAX_RATIO(val) (((val) >> 8) & 0xFF)
+#define PLATFORM_INFO_MIN_RATIO(val) (((val) >> 40) & 0xFF)
+
+/**
+ * State of a core controlled through the MSR.
+ */
+typedef struct {
+   int fd;                    //!< MSR device of the core
+   uint64_t init_perf_ctl;    //!< IA32_PERF_CTL when the core got initialised
+} msr_core;
+
+static int msr_open(dvfs_core *core)
+{
+   int ret;
+
+   msr_core *mcore = malloc(sizeof(*mcore));
+   if (mcore == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   mcore->fd = -1;
+   core->priv = mcore;
+
+   ret = dvfs_msr_open(core->id, O_RDWR, &mcore->fd);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   // with HWP, the hardware ignores IA32_PERF_CTL
+   if (dvfs_features_hwp_enabled(mcore->fd))
+   {
+      close(mcore->fd), mcore->fd = -1;
+      return DVFS_ERROR_HWP_ACTIVE;
+   }
+
+   ret = dvfs_msr_read(mcore->fd, DVFS_MSR_IA32_PERF_CTL, &mcore->init_perf_ctl);
+   if (ret != DVFS_SUCCESS)
+   {
+      close(mcore->fd), mcore->fd = -1;
+      return ret;
+   }
+
+   // the initial state is kept in the core like the other backends, so that
+   // dvfs_core_restore(), the snapshots and the leases see it. The governor is
+   // still handled by cpufreq, when available.
+   if (dvfs_backend_sysfs.get_gov(core, core->init_gov, sizeof(core->init_gov)) != DVFS_SUCCESS)
+   {
+      core->init_gov[0] = '\0';
+   }
+   core->init_gov[strcspn(core->init_gov, "\n")] = '\0';
+   core->init_freq = ((mcore->init_perf_ctl >> PERF_RATIO_SHIFT) & PERF_RATIO_MASK) * DVFS_MSR_BUS_CLOCK;
+
+   return DVFS_SUCCESS;
+}
+
+static void msr_close(dvfs_core *core)
+{
+   msr_core *mcore = core->priv;
+
+   if (mcore == NULL)
+   {
+      return;
+   }
+
+   // the governor has been restored by dvfs_core_restore(), the other fields
+   // of the request are put back as well, unless the core belongs to another
+   // context
+   if (mcore->fd >= 0)
+   {
+      if (!core->fenced)
+      {
+         dvfs_msr_write(mcore->fd, DVFS_MSR_IA32_PERF_CTL, mcore->init_perf_ctl);
+      }
+      close(mcore->fd);
+   }
+
+   free(mcore), core->priv = NULL;
+}
+
+/**
+ * The frequency table goes from the minimal to the maximal non-turbo ratio,
+ * plus the single core turbo ratio when the processor reports it.
+ */
+static int msr_read_freqs(dvfs_core *core)
+{
+   const msr_core *mcore = core->priv;
+   uint64_t info = 0, turbo = 0;
+   unsigned int i;
+
+   int ret = dvfs_msr_read(mcore->fd, DVFS_MSR_PLATFORM_INFO, &info);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   unsigned int min_ratio = PLATFORM_INFO_MIN_RATIO(info);
+   unsigned int max_ratio = PLATFORM_INFO_MAX_RATIO(info);
+   if (min_ratio == 0 || max_ratio < min_ratio)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   unsigned int turbo_ratio = 0;
+   if (dvfs_msr_read(mcore->fd, DVFS_MSR_TURBO_RATIO_LIMIT, &turbo) == DVFS_SUCCESS
+       && (turbo & PERF_RATIO_MASK) > max_ratio)
+   {
+      turbo_ratio = turbo & PERF_RATIO_MASK;
+   }
+
+   core->nb_freqs = max_ratio - min_ratio + 1 + (turbo_ratio != 0);
+   core->freqs = malloc(core->nb_freqs * sizeof(*core->freqs));
+   if (core->freqs == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i <= max_ratio - min_ratio; i++)
+   {
+      core->freqs[i] = (min_ratio + i) * DVFS_MSR_BUS_CLOCK;
+   }
+   if (turbo_ratio != 0)
+   {
+      core->freqs[i] = turbo_ratio * DVFS_MSR_BUS_CLOCK;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int msr_get_gov(const dvfs_core *core, char *buf, size_t buf_len)
+{
+   return dvfs_backend_sysfs.get_gov(core, buf, buf_len);
+}
+
+static int msr_set_gov(const dvfs_core *core, const char *gov)
+{
+   return dvfs_backend_sysfs.set_gov(core, gov);
+}
+
+static int msr_set_freq(const dvfs_core *core, unsigned int freq)
+{
+   const msr_core *mcore = core->priv;
+   uint64_t ratio = freq / DVFS_MSR_BUS_CLOCK;
+
+   // keep the other fields (turbo disengage, ...) as found at init
+   uint64_t val = (mcore->init_perf_ctl & ~(PERF_RATIO_MASK << PERF_RATIO_SHIFT)) | (ratio << PERF_RATIO_SHIFT);
+
+   return dvfs_msr_write(mcore->fd, DVFS_MSR_IA32_PERF_CTL, val);
+}
+
+static int msr_get_freq(const dvfs_core *core, unsigned int *pFreq)
+{
+   const msr_core *mcore = core->priv;
+   uint64_t val = 0;
+
+   int ret = dvfs_msr_read(mcore->fd, DVFS_MSR_IA32_PERF_STATUS, &val);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   *pFreq = ((val >> PERF_RATIO_SHIFT) & PERF_RATIO_MASK) * DVFS_MSR_BUS_CLOCK;
+   return DVFS_SUCCESS;
+}
+
+static int msr_get_target(const dvfs_core *core, unsigned int *pFreq)
+{
+   const msr_core *mcore = core->priv;
+   uint64_t val = 0;
+
+   int ret = dvfs_msr_read(mcore->fd, DVFS_MSR_IA32_PERF_CTL, &val);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   *pFreq = ((val >> PERF_RATIO_SHIFT) & PERF_RATIO_MASK) * DVFS_MSR_BUS_CLOCK;
+   return DVFS_SUCCESS;
+}
+
+static unsigned int msr_get_nb_cores(void)
+{
+   return dvfs_backend_sysfs.get_nb_cores();
+}
+
+static void msr_get_related_cores(unsigned int id, unsigned int **cores, unsigned int *nb_cores)
+{
+   dvfs_backend_sysfs.get_related_cores(id, cores, nb_cores);
+}
+
+const dvfs_backend dvfs_backend_msr = {
+   .name = "msr",
+   .hardware = true,
+   .get_nb_cores = msr_get_nb_cores,
+   .get_related_cores = msr_get_related_cores,
+   .open = msr_open,
+   .close = msr_close,
+   .read_freqs = msr_read_freqs,
+   .get_gov = msr_get_gov,
+   .set_gov = msr_set_gov,
+   .set_freq = msr_set_freq,
+   .get_freq = msr_get_freq,
+   .get_target = msr_get_target,
+};
@@ -0,0 +1,762 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <cpuid.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dvfs_backend.h"
+#include "dvfs_core.h"
+#include "dvfs_error.h"
+#include "dvfs_gov.h"
+#include "dvfs_sysfs.h"
+
+// These patterns should be used in dvfs_sysfs_path functions
+#define SCALING_GOVERNOR_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_governor"
+#define SCALING_CURFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq"
+#define SCALING_AVAIL_FREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_available_frequencies"
+#define SCALING_SETSPEED_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_setspeed"
+#define SCALING_AVAIL_GOV_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_available_governors"
+#define SCALING_MINFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_min_freq"
+#define SCALING_MAXFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_max_freq"
+#define CPUINFO_MINFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/cpuinfo_min_freq"
+#define CPUINFO_MAXFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq"
+#define BASE_FREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/base_frequency"
+#define CPUINFO_LATENCY_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/cpuinfo_transition_latency"
+
+// Transition latency reported by the drivers that do not know it
+#define CPUFREQ_ETERNAL ((unsigned int) -1)
+
+/**
+ * Opens the governor file once for the lifetime of the core. Falls back to a
+ * read-only descriptor to allow instantiating the library without any write
+ * access: only setting the governor will then fail.
+ */
+static int open_governor(const dvfs_core* core)
+{
+    // the descriptor is only bookkeeping, it does not change the state of the
+    // core as seen by the caller
+    dvfs_core *pCore = (dvfs_core *) core;
+    char fname [256] = {0};
+
+    if (core->fd_gov >= 0)
+    {
+        return DVFS_SUCCESS;
+    }
+
+    // Paranoid: Make sure the fname buffer is long enough
+    assert (sizeof (SCALING_GOVERNOR_FILE_PATTERN) <= sizeof (fname));
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_GOVERNOR_FILE_PATTERN, core->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+
+    pCore->fd_gov = open(fname, O_RDWR | O_CLOEXEC);
+    if (pCore->fd_gov < 0)
+    {
+        pCore->fd_gov = open(fname, O_RDONLY | O_CLOEXEC);
+    }
+
+    return pCore->fd_gov < 0 ? DVFS_ERROR_FILE_ERROR : DVFS_SUCCESS;
+}
+
+static int read_governor(dvfs_core* pCore)
+{
+    char buf [128] = {0};
+
+    assert(pCore);
+
+    /* fetch  the initial governor and frequency */
+    int ret = open_governor(pCore);
+    if ( ret != DVFS_SUCCESS )
+    {
+        return ret;
+    }
+
+    // sysfs files are generated again when read from their beginning
+    ssize_t len = pread(pCore->fd_gov, buf, sizeof(buf) - 1, 0);
+    if (len > 0)
+    {
+        sscanf(buf, "%127s", pCore->init_gov);
+    }
+
+    return DVFS_SUCCESS;
+}
+
+static int read_cur_freq(dvfs_core* pCore)
+{
+    char fname [256] = {0};
+
+    assert(pCore);
+
+    assert (sizeof (SCALING_CURFREQ_FILE_PATTERN) <= sizeof (fname));
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_CURFREQ_FILE_PATTERN, pCore->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+        // No cleanup to do here
+    }
+
+    FILE* fd = fopen(fname, "r");
+    if (fd == NULL)
+    {
+        return DVFS_ERROR_FILE_ERROR;
+    }
+    fscanf(fd, "%u", &pCore->init_freq);
+    fclose(fd);
+
+    return DVFS_SUCCESS;
+}
+
+/**
+ * Enumerates the governors of the core and selects how the frequency is set:
+ * through scaling_setspeed if the driver provides the "userspace" governor, by
+ * pinning the limits otherwise.
+ */
+static int read_freq_ctrl(dvfs_core* pCore)
+{
+    char fname [256] = {0};
+    char govs [512] = {0};
+
+    assert(pCore);
+
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_AVAIL_GOV_FILE_PATTERN, pCore->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+
+    // without the list of governors, stick to scaling_setspeed
+    FILE* fd = fopen(fname, "r");
+    if (fd == NULL)
+    {
+        return DVFS_SUCCESS;
+    }
+    char* fgets_error = fgets(govs, sizeof(govs), fd);
+    fclose(fd);
+
+    if (fgets_error == NULL)
+    {
+        return DVFS_ERROR_FILE_ERROR;
+    }
+
+    pCore->ctrl = DVFS_CTRL_MINMAX;
+
+    char *tmpstr=NULL;
+    char *strtokctx=NULL;
+    uint32_t mask = 0;
+    bool complete = true;
+    for (tmpstr = strtok_r(govs, " \n", &strtokctx); tmpstr != NULL; tmpstr = strtok_r(NULL, " \n", &strtokctx))
+    {
+        unsigned int id;
+
+        if (strcmp(tmpstr, "userspace") == 0)
+        {
+            pCore->ctrl = DVFS_CTRL_SETSPEED;
+        }
+
+        if (dvfs_gov_intern(tmpstr, &id) == DVFS_SUCCESS)
+        {
+            mask |= UINT32_C(1) << id;
+        }
+        else
+        {
+            complete = false;
+        }
+    }
+
+    // a partial list would reject valid governors: rather check nothing
+    pCore->govs = complete ? mask : 0;
+
+    return DVFS_SUCCESS;
+}
+
+static int read_core_uint(const dvfs_core* pCore, const char *pattern, unsigned int *pVal)
+{
+    char fname [256] = {0};
+
+    if ( dvfs_sysfs_path (fname, sizeof (fname), pattern, pCore->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+
+    return dvfs_sysfs_read_uint(fname, pVal);
+}
+
+/**
+ * Builds the frequency table from the hardware limits when the driver does not
+ * list the available frequencies. The table goes from cpuinfo_min_freq to
+ * cpuinfo_max_freq by the step of the core and always contains the base frequency.
+ */
+static int synthesize_available_freq(dvfs_core* pCore)
+{
+    unsigned int min = 0, max = 0, base = 0;
+    int ret;
+
+    assert(pCore);
+
+    if ( (ret = read_core_uint(pCore, CPUINFO_MINFREQ_FILE_PATTERN, &min)) != DVFS_SUCCESS
+         || (ret = read_core_uint(pCore, CPUINFO_MAXFREQ_FILE_PATTERN, &max)) != DVFS_SUCCESS )
+    {
+        return ret;
+    }
+
+    if (min == 0 || max < min)
+    {
+        return DVFS_ERROR_FILE_ERROR;
+    }
+
+    // base_frequency is only exposed by some drivers (intel_pstate)
+    if (read_core_uint(pCore, BASE_FREQ_FILE_PATTERN, &base) != DVFS_SUCCESS
+        || base <= min || base >= max || (base - min) % pCore->freq_step == 0)
+    {
+        base = 0;
+    }
+
+    pCore->nb_freqs = (max - min) / pCore->freq_step + 1;
+    if ( (max - min) % pCore->freq_step != 0 )
+    {
+        pCore->nb_freqs++; // the maximal frequency
+    }
+    if ( base != 0 )
+    {
+        pCore->nb_freqs++;
+    }
+
+    pCore->freqs = malloc(pCore->nb_freqs * sizeof(*pCore->freqs));
+    if ( pCore->freqs == NULL )
+    {
+        return DVFS_ERROR_MEM_ALLOC_FAILED;
+    }
+
+    unsigned int i = 0;
+    unsigned int freq;
+    for (freq = min; freq < max; freq += pCore->freq_step)
+    {
+        if ( base != 0 && base < freq )
+        {
+            pCore->freqs[i++] = base;
+            base = 0;
+        }
+        pCore->freqs[i++] = freq;
+    }
+    if ( base != 0 )
+    {
+        pCore->freqs[i++] = base;
+    }
+    pCore->freqs[i++] = max;
+    assert (i == pCore->nb_freqs);
+
+    return DVFS_SUCCESS;
+}
+
+/**
+ * Opens the limit files and reads the limits to restore them later.
+ */
+static int open_limits(dvfs_core* pCore)
+{
+    char fname [256] = {0};
+    int ret;
+
+    assert(pCore);
+
+    if ( (ret = read_core_uint(pCore, SCALING_MINFREQ_FILE_PATTERN, &pCore->init_min_freq)) != DVFS_SUCCESS
+         || (ret = read_core_uint(pCore, SCALING_MAXFREQ_FILE_PATTERN, &pCore->init_max_freq)) != DVFS_SUCCESS )
+    {
+        return ret;
+    }
+    pCore->min_freq = pCore->init_min_freq;
+    pCore->max_freq = pCore->init_max_freq;
+
+    // as for scaling_setspeed, do not check the result to allow instantiating
+    // the library without any write access
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_MINFREQ_FILE_PATTERN, pCore->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+    pCore->fd_minf = fopen(fname, "w");
+
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_MAXFREQ_FILE_PATTERN, pCore->id) != DVFS_SUCCESS )
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+    pCore->fd_maxf = fopen(fname, "w");
+
+    return DVFS_SUCCESS;
+}
+
+static int write_freq(FILE *fd, unsigned int freq)
+{
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%u\n", freq);
+
+    // a single system call, without going through the stream buffer
+    if (pwrite(fileno(fd), buf, len, 0) != len)
+    {
+        return DVFS_ERROR_FILE_ERROR;
+    }
+
+    return DVFS_SUCCESS;
+}
+
+/**
+ * Sets the limits of a DVFS_CTRL_MINMAX core. The driver may reject a lower
+ * limit above the upper one: when the range moves up, the upper limit is
+ * written first.
+ */
+static int set_limits(const dvfs_core *core, unsigned int min, unsigned int max)
+{
+    // the limits currently set are only bookkeeping, they do not change the
+    // state of the core as seen by the caller
+    dvfs_core *pCore = (dvfs_core *) core;
+    int ret;
+
+    if (core->fd_minf == NULL || core->fd_maxf == NULL)
+    {
+        return DVFS_ERROR_SET_FREQ_FILE;
+    }
+
+    if (min > core->max_freq)
+    {
+        if ((ret = write_freq(core->fd_maxf, max)) == DVFS_SUCCESS)
+        {
+            pCore->max_freq = max;
+            if ((ret = write_freq(core->fd_minf, min)) == DVFS_SUCCESS)
+            {
+                pCore->min_freq = min;
+            }
+        }
+    }
+    else
+    {
+        if ((ret = write_freq(core->fd_minf, min)) == DVFS_SUCCESS)
+        {
+            pCore->min_freq = min;
+            if ((ret = write_freq(core->fd_maxf, max)) == DVFS_SUCCESS)
+            {
+                pCore->max_freq = max;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int sysfs_read_freqs(dvfs_core* pCore)
+{
+    char fname [256] = {0};
+
+    assert(pCore);
+    // Paranoid: Make sure the fname buffer is long enough
+    assert (sizeof (SCALING_AVAIL_FREQ_FILE_PATTERN) <= sizeof (fname));
+
+    /* parse all the frequencies */
+    if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_AVAIL_FREQ_FILE_PATTERN, pCore->id) != DVFS_SUCCESS)
+    {
+        return DVFS_ERROR_BUFFER_TOO_SHORT;
+    }
+
+    FILE* fd = fopen(fname, "r");
+    if (fd == NULL)
+    {
+        // Not provided by intel_pstate, amd-pstate, CPPC, ...
+        return synthesize_available_freq(pCore);
+    }
+
+    // Set freqs memory to zero
+    char freqs [1024] = {0};
+    char* fgets_error = fgets(freqs, sizeof(freqs), fd);
+    fclose(fd);
+
+    if (fgets_error == NULL)
+    {
+       return DVFS_ERROR_FILE_ERROR;
+    }
+
+    char *tmpstr=NULL;
+    bool inFreq = false;
+    // Count freqs number
+    for (tmpstr = freqs; *tmpstr; tmpstr++) {
+       if (*tmpstr >= '0' && *tmpstr <= '9') {
+          if (inFreq) {
+             continue;
+          }
+          pCore->nb_freqs++;
+          inFreq = true;
+       } else {
+          inFreq = false;
+       }
+    }
+
+    // Paranoid: No need to syscall malloc if no freqs are available
+    assert (pCore->nb_freqs > 0);
+
+    pCore->freqs = malloc(pCore->nb_freqs * sizeof(*pCore->freqs));
+    if ( pCore->freqs == NULL )
+    {
+        return DVFS_ERROR_MEM_ALLOC_FAILED;
+    }
+
+    unsigned int i=0;
+    char *strtokctx=NULL;
+    for (i = 0, tmpstr = strtok_r(freqs, " ", &strtokctx);
+         i < pCore->nb_freqs && tmpstr != NULL;
+         i++, tmpstr = strtok_r(NULL, " ", &strtokctx))
+    {
+       char *end;
+       pCore->freqs[pCore->nb_freqs - i - 1] = strtol (tmpstr, &end, 10);
+
+       // Paranoid: Check that what we have read in the file is valid
+       assert (end != tmpstr);
+    }
+    assert (i == pCore->nb_freqs);
+
+    return DVFS_SUCCESS;
+}
+
+static int sysfs_open(dvfs_core* pCore)
+{
+   char fname [256] = {0};
+   int id_error=DVFS_SUCCESS;
+
+   // Gets initial governor (to put it back later)
+   id_error = read_governor(pCore);
+   if ( id_error != DVFS_SUCCESS )
+   {
+       return id_error;
+   }
+
+   if (!strcmp(pCore->init_gov, "userspace")) // If it was userspace, we have
+                                              // to gets initial frequency
+                                              // to put it back later
+   {
+      id_error = read_cur_freq(pCore);
+      if ( id_error != DVFS_SUCCESS )
+      {
+          return id_error;
+      }
+   }
+
+   id_error = read_freq_ctrl(pCore);
+   if ( id_error != DVFS_SUCCESS)
+   {
+       return id_error;
+   }
+
+   if (pCore->ctrl == DVFS_CTRL_MINMAX)
+   {
+      id_error = open_limits(pCore);
+      if ( id_error != DVFS_SUCCESS)
+      {
+          return id_error;
+      }
+   }
+
+   // Paranoid: Make sure the fname buffer is long enough
+   assert (sizeof (SCALING_SETSPEED_FILE_PATTERN) <= sizeof (fname));
+
+   // open the frequency setter file
+   if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_SETSPEED_FILE_PATTERN, pCore->id) != DVFS_SUCCESS)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   if (pCore->ctrl == DVFS_CTRL_SETSPEED)
+   {
+      pCore->fd_setf = fopen(fname, "w");
+   }
+   // don't check the result here to allow instantiating the library without any
+   // write access. Only set freq will fail (with no trouble).
+
+   // Paranoid: Make sure the fname buffer is long enough
+   assert (sizeof (SCALING_CURFREQ_FILE_PATTERN) <= sizeof (fname));
+
+   // same for the frequency getter file
+   if ( dvfs_sysfs_path (fname, sizeof (fname), SCALING_CURFREQ_FILE_PATTERN, pCore->id) != DVFS_SUCCESS )
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   pCore->fd_getf = fopen(fname, "r");
+   if (pCore->fd_getf == NULL) {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static void sysfs_close(dvfs_core *core)
+{
+   // the limits have been restored by dvfs_core_restore()
+   if (core->fd_setf != NULL) {
+      fclose(core->fd_setf), core->fd_setf = NULL;
+   }
+
+   if (core->fd_getf != NULL) {
+      fclose(core->fd_getf), core->fd_getf = NULL;
+   }
+
+   if (core->fd_minf != NULL) {
+      fclose(core->fd_minf), core->fd_minf = NULL;
+   }
+
+   if (core->fd_maxf != NULL) {
+      fclose(core->fd_maxf), core->fd_maxf = NULL;
+   }
+}
+
+static int sysfs_get_gov (const dvfs_core *core, char *buf, size_t buf_len) {
+   // room for the NUL byte at least
+   if (buf_len == 0)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   int ret = open_governor(core);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   ssize_t len = pread(core->fd_gov, buf, buf_len - 1, 0);
+   if (len <= 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+
+   return DVFS_SUCCESS;
+}
+
+static int sysfs_set_gov(const dvfs_core *core, const char *gov) {
+   // pinning the limits does not need any specific governor
+   if (core->ctrl == DVFS_CTRL_MINMAX && strcmp(gov, "userspace") == 0)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   int ret = open_governor(core);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   ssize_t len = strlen(gov);
+   if (pwrite(core->fd_gov, gov, len, 0) != len)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int sysfs_set_freq(const dvfs_core *core, unsigned int freq) {
+   if (core->ctrl == DVFS_CTRL_MINMAX)
+   {
+      return set_limits(core, freq, freq);
+   }
+
+   // If fd_freq has not been opened yet
+   if (core->fd_setf == NULL)
+   {
+      return DVFS_ERROR_SET_FREQ_FILE;
+   }
+
+   return write_freq(core->fd_setf, freq);
+}
+
+static int sysfs_get_freq(const dvfs_core *core, unsigned int* pFreq) {
+   char buf[16];
+
+   // sysfs files are generated again when read from their beginning
+   ssize_t len = pread(fileno(core->fd_getf), buf, sizeof(buf) - 1, 0);
+   if (len <= 0) {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+   *pFreq = strtoul(buf, NULL, 10);
+
+   return DVFS_SUCCESS;
+}
+
+static int sysfs_get_target(const dvfs_core *core, unsigned int *pFreq) {
+   // pinned limits are the target, looser ones leave the choice to the governor
+   if (core->ctrl == DVFS_CTRL_MINMAX)
+   {
+      if (core->min_freq != core->max_freq)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+      *pFreq = core->min_freq;
+      return DVFS_SUCCESS;
+   }
+
+   // only a number with the "userspace" governor
+   return read_core_uint(core, SCALING_SETSPEED_FILE_PATTERN, pFreq);
+}
+
+static int sysfs_get_latency(const dvfs_core *core, unsigned int *pLatency) {
+   int ret = read_core_uint(core, CPUINFO_LATENCY_FILE_PATTERN, pLatency);
+   if (ret == DVFS_SUCCESS && *pLatency == CPUFREQ_ETERNAL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return ret;
+}
+
+static unsigned int sysfs_get_nb_cores() {
+   unsigned int nb_cores = 0;
+
+   nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+   if (nb_cores < 1) // This sysconf is not always available
+   {
+      // Second try
+      FILE* pFile = NULL;
+      pFile = fopen("/proc/cpuinfo", "r");
+      if (pFile == NULL) {
+         return 0;
+      }
+
+      char buf [2048];
+      while (fgets(buf, sizeof(buf), pFile) != NULL) {
+         if (!strncmp (buf, "processor", 9)) {
+            nb_cores++;
+         }
+      }
+
+      fclose(pFile);
+   }
+
+   return nb_cores;
+}
+
+static void sysfs_get_related_cores(unsigned int id, unsigned int **cores, unsigned int *nb_cores) {
+   unsigned int val, i;
+   char relfile[1024];
+   FILE *fd;
+   struct stat buf;
+
+   assert(cores != NULL && nb_cores != NULL);
+
+   // all Linux files are broken in some versions... first rely on the manufacturer
+   __get_cpuid(0, &i, (unsigned int *) relfile, (unsigned int *) (relfile + 8),
+               (unsigned int *) (relfile + 4));
+   relfile[12] = '\0';
+
+   // Intel platforms have a single frequency domain
+   if (strncmp(relfile, "GenuineIntel", 12) == 0) {
+      dvfs_sysfs_path(relfile, sizeof(relfile), "/devices/system/cpu/cpu%u/topology/core_siblings_list", id);
+   } else {
+      // prefer the more recent freq_domain_cpus over related_cpus
+      dvfs_sysfs_path(relfile, sizeof(relfile), "/devices/system/cpu/cpu%u/cpufreq/freqdomain_cpus", id);
+      if (stat(relfile, &buf) < 0) {
+         dvfs_sysfs_path(relfile, sizeof(relfile), "/devices/system/cpu/cpu%u/cpufreq/related_cpus", id);
+      }
+   }
+
+   if ((fd = fopen(relfile, "r")) == NULL) {
+      *nb_cores = 0;
+      *cores = NULL;
+      return;
+   }
+
+   // parse the file
+   // supports space-separated list of values and condensed format
+   // (comma-separated list with dash notation for contiguous lists)
+   // only counting here
+   *nb_cores = 0;
+   while (fscanf(fd, "%u", &val) == 1) {
+      unsigned int nval;
+      char sep;
+
+      int fret = fscanf(fd, "%c", &sep);
+
+      if (fret == EOF || fret == 0 || sep == ' ' || sep == ',' || sep == '\n') {
+         (*nb_cores)++;
+         continue;
+      }
+
+      if (sep != '-') { // Error case ... no format recognized here
+         fprintf(stderr, "[LIBDVFS][ERROR] Illformed topology file: expected '-', read '%c' \n", sep);
+         *nb_cores = 0;
+         *cores = NULL;
+         return;
+      }
+
+      // Treat the second file (since first did not match) format (0-N)
+      fscanf(fd, "%u", &nval);
+      *nb_cores += nval - val + 1;
+
+      fscanf(fd, "%c", &sep);
+   }
+
+   *cores = malloc(*nb_cores * sizeof(**cores));
+   fseek(fd, 0, SEEK_SET);
+
+   // now fill the array
+   i = 0;
+   while (fscanf(fd, "%u", &val) == 1 && i < *nb_cores) {
+      unsigned int nval;
+      char sep;
+
+      fscanf(fd, "%c", &sep);
+
+      if ( sep == '\n' ) // File finished, we guess, we have count everything
+      {
+         (*cores)[i++] = val;
+         break; // Leave
+      }
+      if (sep == ' ' || sep == ',') {
+         (*cores)[i++] = val;
+         continue;
+      }
+
+      fscanf(fd, "%u", &nval);
+      unsigned int j;
+      for (j = 0; j < nval - val + 1; j++) {
+         (*cores)[i + j] = val + j;
+      }
+      i += j;
+
+      fscanf(fd, "%c", &sep);
+   }
+
+   fclose(fd);
+}
+
+const dvfs_backend dvfs_backend_sysfs = {
+   .name = "sysfs",
+   .hardware = true,
+   .get_nb_cores = sysfs_get_nb_cores,
+   .get_related_cores = sysfs_get_related_cores,
+   .open = sysfs_open,
+   .close = sysfs_close,
+   .read_freqs = sysfs_read_freqs,
+   .get_gov = sysfs_get_gov,
+   .set_gov = sysfs_set_gov,
+   .set_freq = sysfs_set_freq,
+   .get_freq = sysfs_get_freq,
+   .set_limits = set_limits,
+   .get_target = sysfs_get_target,
+   .get_latency = sysfs_get_latency,
+};
@@ -0,0 +1,561 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dvfs_bulk.h"
+#include "dvfs_error.h"
+#include "dvfs_state.h"
+#include "dvfs_sysfs.h"
+
+#define SCALING_CURFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq"
+#define SCALING_SETSPEED_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_setspeed"
+
+// Highest number of entries in the submission queue
+#define URING_MAX_ENTRIES 256
+
+// Size of the buffer holding a frequency
+#define FREQ_BUF_LEN 32
+
+/**
+ * io_uring instance accessed through the raw system calls, the rings being
+ * mapped in memory.
+ */
+struct dvfs_uring {
+   int fd;                          //!< io_uring file descriptor
+   unsigned int entries;            //!< Number of entries of the submission queue
+
+   void *sq_ptr;                    //!< Mapping of the submission ring
+   size_t sq_len;                   //!< Size of the submission ring mapping
+   void *cq_ptr;                    //!< Mapping of the completion ring (may be sq_ptr)
+   size_t cq_len;                   //!< Size of the completion ring mapping
+   struct io_uring_sqe *sqes;       //!< Submission queue entries
+   size_t sqes_len;                 //!< Size of the entries mapping
+
+   unsigned int *sq_tail;           //!< Tail of the submission ring
+   unsigned int *sq_mask;           //!< Mask of the submission ring
+   unsigned int *sq_array;          //!< Indexes of the submitted entries
+   unsigned int *cq_head;           //!< Head of the completion ring
+   unsigned int *cq_tail;           //!< Tail of the completion ring
+   unsigned int *cq_mask;           //!< Mask of the completion ring
+   struct io_uring_cqe *cqes;       //!< Completion queue entries
+
+   char (*bufs)[FREQ_BUF_LEN];      //!< Read buffer of each core
+   unsigned int *files;             //!< Registered files of a batch, one per core at most
+   int *res;                        //!< Results of a batch, one per core at most
+};
+
+static void uring_close(struct dvfs_uring *ring)
+{
+   if (ring->sqes != NULL)
+   {
+      munmap(ring->sqes, ring->sqes_len);
+   }
+   if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr)
+   {
+      munmap(ring->cq_ptr, ring->cq_len);
+   }
+   if (ring->sq_ptr != NULL)
+   {
+      munmap(ring->sq_ptr, ring->sq_len);
+   }
+   if (ring->fd >= 0)
+   {
+      close(ring->fd);
+   }
+   free(ring->bufs);
+   free(ring->files);
+   free(ring->res);
+   free(ring);
+}
+
+/**
+ * Sets up an io_uring instance and registers the files. Returns NULL if
+ * io_uring is not available.
+ */
+static struct dvfs_uring *uring_open(unsigned int nb_cores, const int *fds, unsigned int nb_fds)
+{
+   struct io_uring_params params;
+
+   struct dvfs_uring *ring = calloc(1, sizeof(*ring));
+   if (ring == NULL)
+   {
+      return NULL;
+   }
+
+   ring->bufs = malloc(nb_cores * sizeof(*ring->bufs));
+   ring->files = malloc(nb_cores * sizeof(*ring->files));
+   ring->res = malloc(nb_cores * sizeof(*ring->res));
+   ring->entries = nb_cores < URING_MAX_ENTRIES ? nb_cores : URING_MAX_ENTRIES;
+   memset(&params, 0, sizeof(params));
+   ring->fd = syscall(__NR_io_uring_setup, ring->entries, &params);
+   if (ring->bufs == NULL || ring->files == NULL || ring->res == NULL || ring->fd < 0)
+   {
+      uring_close(ring);
+      return NULL;
+   }
+   ring->entries = params.sq_entries;
+
+   ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+   ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+   if (params.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      ring->sq_len = ring->cq_len = ring->sq_len > ring->cq_len ? ring->sq_len : ring->cq_len;
+   }
+
+   ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+   if (ring->sq_ptr == MAP_FAILED)
+   {
+      ring->sq_ptr = NULL;
+      uring_close(ring);
+      return NULL;
+   }
+
+   if (params.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      ring->cq_ptr = ring->sq_ptr;
+   }
+   else
+   {
+      ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+      if (ring->cq_ptr == MAP_FAILED)
+      {
+         ring->cq_ptr = NULL;
+         uring_close(ring);
+         return NULL;
+      }
+   }
+
+   ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+   ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+   if (ring->sqes == MAP_FAILED)
+   {
+      ring->sqes = NULL;
+      uring_close(ring);
+      return NULL;
+   }
+
+   ring->sq_tail = (unsigned int *) ((char *) ring->sq_ptr + params.sq_off.tail);
+   ring->sq_mask = (unsigned int *) ((char *) ring->sq_ptr + params.sq_off.ring_mask);
+   ring->sq_array = (unsigned int *) ((char *) ring->sq_ptr + params.sq_off.array);
+   ring->cq_head = (unsigned int *) ((char *) ring->cq_ptr + params.cq_off.head);
+   ring->cq_tail = (unsigned int *) ((char *) ring->cq_ptr + params.cq_off.tail);
+   ring->cq_mask = (unsigned int *) ((char *) ring->cq_ptr + params.cq_off.ring_mask);
+   ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ptr + params.cq_off.cqes);
+
+   // registered files save the descriptor lookup of every operation
+   if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, fds, nb_fds) < 0)
+   {
+      uring_close(ring);
+      return NULL;
+   }
+
+   return ring;
+}
+
+/**
+ * Submits a batch of operations on registered files at offset 0 and waits
+ * for their completion. The result of operation i is stored in res[i].
+ */
+static int uring_submit(struct dvfs_uring *ring, unsigned int nb, int opcode, const unsigned int *files,
+                        char (*bufs)[FREQ_BUF_LEN], const char *wbuf, size_t wlen, int *res)
+{
+   unsigned int done = 0;
+
+   while (done < nb)
+   {
+      unsigned int i;
+      unsigned int batch = nb - done < ring->entries ? nb - done : ring->entries;
+      unsigned int tail = *ring->sq_tail;
+
+      for (i = 0; i < batch; i++)
+      {
+         unsigned int idx = (tail + i) & *ring->sq_mask;
+         struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+         memset(sqe, 0, sizeof(*sqe));
+         sqe->opcode = opcode;
+         sqe->flags = IOSQE_FIXED_FILE;
+         sqe->fd = files[done + i];
+         sqe->off = 0;
+         if (opcode == IORING_OP_READ)
+         {
+            sqe->addr = (unsigned long) bufs[done + i];
+            sqe->len = FREQ_BUF_LEN - 1;
+         }
+         else
+         {
+            sqe->addr = (unsigned long) wbuf;
+            sqe->len = wlen;
+         }
+         sqe->user_data = done + i;
+         ring->sq_array[idx] = idx;
+      }
+      __atomic_store_n(ring->sq_tail, tail + batch, __ATOMIC_RELEASE);
+
+      // a signal may interrupt the wait: the entries already consumed are
+      // not submitted again and the completions already posted are counted
+      long eret;
+      while ((eret = syscall(__NR_io_uring_enter, ring->fd, batch, batch, IORING_ENTER_GETEVENTS, NULL, 0)) < 0
+             && errno == EINTR);
+      if (eret < 0)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+
+      // all the operations of the batch are completed
+      unsigned int head = *ring->cq_head;
+      unsigned int ctail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != ctail; head++)
+      {
+         const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+         res[cqe->user_data] = cqe->res;
+      }
+      __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+      done += batch;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int open_file(const char *pattern, unsigned int id, int flags, int *pFd)
+{
+   char fname[256];
+
+   int ret = dvfs_sysfs_path(fname, sizeof(fname), pattern, id);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   *pFd = open(fname, flags | O_CLOEXEC);
+   return *pFd < 0 ? DVFS_ERROR_FILE_ERROR : DVFS_SUCCESS;
+}
+
+int dvfs_bulk_open(dvfs_bulk **ppBulk, unsigned int nb_units, dvfs_unit **units, bool use_uring)
+{
+   unsigned int i, j, nb_cores = 0;
+
+   assert(ppBulk != NULL);
+   assert(units != NULL);
+   if (ppBulk == NULL || units == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      for (j = 0; j < units[i]->nb_cores; j++)
+      {
+         if (units[i]->cores[j]->backend != &dvfs_backend_sysfs)
+         {
+            return DVFS_ERROR_INVALID_ARG;
+         }
+      }
+      nb_cores += units[i]->nb_cores;
+   }
+
+   dvfs_bulk *bulk = calloc(1, sizeof(*bulk));
+   if (bulk == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   *ppBulk = bulk;
+
+   bulk->cores = malloc(nb_cores * sizeof(*bulk->cores));
+   bulk->fd_getf = malloc(nb_cores * sizeof(*bulk->fd_getf));
+   bulk->fd_setf = malloc(nb_cores * sizeof(*bulk->fd_setf));
+   if (bulk->cores == NULL || bulk->fd_getf == NULL || bulk->fd_setf == NULL)
+   {
+      dvfs_bulk_close(bulk);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      for (j = 0; j < units[i]->nb_cores; j++)
+      {
+         dvfs_core *core = units[i]->cores[j];
+         unsigned int c = bulk->nb_cores++;
+
+         bulk->cores[c] = core;
+         bulk->fd_setf[c] = -1;
+         if (bulk->sem == NULL)
+         {
+            bulk->sem = core->sem;
+         }
+
+         int ret = open_file(SCALING_CURFREQ_FILE_PATTERN, core->id, O_RDONLY, &bulk->fd_getf[c]);
+         if (ret != DVFS_SUCCESS)
+         {
+            bulk->fd_getf[c] = -1;
+            dvfs_bulk_close(bulk);
+            return ret;
+         }
+
+         // as for the cores, a missing write access only fails the writes
+         if (core->ctrl == DVFS_CTRL_SETSPEED)
+         {
+            open_file(SCALING_SETSPEED_FILE_PATTERN, core->id, O_WRONLY, &bulk->fd_setf[c]);
+         }
+      }
+   }
+
+   if (use_uring && nb_cores > 0)
+   {
+      // the getters first, then the setters (or a placeholder, never written)
+      int *fds = malloc(2 * nb_cores * sizeof(*fds));
+      if (fds != NULL)
+      {
+         for (i = 0; i < nb_cores; i++)
+         {
+            fds[i] = bulk->fd_getf[i];
+            fds[nb_cores + i] = bulk->fd_setf[i] >= 0 ? bulk->fd_setf[i] : bulk->fd_getf[i];
+         }
+         bulk->uring = uring_open(nb_cores, fds, 2 * nb_cores);
+         free(fds);
+      }
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_bulk_close(dvfs_bulk *bulk)
+{
+   unsigned int i;
+
+   assert(bulk != NULL);
+   if (bulk == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (bulk->uring != NULL)
+   {
+      uring_close(bulk->uring);
+   }
+
+   for (i = 0; i < bulk->nb_cores; i++)
+   {
+      if (bulk->fd_getf[i] >= 0)
+      {
+         close(bulk->fd_getf[i]);
+      }
+      if (bulk->fd_setf[i] >= 0)
+      {
+         close(bulk->fd_setf[i]);
+      }
+   }
+
+   free(bulk->cores);
+   free(bulk->fd_getf);
+   free(bulk->fd_setf);
+   free(bulk);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_bulk_read_freqs(const dvfs_bulk *bulk, unsigned int *freqs)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(bulk != NULL);
+   assert(freqs != NULL);
+   if (bulk == NULL || freqs == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (bulk->uring != NULL)
+   {
+      unsigned int *files = bulk->uring->files;
+      int *res = bulk->uring->res;
+
+      for (i = 0; i < bulk->nb_cores; i++)
+      {
+         files[i] = i;
+         res[i] = -EIO;
+      }
+
+      ret = uring_submit(bulk->uring, bulk->nb_cores, IORING_OP_READ, files, bulk->uring->bufs, NULL, 0, res);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+
+      for (i = 0; i < bulk->nb_cores; i++)
+      {
+         freqs[i] = 0;
+         if (res[i] <= 0)
+         {
+            ret = DVFS_ERROR_FILE_ERROR;
+            continue;
+         }
+         bulk->uring->bufs[i][res[i]] = '\0';
+         freqs[i] = strtoul(bulk->uring->bufs[i], NULL, 10);
+      }
+      return ret;
+   }
+
+   for (i = 0; i < bulk->nb_cores; i++)
+   {
+      char buf[FREQ_BUF_LEN];
+
+      // sysfs files are generated again when read from their beginning
+      ssize_t len = pread(bulk->fd_getf[i], buf, sizeof(buf) - 1, 0);
+      freqs[i] = 0;
+      if (len <= 0)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+         continue;
+      }
+      buf[len] = '\0';
+      freqs[i] = strtoul(buf, NULL, 10);
+   }
+
+   return ret;
+}
+
+/**
+ * Tells if the frequency is in the table of the core.
+ */
+static bool has_freq(const dvfs_core *core, unsigned int freq)
+{
+   unsigned int i;
+
+   for (i = 0; i < core->nb_freqs; i++)
+   {
+      if (core->freqs[i] == freq)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+int dvfs_bulk_set_freq(const dvfs_bulk *bulk, unsigned int freq)
+{
+   char buf[FREQ_BUF_LEN];
+   unsigned int i, nb_files = 0;
+   int ret = DVFS_SUCCESS;
+
+   assert(bulk != NULL);
+   if (bulk == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < bulk->nb_cores; i++)
+   {
+      if (!has_freq(bulk->cores[i], freq))
+      {
+         return DVFS_ERROR_INVALID_FREQ;
+      }
+   }
+
+   // the limits have to be written in order, through the core
+   for (i = 0; i < bulk->nb_cores; i++)
+   {
+      const dvfs_core *core = bulk->cores[i];
+
+      if (core->fenced)
+      {
+         ret = DVFS_ERROR_NOT_LEASED;
+      }
+      else if (core->ctrl == DVFS_CTRL_MINMAX)
+      {
+         int cret = dvfs_core_set_freq(core, freq);
+         if (cret != DVFS_SUCCESS)
+         {
+            ret = cret;
+         }
+      }
+   }
+
+   // the other cores are written directly, sequentialized with the
+   // transitions of the cores
+   int len = snprintf(buf, sizeof(buf), "%u\n", freq);
+   SAFE_SEM_WAIT(bulk->sem);
+
+   for (i = 0; i < bulk->nb_cores; i++)
+   {
+      const dvfs_core *core = bulk->cores[i];
+
+      if (core->fenced || core->ctrl == DVFS_CTRL_MINMAX)
+      {
+         continue;
+      }
+
+      if (bulk->fd_setf[i] < 0)
+      {
+         ret = DVFS_ERROR_SET_FREQ_FILE;
+         continue;
+      }
+
+      if (bulk->uring != NULL)
+      {
+         bulk->uring->files[nb_files] = bulk->nb_cores + i;
+         bulk->uring->res[nb_files++] = -EIO;
+      }
+      else if (pwrite(bulk->fd_setf[i], buf, len, 0) != len)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+      else if (core->state != NULL)
+      {
+         dvfs_state_publish_target(core->state, freq);
+      }
+   }
+
+   if (nb_files > 0)
+   {
+      int uret = uring_submit(bulk->uring, nb_files, IORING_OP_WRITE, bulk->uring->files, NULL, buf, len, bulk->uring->res);
+      for (i = 0; i < nb_files; i++)
+      {
+         const dvfs_core *core = bulk->cores[bulk->uring->files[i] - bulk->nb_cores];
+
+         if (uret != DVFS_SUCCESS)
+         {
+            ret = uret;
+         }
+         else if (bulk->uring->res[i] != len)
+         {
+            ret = DVFS_ERROR_FILE_ERROR;
+         }
+         else if (core->state != NULL)
+         {
+            dvfs_state_publish_target(core->state, freq);
+         }
+      }
+   }
+
+   SAFE_SEM_POST(bulk->sem);
+
+   return ret;
+}
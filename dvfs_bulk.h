@@ -0,0 +1,113 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_bulk.h
+ *
+ * Bulk reads and writes of the frequency of many cores. The \c scaling_cur_freq
+ * and \c scaling_setspeed files of every core are opened once, and a whole
+ * snapshot (or a frequency change of all the cores) is submitted as a single
+ * batch through io_uring, costing one system call instead of one or more per
+ * core. When io_uring is not available (old kernel, seccomp filter), the same
+ * operations fall back to one pread/pwrite per core. Even the fallback saves
+ * the stdio buffering and the rewind of every core access. The kernel may
+ * complete the sysfs operations of a batch in its worker threads: compare both
+ * paths on the target machine with \c bench_bulk.
+ *
+ * Only the cores of the sysfs backend are supported. The cores controlled by
+ * pinning their limits (DVFS_CTRL_MINMAX) are written through
+ * dvfs_core_set_freq(), one after the other. The other writes take the
+ * semaphore of the cores once for the whole batch, the reads do not take it.
+ * A bulk access is used by one thread at a time.
+ */
+
+struct dvfs_uring;
+
+/**
+ * Bulk access to the cores of several DVFS units.
+ */
+typedef struct {
+   unsigned int nb_cores;     //!< Number of cores
+   dvfs_core **cores;         //!< The cores, in the order of the snapshots
+   int *fd_getf;              //!< Raw descriptors toward \c scaling_cur_freq
+   int *fd_setf;              //!< Raw descriptors toward \c scaling_setspeed, -1 if not available
+   struct dvfs_uring *uring;  //!< io_uring instance, NULL when using the fallback
+   sem_t *sem;                //!< Semaphore sequentializing the transitions, shared by the cores (see dvfs_core_open()), NULL if none
+} dvfs_bulk;
+
+/**
+ * Opens a bulk access to the cores of the given DVFS units.
+ *
+ * @param ppBulk Will be filled with the bulk access.
+ * @param nb_units The number of DVFS units.
+ * @param units The DVFS units, for instance the ones of a context.
+ * @param use_uring False to always use the fallback path.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppBulk or \c units are NULL, or a core does not use the sysfs backend.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if a path does not fit in the buffers.
+ *         \retval DVFS_ERROR_FILE_ERROR if a \c scaling_cur_freq file cannot be opened.
+ *
+ * @sa dvfs_bulk_close()
+ */
+int dvfs_bulk_open(dvfs_bulk **ppBulk, unsigned int nb_units, dvfs_unit **units, bool use_uring);
+
+/**
+ * Closes a bulk access. The cores are not closed.
+ *
+ * @param bulk The bulk access.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c bulk is NULL.
+ */
+int dvfs_bulk_close(dvfs_bulk *bulk);
+
+/**
+ * Reads the current frequency of all the cores.
+ *
+ * @param bulk The bulk access.
+ * @param freqs The array to fill, \c bulk->nb_cores entries in the order of
+ * \c bulk->cores.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c bulk or \c freqs are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a frequency cannot be read (the other entries are still filled).
+ */
+int dvfs_bulk_read_freqs(const dvfs_bulk *bulk, unsigned int *freqs);
+
+/**
+ * Sets the same frequency on all the cores. The effects are unknown if the
+ * current governor is not "userspace". The frequency is published for the
+ * units whose state is published (see dvfs_state.h).
+ *
+ * @param bulk The bulk access.
+ * @param freq The frequency to set.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c bulk is NULL.
+ *         \retval DVFS_ERROR_INVALID_FREQ if a core does not support the frequency (nothing is written).
+ *         \retval DVFS_ERROR_SET_FREQ_FILE if a \c scaling_setspeed file is not available.
+ *         \retval DVFS_ERROR_FILE_ERROR if a frequency cannot be written.
+ */
+int dvfs_bulk_set_freq(const dvfs_bulk *bulk, unsigned int freq);
@@ -0,0 +1,197 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Measures how the runtime and the energy of the kernels of dvfs_profile.h
+ * scale with the frequency of every unit, and writes the profile of the
+ * machine. Meant to be run as root on an otherwise idle machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+static void usage(const char *name) {
+   printf("Measures the frequency sensitivity of the units and writes the profile of the machine\n\n");
+   printf("Usage: %s [-o profile] [-u unit]... [-k kernels] [-x kernel.so] [-w warmup] [-r repetitions] [-d duration] [-m]\n", name);
+   printf("  -o  Profile to write, %s unless set in the %s environment variable\n", DVFS_PROFILE_DEFAULT_PATH, DVFS_PROFILE_PATH_ENV);
+   printf("  -u  Unit to characterize, all the units by default\n");
+   printf("  -k  Comma separated kernels among compute,l1,l2,l3,dram (all by default)\n");
+   printf("  -x  Shared object exporting %s(unsigned long long n), run as the user kernel\n", DVFS_PROFILE_USER_SYMBOL);
+   printf("  -w  Repetitions run before measuring (default 2)\n");
+   printf("  -r  Repetitions measured (default 5)\n");
+   printf("  -d  Duration of a repetition at the highest frequency in microseconds (default 50000)\n");
+   printf("  -m  Uses the in-memory mock backend instead of the hardware (testing)\n");
+}
+
+/**
+ * Parses a list of kernel names, returns 0 if a name is unknown.
+ */
+static uint32_t parse_kernels(char *list) {
+   uint32_t kernels = 0;
+   char *name;
+   unsigned int k;
+
+   for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+      for (k = 0; k < DVFS_KERNEL_USER && strcmp(name, dvfs_profile_kernel_name(k)) != 0; k++);
+      if (k == DVFS_KERNEL_USER) {
+         return 0;
+      }
+      kernels |= 1U << k;
+   }
+   return kernels;
+}
+
+static void print_unit(const dvfs_profile *profile, unsigned int unit_id) {
+   const dvfs_profile_curve *curve;
+   unsigned int k, i;
+
+   for (k = 0; k < DVFS_KERNEL_NB; k++) {
+      dvfs_profile_get_curve(profile, unit_id, k, &curve);
+      for (i = 0; i < curve->nb_points; i++) {
+         const dvfs_profile_point *point = &curve->points[i];
+         printf("unit %u %-8s %8u kHz %10.6f s", unit_id, dvfs_profile_kernel_name(k), point->freq, point->time);
+         if (point->energy >= 0) {
+            printf(" %10.6f J", point->energy);
+         }
+         if (point->eff_freq != 0) {
+            printf(" %8u kHz effective", point->eff_freq);
+         }
+         printf("\n");
+      }
+   }
+}
+
+int main(int argc, char **argv) {
+   const dvfs_backend *backend = &dvfs_backend_sysfs;
+   const char *path = NULL;
+   dvfs_ctx *ctx = NULL;
+   dvfs_profile *profile = NULL;
+   unsigned int units[256];
+   unsigned int nb_units = 0;
+   unsigned int i;
+   int opt;
+   dvfs_profile_config config = {
+      .kernels = (1U << DVFS_KERNEL_USER) - 1,
+      .warmup = 2,
+      .repetitions = 5,
+      .duration_us = 50000,
+      .user_kernel = NULL,
+   };
+
+   while ((opt = getopt(argc, argv, "o:u:k:x:w:r:d:mh")) != -1) {
+      switch (opt) {
+         case 'o':
+            path = optarg;
+            break;
+         case 'u':
+            if (nb_units == sizeof(units) / sizeof(*units)) {
+               usage(argv[0]);
+               return EXIT_FAILURE;
+            }
+            units[nb_units++] = atoi(optarg);
+            break;
+         case 'k':
+            config.kernels = parse_kernels(optarg);
+            if (config.kernels == 0) {
+               usage(argv[0]);
+               return EXIT_FAILURE;
+            }
+            break;
+         case 'x':
+            config.user_kernel = optarg;
+            break;
+         case 'w':
+            config.warmup = atoi(optarg);
+            break;
+         case 'r':
+            config.repetitions = atoi(optarg);
+            break;
+         case 'd':
+            config.duration_us = atoi(optarg);
+            break;
+         case 'm':
+            backend = &dvfs_backend_mock;
+            break;
+         case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+         default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+   if (config.user_kernel != NULL) {
+      config.kernels |= 1U << DVFS_KERNEL_USER;
+   }
+
+   int result = dvfs_start_backend(&ctx, false, backend);
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to start the library (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   // the units not characterized keep the curves of the existing profile
+   if (dvfs_profile_load(&profile, path) != DVFS_SUCCESS || profile->nb_units != ctx->nb_units) {
+      if (profile != NULL) {
+         dvfs_profile_free(profile);
+      }
+      result = dvfs_profile_create(&profile, ctx->nb_units);
+      if (result != DVFS_SUCCESS) {
+         printf("Unable to create the profile (%s).\n", dvfs_strerror(result));
+         dvfs_stop(ctx);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (nb_units == 0) {
+      for (i = 0; i < ctx->nb_units; i++) {
+         units[nb_units++] = i;
+      }
+   }
+
+   for (i = 0; i < nb_units && result == DVFS_SUCCESS; i++) {
+      const dvfs_unit *unit = NULL;
+
+      result = dvfs_get_unit_by_id(ctx, &unit, units[i]);
+      if (result != DVFS_SUCCESS) {
+         printf("Unknown unit %u (%s).\n", units[i], dvfs_strerror(result));
+         break;
+      }
+
+      result = dvfs_profile_characterize(ctx, unit, &config, profile);
+      if (result != DVFS_SUCCESS) {
+         printf("Unable to characterize unit %u (%s).\n", units[i], dvfs_strerror(result));
+         break;
+      }
+      print_unit(profile, units[i]);
+   }
+
+   if (result == DVFS_SUCCESS) {
+      result = dvfs_profile_save(profile, path);
+      if (result != DVFS_SUCCESS) {
+         printf("Unable to write the profile (%s).\n", dvfs_strerror(result));
+      }
+   }
+
+   dvfs_profile_free(profile);
+   dvfs_stop(ctx);
+   return result == DVFS_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,249 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dvfs_client.h"
+#include "dvfs_error.h"
+#include "dvfs_proto.h"
+
+// Interval between two checks of the connection while waiting for a completion
+#define CLIENT_WAIT_NS 100000000
+
+struct dvfs_client {
+   int sock;                  //!< Connection to the daemon, only watched for its end
+   int doorbell;              //!< eventfd waking the daemon
+   dvfs_proto_ring *ring;     //!< Shared request ring
+   unsigned int nb_units;     //!< Number of units of the daemon
+   pthread_mutex_t lock;      //!< Serializes the requests
+};
+
+/**
+ * Receives the answer to the hello message and the descriptors.
+ */
+static int recv_welcome(int sock, dvfs_proto_welcome *welcome, int *ring_fd, int *doorbell)
+{
+   struct iovec iov = { .iov_base = welcome, .iov_len = sizeof(*welcome) };
+   char control[CMSG_SPACE(2 * sizeof(int))];
+   struct msghdr msg;
+   struct cmsghdr *cmsg;
+   int fds[2];
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control;
+   msg.msg_controllen = sizeof(control);
+
+   if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != (ssize_t) sizeof(*welcome))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   if (welcome->status != DVFS_SUCCESS)
+   {
+      return welcome->status;
+   }
+
+   cmsg = CMSG_FIRSTHDR(&msg);
+   if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+         || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+   *ring_fd = fds[0];
+   *doorbell = fds[1];
+   return DVFS_SUCCESS;
+}
+
+int dvfs_client_open(dvfs_client **ppClient, const char *path)
+{
+   dvfs_proto_hello hello = { .magic = DVFS_PROTO_MAGIC, .version = DVFS_PROTO_VERSION };
+   dvfs_proto_welcome welcome;
+   struct sockaddr_un addr;
+   int ring_fd;
+   int ret;
+
+   assert(ppClient != NULL);
+   if (ppClient == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (path == NULL)
+   {
+      path = getenv(DVFS_SOCKET_PATH_ENV);
+      if (path == NULL || path[0] == '\0')
+      {
+         path = DVFS_SOCKET_DEFAULT_PATH;
+      }
+   }
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if (strlen(path) >= sizeof(addr.sun_path))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   memcpy(addr.sun_path, path, strlen(path));
+
+   dvfs_client *client = malloc(sizeof(*client));
+   if (client == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   client->sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+   if (client->sock < 0)
+   {
+      free(client);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   if (connect(client->sock, (struct sockaddr *) &addr, sizeof(addr)) != 0
+         || send(client->sock, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t) sizeof(hello))
+   {
+      close(client->sock);
+      free(client);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   ret = recv_welcome(client->sock, &welcome, &ring_fd, &client->doorbell);
+   if (ret != DVFS_SUCCESS)
+   {
+      close(client->sock);
+      free(client);
+      return ret;
+   }
+   client->nb_units = welcome.nb_units;
+
+   client->ring = mmap(NULL, sizeof(*client->ring), PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+   close(ring_fd);
+   if (client->ring == MAP_FAILED)
+   {
+      close(client->doorbell);
+      close(client->sock);
+      free(client);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   pthread_mutex_init(&client->lock, NULL);
+   *ppClient = client;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_client_close(dvfs_client *client)
+{
+   assert(client != NULL);
+   if (client == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   munmap(client->ring, sizeof(*client->ring));
+   close(client->doorbell);
+   close(client->sock);
+   pthread_mutex_destroy(&client->lock);
+   free(client);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_client_get_nb_units(const dvfs_client *client, unsigned int *pNb)
+{
+   assert(client != NULL);
+   assert(pNb != NULL);
+   if (client == NULL || pNb == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *pNb = client->nb_units;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Tells if the daemon closed the connection.
+ */
+static bool daemon_gone(const dvfs_client *client)
+{
+   struct pollfd pfd = { .fd = client->sock, .events = POLLIN };
+
+   return poll(&pfd, 1, 0) != 0;
+}
+
+int dvfs_client_unit_set_freq(dvfs_client *client, unsigned int unit_id, unsigned int freq)
+{
+   const struct timespec timeout = { .tv_sec = 0, .tv_nsec = CLIENT_WAIT_NS };
+   uint64_t value = 1;
+   uint32_t done;
+   int status;
+
+   assert(client != NULL);
+   if (client == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&client->lock);
+
+   dvfs_proto_ring *ring = client->ring;
+   uint32_t seq = ring->head;
+   dvfs_proto_request *req = &ring->slots[seq % DVFS_PROTO_RING_SIZE];
+
+   req->unit = unit_id;
+   req->freq = freq;
+   req->status = DVFS_PROTO_PENDING;
+   __atomic_store_n(&ring->head, seq + 1, __ATOMIC_RELEASE);
+
+   if (write(client->doorbell, &value, sizeof(value)) < 0)
+   {
+      pthread_mutex_unlock(&client->lock);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   // the daemon wakes the futex after publishing the completion
+   while ((int32_t) ((done = __atomic_load_n(&ring->done, __ATOMIC_ACQUIRE)) - (seq + 1)) < 0)
+   {
+      if (syscall(SYS_futex, &ring->done, FUTEX_WAIT, done, &timeout, NULL, 0) != 0
+            && errno == ETIMEDOUT && daemon_gone(client))
+      {
+         pthread_mutex_unlock(&client->lock);
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+
+   status = req->status;
+   pthread_mutex_unlock(&client->lock);
+   return status;
+}
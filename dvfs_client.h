@@ -0,0 +1,99 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @file dvfs_client.h
+ *
+ * Client of the \c dvfsd daemon (see dvfs_server.h). An unprivileged process
+ * connects to the daemon and sends it frequency requests for the DVFS units
+ * instead of opening a DVFS context itself. The requests go through a ring in
+ * shared memory: a request costs an eventfd write to wake the daemon and a
+ * futex wait for the completion, the socket is only used by
+ * dvfs_client_open().
+ *
+ * The daemon arbitrates between its clients: the unit runs at the highest
+ * frequency requested, within the limits of the policy of each user. A
+ * successful request is therefore not a guarantee that the unit runs at the
+ * requested frequency.
+ *
+ * A client can be shared by several threads, the requests are then
+ * serialized.
+ */
+
+/**
+ * A connection to the daemon, opaque.
+ */
+typedef struct dvfs_client dvfs_client;
+
+/**
+ * Connects to the daemon. The path of the socket is taken from the
+ * LIBDVFS_SOCKET_PATH environment variable when \c path is NULL, and defaults
+ * to \c /run/dvfsd.sock.
+ *
+ * @param ppClient Will be filled with the new client.
+ * @param path The path of the socket, or NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppClient is NULL, if the path is too long or if the daemon does not speak the same protocol.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the daemon cannot be reached.
+ *         \retval DVFS_ERROR_ACCESS_DENIED if the policy of the daemon does not allow the user.
+ *
+ * @sa dvfs_client_close()
+ */
+int dvfs_client_open(dvfs_client **ppClient, const char *path);
+
+/**
+ * Disconnects from the daemon. The requests of the client are withdrawn.
+ *
+ * @param client The client.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c client is NULL.
+ */
+int dvfs_client_close(dvfs_client *client);
+
+/**
+ * Gets the number of DVFS units controlled by the daemon.
+ *
+ * @param client The client.
+ * @param pNb Will be filled with the number of units.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c client or \c pNb are NULL.
+ */
+int dvfs_client_get_nb_units(const dvfs_client *client, unsigned int *pNb);
+
+/**
+ * Requests a frequency for a DVFS unit and waits for the daemon to apply it.
+ * Mirrors dvfs_unit_set_freq().
+ *
+ * @param client The client.
+ * @param unit_id The index of the unit in the context of the daemon.
+ * @param freq The requested frequency.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c client is NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit does not exist.
+ *         \retval DVFS_ERROR_INVALID_FREQ if the frequency is not available or if the policy of the user leaves no frequency.
+ *         \retval DVFS_ERROR_FILE_ERROR if the daemon is gone.
+ *         Otherwise, the error met by the daemon while setting the frequency.
+ */
+int dvfs_client_unit_set_freq(dvfs_client *client, unsigned int unit_id, unsigned int freq);
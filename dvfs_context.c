@@ -16,11 +16,17 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
 #include "dvfs_context.h"
 #include "dvfs_error.h"
+#include "dvfs_journal.h"
+#include "dvfs_lease.h"
+#include "dvfs_parallel.h"
+#include "dvfs_sysfs.h"
 
 #include <assert.h>
-#include <cpuid.h>
+#include <sched.h>
+#include <dirent.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,17 +36,39 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 
-static unsigned int get_nb_cores();
-static void get_related_cores(unsigned int id, unsigned int **cores, unsigned int *nb_cores);
+#define UNCORE_ROOT_DIR_PATTERN "/devices/system/cpu/intel_uncore_frequency"
+
+static int open_uncores(dvfs_ctx *ctx);
+
+// Generation of the last context started, 0 is never used
+static unsigned long last_generation;
+
+/**
+ * DVFS unit of the core the thread last ran on, see dvfs_self_get_unit().
+ */
+static __thread struct {
+   unsigned long generation;  //!< Generation of the context the entry belongs to
+   int cpu;                   //!< Core the thread was running on
+   const dvfs_unit *unit;     //!< DVFS unit of the core
+} self_cache;
 
 int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
-   unsigned int nb_cores = get_nb_cores();
+   return dvfs_start_backend(ppCtx, seq, &dvfs_backend_sysfs);
+}
 
-   if ( ppCtx == NULL )
+/**
+ * Opens the context. A read-only context does not use the journal, fences its
+ * cores so that they are never written nor restored, and leaves the uncore
+ * and turbo controls alone.
+ */
+static int start_context(dvfs_ctx** ppCtx, bool seq, const dvfs_backend *backend, bool read_only, unsigned int step) {
+   if ( ppCtx == NULL || backend == NULL || step == 0 )
    {
        return DVFS_ERROR_INVALID_ARG;
    }
 
+   unsigned int nb_cores = backend->get_nb_cores();
+
    // we can have at most one unit per core
    *ppCtx = malloc(sizeof(*(*ppCtx)));
    if ( *ppCtx == NULL )
@@ -48,7 +76,26 @@ int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
        return DVFS_ERROR_MEM_ALLOC_FAILED;
    }
 
+   (*ppCtx)->backend = backend;
    (*ppCtx)->nb_units = 0;
+   (*ppCtx)->topo = NULL;
+   (*ppCtx)->nb_uncores = 0;
+   (*ppCtx)->uncores = NULL;
+   (*ppCtx)->turbo = NULL;
+   (*ppCtx)->idle = NULL;
+   (*ppCtx)->generation = __atomic_add_fetch(&last_generation, 1, __ATOMIC_RELAXED);
+   (*ppCtx)->journal = NULL;
+   (*ppCtx)->lease = NULL;
+   (*ppCtx)->read_only = read_only;
+   dvfs_features_detect(&(*ppCtx)->features);
+
+   // restore the cores left behind by the processes killed before calling
+   // dvfs_stop(), before reading their initial state. Without the journal
+   // (missing permissions), the library still works.
+   if (backend->hardware && !read_only && dvfs_journal_open(&(*ppCtx)->journal, NULL) == DVFS_SUCCESS)
+   {
+      dvfs_journal_recover((*ppCtx)->journal, NULL);
+   }
    (*ppCtx)->units = malloc(nb_cores * sizeof(*(*ppCtx)->units));
    if ( (*ppCtx)->units == NULL )
    {
@@ -78,7 +125,7 @@ int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
       }
 
       // open the related cores ids
-      get_related_cores(c, &ucores_ids, &nb_ucores);
+      backend->get_related_cores(c, &ucores_ids, &nb_ucores);
 
       if (ucores_ids == NULL) {
          dvfs_stop(*ppCtx);
@@ -95,7 +142,7 @@ int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
       }
 
       for (uc = 0; uc < nb_ucores; uc++) {
-         int result = dvfs_core_open(&ucores[uc],ucores_ids[uc], seq);
+         int result = dvfs_core_open_step(&ucores[uc],ucores_ids[uc], seq, backend, step);
 
          if (result != DVFS_SUCCESS) {
             free (ucores_ids);
@@ -103,6 +150,12 @@ int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
             dvfs_stop(*ppCtx);
             return result;
          }
+
+         ucores[uc]->fenced = read_only;
+         if ((*ppCtx)->journal != NULL)
+         {
+            dvfs_journal_record((*ppCtx)->journal, ucores[uc], (*ppCtx)->nb_units);
+         }
       }
       free(ucores_ids);
 
@@ -116,9 +169,59 @@ int dvfs_start(dvfs_ctx** ppCtx, bool seq) {
       (*ppCtx)->nb_units++;
    }
 
+   // organize the units in a tree
+   int topo_result = dvfs_topology_open(&(*ppCtx)->topo, (*ppCtx)->nb_units, (*ppCtx)->units);
+   if ( topo_result != DVFS_SUCCESS )
+   {
+      dvfs_stop(*ppCtx);
+      return topo_result;
+   }
+
+   // the other sysfs features are only relevant on the actual hardware
+   bool controls = backend->hardware && !read_only;
+   int uncore_result = controls ? open_uncores(*ppCtx) : DVFS_SUCCESS;
+   if ( uncore_result != DVFS_SUCCESS )
+   {
+      dvfs_stop(*ppCtx);
+      return uncore_result;
+   }
+
+   int turbo_result = controls ? dvfs_turbo_open(&(*ppCtx)->turbo, (*ppCtx)->nb_units, (*ppCtx)->units) : DVFS_SUCCESS;
+   if ( turbo_result != DVFS_SUCCESS )
+   {
+      dvfs_stop(*ppCtx);
+      return turbo_result;
+   }
+
+   // the idle states are enumerated on first use
+   int idle_result = dvfs_idle_open(&(*ppCtx)->idle, controls ? (*ppCtx)->topo->nb_core_nodes : 0);
+   if ( idle_result != DVFS_SUCCESS )
+   {
+      dvfs_stop(*ppCtx);
+      return idle_result;
+   }
+
    return DVFS_SUCCESS;
 }
 
+int dvfs_start_backend(dvfs_ctx** ppCtx, bool seq, const dvfs_backend *backend) {
+   return start_context(ppCtx, seq, backend, false, DVFS_DEFAULT_FREQ_STEP);
+}
+
+int dvfs_start_step(dvfs_ctx** ppCtx, bool seq, const dvfs_backend *backend, unsigned int step) {
+   return start_context(ppCtx, seq, backend, false, step);
+}
+
+int dvfs_start_read_only(dvfs_ctx** ppCtx, const dvfs_backend *backend) {
+   return start_context(ppCtx, false, backend, true, DVFS_DEFAULT_FREQ_STEP);
+}
+
+static int close_unit(unsigned int index, void *arg) {
+   dvfs_unit **units = arg;
+
+   return units[index] != NULL ? dvfs_unit_close(units[index]) : DVFS_SUCCESS;
+}
+
 int dvfs_stop(dvfs_ctx *ctx) {
    unsigned int i;
    int id_result = DVFS_SUCCESS;
@@ -129,49 +232,136 @@ int dvfs_stop(dvfs_ctx *ctx) {
        return DVFS_ERROR_INVALID_ARG;
    }
 
-   for (i = 0; i < ctx->nb_units; i++)
+   if (ctx->topo != NULL)
+   {
+      dvfs_topology_close(ctx->topo);
+   }
+
+   if (ctx->idle != NULL)
+   {
+      int ires = dvfs_idle_close(ctx->idle);
+      if ( ires != DVFS_SUCCESS )
+      {
+          id_result = ires;
+      }
+   }
+
+   if (ctx->turbo != NULL)
+   {
+      int tres = dvfs_turbo_close(ctx->turbo);
+      if ( tres != DVFS_SUCCESS )
+      {
+          id_result = tres;
+      }
+   }
+
+   for (i = 0; i < ctx->nb_uncores; i++)
    {
-      if ( ctx->units[i])
+      int ures = dvfs_uncore_close(ctx->uncores[i]);
+      if ( ures != DVFS_SUCCESS )
       {
-          int cres = dvfs_unit_close(ctx->units[i]);
-          if ( cres != DVFS_SUCCESS )
-          {
-              id_result = cres;
-          }
+          id_result = ures;
       }
    }
+   free(ctx->uncores);
+
+   // the units are independent: restoring them in parallel overlaps the
+   // latencies of the cpufreq drivers
+   int cres = dvfs_parallel_run(ctx->nb_units, close_unit, ctx->units);
+   if ( cres != DVFS_SUCCESS )
+   {
+       id_result = cres;
+   }
 
    free(ctx->units);
+
+   // the initial states are restored, the slots can be released
+   if (ctx->journal != NULL)
+   {
+      dvfs_journal_close(ctx->journal);
+   }
+
+   // the leased units are restored, the other contexts can take them
+   if (ctx->lease != NULL)
+   {
+      dvfs_lease_close(ctx->lease);
+   }
+
    free(ctx);
 
    return id_result;
 }
 
 int dvfs_has_TB() {
-   FILE* pFile = NULL;
-   pFile = fopen("/proc/cpuinfo", "r");
-   if (pFile == NULL) {
-      return DVFS_ERROR_FILE_ERROR;
-   }
-
-   int hasTB = DVFS_TB_UNAVAILABLE;
-   char buf [2048];
-   while (fgets(buf, sizeof(buf), pFile) != NULL) {
-      if (!strncmp (buf, "flags", 5)) {
-         if (strstr (buf, "ida") != NULL) {
-            hasTB = DVFS_TB_AVAILABLE;
-            break;
-         }
-      }
+   dvfs_features features;
+
+   dvfs_features_detect(&features);
+   return features.turbo ? DVFS_TB_AVAILABLE : DVFS_TB_UNAVAILABLE;
+}
+
+int dvfs_get_features(const dvfs_ctx *ctx, const dvfs_features **ppFeatures) {
+   assert(ctx != NULL);
+   assert(ppFeatures != NULL);
+   if ( ctx == NULL || ppFeatures == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
    }
 
-   fclose(pFile);
-   return hasTB;
+   *ppFeatures = &ctx->features;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_set_turbo(dvfs_ctx *ctx, bool enable) {
+   assert(ctx != NULL);
+   if ( ctx == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if ( ctx->turbo == NULL )
+   {
+      return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+
+   return dvfs_turbo_set(ctx->turbo, enable);
+}
+
+int dvfs_get_turbo(const dvfs_ctx *ctx, bool *pEnabled) {
+   assert(ctx != NULL);
+   assert(pEnabled != NULL);
+   if ( ctx == NULL || pEnabled == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if ( ctx->turbo == NULL )
+   {
+      return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+
+   return dvfs_turbo_get(ctx->turbo, pEnabled);
+}
+
+int dvfs_set_unit_turbo(dvfs_ctx *ctx, const dvfs_unit *unit, bool enable) {
+   assert(ctx != NULL);
+   assert(unit != NULL);
+   if ( ctx == NULL || unit == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if ( ctx->turbo == NULL )
+   {
+      return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+
+   return dvfs_turbo_set_unit(ctx->turbo, unit, enable);
 }
 
 int dvfs_set_gov(const dvfs_ctx *ctx, const char *gov) {
    unsigned int i;
    int ret = DVFS_SUCCESS;
+   bool leased = false;
 
    assert(ctx != NULL);
    assert(gov != NULL);
@@ -181,6 +371,11 @@ int dvfs_set_gov(const dvfs_ctx *ctx, const char *gov) {
    }
 
    for (i = 0; i < ctx->nb_units; i++) {
+      // once partitioned, the context only covers its leases
+      if (ctx->units[i]->cores[0]->fenced) {
+         continue;
+      }
+      leased = true;
       int cret = dvfs_unit_set_gov(ctx->units[i], gov);
       if ( cret != DVFS_SUCCESS )
       {
@@ -188,12 +383,52 @@ int dvfs_set_gov(const dvfs_ctx *ctx, const char *gov) {
       }
    }
 
+   // every unit is leased by other contexts
+   if ( !leased && ctx->nb_units > 0 )
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   return ret;
+}
+
+int dvfs_set_gov_id(const dvfs_ctx *ctx, unsigned int id) {
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+   bool leased = false;
+
+   assert(ctx != NULL);
+   if ( ctx == NULL )
+   {
+       return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++) {
+      // once partitioned, the context only covers its leases
+      if (ctx->units[i]->cores[0]->fenced) {
+         continue;
+      }
+      leased = true;
+      int cret = dvfs_unit_set_gov_id(ctx->units[i], id);
+      if ( cret != DVFS_SUCCESS )
+      {
+        ret = cret;
+      }
+   }
+
+   // every unit is leased by other contexts
+   if ( !leased && ctx->nb_units > 0 )
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
    return ret;
 }
 
 int dvfs_set_freq(dvfs_ctx *ctx, unsigned int freq) {
    unsigned int i;
    int ret = DVFS_SUCCESS;
+   bool leased = false;
 
    assert(ctx != NULL);
    if ( ctx == NULL )
@@ -202,6 +437,11 @@ int dvfs_set_freq(dvfs_ctx *ctx, unsigned int freq) {
    }
 
    for (i = 0; i < ctx->nb_units; i++) {
+      // once partitioned, the context only covers its leases
+      if (ctx->units[i]->cores[0]->fenced) {
+         continue;
+      }
+      leased = true;
       int cret = dvfs_unit_set_freq(ctx->units[i], freq);
       if ( cret != DVFS_SUCCESS )
       {
@@ -209,11 +449,109 @@ int dvfs_set_freq(dvfs_ctx *ctx, unsigned int freq) {
       }
    }
 
+   // every unit is leased by other contexts
+   if ( !leased && ctx->nb_units > 0 )
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
    return ret;
 }
 
-int dvfs_get_core(const dvfs_ctx *ctx, const dvfs_core** ppCore, unsigned int core_id) {
+int dvfs_set_epp_profile(const dvfs_ctx *ctx, unsigned int nb_settings, const dvfs_epp_setting *profile) {
    unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   assert(profile != NULL);
+   if ( ctx == NULL || profile == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < nb_settings; i++) {
+      int uret = profile[i].unit == NULL || profile[i].epp == NULL ? DVFS_ERROR_INVALID_ARG : dvfs_unit_set_epp(profile[i].unit, profile[i].epp);
+      if ( uret != DVFS_SUCCESS )
+      {
+         ret = uret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_get_idle(dvfs_ctx *ctx, dvfs_idle **ppIdle) {
+   assert(ctx != NULL);
+   assert(ppIdle != NULL);
+   if ( ctx == NULL || ppIdle == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppIdle = ctx->idle;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_acquire_idle_latency(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units, unsigned int max_latency) {
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   if ( ctx == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (units == NULL) {
+      nb_units = ctx->nb_units;
+   }
+
+   for (i = 0; i < nb_units; i++) {
+      // once partitioned, the whole context only covers its leases
+      if (units == NULL && ctx->units[i]->cores[0]->fenced) {
+         continue;
+      }
+      int uret = dvfs_idle_acquire_unit(ctx->idle, units == NULL ? ctx->units[i] : units[i], max_latency);
+      if ( uret != DVFS_SUCCESS )
+      {
+         ret = uret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_release_idle_latency(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units, unsigned int max_latency) {
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   if ( ctx == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (units == NULL) {
+      nb_units = ctx->nb_units;
+   }
+
+   for (i = 0; i < nb_units; i++) {
+      // once partitioned, the whole context only covers its leases
+      if (units == NULL && ctx->units[i]->cores[0]->fenced) {
+         continue;
+      }
+      int uret = dvfs_idle_release_unit(ctx->idle, units == NULL ? ctx->units[i] : units[i], max_latency);
+      if ( uret != DVFS_SUCCESS )
+      {
+         ret = uret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_get_core(const dvfs_ctx *ctx, const dvfs_core** ppCore, unsigned int core_id) {
+   const dvfs_topo_node *node = NULL;
 
    assert(ctx != NULL);
    assert(ppCore != NULL);
@@ -222,17 +560,15 @@ int dvfs_get_core(const dvfs_ctx *ctx, const dvfs_core** ppCore, unsigned int co
        return DVFS_ERROR_INVALID_ARG;
    }
 
-   for (i = 0; i < ctx->nb_units; i++) {
-      unsigned int j;
-      for (j = 0; j < ctx->units[i]->nb_cores; j++) {
-         if (ctx->units[i]->cores[j]->id == core_id) {
-            *ppCore = ctx->units[i]->cores[j];
-             return DVFS_SUCCESS;
-         }
-      }
+   // the topology indexes the cores
+   int ret = dvfs_topo_get_core_node(ctx->topo, &node, core_id);
+   if ( ret != DVFS_SUCCESS )
+   {
+      return ret;
    }
 
-   return DVFS_ERROR_INVALID_CORE_ID;
+   *ppCore = node->core;
+   return DVFS_SUCCESS;
 }
 
 int dvfs_get_unit_by_id(const dvfs_ctx* ctx, const dvfs_unit** ppUnit, unsigned int index)
@@ -254,7 +590,7 @@ int dvfs_get_unit_by_id(const dvfs_ctx* ctx, const dvfs_unit** ppUnit, unsigned
 }
 
 int dvfs_get_unit_by_core(const dvfs_ctx *ctx, const dvfs_core *core, const dvfs_unit** ppUnit) {
-   unsigned int i;
+   const dvfs_topo_node *node = NULL;
 
    assert(ctx != NULL);
    assert(core != NULL);
@@ -264,19 +600,59 @@ int dvfs_get_unit_by_core(const dvfs_ctx *ctx, const dvfs_core *core, const dvfs
        return DVFS_ERROR_INVALID_ARG;
    }
 
-   for (i = 0; i < ctx->nb_units; i++) {
-      unsigned int j;
-      for (j = 0; j < ctx->units[i]->nb_cores; j++) {
-         if (ctx->units[i]->cores[j]->id == core->id)
-         {
-            *ppUnit = ctx->units[i];
-            return DVFS_SUCCESS;
-         }
-      }
+   // the topology indexes the cores
+   if ( dvfs_topo_get_core_node(ctx->topo, &node, core->id) != DVFS_SUCCESS || node->core != core )
+   {
+      // Sincerely, we should never reach this point
+      return DVFS_ERROR_CORE_UNIT_MISMATCH;
    }
 
-   // Sincerely, we should never reach this point
-   return DVFS_ERROR_CORE_UNIT_MISMATCH;
+   *ppUnit = node->unit;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_self_get_unit(const dvfs_ctx *ctx, const dvfs_unit **ppUnit) {
+   const dvfs_topo_node *node = NULL;
+
+   assert(ctx != NULL);
+   assert(ppUnit != NULL);
+   if ( ctx == NULL || ppUnit == NULL )
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   int cpu = sched_getcpu();
+
+   // fast path: same context, no migration
+   if ( self_cache.generation == ctx->generation && self_cache.cpu == cpu )
+   {
+      *ppUnit = self_cache.unit;
+      return DVFS_SUCCESS;
+   }
+
+   if ( cpu < 0 || dvfs_topo_get_core_node(ctx->topo, &node, cpu) != DVFS_SUCCESS )
+   {
+      return DVFS_ERROR_INVALID_CORE_ID;
+   }
+
+   self_cache.generation = ctx->generation;
+   self_cache.cpu = cpu;
+   self_cache.unit = node->unit;
+
+   *ppUnit = node->unit;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_self_set_freq(const dvfs_ctx *ctx, unsigned int freq) {
+   const dvfs_unit *unit = NULL;
+
+   int ret = dvfs_self_get_unit(ctx, &unit);
+   if ( ret != DVFS_SUCCESS )
+   {
+      return ret;
+   }
+
+   return dvfs_unit_set_freq(unit, freq);
 }
 
 int dvfs_get_nb_units(const dvfs_ctx* ctx, unsigned int* pNb)
@@ -292,123 +668,186 @@ int dvfs_get_nb_units(const dvfs_ctx* ctx, unsigned int* pNb)
     return DVFS_SUCCESS;
 }
 
-static unsigned int get_nb_cores() {
-   unsigned int nb_cores = 0;
+int dvfs_get_topology(const dvfs_ctx* ctx, const dvfs_topology **ppTopo)
+{
+    assert(ctx != NULL);
+    assert(ppTopo != NULL);
+    if ( ctx == NULL || ppTopo == NULL )
+    {
+        return DVFS_ERROR_INVALID_ARG;
+    }
+
+    *ppTopo = ctx->topo;
+    return DVFS_SUCCESS;
+}
+
+int dvfs_get_nb_uncores(const dvfs_ctx* ctx, unsigned int* pNb)
+{
+    assert(ctx != NULL);
+    assert(pNb != NULL);
+    if ( ctx == NULL || pNb == NULL )
+    {
+        return DVFS_ERROR_INVALID_ARG;
+    }
+
+    *pNb = ctx->nb_uncores;
+    return DVFS_SUCCESS;
+}
+
+int dvfs_get_uncore_by_id(const dvfs_ctx* ctx, const dvfs_uncore** ppUncore, unsigned int index)
+{
+    assert(ctx != NULL);
+    assert(ppUncore != NULL);
+    if ( ctx == NULL || ppUncore == NULL )
+    {
+        return DVFS_ERROR_INVALID_ARG;
+    }
+
+    if ( index >= ctx->nb_uncores )
+    {
+        return DVFS_ERROR_INVALID_INDEX;
+    }
+
+    *ppUncore = ctx->uncores[index];
+    return DVFS_SUCCESS;
+}
+
+int dvfs_get_uncore_by_unit(const dvfs_ctx* ctx, const dvfs_unit *unit, const dvfs_uncore** ppUncore)
+{
+   unsigned int i;
+   const dvfs_topo_node *node = NULL, *package = NULL, *die = NULL;
 
-   nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
-   if (nb_cores < 1) // This sysconf is not always available
+   assert(ctx != NULL);
+   assert(unit != NULL);
+   assert(ppUncore != NULL);
+   if ( ctx == NULL || unit == NULL || ppUncore == NULL )
    {
-      // Second try
-      FILE* pFile = NULL;
-      pFile = fopen("/proc/cpuinfo", "r");
-      if (pFile == NULL) {
-         return 0;
-      }
+       return DVFS_ERROR_INVALID_ARG;
+   }
 
-      char buf [2048];
-      while (fgets(buf, sizeof(buf), pFile) != NULL) {
-         if (!strncmp (buf, "processor", 9)) {
-            nb_cores++;
-         }
-      }
+   // locate the unit package and die in the topology
+   if (unit->nb_cores == 0
+       || dvfs_topo_get_core_node(ctx->topo, &node, unit->cores[0]->id) != DVFS_SUCCESS
+       || dvfs_topo_get_ancestor(node, DVFS_TOPO_PACKAGE, &package) != DVFS_SUCCESS
+       || dvfs_topo_get_ancestor(node, DVFS_TOPO_DIE, &die) != DVFS_SUCCESS)
+   {
+      return DVFS_ERROR_CORE_UNIT_MISMATCH;
+   }
 
-      fclose(pFile);
+   // without die support in the kernel, the package has a single die 0
+   unsigned int die_id = die->id != DVFS_TOPO_UNKNOWN_ID ? die->id : 0;
+   for (i = 0; i < ctx->nb_uncores; i++)
+   {
+      if (ctx->uncores[i]->package_id == package->id && ctx->uncores[i]->die_id == die_id)
+      {
+         *ppUncore = ctx->uncores[i];
+         return DVFS_SUCCESS;
+      }
    }
 
-   return nb_cores;
+   return DVFS_ERROR_UNCORE_UNAVAILABLE;
 }
 
-static void get_related_cores(unsigned int id, unsigned int **cores, unsigned int *nb_cores) {
-   unsigned int val, i;
-   char relfile[1024];
-   FILE *fd;
-   struct stat buf;
-
-   assert(cores != NULL && nb_cores != NULL);
-
-   // all Linux files are broken in some versions... first rely on the manufacturer
-   __get_cpuid(0, &i, (unsigned int *) relfile, (unsigned int *) (relfile + 8),
-               (unsigned int *) (relfile + 4));
-   relfile[12] = '\0';
-
-   // Intel platforms have a single frequency domain
-   if (strncmp(relfile, "GenuineIntel", 12) == 0) {
-      snprintf(relfile, sizeof(relfile), "/sys/devices/system/cpu/cpu%u/topology/core_siblings_list", id);
-   } else {
-      // prefer the more recent freq_domain_cpus over related_cpus
-      snprintf(relfile, sizeof(relfile), "/sys/devices/system/cpu/cpu%u/cpufreq/freqdomain_cpus", id);
-      if (stat(relfile, &buf) < 0) {
-         snprintf(relfile, sizeof(relfile), "/sys/devices/system/cpu/cpu%u/cpufreq/related_cpus", id);
-      }
+int dvfs_set_unit_and_uncore_freq(const dvfs_ctx* ctx, const dvfs_unit *unit, unsigned int freq, unsigned int uncore_freq)
+{
+   const dvfs_uncore *uncore = NULL;
+
+   assert(ctx != NULL);
+   assert(unit != NULL);
+   if ( ctx == NULL || unit == NULL )
+   {
+       return DVFS_ERROR_INVALID_ARG;
    }
 
-   if ((fd = fopen(relfile, "r")) == NULL) {
-      *nb_cores = 0;
-      *cores = NULL;
-      return;
+   // check the uncore domain and the frequency before touching anything
+   int ret = dvfs_get_uncore_by_unit(ctx, unit, &uncore);
+   if ( ret != DVFS_SUCCESS )
+   {
+      return ret;
+   }
+   if ( uncore_freq < uncore->hw_min_freq || uncore_freq > uncore->hw_max_freq )
+   {
+      return DVFS_ERROR_INVALID_FREQ;
+   }
+   if ( unit->cores[0]->fenced || uncore->fenced )
+   {
+      return DVFS_ERROR_NOT_LEASED;
    }
 
-   // parse the file
-   // supports space-separated list of values and condensed format
-   // (comma-separated list with dash notation for contiguous lists)
-   // only counting here
-   *nb_cores = 0;
-   while (fscanf(fd, "%u", &val) == 1) {
-      unsigned int nval;
-      char sep;
+   // the previous request, the measured frequency may not be in the table
+   const dvfs_core *core = unit->cores[0];
+   unsigned int prev_freq = 0, prev_min = core->min_freq, prev_max = core->max_freq;
+   bool has_prev = core->ctrl == DVFS_CTRL_MINMAX || dvfs_core_get_target(core, &prev_freq) == DVFS_SUCCESS;
 
-      int fret = fscanf(fd, "%c", &sep);
+   ret = dvfs_unit_set_freq(unit, freq);
+   if ( ret != DVFS_SUCCESS )
+   {
+      return ret;
+   }
 
-      if (fret == EOF || fret == 0 || sep == ' ' || sep == ',' || sep == '\n') {
-         (*nb_cores)++;
-         continue;
-      }
+   // both or none: the unit goes back to its previous request
+   ret = dvfs_uncore_set_freq(uncore, uncore_freq);
+   if ( ret != DVFS_SUCCESS && has_prev )
+   {
+      unsigned int i;
+      int rollback = DVFS_SUCCESS;
 
-      if (sep != '-') { // Error case ... no format recognized here
-         fprintf(stderr, "[LIBDVFS][ERROR] Illformed topology file: expected '-', read '%c' \n", sep);
-         *nb_cores = 0;
-         *cores = NULL;
-         return;
+      for (i = 0; i < unit->nb_cores && rollback == DVFS_SUCCESS; i++)
+      {
+         rollback = core->ctrl == DVFS_CTRL_MINMAX ? dvfs_core_set_limits(unit->cores[i], prev_min, prev_max)
+                                                   : dvfs_core_set_freq(unit->cores[i], prev_freq);
       }
+      if ( rollback != DVFS_SUCCESS )
+      {
+         fprintf(stderr, "[LIBDVFS][ERROR] setUnitAndUncoreFreq: cannot roll unit %u back (%s)\n", unit->id, dvfs_strerror(rollback));
+         ret = rollback;
+      }
+   }
 
-      // Treat the second file (since first did not match) format (0-N)
-      fscanf(fd, "%u", &nval);
-      *nb_cores += nval - val + 1;
+   return ret;
+}
 
-      fscanf(fd, "%c", &sep);
-   }
+/**
+ * Opens all the uncore frequency domains exposed by the intel_uncore_frequency
+ * driver. Having none of them is not an error, the domains that cannot be
+ * opened are skipped.
+ */
+static int open_uncores(dvfs_ctx *ctx) {
+   char dname[256];
 
-   *cores = malloc(*nb_cores * sizeof(**cores));
-   fseek(fd, 0, SEEK_SET);
+   if (dvfs_sysfs_path(dname, sizeof(dname), UNCORE_ROOT_DIR_PATTERN) != DVFS_SUCCESS) {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
 
-   // now fill the array
-   i = 0;
-   while (fscanf(fd, "%u", &val) == 1 && i < *nb_cores) {
-      unsigned int nval;
-      char sep;
+   DIR *dir = opendir(dname);
+   if (dir == NULL) {
+      return DVFS_SUCCESS;
+   }
 
-      fscanf(fd, "%c", &sep);
+   struct dirent *entry;
+   while ((entry = readdir(dir)) != NULL) {
+      unsigned int package_id, die_id;
 
-      if ( sep == '\n' ) // File finished, we guess, we have count everything
-      {
-         (*cores)[i++] = val;
-         break; // Leave
-      }
-      if (sep == ' ' || sep == ',') {
-         (*cores)[i++] = val;
+      if (sscanf(entry->d_name, "package_%u_die_%u", &package_id, &die_id) != 2) {
          continue;
       }
 
-      fscanf(fd, "%u", &nval);
-      unsigned int j;
-      for (j = 0; j < nval - val + 1; j++) {
-         (*cores)[i + j] = val + j;
+      dvfs_uncore **uncores = realloc(ctx->uncores, (ctx->nb_uncores + 1) * sizeof(*uncores));
+      if (uncores == NULL) {
+         closedir(dir);
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
       }
-      i += j;
+      ctx->uncores = uncores;
 
-      fscanf(fd, "%c", &sep);
+      // a broken domain only disables the uncore control of its die
+      int ret = dvfs_uncore_open(&ctx->uncores[ctx->nb_uncores], package_id, die_id);
+      if (ret != DVFS_SUCCESS) {
+         fprintf(stderr, "[LIBDVFS][ERROR] openUncores: skipping package %u die %u (%s)\n", package_id, die_id, dvfs_strerror(ret));
+         continue;
+      }
+      ctx->nb_uncores++;
    }
 
-   fclose(fd);
+   closedir(dir);
+   return DVFS_SUCCESS;
 }
-
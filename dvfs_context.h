@@ -22,6 +22,12 @@
 
 #include "dvfs_unit.h"
 #include "dvfs_core.h"
+#include "dvfs_topology.h"
+#include "dvfs_uncore.h"
+#include "dvfs_features.h"
+#include "dvfs_turbo.h"
+#include "dvfs_epp.h"
+#include "dvfs_idle.h"
 
 
 /**
@@ -41,8 +47,19 @@
  * @sa dvfs_unit()
  */
 typedef struct {
+   const dvfs_backend *backend;  //!< Backend used by all the cores
    unsigned int nb_units;  //!< Number of DVFS units on the system
    dvfs_unit **units;      //!< DVFS units we are handling
+   dvfs_topology *topo;    //!< Topology tree above the DVFS units
+   unsigned int nb_uncores;   //!< Number of uncore frequency domains on the system
+   dvfs_uncore **uncores;     //!< Uncore frequency domains we are handling
+   dvfs_features features;    //!< Features of the processor
+   dvfs_turbo *turbo;         //!< Turbo control, NULL if the backend does not control the hardware
+   dvfs_idle *idle;           //!< Idle states control (no core if the backend does not control the hardware)
+   unsigned long generation;  //!< Unique id of the context, invalidates the per-thread caches of dvfs_self_get_unit()
+   struct dvfs_journal *journal;    //!< Crash-safe journal of the initial states (see dvfs_journal.h), NULL if not available
+   struct dvfs_lease *lease;        //!< Units leased by the context (see dvfs_lease.h), NULL until the first lease
+   bool read_only;            //!< True if the context only observes the cores (see dvfs_start_read_only())
 } dvfs_ctx;
 
 /**
@@ -60,9 +77,59 @@ typedef struct {
  */
 int dvfs_start(dvfs_ctx** ppCtx, bool seq);
 
+/**
+ * Starts controlling DVFS on the system through the given backend. See
+ * dvfs_start().
+ *
+ * @param ppCtx the new DVFS context used in the various functions.
+ * @param seq Tells if the frequency transitions must be synchronized or not.
+ * @param backend The backend to use, for instance \c &dvfs_backend_mock to
+ * measure the overhead of the library without touching the hardware.
+ *
+ * @return See dvfs_start().
+ *
+ * @sa dvfs_stop()
+ */
+int dvfs_start_backend(dvfs_ctx** ppCtx, bool seq, const dvfs_backend *backend);
+
+/**
+ * Starts controlling DVFS on the system through the given backend, with the
+ * step of the frequency tables synthesized for the cores whose driver does
+ * not list its frequencies (see dvfs_core_open_step()). See dvfs_start().
+ *
+ * @param ppCtx the new DVFS context used in the various functions.
+ * @param seq Tells if the frequency transitions must be synchronized or not.
+ * @param backend The backend to use.
+ * @param step The step in kHz, DVFS_DEFAULT_FREQ_STEP for the other functions.
+ *
+ * @return See dvfs_start(). \retval DVFS_ERROR_INVALID_ARG if \c step is 0.
+ *
+ * @sa dvfs_stop()
+ */
+int dvfs_start_step(dvfs_ctx** ppCtx, bool seq, const dvfs_backend *backend, unsigned int step);
+
+/**
+ * Opens a context that only observes the cores, for monitors running next to
+ * the process controlling DVFS. The cores are fenced as if leased by another
+ * context (see dvfs_lease.h): their changes are refused with
+ * DVFS_ERROR_NOT_LEASED and dvfs_stop() leaves them as they are. The context
+ * takes no slot in the journal, cannot lease units and does not open the
+ * uncore, turbo and idle controls.
+ *
+ * @param ppCtx the new DVFS context used in the various functions.
+ * @param backend The backend to read the cores through.
+ *
+ * @return See dvfs_start().
+ *
+ * @sa dvfs_stop()
+ */
+int dvfs_start_read_only(dvfs_ctx** ppCtx, const dvfs_backend *backend);
+
 /**
  * Frees the memory associated to a DVFS context and restores the DVFS control
- * to its state before calling dvfs_start.
+ * to its state before calling dvfs_start. The units are restored by helper
+ * threads, or by the calling thread alone when they cannot be started or when
+ * the \c LIBDVFS_THREADS environment variable is 1 (see dvfs_parallel.h).
  *
  * @param ctx the context
  *
@@ -76,14 +143,74 @@ int dvfs_stop(dvfs_ctx *ctx);
 #define DVFS_TB_UNAVAILABLE 0   /*!< TurboBoost is not available, see dvfs_has_TB() */
 #define DVFS_TB_AVAILABLE 1     /*!< TurboBoost is available, see dvfs_has_TB() */
 /**
- * Returns true if one of the DVFS unit on the system allows TurboBoost.
+ * Returns true if the processor has turbo frequencies (Intel Turbo Boost or
+ * AMD Core Performance Boost). The detection relies on CPUID and is cached,
+ * see dvfs_features_detect().
  *
- * @return \retval DVFS_TB_AVAILABLE if TurboBoost is available on one of the DVFS unit.
- *         \retval DVFS_TB_UNAVAILABLE if TurboBoost is not available.
- *         \retval DVFS_ERROR_FILE_FAILED if the information could not be read (likely because /proc/cpuinfo is not available), or can't be opened.
+ * @return \retval DVFS_TB_AVAILABLE if turbo frequencies are available.
+ *         \retval DVFS_TB_UNAVAILABLE if turbo frequencies are not available.
  */
 int dvfs_has_TB();
 
+/**
+ * Gets the features of the processor, detected when starting the library.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param ppFeatures Will be filled with the features.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppFeatures are NULL.
+ */
+int dvfs_get_features(const dvfs_ctx *ctx, const dvfs_features **ppFeatures);
+
+/**
+ * Enables or disables the turbo frequencies on the whole system. The initial
+ * setting is restored by dvfs_stop().
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param enable True to allow the turbo frequencies.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the setting could not be written.
+ *
+ * @sa dvfs_turbo_set()
+ */
+int dvfs_set_turbo(dvfs_ctx *ctx, bool enable);
+
+/**
+ * Tells if the turbo frequencies are enabled.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param pEnabled Will be filled with the setting.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c pEnabled are NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled.
+ *
+ * @sa dvfs_turbo_get()
+ */
+int dvfs_get_turbo(const dvfs_ctx *ctx, bool *pEnabled);
+
+/**
+ * Enables or disables the turbo frequencies on one DVFS unit. Only available
+ * when the cpufreq driver provides a boost file per policy. The initial
+ * setting is restored by dvfs_stop().
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param unit The DVFS unit.
+ * @param enable True to allow the turbo frequencies.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c unit are NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled per unit.
+ *         \retval DVFS_ERROR_NOT_LEASED if the unit is fenced (see dvfs_lease.h).
+ *
+ * @sa dvfs_turbo_set_unit()
+ */
+int dvfs_set_unit_turbo(dvfs_ctx *ctx, const dvfs_unit *unit, bool enable);
+
 /**
  * Sets the provided governor on all the DVFS units.
  *
@@ -92,21 +219,109 @@ int dvfs_has_TB();
  *
  * @return \retval DVFS_SUCCESS if everything goes right.
  *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or gov are NULL.
+ *         \retval DVFS_ERROR_NOT_LEASED if every unit is leased by another context (see dvfs_lease.h).
  */
 int dvfs_set_gov(const dvfs_ctx *ctx, const char *gov);
 
+/**
+ * Sets the governor given by id on all the DVFS units. Once the id is known
+ * (dvfs_gov_get_id()), switching governors costs one write per core.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start
+ * @param id The id of the governor to set
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if the governor is not available on a core.
+ *         \retval DVFS_ERROR_NOT_LEASED if every unit is leased by another context (see dvfs_lease.h).
+ */
+int dvfs_set_gov_id(const dvfs_ctx *ctx, unsigned int id);
+
 /**
  * Sets the given frequency on all the DVFS units. The effects are unknown if
- * the current governor is not "userspace".
+ * the current governor is not "userspace". Once the context holds leases
+ * (dvfs_lease_acquire()), only the leased units are changed, as for
+ * dvfs_set_gov() and dvfs_set_gov_id().
  *
  * @param ctx The DVFS context as provided by dvfs_start()
  * @param freq The new frequency to set.
  *
  * @return \retval DVFS_SUCCESS if everything goes right.
  *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL.
+ *         \retval DVFS_ERROR_NOT_LEASED if every unit is leased by another context (see dvfs_lease.h).
  */
 int dvfs_set_freq(dvfs_ctx *ctx, unsigned int freq);
 
+/**
+ * Energy/performance preference of a DVFS unit, see dvfs_set_epp_profile().
+ */
+typedef struct {
+   const dvfs_unit *unit;  //!< The DVFS unit
+   const char *epp;        //!< The preference to set on the unit
+} dvfs_epp_setting;
+
+/**
+ * Applies an energy/performance preference profile: sets the preference of
+ * every listed DVFS unit in one pass. The units already holding the requested
+ * preference are not written again. The whole profile is applied even if
+ * some units fail.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param nb_settings The number of entries in the profile.
+ * @param profile The preference of each unit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c profile are NULL, or an entry is incomplete.
+ *         \retval DVFS_ERROR_FILE_ERROR if a preference cannot be written.
+ *
+ * @sa dvfs_unit_set_epp()
+ */
+int dvfs_set_epp_profile(const dvfs_ctx *ctx, unsigned int nb_settings, const dvfs_epp_setting *profile);
+
+/**
+ * Gets the idle states control, to bound the wake-up latency of single cores.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param ppIdle Will be filled with the idle control.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppIdle are NULL.
+ */
+int dvfs_get_idle(dvfs_ctx *ctx, dvfs_idle **ppIdle);
+
+/**
+ * Acquires an idle latency limit on several DVFS units in one pass: the idle
+ * states with a higher exit latency are disabled on all their cores until the
+ * limit is released. The states are set back as found by dvfs_stop().
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param nb_units The number of units.
+ * @param units The DVFS units, NULL for all the units of the context (only the leased ones once it holds leases).
+ * @param max_latency The highest exit latency allowed, in microseconds.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a state could not be disabled.
+ *         \retval DVFS_ERROR_NOT_LEASED if a given unit is fenced (see dvfs_lease.h).
+ *
+ * @sa dvfs_idle_acquire_unit(), dvfs_release_idle_latency()
+ */
+int dvfs_acquire_idle_latency(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units, unsigned int max_latency);
+
+/**
+ * Releases an idle latency limit acquired with dvfs_acquire_idle_latency().
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param nb_units The number of units.
+ * @param units The DVFS units, NULL for all the units of the context (only the leased ones once it holds leases).
+ * @param max_latency The limit given when acquiring it.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL or the limit is not held.
+ *         \retval DVFS_ERROR_FILE_ERROR if a state could not be changed.
+ */
+int dvfs_release_idle_latency(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units, unsigned int max_latency);
+
 /**
  * Gets the dvfs_core structure associated to the given core id.
  *
@@ -147,6 +362,34 @@ int dvfs_get_unit_by_id(const dvfs_ctx* ctx, const dvfs_unit** ppUnit, unsigned
  */
 int dvfs_get_unit_by_core(const dvfs_ctx *ctx, const dvfs_core *core, const dvfs_unit **ppUnit);
 
+/**
+ * Gets the DVFS unit of the core the calling thread is running on. The unit is
+ * cached per thread: as long as the thread stays on the same core, this only
+ * costs a \c sched_getcpu() call (served from the vDSO or rseq) and a
+ * comparison. The thread may migrate right after the call.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param ppUnit Will be filled with the DVFS unit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppUnit are NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the current core is not handled by the context.
+ */
+int dvfs_self_get_unit(const dvfs_ctx *ctx, const dvfs_unit **ppUnit);
+
+/**
+ * Sets the frequency of the DVFS unit the calling thread is running on. See
+ * dvfs_self_get_unit() and dvfs_unit_set_freq().
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param freq The frequency to set.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx is NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the current core is not handled by the context.
+ */
+int dvfs_self_set_freq(const dvfs_ctx *ctx, unsigned int freq);
+
 /**
  * Gets the number of DVFS units available in this context.
  *
@@ -157,3 +400,77 @@ int dvfs_get_unit_by_core(const dvfs_ctx *ctx, const dvfs_core *core, const dvfs
  *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c pNb are NULL.
  */
 int dvfs_get_nb_units(const dvfs_ctx* ctx, unsigned int *pNb);
+
+/**
+ * Gets the topology tree (package, die, NUMA node, L3 group) built above the
+ * DVFS units of this context.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param ppTopo Will be filled with the topology.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppTopo are NULL.
+ *
+ * @sa dvfs_topology
+ */
+int dvfs_get_topology(const dvfs_ctx* ctx, const dvfs_topology **ppTopo);
+
+/**
+ * Gets the number of uncore frequency domains available in this context. There
+ * is none when the \c intel_uncore_frequency driver is not loaded.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param pNb Will be filled with the number of uncore domains.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c pNb are NULL.
+ */
+int dvfs_get_nb_uncores(const dvfs_ctx* ctx, unsigned int *pNb);
+
+/**
+ * Gets the uncore frequency domain associated to the given index.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param ppUncore Will be filled with the uncore domain.
+ * @param index The index of the uncore domain to get.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppUncore are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if \c index does not match any uncore domain.
+ */
+int dvfs_get_uncore_by_id(const dvfs_ctx* ctx, const dvfs_uncore **ppUncore, unsigned int index);
+
+/**
+ * Gets the uncore frequency domain of the package die holding the given DVFS
+ * unit.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param unit The DVFS unit.
+ * @param ppUncore Will be filled with the uncore domain.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx, \c unit or \c ppUncore are NULL.
+ *         \retval DVFS_ERROR_UNCORE_UNAVAILABLE if no uncore domain matches the unit.
+ */
+int dvfs_get_uncore_by_unit(const dvfs_ctx* ctx, const dvfs_unit *unit, const dvfs_uncore **ppUncore);
+
+/**
+ * Sets the frequency of a DVFS unit and pins the uncore domain of its package
+ * die to the given uncore frequency, in one call. When the uncore domain
+ * cannot be written, the unit is set back to the frequency it had before the
+ * call.
+ *
+ * @param ctx The DVFS context as provided by dvfs_start()
+ * @param unit The DVFS unit.
+ * @param freq The core frequency to set.
+ * @param uncore_freq The uncore frequency to set.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c unit are NULL.
+ *         \retval DVFS_ERROR_UNCORE_UNAVAILABLE if no uncore domain matches the unit.
+ *         \retval DVFS_ERROR_INVALID_FREQ if \c uncore_freq is outside the range of the domain (nothing is changed).
+ *         \retval DVFS_ERROR_NOT_LEASED if the unit or the uncore domain is fenced (nothing is changed, see dvfs_lease.h).
+ *         \retval DVFS_ERROR_FILE_ERROR if the uncore domain cannot be written (the unit is restored to its previously requested frequency or limits).
+ *         Otherwise, the error met while setting the unit frequency, or while restoring it after an uncore failure.
+ */
+int dvfs_set_unit_and_uncore_freq(const dvfs_ctx* ctx, const dvfs_unit *unit, unsigned int freq, unsigned int uncore_freq);
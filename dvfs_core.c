@@ -24,33 +24,45 @@
 #include <unistd.h>
 
 #include "dvfs_core.h"
+#include "dvfs_epp.h"
 #include "dvfs_error.h"
+#include "dvfs_gov.h"
+#include "dvfs_state.h"
 
 // Semaphore name
 #define SEM_NAME "/libdvfsSeqSem"
 
-// These patterns should be used in snprintf functions
-#define SCALING_GOVERNOR_FILE_PATTERN "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_governor"
-#define SCALING_CURFREQ_FILE_PATTERN "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq"
-#define SCALING_AVAIL_FREQ_FILE_PATTERN "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_available_frequencies"
-#define SCALING_SETSPEED_FILE_PATTERN "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_setspeed"
-
-// Macros for wait and post on semaphore
-#define SAFE_SEM_POST(semaphore) { if (semaphore != NULL) sem_post(semaphore); }
-#define SAFE_SEM_WAIT(semaphore) { if (semaphore != NULL) sem_wait(semaphore); }
-
-static void init_dvfs_core(dvfs_core* pCore, unsigned int id, bool seq)
+static void init_dvfs_core(dvfs_core* pCore, unsigned int id, bool seq, const dvfs_backend *backend, unsigned int step)
 {
     assert(pCore);
 
     // A well initialized struct avoids tons of errors, trust me
     pCore->id = id;
+    pCore->backend = backend;
+    pCore->priv = NULL;
     pCore->nb_freqs = 0;
     pCore->freqs = NULL;
     pCore->fd_getf = NULL;
     pCore->fd_setf = NULL;
+    pCore->ctrl = DVFS_CTRL_SETSPEED;
+    pCore->freq_step = step;
+    pCore->fd_minf = NULL;
+    pCore->fd_maxf = NULL;
+    pCore->min_freq = 0;
+    pCore->max_freq = 0;
+    pCore->govs = 0;
+    pCore->fd_gov = -1;
     memset (pCore->init_gov, 0, sizeof (pCore->init_gov));
     pCore->init_freq = 0;
+    pCore->init_min_freq = 0;
+    pCore->init_max_freq = 0;
+    pCore->hwp->epp[0] = '\0';
+    pCore->hwp->init_epp[0] = '\0';
+    pCore->hwp->fd_msr = -1;
+    pCore->hwp->hwp_saved = false;
+    pCore->hwp->init_hwp_request = 0;
+    pCore->fenced = false;
+    pCore->state = NULL;
     pCore->sem = NULL;
 
     // open / create the semaphore
@@ -68,211 +80,52 @@ static void init_dvfs_core(dvfs_core* pCore, unsigned int id, bool seq)
     }
 }
 
-static int read_governor(dvfs_core* pCore)
-{
-    char fname [256] = {0};
-
-    assert(pCore);
-
-    // Paranoid: Make sure the fname buffer is long enough
-    assert (sizeof (SCALING_GOVERNOR_FILE_PATTERN) <= sizeof (fname));
-
-    /* fetch  the initial governor and frequency */
-    if ( snprintf (fname, sizeof (fname), SCALING_GOVERNOR_FILE_PATTERN, pCore->id) >= (int)sizeof(fname) )
-    {
-        return DVFS_ERROR_BUFFER_TOO_SHORT;
-        // No cleanup to do
-    }
-
-    SAFE_SEM_WAIT(pCore->sem);
-    FILE* fd = fopen(fname, "r");
-    if (fd == NULL)
-    {
-       SAFE_SEM_POST(pCore->sem);
-       return DVFS_ERROR_FILE_ERROR;
-    }
-    fscanf(fd, "%127s", pCore->init_gov);
-    fclose(fd);
-
-    SAFE_SEM_POST(pCore->sem);
-
-    return DVFS_SUCCESS;
-}
-
-static int read_cur_freq(dvfs_core* pCore)
-{
-    char fname [256] = {0};
-
-    assert(pCore);
-
-    assert (sizeof (SCALING_CURFREQ_FILE_PATTERN) <= sizeof (fname));
-    if ( snprintf (fname, sizeof (fname), SCALING_CURFREQ_FILE_PATTERN, pCore->id) >= (int)sizeof(fname) )
-    {
-        return DVFS_ERROR_BUFFER_TOO_SHORT;
-        // No cleanup to do here
-    }
-
-    SAFE_SEM_WAIT(pCore->sem);
-    FILE* fd = fopen(fname, "r");
-    if (fd == NULL)
-    {
-        SAFE_SEM_POST(pCore->sem);
-        return DVFS_ERROR_FILE_ERROR;
-    }
-    fscanf(fd, "%u", &pCore->init_freq);
-    fclose(fd);
-
-    SAFE_SEM_POST(pCore->sem);
-
-    return DVFS_SUCCESS;
+int dvfs_core_open(dvfs_core** pCore, unsigned int id, bool seq) {
+   return dvfs_core_open_backend(pCore, id, seq, &dvfs_backend_sysfs);
 }
 
-int read_available_freq(dvfs_core* pCore)
-{
-    char fname [256] = {0};
-
-    assert(pCore);
-    // Paranoid: Make sure the fname buffer is long enough
-    assert (sizeof (SCALING_AVAIL_FREQ_FILE_PATTERN) <= sizeof (fname));
-
-    /* parse all the frequencies */
-    if ( snprintf (fname, sizeof (fname), SCALING_AVAIL_FREQ_FILE_PATTERN, pCore->id) >= (int)sizeof(fname))
-    {
-        return DVFS_ERROR_BUFFER_TOO_SHORT;
-    }
-
-    FILE* fd = fopen(fname, "r");
-    if (fd == NULL)
-    {
-        return DVFS_ERROR_FILE_ERROR;
-    }
-
-    // Set freqs memory to zero
-    char freqs [1024] = {0};
-    char* fgets_error = fgets(freqs, sizeof(freqs), fd);
-    fclose(fd);
-
-    if (fgets_error == NULL)
-    {
-       return DVFS_ERROR_FILE_ERROR;
-    }
-
-    char *tmpstr=NULL;
-    bool inFreq = false;
-    // Count freqs number
-    for (tmpstr = freqs; *tmpstr; tmpstr++) {
-       if (*tmpstr >= '0' && *tmpstr <= '9') {
-          if (inFreq) {
-             continue;
-          }
-          pCore->nb_freqs++;
-          inFreq = true;
-       } else {
-          inFreq = false;
-       }
-    }
-
-    // Paranoid: No need to syscall malloc if no freqs are available
-    assert (pCore->nb_freqs > 0);
-
-    pCore->freqs = malloc(pCore->nb_freqs * sizeof(*pCore->freqs));
-    if ( pCore->freqs == NULL )
-    {
-        return DVFS_ERROR_MEM_ALLOC_FAILED;
-    }
-
-    unsigned int i=0;
-    char *strtokctx=NULL;
-    for (i = 0, tmpstr = strtok_r(freqs, " ", &strtokctx);
-         i < pCore->nb_freqs && tmpstr != NULL;
-         i++, tmpstr = strtok_r(NULL, " ", &strtokctx))
-    {
-       char *end;
-       pCore->freqs[pCore->nb_freqs - i - 1] = strtol (tmpstr, &end, 10);
-
-       // Paranoid: Check that what we have read in the file is valid
-       assert (end != tmpstr);
-    }
-    assert (i == pCore->nb_freqs);
-
-    return DVFS_SUCCESS;
+int dvfs_core_open_backend(dvfs_core** pCore, unsigned int id, bool seq, const dvfs_backend *backend) {
+   return dvfs_core_open_step(pCore, id, seq, backend, DVFS_DEFAULT_FREQ_STEP);
 }
 
-int dvfs_core_open(dvfs_core** pCore, unsigned int id, bool seq) {
-   char fname [256] = {0};
-
+int dvfs_core_open_step(dvfs_core** pCore, unsigned int id, bool seq, const dvfs_backend *backend, unsigned int step) {
    int id_error=DVFS_SUCCESS;
 
-   if ( pCore == NULL )
+   if ( pCore == NULL || backend == NULL || step == 0 )
    {
         return DVFS_ERROR_INVALID_ARG;
    }
 
    *pCore = malloc(sizeof(dvfs_core));
-   if ( pCore == NULL )
+   if ( *pCore == NULL )
+   {
+       return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   (*pCore)->hwp = malloc(sizeof(dvfs_core_hwp));
+   if ( (*pCore)->hwp == NULL )
    {
+       free(*pCore), *pCore = NULL;
        return DVFS_ERROR_MEM_ALLOC_FAILED;
    }
 
-   init_dvfs_core(*pCore,id,seq);
+   init_dvfs_core(*pCore,id,seq,backend,step);
 
-   // Gets initial governor (to put it back later)
-   id_error = read_governor(*pCore);
+   // Gets initial state (to put it back later)
+   id_error = backend->open(*pCore);
    if ( id_error != DVFS_SUCCESS )
    {
        dvfs_core_close(*pCore);
        return id_error;
    }
 
-   if (!strcmp((*pCore)->init_gov, "userspace")) // If it was userspace, we have
-                                             // to gets initial frequency
-                                             // to put it back later
-   {
-      id_error = read_cur_freq(*pCore);
-      if ( id_error != DVFS_SUCCESS )
-      {
-          dvfs_core_close(*pCore);
-          return id_error;
-      }
-   }
-
-   id_error = read_available_freq(*pCore);
+   id_error = backend->read_freqs(*pCore);
    if ( id_error != DVFS_SUCCESS)
    {
        dvfs_core_close(*pCore);
        return id_error;
    }
 
-   // Paranoid: Make sure the fname buffer is long enough
-   assert (sizeof (SCALING_SETSPEED_FILE_PATTERN) <= sizeof (fname));
-
-   // open the frequency setter file
-   if ( snprintf (fname, sizeof (fname), SCALING_SETSPEED_FILE_PATTERN, id) >= (int)sizeof(fname))
-   {
-      dvfs_core_close(*pCore);
-      return DVFS_ERROR_BUFFER_TOO_SHORT;
-   }
-
-   (*pCore)->fd_setf = fopen(fname, "w");
-   // don't check the result here to allow instantiating the library without any
-   // write access. Only set freq will fail (with no trouble).
-
-   // Paranoid: Make sure the fname buffer is long enough
-   assert (sizeof (SCALING_CURFREQ_FILE_PATTERN) <= sizeof (fname));
-
-   // same for the frequency getter file
-   if ( snprintf(fname, sizeof(fname), SCALING_CURFREQ_FILE_PATTERN, id) >= (int)sizeof(fname) )
-   {
-      dvfs_core_close(*pCore);
-      return DVFS_ERROR_BUFFER_TOO_SHORT;
-   }
-
-   (*pCore)->fd_getf = fopen(fname, "r");
-   if ((*pCore)->fd_getf == NULL) {
-      dvfs_core_close(*pCore);
-      return DVFS_ERROR_FILE_ERROR;
-   }
-
    return DVFS_SUCCESS;
 }
 
@@ -284,25 +137,22 @@ int dvfs_core_close(dvfs_core *core) {
    }
 
 
-   // restore the previous state
-   if (core->init_gov)
+   // restore the previous state, unless the core now belongs to another lease
+   if (!core->fenced)
    {
-       dvfs_core_set_gov(core, core->init_gov);
-
-       if (strcmp(core->init_gov, "userspace") == 0) {
-          dvfs_core_set_freq(core, core->init_freq);
-       }
+       dvfs_core_restore(core);
    }
 
-   free(core->freqs), core->freqs = NULL;
-   if (core->fd_setf != NULL) {
-      fclose(core->fd_setf), core->fd_setf = NULL;
-   }
+   core->backend->close(core);
 
-   if (core->fd_getf != NULL) {
-      fclose(core->fd_getf), core->fd_getf = NULL;
+   if (core->fd_gov >= 0)
+   {
+      close(core->fd_gov), core->fd_gov = -1;
    }
 
+   free(core->freqs), core->freqs = NULL;
+   free(core->hwp), core->hwp = NULL;
+
    // close the semaphore
    if (core->sem != NULL) {
       sem_close(core->sem);
@@ -314,44 +164,88 @@ int dvfs_core_close(dvfs_core *core) {
    return DVFS_SUCCESS;
 }
 
-int dvfs_core_get_gov (const dvfs_core *core, char *buf, size_t buf_len) {
-   char fname [256]={0};
-   FILE *fd=NULL;
+int dvfs_core_restore(dvfs_core *core) {
+   int ret = DVFS_SUCCESS;
+   int res;
+
    assert (core != NULL);
    if (core==NULL)
    {
        return DVFS_ERROR_INVALID_ARG;
    }
 
-   assert (sizeof (SCALING_GOVERNOR_FILE_PATTERN) <= sizeof (fname));
-   if ( snprintf (fname, sizeof (fname), SCALING_GOVERNOR_FILE_PATTERN, core->id) >= (int)sizeof(fname))
+   if (core->init_gov[0] != '\0')
+   {
+       ret = dvfs_core_set_gov(core, core->init_gov);
+
+       if (strcmp(core->init_gov, "userspace") == 0) {
+          res = dvfs_core_set_freq(core, core->init_freq);
+          ret = ret != DVFS_SUCCESS ? ret : res;
+       }
+   }
+
+   // after the frequency, which pins the limits
+   if (core->ctrl == DVFS_CTRL_MINMAX && core->init_max_freq != 0 && core->backend->set_limits != NULL)
+   {
+       res = core->backend->set_limits(core, core->init_min_freq, core->init_max_freq);
+       ret = ret != DVFS_SUCCESS ? ret : res;
+   }
+
+   // after the governor, as changing the governor may reset the preference
+   res = dvfs_epp_restore(core);
+   return ret != DVFS_SUCCESS ? ret : res;
+}
+
+int dvfs_core_get_gov (const dvfs_core *core, char *buf, size_t buf_len) {
+   assert (core != NULL);
+   if (core==NULL || buf == NULL)
    {
-       return DVFS_ERROR_BUFFER_TOO_SHORT;
+       return DVFS_ERROR_INVALID_ARG;
    }
 
    SAFE_SEM_WAIT(core->sem);
-   fd = fopen (fname, "r");
-   if (fd == NULL)
+   int ret = core->backend->get_gov(core, buf, buf_len);
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
+}
+
+/**
+ * Writes a governor already validated.
+ */
+static int set_gov(const dvfs_core *core, const char *gov) {
+   if (core->fenced)
    {
-      SAFE_SEM_POST(core->sem);
-      return DVFS_ERROR_FILE_ERROR;
+      return DVFS_ERROR_NOT_LEASED;
    }
 
-   char* fgets_result = fgets (buf, buf_len, fd);
-   fclose (fd);
+   SAFE_SEM_WAIT(core->sem);
+   int ret = core->backend->set_gov(core, gov);
+   // the driver may change the energy/performance preference with the
+   // governor: forget the cached one
+   core->hwp->epp[0] = '\0';
    SAFE_SEM_POST(core->sem);
 
-   if (fgets_result == NULL)
+   // published as the last change of the unit of the core
+   unsigned int id;
+   if (ret == DVFS_SUCCESS && core->state != NULL && dvfs_gov_get_id(gov, &id) == DVFS_SUCCESS)
    {
-      return DVFS_ERROR_FILE_ERROR;
+      dvfs_state_publish_gov(core->state, id);
    }
 
-   return DVFS_SUCCESS;
+   return ret;
+}
+
+/**
+ * Pinning the limits does not need any governor, "userspace" is then accepted
+ * although the driver does not provide it.
+ */
+static bool is_pinned_userspace(const dvfs_core *core, const char *gov) {
+   return core->ctrl == DVFS_CTRL_MINMAX && strcmp(gov, "userspace") == 0;
 }
 
 int dvfs_core_set_gov(const dvfs_core *core, const char *gov) {
-   char fname [256]={0};
-   FILE *fd=NULL;
+   unsigned int id;
 
    assert (core != NULL);
    if (core==NULL || gov == NULL)
@@ -359,37 +253,46 @@ int dvfs_core_set_gov(const dvfs_core *core, const char *gov) {
       return DVFS_ERROR_INVALID_ARG;
    }
 
-   // Paranoid: Make sure the fname buffer is long enough
-   assert (sizeof (SCALING_GOVERNOR_FILE_PATTERN) <= sizeof (fname));
-   if ( snprintf (fname, sizeof (fname), SCALING_GOVERNOR_FILE_PATTERN, core->id) >= (int)sizeof(fname))
+   if (core->govs != 0 && !is_pinned_userspace(core, gov)
+       && (dvfs_gov_get_id(gov, &id) != DVFS_SUCCESS || !dvfs_core_has_gov(core, id)))
    {
-       return DVFS_ERROR_BUFFER_TOO_SHORT;
+      return DVFS_ERROR_INVALID_GOV;
    }
 
-   SAFE_SEM_WAIT(core->sem);
+   return set_gov(core, gov);
+}
 
-   fd = fopen (fname, "w");
-   if (fd == NULL)
+bool dvfs_core_has_gov(const dvfs_core *core, unsigned int id) {
+   assert (core != NULL);
+   if (core == NULL || id >= DVFS_GOV_MAX)
    {
-      SAFE_SEM_POST(core->sem);
-      return DVFS_ERROR_FILE_ERROR;
+      return false;
    }
 
-   if (fwrite (gov, sizeof (*gov), strlen (gov) + 1, fd) < strlen (gov) + 1)
+   return core->govs == 0 || (core->govs & (UINT32_C(1) << id)) != 0;
+}
+
+int dvfs_core_set_gov_id(const dvfs_core *core, unsigned int id) {
+   const char *gov = NULL;
+
+   assert (core != NULL);
+   if (core == NULL)
    {
-      fclose (fd);
-      SAFE_SEM_POST(core->sem);
-      return DVFS_ERROR_FILE_ERROR;
+      return DVFS_ERROR_INVALID_ARG;
    }
 
-   int fflush_error = fflush (fd);
-   fclose(fd);
-   SAFE_SEM_POST(core->sem);
-   if (fflush_error != 0) {
-      return DVFS_ERROR_FILE_ERROR;
+   int ret = dvfs_gov_get_name(id, &gov);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
    }
 
-   return DVFS_SUCCESS;
+   if (!dvfs_core_has_gov(core, id) && !is_pinned_userspace(core, gov))
+   {
+      return DVFS_ERROR_INVALID_GOV;
+   }
+
+   return set_gov(core, gov);
 }
 
 int dvfs_core_set_freq(const dvfs_core *core, unsigned int freq) {
@@ -399,12 +302,6 @@ int dvfs_core_set_freq(const dvfs_core *core, unsigned int freq) {
        return DVFS_ERROR_INVALID_ARG;
    }
 
-   // If fd_freq has not been opened yet
-   if (core->fd_setf == NULL)
-   {
-      return DVFS_ERROR_SET_FREQ_FILE;
-   }
-
    // check that the frequency asked is available
 #ifndef NDEBUG
    unsigned int i;
@@ -423,20 +320,40 @@ int dvfs_core_set_freq(const dvfs_core *core, unsigned int freq) {
    assert (freqIsValid);
 #endif
 
-   SAFE_SEM_WAIT(core->sem);
-   if (fprintf(core->fd_setf, "%u", freq) < 0) {
-      SAFE_SEM_POST(core->sem);
-      return DVFS_ERROR_FILE_ERROR;
+   if (core->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
    }
 
-   int fflush_result = fflush (core->fd_setf);
+   SAFE_SEM_WAIT(core->sem);
+   int ret = core->backend->set_freq(core, freq);
    SAFE_SEM_POST(core->sem);
-   if (fflush_result != 0)
+
+   if (ret == DVFS_SUCCESS && core->state != NULL)
    {
-      return DVFS_ERROR_FILE_ERROR;
+      dvfs_state_publish_target(core->state, freq);
    }
 
-   return DVFS_SUCCESS;
+   return ret;
+}
+
+int dvfs_core_set_limits(const dvfs_core *core, unsigned int min, unsigned int max) {
+   assert (core != NULL);
+   if (core == NULL || min > max || core->ctrl != DVFS_CTRL_MINMAX || core->backend->set_limits == NULL)
+   {
+       return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = core->backend->set_limits(core, min, max);
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
 }
 
 int dvfs_core_get_current_freq(const dvfs_core *core, unsigned int* pFreq) {
@@ -448,13 +365,46 @@ int dvfs_core_get_current_freq(const dvfs_core *core, unsigned int* pFreq) {
    }
 
    SAFE_SEM_WAIT(core->sem);
-   if (fscanf(core->fd_getf, "%u", pFreq) < 0) {
-      SAFE_SEM_POST(core->sem);
+   int ret = core->backend->get_freq(core, pFreq);
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
+}
+
+int dvfs_core_get_target(const dvfs_core *core, unsigned int *pFreq) {
+   assert (core != NULL);
+   assert (pFreq != NULL);
+   if (core == NULL || pFreq == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core->backend->get_target == NULL)
+   {
       return DVFS_ERROR_FILE_ERROR;
    }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = core->backend->get_target(core, pFreq);
    SAFE_SEM_POST(core->sem);
 
-   return DVFS_SUCCESS;
+   return ret;
+}
+
+int dvfs_core_get_transition_latency(const dvfs_core *core, unsigned int *pLatency) {
+   assert (core != NULL);
+   assert (pLatency != NULL);
+   if (core == NULL || pLatency == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core->backend->get_latency == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return core->backend->get_latency(core, pLatency);
 }
 
 int dvfs_core_get_freq (const dvfs_core *core, unsigned int* pFreq, unsigned int freq_id) {
@@ -18,11 +18,17 @@
 
 #pragma once
 
+#include <errno.h>
 #include <fcntl.h>
 #include <semaphore.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "dvfs_backend.h"
+
+struct dvfs_state_record;
+
 /**
  * @file dvfs_core.h
  *
@@ -30,19 +36,67 @@
  * core.
  */
 
+/** Takes the semaphore sequentializing the transitions, if any, waiting again when interrupted by a signal */
+#define SAFE_SEM_WAIT(semaphore) { if (semaphore != NULL) while (sem_wait(semaphore) != 0 && errno == EINTR); }
+/** Releases the semaphore sequentializing the transitions, if any */
+#define SAFE_SEM_POST(semaphore) { if (semaphore != NULL) sem_post(semaphore); }
+
 /**
- * Represents on core. A core allows to control CPU Core governor and frequency.
+ * Energy/performance preference and HWP hints of a core (see dvfs_epp.h),
+ * updated by their setters through a const core, under the semaphore.
  */
 typedef struct {
+   char epp[64];           //!< Last energy/performance preference read or written, empty if unknown
+   char init_epp[64];      //!< Preference before the first change, empty if never changed
+   int fd_msr;             //!< MSR device used for the HWP hints, opened on first use (-1 otherwise)
+   bool hwp_saved;         //!< True if \c init_hwp_request holds the HWP request before the first change
+   uint64_t init_hwp_request;    //!< IA32_HWP_REQUEST before the first change of the hints
+} dvfs_core_hwp;
+
+/**
+ * How the frequency of a core is controlled.
+ */
+typedef enum {
+   DVFS_CTRL_SETSPEED = 0, //!< Writes in \c scaling_setspeed, requires the "userspace" governor (acpi-cpufreq, ...)
+   DVFS_CTRL_MINMAX        //!< Pins \c scaling_min_freq and \c scaling_max_freq (intel_pstate, amd-pstate, CPPC, ...)
+} dvfs_freq_ctrl;
+
+/** Default step of the synthesized frequency tables, in kHz */
+#define DVFS_DEFAULT_FREQ_STEP 100000
+
+/**
+ * Represents on core. A core allows to control CPU Core governor and frequency.
+ */
+typedef struct dvfs_core {
    unsigned int id;        //!< Core id as declared by Linux
+   const dvfs_backend *backend;  //!< Backend accessing the hardware
+   void *priv;             //!< Data private to the backend
    unsigned int nb_freqs;  //!< Number of frequencies available for this core
    unsigned int *freqs;    //!< Available frequencies for this core, sorted by increasing order
 
    FILE *fd_setf;          //!< File descriptor toward the \c set_speed file
    FILE *fd_getf;          //!< Descriptor toward the \c cur_freq file
 
+   dvfs_freq_ctrl ctrl;    //!< How the frequency is controlled
+   unsigned int freq_step; //!< Step of the synthesized frequency table (kHz), see dvfs_core_open_step()
+   FILE *fd_minf;          //!< File descriptor toward the \c scaling_min_freq file (DVFS_CTRL_MINMAX only)
+   FILE *fd_maxf;          //!< File descriptor toward the \c scaling_max_freq file (DVFS_CTRL_MINMAX only)
+   unsigned int min_freq;  //!< Lower limit currently set (DVFS_CTRL_MINMAX only)
+   unsigned int max_freq;  //!< Upper limit currently set (DVFS_CTRL_MINMAX only)
+
+   uint32_t govs;          //!< Available governors, bit i for the governor of id i (see dvfs_gov.h), 0 if not enumerated
+   int fd_gov;             //!< Descriptor toward the \c scaling_governor file, opened on first use (-1 otherwise)
+
    char init_gov[128];     //!< Governor used when core get initialised
    unsigned int init_freq; //!< Freqency used when core get initialised
+   unsigned int init_min_freq;   //!< Lower limit used when core get initialised (DVFS_CTRL_MINMAX only)
+   unsigned int init_max_freq;   //!< Upper limit used when core get initialised (DVFS_CTRL_MINMAX only)
+
+   dvfs_core_hwp *hwp;     //!< Energy/performance preference and HWP hints
+
+   bool fenced;            //!< True if the unit of the core is leased by another context (see dvfs_lease.h): changes are refused and the state is not restored
+
+   struct dvfs_state_record *state; //!< Published state of the unit of the core (see dvfs_state.h), NULL if not published
 
    sem_t *sem;             //!< Semaphore for sequentialization. Can be NULL.
 } dvfs_core;
@@ -50,6 +104,12 @@ typedef struct {
 /**
  * Opens the Core context for the given core ID.
  *
+ * When the cpufreq driver offers the "userspace" governor, the frequency is set
+ * through \c scaling_setspeed. Otherwise, the frequency is set by pinning both
+ * \c scaling_min_freq and \c scaling_max_freq to it, and the frequency table
+ * is synthesized from \c cpuinfo_min_freq, \c cpuinfo_max_freq and
+ * \c base_frequency when the driver does not list its frequencies.
+ *
  * The dvfs_core is valid even if the semaphore failed. The frequency transitions will
  * not be seqeuntialized.
  *
@@ -67,6 +127,43 @@ typedef struct {
  */
 int dvfs_core_open(dvfs_core** ppCore, unsigned int id, bool seq);
 
+/**
+ * Opens the Core context for the given core ID, accessing the hardware
+ * through the given backend. See dvfs_core_open().
+ *
+ * @param ppCore the instanciated Core context for this core.
+ * @param id The id of the core to control.
+ * @param seq True when the frequency transitions must be sequentialized.
+ * @param backend The backend to use (for instance \c &dvfs_backend_sysfs).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppCore or \c backend are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_core_close()
+ */
+int dvfs_core_open_backend(dvfs_core** ppCore, unsigned int id, bool seq, const dvfs_backend *backend);
+
+/**
+ * Opens the Core context for the given core ID through the given backend,
+ * with the step used to synthesize its frequency table when the driver does
+ * not provide \c scaling_available_frequencies (intel_pstate, amd-pstate,
+ * CPPC...). See dvfs_core_open_backend(), which uses DVFS_DEFAULT_FREQ_STEP.
+ *
+ * @param ppCore the instanciated Core context for this core.
+ * @param id The id of the core to control.
+ * @param seq True when the frequency transitions must be sequentialized.
+ * @param backend The backend to use (for instance \c &dvfs_backend_sysfs).
+ * @param step The step in kHz.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppCore or \c backend are NULL or if \c step is 0.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_core_close()
+ */
+int dvfs_core_open_step(dvfs_core** ppCore, unsigned int id, bool seq, const dvfs_backend *backend, unsigned int step);
+
 /**
  * Closes properly an opened Core context.
  * Sets back the governor that was in place when opening the context.
@@ -78,6 +175,20 @@ int dvfs_core_open(dvfs_core** ppCore, unsigned int id, bool seq);
  */
 int dvfs_core_close(dvfs_core *core);
 
+/**
+ * Puts the core back in the state found when opening it: governor, frequency
+ * under "userspace", limits (DVFS_CTRL_MINMAX) and energy/performance
+ * preference. Called by dvfs_core_close() and when a leased unit is released.
+ *
+ * @param core The core.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core is NULL.
+ *         \retval DVFS_ERROR_NOT_LEASED if the core is fenced (see dvfs_lease.h).
+ *         \retval DVFS_ERROR_FILE_ERROR if a value could not be restored.
+ */
+int dvfs_core_restore(dvfs_core *core);
+
 /**
  * Sets the current DVFS governor on the given core to the given buffer.
  *
@@ -87,7 +198,7 @@ int dvfs_core_close(dvfs_core *core);
  *
  * @return \retval DVFS_SUCCESS if everything goes right.
  *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c buf are NULL.
- *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer for the path to the governor file is too short
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer for the path to the governor file, or \c buf_len, is too short
  *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
  */
 int dvfs_core_get_gov(const dvfs_core *core, char *buf, size_t buf_len);
@@ -95,19 +206,54 @@ int dvfs_core_get_gov(const dvfs_core *core, char *buf, size_t buf_len);
 /**
  * Changes the governor on the given core.
  *
+ * When the frequency is controlled by pinning the limits (DVFS_CTRL_MINMAX),
+ * no governor is needed to set the frequency: requesting "userspace" succeeds
+ * without changing anything.
+ *
+ * The governor is checked against the ones enumerated when opening the core,
+ * when the backend enumerates them.
+ *
  * @param core The core on which the governor has to be set.
  * @param gov The governor to set.
  *
  * @return \retval DVFS_SUCCESS if everything goes right.
  *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c buf are NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if the governor is not available on the core.
  *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer for the path to the governor file is too short.
  *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
  */
 int dvfs_core_set_gov(const dvfs_core *core, const char *gov);
 
+/**
+ * Tells if a governor is available on the core. All the governors are
+ * considered available when the backend does not enumerate them.
+ *
+ * @param core The core.
+ * @param id The id of the governor, see dvfs_gov_get_id().
+ *
+ * @return True if the governor can be set on the core.
+ */
+bool dvfs_core_has_gov(const dvfs_core *core, unsigned int id);
+
+/**
+ * Changes the governor on the given core, the governor being given by its id.
+ * Neither the name nor any path is processed: the cost is a single write.
+ *
+ * @param core The core on which the governor has to be set.
+ * @param id The id of the governor, see dvfs_gov_get_id().
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core is NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if the governor is not available on the core.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ */
+int dvfs_core_set_gov_id(const dvfs_core *core, unsigned int id);
+
 /**
  * Sets the frequency for the given core. Assumes that the "userspace" governor
- * has been set, result is unknown otherwise.
+ * has been set, result is unknown otherwise. When the frequency is controlled
+ * by pinning the limits (DVFS_CTRL_MINMAX), the limits are written in the
+ * order keeping the range valid and no governor is needed.
  *
  * @param core The related core.
  * @param freq The frequency to set.
@@ -119,6 +265,22 @@ int dvfs_core_set_gov(const dvfs_core *core, const char *gov);
  */
 int dvfs_core_set_freq(const dvfs_core *core, unsigned int freq);
 
+/**
+ * Sets the frequency limits of a core controlled by pinning its limits
+ * (DVFS_CTRL_MINMAX), for instance to give the hardware a range instead of a
+ * single frequency. The limits are written in the order keeping the range valid.
+ *
+ * @param core The related core.
+ * @param min The lower limit.
+ * @param max The upper limit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core is NULL, \c min is above \c max or the core is not controlled by its limits.
+ *         \retval DVFS_ERROR_SET_FREQ_FILE limit files not operational.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ */
+int dvfs_core_set_limits(const dvfs_core *core, unsigned int min, unsigned int max);
+
 /**
  * Gets the frequency currently set for the core. Warning, this is not
  * necessarily the frequency currently active for the core as other cores in the
@@ -136,6 +298,36 @@ int dvfs_core_set_freq(const dvfs_core *core, unsigned int freq);
  */
 int dvfs_core_get_current_freq(const dvfs_core *core, unsigned int* pFreq);
 
+/**
+ * Gets the frequency last requested for the core, as opposed to the one it
+ * currently runs at (dvfs_core_get_current_freq()), which is measured and often
+ * not an entry of the frequency table. For the sysfs backend, this is
+ * \c scaling_setspeed, only available with the "userspace" governor, or the
+ * pinned limits of a DVFS_CTRL_MINMAX core.
+ *
+ * @param core The CPU core.
+ * @param pFreq The frequency requested.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c pFreq are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if no frequency is requested or if the backend cannot read it back.
+ */
+int dvfs_core_get_target(const dvfs_core *core, unsigned int *pFreq);
+
+/**
+ * Gets the time the hardware of the core takes to switch frequencies, as
+ * declared by the driver (\c cpuinfo_transition_latency for the sysfs
+ * backend). The time of the write itself is usually much shorter.
+ *
+ * @param core The CPU core.
+ * @param pLatency The transition latency (ns).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c pLatency are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the backend does not know the latency.
+ */
+int dvfs_core_get_transition_latency(const dvfs_core *core, unsigned int *pLatency);
+
 /**
  * Gets the frequency currently set for the core.
  *
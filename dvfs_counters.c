@@ -0,0 +1,414 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dvfs_counters.h"
+#include "dvfs_error.h"
+
+static const dvfs_counters_event default_events[DVFS_COUNTER_NB_DEFAULT] = {
+   [DVFS_COUNTER_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+   [DVFS_COUNTER_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+   [DVFS_COUNTER_LLC_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+   [DVFS_COUNTER_STALLS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND },
+};
+
+static int perf_event_open(struct perf_event_attr *attr, int cpu, int group_fd)
+{
+   return syscall(SYS_perf_event_open, attr, -1, cpu, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * Opens the group of a core. The core is left with no event if the first one
+ * cannot be opened.
+ */
+static void open_core(dvfs_counters *counters, unsigned int id)
+{
+   dvfs_counters_core *core = &counters->cores[id];
+   struct perf_event_attr attr;
+   long page_size = sysconf(_SC_PAGESIZE);
+   unsigned int i;
+
+   for (i = 0; i < counters->nb_events; i++)
+   {
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = counters->events[i].type;
+      attr.config = counters->events[i].config;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      core->fds[i] = perf_event_open(&attr, id, i == 0 ? -1 : core->fds[0]);
+      if (core->fds[i] == -1)
+      {
+         if (i == 0)
+         {
+            return;
+         }
+         continue;
+      }
+
+      core->pos[i] = core->nb_open++;
+      counters->available |= 1U << i;
+
+      // rdpmc needs the page of the event, read() is used without it
+      core->pages[i] = mmap(NULL, page_size, PROT_READ, MAP_SHARED, core->fds[i], 0);
+      if (core->pages[i] == MAP_FAILED)
+      {
+         core->pages[i] = NULL;
+      }
+   }
+}
+
+static void close_core(dvfs_counters_core *core)
+{
+   long page_size = sysconf(_SC_PAGESIZE);
+   unsigned int i;
+
+   // the members first, the group goes with its leader
+   for (i = DVFS_COUNTERS_MAX; i-- > 0;)
+   {
+      if (core->pages[i] != NULL)
+      {
+         munmap(core->pages[i], page_size);
+      }
+      if (core->fds[i] != -1)
+      {
+         close(core->fds[i]);
+      }
+   }
+}
+
+int dvfs_counters_open(dvfs_counters **ppCounters, const dvfs_ctx *ctx, const dvfs_counters_event *events, unsigned int nb_events)
+{
+   unsigned int i, j, k;
+
+   assert(ppCounters != NULL);
+   assert(ctx != NULL);
+   if (ppCounters == NULL || ctx == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (events == NULL)
+   {
+      events = default_events;
+      nb_events = DVFS_COUNTER_NB_DEFAULT;
+   }
+   if (nb_events == 0 || nb_events > DVFS_COUNTERS_MAX)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_counters *counters = calloc(1, sizeof(*counters));
+   if (counters == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   counters->ctx = ctx;
+   counters->nb_events = nb_events;
+   memcpy(counters->events, events, nb_events * sizeof(*events));
+
+   counters->nb_cores = ctx->topo->nb_core_nodes;
+   counters->cores = malloc(counters->nb_cores * sizeof(*counters->cores));
+   if (counters->cores == NULL)
+   {
+      free(counters);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   for (i = 0; i < counters->nb_cores; i++)
+   {
+      for (k = 0; k < DVFS_COUNTERS_MAX; k++)
+      {
+         counters->cores[i].fds[k] = -1;
+         counters->cores[i].pos[k] = -1;
+         counters->cores[i].pages[k] = NULL;
+      }
+      counters->cores[i].nb_open = 0;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      for (j = 0; j < ctx->units[i]->nb_cores; j++)
+      {
+         open_core(counters, ctx->units[i]->cores[j]->id);
+      }
+   }
+
+   if ((counters->available & 1) == 0)
+   {
+      dvfs_counters_close(counters);
+      return DVFS_ERROR_COUNTERS_UNAVAILABLE;
+   }
+
+   *ppCounters = counters;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_counters_close(dvfs_counters *counters)
+{
+   unsigned int i;
+
+   assert(counters != NULL);
+   if (counters == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < counters->nb_cores; i++)
+   {
+      close_core(&counters->cores[i]);
+   }
+   free(counters->cores);
+   free(counters);
+   return DVFS_SUCCESS;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+static uint64_t rdpmc(unsigned int counter)
+{
+   uint32_t low, high;
+
+   __asm__ volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+   return low | ((uint64_t) high << 32);
+}
+
+static uint64_t rdtsc(void)
+{
+   uint32_t low, high;
+
+   __asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+   return low | ((uint64_t) high << 32);
+}
+
+/**
+ * Reads the group from user space, following the protocol of the perf mapped
+ * page. The page of a per core event only describes the counter of its own
+ * core: the calling thread has to run on it.
+ *
+ * @return False if the group cannot be read this way (other core, event not
+ * scheduled or multiplexed, rdpmc not allowed).
+ */
+static bool read_rdpmc(const dvfs_counters *counters, unsigned int id, dvfs_counters_sample *pSample)
+{
+   const dvfs_counters_core *core = &counters->cores[id];
+   unsigned int i;
+
+   if ((unsigned int) sched_getcpu() != id)
+   {
+      return false;
+   }
+
+   for (i = 0; i < counters->nb_events; i++)
+   {
+      volatile struct perf_event_mmap_page *page = core->pages[i];
+      uint64_t enabled, running, count, cyc, quot, rem, delta;
+      uint32_t seq, index;
+
+      if (core->fds[i] == -1)
+      {
+         pSample->values[i] = 0;
+         continue;
+      }
+      if (page == NULL)
+      {
+         return false;
+      }
+
+      do
+      {
+         seq = page->lock;
+         __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+         enabled = page->time_enabled;
+         running = page->time_running;
+         index = page->index;
+         if (!page->cap_user_rdpmc || index == 0 || enabled != running)
+         {
+            return false;
+         }
+
+         count = page->offset + ((int64_t) (rdpmc(index - 1) << (64 - page->pmc_width)) >> (64 - page->pmc_width));
+
+         // the times of the page date from the last scheduling of the group
+         if (page->cap_user_time)
+         {
+            cyc = rdtsc();
+            quot = cyc >> page->time_shift;
+            rem = cyc & (((uint64_t) 1 << page->time_shift) - 1);
+            delta = page->time_offset + quot * page->time_mult + ((rem * page->time_mult) >> page->time_shift);
+            enabled += delta;
+            running += delta;
+         }
+
+         __atomic_signal_fence(__ATOMIC_SEQ_CST);
+      } while (page->lock != seq);
+
+      pSample->values[i] = count;
+      if (i == 0)
+      {
+         pSample->time_enabled = enabled;
+         pSample->time_running = running;
+      }
+   }
+
+   // migrated while reading, the counters may belong to another core
+   return (unsigned int) sched_getcpu() == id;
+}
+#else
+static bool read_rdpmc(const dvfs_counters *counters, unsigned int id, dvfs_counters_sample *pSample)
+{
+   (void) counters;
+   (void) id;
+   (void) pSample;
+   return false;
+}
+#endif
+
+/**
+ * Reads the group of a core with a single read().
+ */
+static int read_group(const dvfs_counters *counters, unsigned int id, dvfs_counters_sample *pSample)
+{
+   const dvfs_counters_core *core = &counters->cores[id];
+   uint64_t buf[3 + DVFS_COUNTERS_MAX];
+   unsigned int i;
+
+   // nr, time_enabled, time_running then the values in the order of the group
+   ssize_t size = read(core->fds[0], buf, sizeof(buf));
+   if (size < (ssize_t) ((3 + core->nb_open) * sizeof(*buf)))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   pSample->time_enabled = buf[1];
+   pSample->time_running = buf[2];
+   for (i = 0; i < counters->nb_events; i++)
+   {
+      uint64_t value = core->pos[i] == -1 ? 0 : buf[3 + core->pos[i]];
+
+      if (buf[2] != 0 && buf[2] < buf[1])
+      {
+         value = (double) value * buf[1] / buf[2];
+      }
+      pSample->values[i] = value;
+   }
+   for (; i < DVFS_COUNTERS_MAX; i++)
+   {
+      pSample->values[i] = 0;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_counters_read_core(dvfs_counters *counters, const dvfs_core *core, dvfs_counters_sample *pSample)
+{
+   unsigned int i;
+
+   assert(counters != NULL);
+   assert(core != NULL);
+   assert(pSample != NULL);
+   if (counters == NULL || core == NULL || pSample == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core->id >= counters->nb_cores || counters->cores[core->id].nb_open == 0)
+   {
+      return DVFS_ERROR_INVALID_CORE_ID;
+   }
+
+   if (read_rdpmc(counters, core->id, pSample))
+   {
+      for (i = counters->nb_events; i < DVFS_COUNTERS_MAX; i++)
+      {
+         pSample->values[i] = 0;
+      }
+      __atomic_fetch_add(&counters->nb_rdpmc, 1, __ATOMIC_RELAXED);
+      return DVFS_SUCCESS;
+   }
+
+   __atomic_fetch_add(&counters->nb_read, 1, __ATOMIC_RELAXED);
+   return read_group(counters, core->id, pSample);
+}
+
+int dvfs_counters_read_unit(dvfs_counters *counters, const dvfs_unit *unit, dvfs_counters_sample *pSample)
+{
+   dvfs_counters_sample core_sample;
+   unsigned int i, j;
+
+   assert(counters != NULL);
+   assert(unit != NULL);
+   assert(pSample != NULL);
+   if (counters == NULL || unit == NULL || pSample == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   memset(pSample, 0, sizeof(*pSample));
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int ret = dvfs_counters_read_core(counters, unit->cores[i], &core_sample);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+
+      for (j = 0; j < counters->nb_events; j++)
+      {
+         pSample->values[j] += core_sample.values[j];
+      }
+      pSample->time_enabled += core_sample.time_enabled;
+      pSample->time_running += core_sample.time_running;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_counters_read_units(dvfs_counters *counters, unsigned int nb_units, const dvfs_unit **units, dvfs_counters_sample *samples)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(counters != NULL);
+   assert(samples != NULL);
+   if (counters == NULL || samples == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (units == NULL)
+   {
+      nb_units = counters->ctx->nb_units;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      int uret = dvfs_counters_read_unit(counters, units == NULL ? counters->ctx->units[i] : units[i], &samples[i]);
+      if (uret != DVFS_SUCCESS)
+      {
+         ret = uret;
+      }
+   }
+   return ret;
+}
@@ -0,0 +1,167 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_counters.h
+ *
+ * Hardware performance counters of the cores, to tell how a phase behaves
+ * (IPC, last level cache misses, stalls) before changing its frequency. A
+ * group of counters is opened per core with \c perf_event_open, counting
+ * everything running on the core. The groups are read together:
+ * - with \c rdpmc, through the page mapped by perf, when the calling thread
+ *   runs on the core and the kernel allows it (x86 only),
+ * - otherwise with a single \c read() of the group.
+ *
+ * The counts are cumulative since the opening: a controller keeps the
+ * previous sample and works on the differences. Opening the counters of all
+ * the cores needs \c CAP_PERFMON or a \c perf_event_paranoid of 0 or less.
+ */
+
+/** Highest number of events in a group */
+#define DVFS_COUNTERS_MAX 8
+
+/**
+ * Default events, in the order of the samples.
+ */
+typedef enum {
+   DVFS_COUNTER_CYCLES = 0,      //!< Core cycles
+   DVFS_COUNTER_INSTRUCTIONS,    //!< Instructions retired
+   DVFS_COUNTER_LLC_MISSES,      //!< Last level cache misses
+   DVFS_COUNTER_STALLS,          //!< Cycles stalled in the back-end (memory), often not provided on Intel processors
+   DVFS_COUNTER_NB_DEFAULT       //!< Number of default events
+} dvfs_counter_id;
+
+/**
+ * An event to count, as given to \c perf_event_open.
+ */
+typedef struct {
+   uint32_t type;       //!< Type of the event (\c PERF_TYPE_HARDWARE, \c PERF_TYPE_RAW, ...)
+   uint64_t config;     //!< Event within the type
+} dvfs_counters_event;
+
+/**
+ * Counts read from a core or summed over the cores of a unit.
+ */
+typedef struct {
+   uint64_t values[DVFS_COUNTERS_MAX];    //!< Counts of the events since the opening, scaled when the group was multiplexed, 0 for the events not available
+   uint64_t time_enabled;                 //!< Time the group was enabled (ns)
+   uint64_t time_running;                 //!< Time the group was actually counting (ns), lower than \c time_enabled when multiplexed
+} dvfs_counters_sample;
+
+/**
+ * Counter group of a core.
+ */
+typedef struct {
+   int fds[DVFS_COUNTERS_MAX];      //!< Descriptor of each event, -1 if not available. The first one leads the group.
+   int pos[DVFS_COUNTERS_MAX];      //!< Position of each event in a group read, -1 if not available
+   void *pages[DVFS_COUNTERS_MAX];  //!< Pages mapped for \c rdpmc, NULL if not mapped
+   unsigned int nb_open;            //!< Number of events in the group, 0 if the core cannot be counted
+} dvfs_counters_core;
+
+/**
+ * Counters of the cores of a context.
+ */
+typedef struct {
+   const dvfs_ctx *ctx;                         //!< The context
+   unsigned int nb_events;                      //!< Number of events counted
+   dvfs_counters_event events[DVFS_COUNTERS_MAX];  //!< Events counted
+   uint32_t available;                          //!< Bit i set if the event i could be opened on at least one core
+   unsigned int nb_cores;                       //!< Size of \c cores (highest core id + 1)
+   dvfs_counters_core *cores;                   //!< Counter groups indexed by core id
+
+   unsigned long long nb_rdpmc;                 //!< Groups read with \c rdpmc
+   unsigned long long nb_read;                  //!< Groups read with \c read()
+} dvfs_counters;
+
+/**
+ * Opens a counter group on every core of the context. The events the
+ * processor does not provide are left out of the groups (see
+ * \c dvfs_counters.available).
+ *
+ * @param ppCounters Will be filled with the counters.
+ * @param ctx The context.
+ * @param events The events to count, NULL for the default ones (dvfs_counter_id).
+ * @param nb_events The number of events, at most DVFS_COUNTERS_MAX (ignored when \c events is NULL).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppCounters or \c ctx are NULL or if \c nb_events is 0 or too high.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_COUNTERS_UNAVAILABLE if the first event cannot be counted on any core.
+ *
+ * @sa dvfs_counters_close()
+ */
+int dvfs_counters_open(dvfs_counters **ppCounters, const dvfs_ctx *ctx, const dvfs_counters_event *events, unsigned int nb_events);
+
+/**
+ * Closes the counters.
+ *
+ * @param counters The counters.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c counters is NULL.
+ */
+int dvfs_counters_close(dvfs_counters *counters);
+
+/**
+ * Reads the counters of a core.
+ *
+ * @param counters The counters.
+ * @param core The core.
+ * @param pSample Will be filled with the counts.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c counters, \c core or \c pSample are NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the core is not counted.
+ *         \retval DVFS_ERROR_FILE_ERROR if the group cannot be read.
+ */
+int dvfs_counters_read_core(dvfs_counters *counters, const dvfs_core *core, dvfs_counters_sample *pSample);
+
+/**
+ * Reads the counters of the cores of a unit and sums them.
+ *
+ * @param counters The counters.
+ * @param unit The unit.
+ * @param pSample Will be filled with the counts of the unit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c counters, \c unit or \c pSample are NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if a core of the unit is not counted.
+ *         \retval DVFS_ERROR_FILE_ERROR if a group cannot be read.
+ */
+int dvfs_counters_read_unit(dvfs_counters *counters, const dvfs_unit *unit, dvfs_counters_sample *pSample);
+
+/**
+ * Reads the counters of several units in one pass. All the units are read
+ * even if one fails.
+ *
+ * @param counters The counters.
+ * @param nb_units The number of units.
+ * @param units The units, NULL for all the units of the context (\c nb_units is then ignored).
+ * @param samples Will be filled with the counts of each unit, in the order of \c units (or of the unit ids).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c counters or \c samples are NULL.
+ *         Otherwise, the last error of dvfs_counters_read_unit().
+ */
+int dvfs_counters_read_units(dvfs_counters *counters, unsigned int nb_units, const dvfs_unit **units, dvfs_counters_sample *samples);
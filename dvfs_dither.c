@@ -0,0 +1,280 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdlib.h>
+
+#include "dvfs_dither.h"
+#include "dvfs_error.h"
+#include "dvfs_timer.h"
+
+/**
+ * Gets the highest transition latency declared for the cores of the unit, 0
+ * if none is known.
+ */
+static unsigned int declared_latency(const dvfs_unit *unit)
+{
+   unsigned int i, latency, max = 0;
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      if (dvfs_core_get_transition_latency(unit->cores[i], &latency) == DVFS_SUCCESS && latency > max)
+      {
+         max = latency;
+      }
+   }
+   return max;
+}
+
+/**
+ * Sets a step on the unit, accounts the time spent on the previous one and
+ * updates the estimated transition cost. Called with the lock held.
+ */
+static int write_step(dvfs_dither *dither, unsigned int freq)
+{
+   unsigned long long start = dvfs_timer_now_ns();
+   int ret = dvfs_unit_set_freq(dither->unit, freq);
+   unsigned long long end = dvfs_timer_now_ns();
+
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   // the previous step lasts until the transition completes
+   if (dither->cur_freq != 0 && dither->since_ns != 0)
+   {
+      dither->sum += (double) dither->cur_freq * (end - dither->since_ns);
+   }
+   dither->cur_freq = freq;
+   dither->since_ns = end;
+
+   // the write returns before the switch completes: only a lower bound
+   if (dither->measured_ns == 0)
+   {
+      dither->measured_ns = end - start;
+   }
+   else
+   {
+      dither->measured_ns = (3 * dither->measured_ns + (end - start)) / 4;
+   }
+   dither->stats.transition_ns = dither->measured_ns > dither->stats.latency_ns ? dither->measured_ns : dither->stats.latency_ns;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Turns the dithering off if a transition is slower than the period, leaving
+ * the unit on the step closest to the target. Called with the lock held.
+ *
+ * @return True if the dithering was turned off.
+ */
+static bool check_too_fast(dvfs_dither *dither)
+{
+   unsigned int nearest;
+
+   if (dither->config.period_us * 1000ULL >= dither->stats.transition_ns)
+   {
+      return false;
+   }
+
+   // ties go to the lower step
+   nearest = dither->stats.target - dither->stats.low <= dither->stats.high - dither->stats.target ? dither->stats.low : dither->stats.high;
+
+   dither->stats.active = false;
+   dither->stats.too_fast = true;
+   dither->stats.low = dither->stats.high = nearest;
+   if (dither->cur_freq != nearest)
+   {
+      dither->stats.last_status = write_step(dither, nearest);
+   }
+   return true;
+}
+
+static void *timer_main(void *arg)
+{
+   dvfs_dither *dither = arg;
+   unsigned long long period = dither->config.period_us * 1000ULL;
+   unsigned long long now;
+   int ret;
+
+   pthread_mutex_lock(&dither->lock);
+   while (!dither->stop)
+   {
+      if (!dither->stats.active)
+      {
+         pthread_cond_wait(&dither->cond, &dither->lock);
+         continue;
+      }
+
+      now = dvfs_timer_now_ns();
+      if (now < dither->next_ns)
+      {
+         dvfs_timer_wait_until(&dither->cond, &dither->lock, dither->next_ns);
+         continue;
+      }
+
+      ret = write_step(dither, dither->cur_freq == dither->stats.high ? dither->stats.low : dither->stats.high);
+      dither->stats.last_status = ret;
+      dither->stats.nb_switches++;
+      if (ret == DVFS_SUCCESS && check_too_fast(dither))
+      {
+         continue;
+      }
+
+      // the switches follow the schedule unless the thread fell a whole period behind
+      dither->next_ns += dither->cur_freq == dither->stats.high ? dither->high_ns : period - dither->high_ns;
+      if (dither->next_ns + period < now)
+      {
+         dither->next_ns = now;
+      }
+   }
+   pthread_mutex_unlock(&dither->lock);
+
+   return NULL;
+}
+
+int dvfs_dither_open(dvfs_dither **ppDither, const dvfs_unit *unit, const dvfs_dither_config *config)
+{
+   assert(ppDither != NULL);
+   assert(unit != NULL);
+   assert(config != NULL);
+   if (ppDither == NULL || unit == NULL || config == NULL || config->period_us == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_dither *dither = calloc(1, sizeof(*dither));
+   if (dither == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   dither->unit = unit;
+   dither->config = *config;
+   if (dvfs_unit_get_freq(unit, &dither->cur_freq) != DVFS_SUCCESS)
+   {
+      dither->cur_freq = 0;
+   }
+   dither->stats.latency_ns = dither->stats.transition_ns = declared_latency(unit);
+
+   dvfs_timer_cond_init(&dither->cond);
+   pthread_mutex_init(&dither->lock, NULL);
+
+   if (pthread_create(&dither->timer, NULL, timer_main, dither) != 0)
+   {
+      pthread_mutex_destroy(&dither->lock);
+      pthread_cond_destroy(&dither->cond);
+      free(dither);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *ppDither = dither;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_dither_close(dvfs_dither *dither)
+{
+   assert(dither != NULL);
+   if (dither == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&dither->lock);
+   dither->stop = true;
+   pthread_cond_signal(&dither->cond);
+   pthread_mutex_unlock(&dither->lock);
+
+   pthread_join(dither->timer, NULL);
+
+   pthread_mutex_destroy(&dither->lock);
+   pthread_cond_destroy(&dither->cond);
+   free(dither);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_dither_set_freq(dvfs_dither *dither, unsigned int freq)
+{
+   const dvfs_core *core;
+   unsigned int i;
+   int ret;
+
+   assert(dither != NULL);
+   if (dither == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // the table is sorted in ascending order
+   core = dither->unit->cores[0];
+   if (core->nb_freqs == 0 || freq < core->freqs[0] || freq > core->freqs[core->nb_freqs - 1])
+   {
+      return DVFS_ERROR_INVALID_FREQ;
+   }
+   for (i = 0; i + 1 < core->nb_freqs && core->freqs[i + 1] <= freq; i++);
+
+   pthread_mutex_lock(&dither->lock);
+   dither->stats.target = freq;
+   dither->stats.active = false;
+   dither->stats.too_fast = false;
+   dither->stats.low = core->freqs[i];
+   dither->stats.high = core->freqs[i] == freq ? freq : core->freqs[i + 1];
+
+   ret = write_step(dither, dither->stats.high);
+   if (ret == DVFS_SUCCESS && dither->stats.low != dither->stats.high && !check_too_fast(dither))
+   {
+      dither->high_ns = dither->config.period_us * 1000ULL * (freq - dither->stats.low) / (dither->stats.high - dither->stats.low);
+      dither->next_ns = dither->since_ns + dither->high_ns;
+      dither->stats.active = true;
+      pthread_cond_signal(&dither->cond);
+   }
+
+   // the average starts with the new target
+   dither->sum = 0;
+   dither->start_ns = dither->since_ns = dvfs_timer_now_ns();
+
+   pthread_mutex_unlock(&dither->lock);
+   return ret;
+}
+
+int dvfs_dither_get_stats(dvfs_dither *dither, dvfs_dither_stats *pStats)
+{
+   unsigned long long now;
+
+   assert(dither != NULL);
+   assert(pStats != NULL);
+   if (dither == NULL || pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&dither->lock);
+   *pStats = dither->stats;
+
+   now = dvfs_timer_now_ns();
+   if (now > dither->start_ns && dither->cur_freq != 0)
+   {
+      pStats->average = (dither->sum + (double) dither->cur_freq * (now - dither->since_ns)) / (now - dither->start_ns);
+   }
+   else
+   {
+      pStats->average = dither->cur_freq;
+   }
+   pthread_mutex_unlock(&dither->lock);
+
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_dither.h
+ *
+ * Frequency dithering, to emulate the frequencies between two steps of the
+ * frequency table. For a target between two neighbouring steps, a timer thread
+ * alternates the unit between them: every period starts on the higher step and
+ * switches to the lower one after the fraction of the period giving the
+ * requested average. The average actually achieved is measured from the dates
+ * of the transitions.
+ *
+ * The cost of a transition starts from the latency declared by the driver
+ * (dvfs_core_get_transition_latency()). Each transition is also timed: the
+ * moving average of these times only raises the cost, since the write returns
+ * before the hardware completes the switch. When the period becomes shorter
+ * than this cost, the dithering turns off by itself and the unit stays on the
+ * step closest to the target.
+ */
+
+/**
+ * Configuration of a dithering control.
+ */
+typedef struct {
+   unsigned int period_us;    //!< Length of a period: one stay on the higher step and one on the lower step (us)
+} dvfs_dither_config;
+
+/**
+ * State and counters of a dithering control.
+ */
+typedef struct {
+   unsigned int target;                //!< Frequency requested, 0 if none
+   unsigned int low;                   //!< Lower step used (equal to \c high when not dithering)
+   unsigned int high;                  //!< Higher step used
+   bool active;                        //!< True while the timer thread alternates between the steps
+   bool too_fast;                      //!< True if the dithering turned off because the period is shorter than a transition
+   unsigned int average;               //!< Average frequency achieved since the target was set (kHz)
+   unsigned long long latency_ns;      //!< Transition latency declared for the cores of the unit, 0 if not known
+   unsigned long long transition_ns;   //!< Estimated cost of a transition: the declared latency, or the measured time of the writes when longer
+   unsigned long long nb_switches;     //!< Transitions written by the timer thread
+   int last_status;                    //!< Result of the last transition written by the timer thread
+} dvfs_dither_stats;
+
+/**
+ * Dithering control of a DVFS unit and its timer thread.
+ */
+typedef struct {
+   const dvfs_unit *unit;           //!< The unit
+   dvfs_dither_config config;       //!< Configuration
+
+   pthread_mutex_t lock;            //!< Protects the state below
+   pthread_cond_t cond;             //!< Wakes up the timer thread
+   pthread_t timer;                 //!< Timer thread switching the steps
+   bool stop;                       //!< Tells the timer thread to exit
+
+   unsigned long long high_ns;      //!< Time spent on the higher step in a period
+   unsigned int cur_freq;           //!< Step currently set, 0 if unknown
+   unsigned long long next_ns;      //!< Date of the next switch (CLOCK_MONOTONIC)
+
+   unsigned long long since_ns;     //!< Date of the last transition, start of the current accounting interval
+   unsigned long long start_ns;     //!< Date the target was set
+   double sum;                      //!< Sum of the frequencies weighted by their duration (kHz.ns), up to \c since_ns
+   unsigned long long measured_ns;  //!< Moving average of the time of the writes, 0 before the first one
+
+   dvfs_dither_stats stats;         //!< State and counters
+} dvfs_dither;
+
+/**
+ * Creates a dithering control for a unit and starts its timer thread. The unit
+ * should then only be changed through the control.
+ *
+ * @param ppDither Will be filled with the control.
+ * @param unit The unit.
+ * @param config The configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppDither, \c unit or \c config are NULL or if the period is 0.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the thread cannot be created.
+ *
+ * @sa dvfs_dither_close()
+ */
+int dvfs_dither_open(dvfs_dither **ppDither, const dvfs_unit *unit, const dvfs_dither_config *config);
+
+/**
+ * Stops the timer thread and frees the control. The unit is left on the step
+ * it was on.
+ *
+ * @param dither The control.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c dither is NULL.
+ */
+int dvfs_dither_close(dvfs_dither *dither);
+
+/**
+ * Requests an average frequency for the unit. A frequency of the table is set
+ * directly. A frequency between two steps starts the dithering between them,
+ * unless the transitions of the unit are slower than the period: the closest
+ * step is then set instead.
+ *
+ * @param dither The control.
+ * @param freq The frequency, between the lowest and the highest steps.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c dither is NULL.
+ *         \retval DVFS_ERROR_INVALID_FREQ if the frequency is out of the frequency table range.
+ *         Otherwise, the error of dvfs_unit_set_freq().
+ */
+int dvfs_dither_set_freq(dvfs_dither *dither, unsigned int freq);
+
+/**
+ * Gets the state of the control, with the average frequency achieved so far.
+ *
+ * @param dither The control.
+ * @param pStats Will be filled with the state.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c dither or \c pStats are NULL.
+ */
+int dvfs_dither_get_stats(dvfs_dither *dither, dvfs_dither_stats *pStats);
@@ -0,0 +1,413 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvfs_epp.h"
+#include "dvfs_error.h"
+#include "dvfs_features.h"
+#include "dvfs_msr.h"
+#include "dvfs_sysfs.h"
+
+#define EPP_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/energy_performance_preference"
+
+// Fields of IA32_HWP_REQUEST
+#define HWP_MIN_SHIFT 0
+#define HWP_MAX_SHIFT 8
+#define HWP_DESIRED_SHIFT 16
+#define HWP_PERF_MASK 0xFFULL
+#define HWP_HINTS_MASK 0xFFFFFFULL
+
+static int read_epp(const dvfs_core *core, char *buf, size_t buf_len)
+{
+   char fname[256];
+
+   int ret = dvfs_sysfs_path(fname, sizeof(fname), EPP_FILE_PATTERN, core->id);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   FILE *fd = fopen(fname, "r");
+   if (fd == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   char *res = fgets(buf, buf_len, fd);
+   fclose(fd);
+   if (res == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   buf[strcspn(buf, "\n")] = '\0';
+   return DVFS_SUCCESS;
+}
+
+static int write_epp(const dvfs_core *core, const char *epp)
+{
+   char fname[256];
+
+   int ret = dvfs_sysfs_path(fname, sizeof(fname), EPP_FILE_PATTERN, core->id);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   FILE *fd = fopen(fname, "w");
+   if (fd == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   // the kernel rejects the value when the file gets closed
+   int wres = fprintf(fd, "%s\n", epp);
+   if (fclose(fd) != 0 || wres < 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Opens the MSR device of the core on first use and checks HWP is enabled.
+ * Called under the semaphore.
+ */
+static int open_hwp(const dvfs_core *core)
+{
+   dvfs_core_hwp *hwp = core->hwp;
+
+   if (hwp->fd_msr >= 0)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   int ret = dvfs_msr_open(core->id, O_RDWR, &hwp->fd_msr);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   if (!dvfs_features_hwp_enabled(hwp->fd_msr))
+   {
+      close(hwp->fd_msr), hwp->fd_msr = -1;
+      return DVFS_ERROR_HWP_INACTIVE;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Fills the cached preference if needed. Called under the semaphore.
+ */
+static int cache_epp(const dvfs_core *core)
+{
+   dvfs_core_hwp *hwp = core->hwp;
+
+   if (hwp->epp[0] == '\0')
+   {
+      int ret = read_epp(core, hwp->epp, sizeof(hwp->epp));
+      if (ret != DVFS_SUCCESS)
+      {
+         hwp->epp[0] = '\0';
+         return ret;
+      }
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_core_get_epp(const dvfs_core *core, char *buf, size_t buf_len)
+{
+   assert(core != NULL);
+   assert(buf != NULL);
+   if (core == NULL || buf == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = cache_epp(core);
+   if (ret == DVFS_SUCCESS && snprintf(buf, buf_len, "%s", core->hwp->epp) >= (int) buf_len)
+   {
+      ret = DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
+}
+
+/**
+ * Writes a preference, saving the initial one before the first change. Called
+ * under the semaphore.
+ */
+static int set_epp(const dvfs_core *core, const char *epp)
+{
+   dvfs_core_hwp *hwp = core->hwp;
+
+   int ret = cache_epp(core);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   // save the preference before the first change
+   if (hwp->init_epp[0] == '\0')
+   {
+      snprintf(hwp->init_epp, sizeof(hwp->init_epp), "%s", hwp->epp);
+   }
+
+   if (strcmp(hwp->epp, epp) == 0)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   ret = write_epp(core, epp);
+   if (ret != DVFS_SUCCESS)
+   {
+      hwp->epp[0] = '\0';
+      return ret;
+   }
+
+   snprintf(hwp->epp, sizeof(hwp->epp), "%s", epp);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_core_set_epp(const dvfs_core *core, const char *epp)
+{
+   assert(core != NULL);
+   assert(epp != NULL);
+   if (core == NULL || epp == NULL || strlen(epp) >= sizeof(core->hwp->epp))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   if (core->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = set_epp(core, epp);
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
+}
+
+int dvfs_core_set_epp_value(const dvfs_core *core, unsigned int value)
+{
+   char buf[16];
+
+   if (value > 255)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   snprintf(buf, sizeof(buf), "%u", value);
+   return dvfs_core_set_epp(core, buf);
+}
+
+/**
+ * Reads IA32_HWP_REQUEST. Called under the semaphore.
+ */
+static int read_hwp_request(const dvfs_core *core, uint64_t *pReq)
+{
+   int ret = open_hwp(core);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   return dvfs_msr_read(core->hwp->fd_msr, DVFS_MSR_IA32_HWP_REQUEST, pReq);
+}
+
+int dvfs_core_get_hwp_hints(const dvfs_core *core, dvfs_hwp_hints *pHints)
+{
+   uint64_t req = 0;
+
+   assert(core != NULL);
+   assert(pHints != NULL);
+   if (core == NULL || pHints == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = read_hwp_request(core, &req);
+   SAFE_SEM_POST(core->sem);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   pHints->min_perf = (req >> HWP_MIN_SHIFT) & HWP_PERF_MASK;
+   pHints->max_perf = (req >> HWP_MAX_SHIFT) & HWP_PERF_MASK;
+   pHints->desired_perf = (req >> HWP_DESIRED_SHIFT) & HWP_PERF_MASK;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Writes the hints, saving the initial request before the first change.
+ * Called under the semaphore.
+ */
+static int set_hwp_hints(const dvfs_core *core, const dvfs_hwp_hints *hints)
+{
+   dvfs_core_hwp *hwp = core->hwp;
+   uint64_t req = 0;
+
+   int ret = read_hwp_request(core, &req);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   if (!hwp->hwp_saved)
+   {
+      hwp->init_hwp_request = req;
+      hwp->hwp_saved = true;
+   }
+
+   req = (req & ~HWP_HINTS_MASK)
+         | ((uint64_t) hints->min_perf << HWP_MIN_SHIFT)
+         | ((uint64_t) hints->max_perf << HWP_MAX_SHIFT)
+         | ((uint64_t) hints->desired_perf << HWP_DESIRED_SHIFT);
+
+   return dvfs_msr_write(hwp->fd_msr, DVFS_MSR_IA32_HWP_REQUEST, req);
+}
+
+int dvfs_core_set_hwp_hints(const dvfs_core *core, const dvfs_hwp_hints *hints)
+{
+   assert(core != NULL);
+   assert(hints != NULL);
+   if (core == NULL || hints == NULL
+       || hints->min_perf > HWP_PERF_MASK || hints->max_perf > HWP_PERF_MASK || hints->desired_perf > HWP_PERF_MASK
+       || hints->min_perf > hints->max_perf)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   if (core->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   SAFE_SEM_WAIT(core->sem);
+   int ret = set_hwp_hints(core, hints);
+   SAFE_SEM_POST(core->sem);
+
+   return ret;
+}
+
+int dvfs_epp_restore(dvfs_core *core)
+{
+   int ret = DVFS_SUCCESS;
+
+   assert(core != NULL);
+   if (core == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_core_hwp *hwp = core->hwp;
+   SAFE_SEM_WAIT(core->sem);
+
+   if (hwp->init_epp[0] != '\0')
+   {
+      if (write_epp(core, hwp->init_epp) != DVFS_SUCCESS)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+      snprintf(hwp->epp, sizeof(hwp->epp), "%s", hwp->init_epp);
+      hwp->init_epp[0] = '\0';
+   }
+
+   if (hwp->fd_msr >= 0)
+   {
+      if (hwp->hwp_saved && dvfs_msr_write(hwp->fd_msr, DVFS_MSR_IA32_HWP_REQUEST, hwp->init_hwp_request) != DVFS_SUCCESS)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+      hwp->hwp_saved = false;
+      close(hwp->fd_msr), hwp->fd_msr = -1;
+   }
+
+   SAFE_SEM_POST(core->sem);
+   return ret;
+}
+
+int dvfs_unit_get_epp(const dvfs_unit *unit, char *buf, size_t buf_len)
+{
+   assert(unit != NULL);
+   if (unit == NULL || unit->nb_cores == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return dvfs_core_get_epp(unit->cores[0], buf, buf_len);
+}
+
+int dvfs_unit_set_epp(const dvfs_unit *unit, const char *epp)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(unit != NULL);
+   assert(epp != NULL);
+   if (unit == NULL || epp == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int cret = dvfs_core_set_epp(unit->cores[i], epp);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_unit_set_hwp_hints(const dvfs_unit *unit, const dvfs_hwp_hints *hints)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(unit != NULL);
+   assert(hints != NULL);
+   if (unit == NULL || hints == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int cret = dvfs_core_set_hwp_hints(unit->cores[i], hints);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
@@ -0,0 +1,159 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "dvfs_core.h"
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_epp.h
+ *
+ * Structures and functions to steer the hardware controlled P-states (HWP)
+ * rather than forcing a frequency. The energy/performance preference (EPP) is
+ * set through the \c energy_performance_preference file of cpufreq, and the
+ * HWP performance hints through the \c IA32_HWP_REQUEST register (see
+ * dvfs_msr.h).
+ *
+ * The values found before the first change are saved and restored when
+ * closing the core, after its governor.
+ */
+
+/**
+ * Performance hints of HWP. The levels are on the HWP performance scale
+ * (0-255), as reported by \c IA32_HWP_CAPABILITIES.
+ */
+typedef struct {
+   unsigned int min_perf;     //!< Lowest performance level the hardware can select
+   unsigned int max_perf;     //!< Highest performance level the hardware can select
+   unsigned int desired_perf; //!< Performance level requested, 0 to let the hardware choose
+} dvfs_hwp_hints;
+
+/**
+ * Gets the energy/performance preference of a core. The value is read once
+ * and then cached, until the governor changes.
+ *
+ * @param core The core.
+ * @param buf The buffer to fill with the preference (for instance
+ * "balance_performance", or a numeric value).
+ * @param buf_len The size of the buffer.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c buf are NULL.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer is too short.
+ *         \retval DVFS_ERROR_FILE_ERROR if the preference cannot be read.
+ */
+int dvfs_core_get_epp(const dvfs_core *core, char *buf, size_t buf_len);
+
+/**
+ * Sets the energy/performance preference of a core. Nothing is written if the
+ * cached preference already matches.
+ *
+ * @param core The core.
+ * @param epp The preference, one of the values listed in
+ * \c energy_performance_available_preferences or a numeric value (0 for
+ * performance to 255 for energy saving) when the driver supports it.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c epp are NULL or \c epp is too long.
+ *         \retval DVFS_ERROR_FILE_ERROR if the preference cannot be written.
+ */
+int dvfs_core_set_epp(const dvfs_core *core, const char *epp);
+
+/**
+ * Sets a numeric energy/performance preference on a core.
+ *
+ * @param core The core.
+ * @param value The preference, from 0 (performance) to 255 (energy saving).
+ *
+ * @return See dvfs_core_set_epp().
+ */
+int dvfs_core_set_epp_value(const dvfs_core *core, unsigned int value);
+
+/**
+ * Gets the HWP performance hints of a core.
+ *
+ * @param core The core.
+ * @param pHints Will be filled with the hints.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c pHints are NULL.
+ *         \retval DVFS_ERROR_HWP_INACTIVE if HWP is not enabled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the register cannot be accessed.
+ */
+int dvfs_core_get_hwp_hints(const dvfs_core *core, dvfs_hwp_hints *pHints);
+
+/**
+ * Sets the HWP performance hints of a core. The other fields of the request
+ * (preference, activity window) are kept.
+ *
+ * @param core The core.
+ * @param hints The hints.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core or \c hints are NULL, or a level is above 255 or \c min_perf is above \c max_perf.
+ *         \retval DVFS_ERROR_HWP_INACTIVE if HWP is not enabled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the register cannot be accessed.
+ */
+int dvfs_core_set_hwp_hints(const dvfs_core *core, const dvfs_hwp_hints *hints);
+
+/**
+ * Restores the preference and the hints found before the first change. You
+ * are not supposed to directly call this function, it is called by
+ * \c dvfs_core_close().
+ *
+ * @param core The core.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c core is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a value could not be restored.
+ */
+int dvfs_epp_restore(dvfs_core *core);
+
+/**
+ * Gets the energy/performance preference of a DVFS unit, that is the one of
+ * its first core.
+ *
+ * @param unit The DVFS unit.
+ * @param buf The buffer to fill with the preference.
+ * @param buf_len The size of the buffer.
+ *
+ * @return See dvfs_core_get_epp().
+ */
+int dvfs_unit_get_epp(const dvfs_unit *unit, char *buf, size_t buf_len);
+
+/**
+ * Sets the energy/performance preference on all the cores of a DVFS unit.
+ *
+ * @param unit The DVFS unit.
+ * @param epp The preference.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c unit or \c epp are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the preference cannot be written.
+ */
+int dvfs_unit_set_epp(const dvfs_unit *unit, const char *epp);
+
+/**
+ * Sets the HWP performance hints on all the cores of a DVFS unit.
+ *
+ * @param unit The DVFS unit.
+ * @param hints The hints.
+ *
+ * @return See dvfs_core_set_hwp_hints().
+ */
+int dvfs_unit_set_hwp_hints(const dvfs_unit *unit, const dvfs_hwp_hints *hints);
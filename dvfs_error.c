@@ -37,6 +37,17 @@ const char* errors[NB_ERROR] =
     "Core ID is not available",
     "Invalid index",
     "Core not findable in DVFS units of this CPU",
+    "No uncore frequency domain available",
+    "Hardware P-states (HWP) are active",
+    "Turbo control not available",
+    "Hardware P-states (HWP) are not active",
+    "Asynchronous queue full",
+    "Governor is not available",
+    "No powercap (RAPL) domain available",
+    "Unit leased by another owner",
+    "Unit not leased by the caller",
+    "Performance counters not available",
+    "Access denied by the daemon policy",
     "Unknown error" // This is also reserved as the last error
 };
 
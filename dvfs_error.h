@@ -42,7 +42,18 @@
 #define DVFS_ERROR_INVALID_CORE_ID -10             /*!< The core ID is not available */
 #define DVFS_ERROR_INVALID_INDEX -11               /*!< The index passed is invalid */
 #define DVFS_ERROR_CORE_UNIT_MISMATCH -12          /*!< Core is not findable in this CPU  */
-#define DVFS_ERROR_UNKNOWN -13                     /*!< Unknown error
+#define DVFS_ERROR_UNCORE_UNAVAILABLE -13          /*!< No uncore frequency domain for this unit */
+#define DVFS_ERROR_HWP_ACTIVE -14                  /*!< Hardware P-states are enabled, the P-state cannot be set */
+#define DVFS_ERROR_TURBO_UNAVAILABLE -15           /*!< The turbo frequencies cannot be controlled */
+#define DVFS_ERROR_HWP_INACTIVE -16                /*!< Hardware P-states are not enabled, the hints cannot be set */
+#define DVFS_ERROR_QUEUE_FULL -17                  /*!< Too many asynchronous requests are pending */
+#define DVFS_ERROR_INVALID_GOV -18                 /*!< The governor is not available */
+#define DVFS_ERROR_POWERCAP_UNAVAILABLE -19        /*!< No powercap (RAPL) domain to read the power from */
+#define DVFS_ERROR_LEASE_HELD -20                  /*!< The unit is leased by another owner */
+#define DVFS_ERROR_NOT_LEASED -21                  /*!< The unit is not leased by the caller */
+#define DVFS_ERROR_COUNTERS_UNAVAILABLE -22        /*!< The performance counters cannot be opened */
+#define DVFS_ERROR_ACCESS_DENIED -23               /*!< The user is not allowed by the daemon policy */
+#define DVFS_ERROR_UNKNOWN -24                     /*!< Unknown error
                                                       (all greater error code results in this) */
 
 /**
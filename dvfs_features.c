@@ -0,0 +1,123 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include "dvfs_error.h"
+#include "dvfs_features.h"
+#include "dvfs_msr.h"
+
+// Thermal and power management leaf
+#define CPUID_LEAF_PM 6
+#define CPUID_PM_EAX_TURBO (1 << 1)
+#define CPUID_PM_EAX_HWP (1 << 7)
+#define CPUID_PM_EAX_HWP_EPP (1 << 10)
+#define CPUID_PM_ECX_APERF_MPERF (1 << 0)
+
+// AMD advanced power management leaf
+#define CPUID_LEAF_AMD_APM 0x80000007
+#define CPUID_APM_EDX_CPB (1 << 9)
+
+static dvfs_features features;
+static pthread_once_t features_once = PTHREAD_ONCE_INIT;
+
+static void detect_features(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+   unsigned int eax, ebx, ecx, edx;
+   char vendor[13];
+
+   if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) == 0)
+   {
+      return;
+   }
+
+   memcpy(vendor, &ebx, 4);
+   memcpy(vendor + 4, &edx, 4);
+   memcpy(vendor + 8, &ecx, 4);
+   vendor[12] = '\0';
+
+   if (strcmp(vendor, "GenuineIntel") == 0)
+   {
+      features.vendor = DVFS_VENDOR_INTEL;
+   }
+   else if (strcmp(vendor, "AuthenticAMD") == 0)
+   {
+      features.vendor = DVFS_VENDOR_AMD;
+   }
+
+   if (__get_cpuid(CPUID_LEAF_PM, &eax, &ebx, &ecx, &edx) != 0)
+   {
+      features.turbo = (eax & CPUID_PM_EAX_TURBO) != 0;
+      features.hwp = (eax & CPUID_PM_EAX_HWP) != 0;
+      features.hwp_epp = (eax & CPUID_PM_EAX_HWP_EPP) != 0;
+      features.aperf_mperf = (ecx & CPUID_PM_ECX_APERF_MPERF) != 0;
+   }
+
+   if (features.vendor == DVFS_VENDOR_AMD && __get_cpuid(CPUID_LEAF_AMD_APM, &eax, &ebx, &ecx, &edx) != 0)
+   {
+      features.turbo = features.turbo || (edx & CPUID_APM_EDX_CPB) != 0;
+   }
+#endif
+}
+
+int dvfs_features_detect(dvfs_features *pFeatures)
+{
+   assert(pFeatures != NULL);
+   if (pFeatures == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_once(&features_once, detect_features);
+   *pFeatures = features;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_features_override(const dvfs_features *pFeatures)
+{
+   assert(pFeatures != NULL);
+   if (pFeatures == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_once(&features_once, detect_features);
+   features = *pFeatures;
+   return DVFS_SUCCESS;
+}
+
+bool dvfs_features_hwp_enabled(int fd_msr)
+{
+   uint64_t val = 0;
+
+   pthread_once(&features_once, detect_features);
+   // the enable bit is not reported by CPUID, but only set when supported
+   if (!features.hwp)
+   {
+      return false;
+   }
+
+   return dvfs_msr_read(fd_msr, DVFS_MSR_IA32_PM_ENABLE, &val) == DVFS_SUCCESS && (val & 1);
+}
@@ -0,0 +1,82 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * @file dvfs_features.h
+ *
+ * Detection of the DVFS related features of the processor. The detection
+ * relies on the CPUID instruction and is only done once per process, the
+ * result being cached.
+ */
+
+/**
+ * Processor vendors.
+ */
+typedef enum {
+   DVFS_VENDOR_UNKNOWN = 0,   //!< Unknown vendor, or not a x86 processor
+   DVFS_VENDOR_INTEL,         //!< GenuineIntel
+   DVFS_VENDOR_AMD,           //!< AuthenticAMD
+} dvfs_cpu_vendor;
+
+/**
+ * DVFS features of the processor.
+ */
+typedef struct {
+   dvfs_cpu_vendor vendor;    //!< Processor vendor
+   bool turbo;                //!< Turbo frequencies (Intel Turbo Boost / AMD Core Performance Boost)
+   bool hwp;                  //!< Hardware controlled P-states (Intel HWP)
+   bool hwp_epp;              //!< Energy/performance preference of HWP
+   bool aperf_mperf;          //!< APERF and MPERF counters (effective frequency)
+} dvfs_features;
+
+/**
+ * Detects the features of the processor. Only the first call executes the
+ * CPUID instruction, the next ones return the cached result.
+ *
+ * @param pFeatures Will be filled with the features.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c pFeatures is NULL.
+ */
+int dvfs_features_detect(dvfs_features *pFeatures);
+
+/**
+ * Replaces the detected features for the rest of the process, for instance to
+ * test the HWP paths against a fake MSR device (see DVFS_MSR_PATH_ENV) on a
+ * processor without HWP. Only the contexts started afterwards see the change.
+ *
+ * @param pFeatures The features to report from now on.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c pFeatures is NULL.
+ */
+int dvfs_features_override(const dvfs_features *pFeatures);
+
+/**
+ * Tells if the hardware P-states are enabled. The processor must support them
+ * (cached CPUID result), then the enable bit of IA32_PM_ENABLE is read from the
+ * MSR device, without any access on the processors without HWP.
+ *
+ * @param fd_msr The MSR device of a core (see dvfs_msr_open()).
+ *
+ * @return True if HWP is enabled.
+ */
+bool dvfs_features_hwp_enabled(int fd_msr);
@@ -0,0 +1,104 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dvfs_error.h"
+#include "dvfs_gov.h"
+
+// Interned names, only appended under the lock
+static char gov_names[DVFS_GOV_MAX][DVFS_GOV_NAME_LEN];
+// Number of names published, read without the lock
+static unsigned int gov_count;
+static pthread_mutex_t gov_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int lookup(const char *gov, unsigned int count, unsigned int *pId)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; i++)
+   {
+      if (strcmp(gov_names[i], gov) == 0)
+      {
+         *pId = i;
+         return DVFS_SUCCESS;
+      }
+   }
+   return DVFS_ERROR_INVALID_GOV;
+}
+
+int dvfs_gov_intern(const char *gov, unsigned int *pId)
+{
+   assert(gov != NULL);
+   assert(pId != NULL);
+   if (gov == NULL || pId == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (strlen(gov) >= DVFS_GOV_NAME_LEN)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   pthread_mutex_lock(&gov_lock);
+   int ret = lookup(gov, gov_count, pId);
+   if (ret != DVFS_SUCCESS && gov_count < DVFS_GOV_MAX)
+   {
+      snprintf(gov_names[gov_count], DVFS_GOV_NAME_LEN, "%s", gov);
+      *pId = gov_count;
+      // the name is written before being published to the readers
+      __atomic_store_n(&gov_count, gov_count + 1, __ATOMIC_RELEASE);
+      ret = DVFS_SUCCESS;
+   }
+   pthread_mutex_unlock(&gov_lock);
+
+   return ret;
+}
+
+int dvfs_gov_get_id(const char *gov, unsigned int *pId)
+{
+   assert(gov != NULL);
+   assert(pId != NULL);
+   if (gov == NULL || pId == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return lookup(gov, __atomic_load_n(&gov_count, __ATOMIC_ACQUIRE), pId);
+}
+
+int dvfs_gov_get_name(unsigned int id, const char **pName)
+{
+   assert(pName != NULL);
+   if (pName == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (id >= __atomic_load_n(&gov_count, __ATOMIC_ACQUIRE))
+   {
+      return DVFS_ERROR_INVALID_GOV;
+   }
+
+   *pName = gov_names[id];
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @file dvfs_gov.h
+ *
+ * Governors interned in a table shared by the whole process. Every core of the
+ * sysfs backend enumerates \c scaling_available_governors once when opened and
+ * keeps the ids of its governors in a bit mask (\c dvfs_core::govs), so that a
+ * governor is validated without reading any file, and switching to a governor
+ * given by id costs a single write on a descriptor kept open.
+ *
+ * The ids are stable until the end of the process. Once interned, a name is
+ * never removed from the table.
+ */
+
+/** Maximal number of governors in the table (bits of dvfs_core::govs) */
+#define DVFS_GOV_MAX 32
+
+/** Maximal length of a governor name, terminating NUL included (as in the kernel) */
+#define DVFS_GOV_NAME_LEN 16
+
+/**
+ * Interns a governor name. You are not supposed to directly call this
+ * function, the governors are interned when opening the cores.
+ *
+ * @param gov The name of the governor.
+ * @param pId Will be filled with the id of the governor.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c gov or \c pId are NULL.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the name is too long.
+ *         \retval DVFS_ERROR_INVALID_GOV if the table is full.
+ */
+int dvfs_gov_intern(const char *gov, unsigned int *pId);
+
+/**
+ * Gets the id of a governor.
+ *
+ * @param gov The name of the governor.
+ * @param pId Will be filled with the id of the governor.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c gov or \c pId are NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if no opened core declared this governor.
+ */
+int dvfs_gov_get_id(const char *gov, unsigned int *pId);
+
+/**
+ * Gets the name of a governor.
+ *
+ * @param id The id of the governor.
+ * @param pName Will be filled with the name of the governor. You don't have to free it.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c pName is NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if \c id does not match any governor.
+ */
+int dvfs_gov_get_name(unsigned int id, const char **pName);
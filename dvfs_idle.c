@@ -0,0 +1,476 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_idle.h"
+#include "dvfs_sysfs.h"
+
+#define DEFAULT_DMA_LATENCY_PATH "/dev/cpu_dma_latency"
+#define IDLE_STATE_PATTERN "/devices/system/cpu/cpu%u/cpuidle/state%u/%s"
+
+// No limit held
+#define NO_LIMIT ((unsigned int) -1)
+
+static int state_path(char *fname, size_t len, unsigned int core_id, unsigned int state, const char *file)
+{
+   return dvfs_sysfs_path(fname, len, IDLE_STATE_PATTERN, core_id, state, file);
+}
+
+/**
+ * Reads the idle states of a core, stops at the first missing state.
+ */
+static int enumerate_states(dvfs_idle_core *icore, unsigned int core_id)
+{
+   char fname[256];
+   unsigned int val;
+
+   for (;;)
+   {
+      unsigned int s = icore->nb_states;
+
+      if (state_path(fname, sizeof(fname), core_id, s, "latency") != DVFS_SUCCESS
+          || dvfs_sysfs_read_uint(fname, &val) != DVFS_SUCCESS)
+      {
+         break;
+      }
+
+      dvfs_idle_state *states = realloc(icore->states, (s + 1) * sizeof(*states));
+      if (states == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      icore->states = states;
+
+      dvfs_idle_state *state = &states[s];
+      state->id = s;
+      state->latency = val;
+      state->name[0] = '\0';
+
+      if (state_path(fname, sizeof(fname), core_id, s, "name") == DVFS_SUCCESS)
+      {
+         FILE *fd = fopen(fname, "r");
+         if (fd != NULL)
+         {
+            if (fgets(state->name, sizeof(state->name), fd) == NULL)
+            {
+               state->name[0] = '\0';
+            }
+            state->name[strcspn(state->name, "\n")] = '\0';
+            fclose(fd);
+         }
+      }
+
+      val = 0;
+      if (state_path(fname, sizeof(fname), core_id, s, "disable") == DVFS_SUCCESS)
+      {
+         dvfs_sysfs_read_uint(fname, &val);
+      }
+      state->init_disabled = val != 0;
+      state->disabled = state->init_disabled;
+
+      icore->nb_states++;
+   }
+
+   icore->enumerated = true;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Gets a core, enumerating its states on first use.
+ */
+static int get_core(dvfs_idle *idle, unsigned int core_id, dvfs_idle_core **ppCore)
+{
+   if (core_id >= idle->nb_cores)
+   {
+      return DVFS_ERROR_INVALID_CORE_ID;
+   }
+
+   *ppCore = &idle->cores[core_id];
+   if (!(*ppCore)->enumerated)
+   {
+      return enumerate_states(*ppCore, core_id);
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Enables or disables the states of a core according to the tightest limit
+ * held, or as found when no limit is held. Only writes the states changing.
+ */
+static int apply_limits(dvfs_idle_core *icore, unsigned int core_id)
+{
+   char fname[256];
+   unsigned int i;
+   unsigned int limit = NO_LIMIT;
+   int ret = DVFS_SUCCESS;
+
+   for (i = 0; i < icore->nb_limits; i++)
+   {
+      if (icore->limits[i] < limit)
+      {
+         limit = icore->limits[i];
+      }
+   }
+
+   for (i = 0; i < icore->nb_states; i++)
+   {
+      dvfs_idle_state *state = &icore->states[i];
+      bool disable = icore->nb_limits == 0 ? state->init_disabled : (state->init_disabled || state->latency > limit);
+
+      if (disable == state->disabled)
+      {
+         continue;
+      }
+
+      int sret = state_path(fname, sizeof(fname), core_id, state->id, "disable");
+      if (sret == DVFS_SUCCESS)
+      {
+         sret = dvfs_sysfs_write_uint(fname, disable);
+      }
+
+      if (sret == DVFS_SUCCESS)
+      {
+         state->disabled = disable;
+      }
+      else
+      {
+         ret = sret;
+      }
+   }
+
+   return ret;
+}
+
+/**
+ * Adds a value to a list of limits.
+ */
+static int push_limit(unsigned int **pLimits, unsigned int *pNb, unsigned int *pSize, unsigned int val)
+{
+   if (*pNb == *pSize)
+   {
+      unsigned int size = *pSize == 0 ? 4 : *pSize * 2;
+      unsigned int *limits = realloc(*pLimits, size * sizeof(*limits));
+      if (limits == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      *pLimits = limits;
+      *pSize = size;
+   }
+
+   (*pLimits)[(*pNb)++] = val;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Removes one occurrence of a value from a list of limits.
+ */
+static int pop_limit(unsigned int *limits, unsigned int *pNb, unsigned int val)
+{
+   unsigned int i;
+
+   for (i = *pNb; i > 0; i--)
+   {
+      if (limits[i - 1] == val)
+      {
+         memmove(&limits[i - 1], &limits[i], (*pNb - i) * sizeof(*limits));
+         (*pNb)--;
+         return DVFS_SUCCESS;
+      }
+   }
+   return DVFS_ERROR_INVALID_ARG;
+}
+
+/**
+ * Writes the tightest process wide constraint held in the PM QoS device.
+ */
+static int write_qos(dvfs_idle *idle)
+{
+   unsigned int i;
+   int32_t val = INT32_MAX;
+
+   for (i = 0; i < idle->nb_qos; i++)
+   {
+      if (idle->qos[i] < (uint32_t) val)
+      {
+         val = idle->qos[i];
+      }
+   }
+
+   // the device expects a binary 32 bits value
+   if (pwrite(idle->qos_fd, &val, sizeof(val), 0) != sizeof(val))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_idle_open(dvfs_idle **ppIdle, unsigned int nb_cores)
+{
+   assert(ppIdle != NULL);
+   if (ppIdle == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppIdle = calloc(1, sizeof(**ppIdle));
+   if (*ppIdle == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   (*ppIdle)->qos_fd = -1;
+   (*ppIdle)->nb_cores = nb_cores;
+   (*ppIdle)->cores = calloc(nb_cores, sizeof(*(*ppIdle)->cores));
+   if (nb_cores != 0 && (*ppIdle)->cores == NULL)
+   {
+      free(*ppIdle), *ppIdle = NULL;
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_idle_close(dvfs_idle *idle)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(idle != NULL);
+   if (idle == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < idle->nb_cores; i++)
+   {
+      dvfs_idle_core *icore = &idle->cores[i];
+
+      icore->nb_limits = 0;
+      if (apply_limits(icore, i) != DVFS_SUCCESS)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+      free(icore->states);
+      free(icore->limits);
+   }
+   free(idle->cores);
+
+   // closing the device drops the constraint
+   if (idle->qos_fd >= 0)
+   {
+      close(idle->qos_fd);
+   }
+   free(idle->qos);
+   free(idle);
+
+   return ret;
+}
+
+int dvfs_idle_get_states(dvfs_idle *idle, unsigned int core_id, const dvfs_idle_state **ppStates, unsigned int *pNb)
+{
+   dvfs_idle_core *icore;
+
+   assert(idle != NULL);
+   assert(ppStates != NULL);
+   assert(pNb != NULL);
+   if (idle == NULL || ppStates == NULL || pNb == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   int ret = get_core(idle, core_id, &icore);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   *ppStates = icore->states;
+   *pNb = icore->nb_states;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_idle_acquire_core(dvfs_idle *idle, unsigned int core_id, unsigned int max_latency)
+{
+   dvfs_idle_core *icore;
+
+   assert(idle != NULL);
+   if (idle == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core_id < idle->nb_cores && idle->cores[core_id].fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   int ret = get_core(idle, core_id, &icore);
+   if (ret == DVFS_SUCCESS)
+   {
+      ret = push_limit(&icore->limits, &icore->nb_limits, &icore->size_limits, max_latency);
+   }
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   return apply_limits(icore, core_id);
+}
+
+int dvfs_idle_release_core(dvfs_idle *idle, unsigned int core_id, unsigned int max_latency)
+{
+   dvfs_idle_core *icore;
+
+   assert(idle != NULL);
+   if (idle == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   int ret = get_core(idle, core_id, &icore);
+   if (ret == DVFS_SUCCESS)
+   {
+      ret = pop_limit(icore->limits, &icore->nb_limits, max_latency);
+   }
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   return apply_limits(icore, core_id);
+}
+
+int dvfs_idle_acquire_unit(dvfs_idle *idle, const dvfs_unit *unit, unsigned int max_latency)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(unit != NULL);
+   if (idle == NULL || unit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (unit->nb_cores != 0 && unit->cores[0]->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int cret = dvfs_idle_acquire_core(idle, unit->cores[i]->id, max_latency);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_idle_release_unit(dvfs_idle *idle, const dvfs_unit *unit, unsigned int max_latency)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(unit != NULL);
+   if (idle == NULL || unit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int cret = dvfs_idle_release_core(idle, unit->cores[i]->id, max_latency);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_idle_acquire_qos(dvfs_idle *idle, unsigned int max_latency)
+{
+   assert(idle != NULL);
+   if (idle == NULL || max_latency > INT32_MAX)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (idle->qos_fd < 0)
+   {
+      const char *path = getenv(DVFS_DMA_LATENCY_PATH_ENV);
+      if (path == NULL || *path == '\0')
+      {
+         path = DEFAULT_DMA_LATENCY_PATH;
+      }
+
+      idle->qos_fd = open(path, O_WRONLY | O_CLOEXEC);
+      if (idle->qos_fd < 0)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+
+   int ret = push_limit(&idle->qos, &idle->nb_qos, &idle->size_qos, max_latency);
+   if (ret != DVFS_SUCCESS)
+   {
+      // the device holds the limit as long as it is open
+      if (idle->nb_qos == 0)
+      {
+         close(idle->qos_fd), idle->qos_fd = -1;
+      }
+      return ret;
+   }
+
+   return write_qos(idle);
+}
+
+int dvfs_idle_release_qos(dvfs_idle *idle, unsigned int max_latency)
+{
+   assert(idle != NULL);
+   if (idle == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   int ret = pop_limit(idle->qos, &idle->nb_qos, max_latency);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   if (idle->nb_qos == 0)
+   {
+      close(idle->qos_fd), idle->qos_fd = -1;
+      return DVFS_SUCCESS;
+   }
+
+   return write_qos(idle);
+}
@@ -0,0 +1,204 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_idle.h
+ *
+ * Structures and functions to bound the wake-up latency of the cores. Two
+ * mechanisms are provided:
+ * - per core limits disabling the cpuidle states whose exit latency is above
+ *   the limit (\c cpuN/cpuidle/stateK/disable),
+ * - a process wide constraint held on \c /dev/cpu_dma_latency, applying to
+ *   all the cores as long as the device stays open.
+ *
+ * The limits are acquired and released by pairs and can be nested: the
+ * tightest limit held applies. When the last limit is released, the states
+ * are set back exactly as found. The structure is not thread safe.
+ */
+
+/** Environment variable overriding the path of the PM QoS latency device */
+#define DVFS_DMA_LATENCY_PATH_ENV "LIBDVFS_DMA_LATENCY_PATH"
+
+/**
+ * An idle state of a core.
+ */
+typedef struct {
+   unsigned int id;           //!< Index of the state (K in stateK)
+   char name[32];             //!< Name of the state (POLL, C1, C6, ...)
+   unsigned int latency;      //!< Exit latency in microseconds
+   bool init_disabled;        //!< True if the state was disabled when enumerated
+   bool disabled;             //!< True if the state is currently disabled
+} dvfs_idle_state;
+
+/**
+ * Idle states of a core and the latency limits held on it.
+ */
+typedef struct {
+   bool enumerated;           //!< True once the states have been read
+   unsigned int nb_states;    //!< Number of idle states
+   dvfs_idle_state *states;   //!< Idle states, from the shallowest to the deepest
+   unsigned int nb_limits;    //!< Number of limits held on the core
+   unsigned int size_limits;  //!< Allocated size of \c limits
+   unsigned int *limits;      //!< Latency limits held on the core (microseconds)
+   bool fenced;               //!< True if the unit of the core is leased by another context (see dvfs_lease.h)
+} dvfs_idle_core;
+
+/**
+ * Idle control of the system.
+ */
+typedef struct {
+   unsigned int nb_cores;     //!< Size of \c cores (highest core id + 1)
+   dvfs_idle_core *cores;     //!< Idle states per core id, enumerated on first use
+   int qos_fd;                //!< PM QoS latency device, -1 when no constraint is held
+   unsigned int nb_qos;       //!< Number of process wide constraints held
+   unsigned int size_qos;     //!< Allocated size of \c qos
+   unsigned int *qos;         //!< Process wide constraints held (microseconds)
+} dvfs_idle;
+
+/**
+ * Opens the idle control. The idle states are enumerated on first use of a
+ * core. You are not supposed to directly call this function, the control is
+ * opened by \c dvfs_start().
+ *
+ * @param ppIdle Will be filled with the idle control.
+ * @param nb_cores The highest core id + 1.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppIdle is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_idle_close()
+ */
+int dvfs_idle_open(dvfs_idle **ppIdle, unsigned int nb_cores);
+
+/**
+ * Closes the idle control. Sets back the idle states as they were found and
+ * drops the process wide constraint, even if limits are still held.
+ *
+ * @param idle The idle control.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a state could not be restored.
+ */
+int dvfs_idle_close(dvfs_idle *idle);
+
+/**
+ * Gets the idle states of a core.
+ *
+ * @param idle The idle control.
+ * @param core_id The core id.
+ * @param ppStates Will be filled with the states.
+ * @param pNb Will be filled with the number of states.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle, \c ppStates or \c pNb are NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the core id is unknown.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ */
+int dvfs_idle_get_states(dvfs_idle *idle, unsigned int core_id, const dvfs_idle_state **ppStates, unsigned int *pNb);
+
+/**
+ * Acquires a latency limit on a core: the idle states with a higher exit
+ * latency are disabled until the limit is released.
+ *
+ * @param idle The idle control.
+ * @param core_id The core id.
+ * @param max_latency The highest exit latency allowed, in microseconds.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle is NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the core id is unknown.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if a state could not be disabled.
+ *         \retval DVFS_ERROR_NOT_LEASED if the core is fenced (see dvfs_lease.h).
+ *
+ * @sa dvfs_idle_release_core()
+ */
+int dvfs_idle_acquire_core(dvfs_idle *idle, unsigned int core_id, unsigned int max_latency);
+
+/**
+ * Releases a latency limit acquired on a core. The remaining limits still
+ * apply; without any, the states are set back as found.
+ *
+ * @param idle The idle control.
+ * @param core_id The core id.
+ * @param max_latency The limit given when acquiring it.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle is NULL or the limit is not held.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the core id is unknown.
+ *         \retval DVFS_ERROR_FILE_ERROR if a state could not be changed.
+ */
+int dvfs_idle_release_core(dvfs_idle *idle, unsigned int core_id, unsigned int max_latency);
+
+/**
+ * Acquires a latency limit on all the cores of a DVFS unit.
+ *
+ * @param idle The idle control.
+ * @param unit The DVFS unit.
+ * @param max_latency The highest exit latency allowed, in microseconds.
+ *
+ * @return See dvfs_idle_acquire_core().
+ */
+int dvfs_idle_acquire_unit(dvfs_idle *idle, const dvfs_unit *unit, unsigned int max_latency);
+
+/**
+ * Releases a latency limit acquired on a DVFS unit.
+ *
+ * @param idle The idle control.
+ * @param unit The DVFS unit.
+ * @param max_latency The limit given when acquiring it.
+ *
+ * @return See dvfs_idle_release_core().
+ */
+int dvfs_idle_release_unit(dvfs_idle *idle, const dvfs_unit *unit, unsigned int max_latency);
+
+/**
+ * Acquires a process wide latency constraint through the PM QoS interface
+ * (\c /dev/cpu_dma_latency). The kernel applies it to all the cores.
+ *
+ * @param idle The idle control.
+ * @param max_latency The highest wake-up latency allowed, in microseconds.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the device cannot be opened or written.
+ *
+ * @sa dvfs_idle_release_qos()
+ */
+int dvfs_idle_acquire_qos(dvfs_idle *idle, unsigned int max_latency);
+
+/**
+ * Releases a process wide latency constraint. The device is closed with the
+ * last constraint.
+ *
+ * @param idle The idle control.
+ * @param max_latency The constraint given when acquiring it.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c idle is NULL or the constraint is not held.
+ *         \retval DVFS_ERROR_FILE_ERROR if the device cannot be written.
+ */
+int dvfs_idle_release_qos(dvfs_idle *idle, unsigned int max_latency);
@@ -0,0 +1,526 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dvfs_backend.h"
+#include "dvfs_error.h"
+#include "dvfs_journal.h"
+#include "dvfs_lease.h"
+#include "dvfs_sysfs.h"
+
+#define SCALING_GOVERNOR_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_governor"
+#define SCALING_SETSPEED_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_setspeed"
+#define SCALING_MINFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_min_freq"
+#define SCALING_MAXFREQ_FILE_PATTERN "/devices/system/cpu/cpu%u/cpufreq/scaling_max_freq"
+
+// Magic number of the journal file, followed by the version
+#define JOURNAL_MAGIC "DVFSJRNL"
+#define JOURNAL_VERSION 2
+
+/**
+ * Header of the journal file, followed by the slots.
+ */
+typedef struct {
+   char magic[8];       //!< JOURNAL_MAGIC, without NUL byte
+   uint32_t version;    //!< JOURNAL_VERSION
+   uint32_t nb_slots;   //!< DVFS_JOURNAL_NB_SLOTS
+} journal_header;
+
+// States of a process as read from /proc
+#define PROC_UNKNOWN -1
+#define PROC_ZOMBIE 0
+#define PROC_RUNNING 1
+
+/**
+ * Reads the state and the start time of a process (in clock ticks since boot).
+ * The start time tells apart two processes getting the same pid.
+ *
+ * @return PROC_RUNNING, PROC_ZOMBIE (it will never restore anything) or
+ * PROC_UNKNOWN if /proc cannot be read.
+ */
+static int read_proc(pid_t pid, uint64_t *pStart)
+{
+   char fname[64];
+   char buf[1024];
+   unsigned long long start = 0;
+
+   *pStart = 0;
+   snprintf(fname, sizeof(fname), "/proc/%d/stat", (int) pid);
+   FILE *fd = fopen(fname, "r");
+   if (fd == NULL)
+   {
+      return PROC_UNKNOWN;
+   }
+   size_t len = fread(buf, 1, sizeof(buf) - 1, fd);
+   fclose(fd);
+   buf[len] = '\0';
+
+   // the command may contain spaces and parentheses: skip to the last one,
+   // the state follows it and the start time is the 20th field after it
+   char *cur = strrchr(buf, ')');
+   if (cur == NULL || cur[1] != ' ')
+   {
+      return PROC_UNKNOWN;
+   }
+   if (cur[2] == 'Z')
+   {
+      return PROC_ZOMBIE;
+   }
+
+   unsigned int field;
+   for (field = 0; cur != NULL && field < 20; field++)
+   {
+      cur = strchr(cur + 1, ' ');
+   }
+   if (cur != NULL && sscanf(cur + 1, "%llu", &start) == 1)
+   {
+      *pStart = start;
+   }
+
+   return PROC_RUNNING;
+}
+
+// Handles of the journals opened by the process
+static uint32_t last_handle;
+
+/**
+ * Tells if the owner of a slot is still running.
+ */
+static bool owner_alive(const dvfs_journal_slot *slot)
+{
+   pid_t pid = __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE);
+   uint64_t start;
+
+   if (pid <= 0)
+   {
+      return false;
+   }
+
+   if (kill(pid, 0) != 0 && errno == ESRCH)
+   {
+      return false;
+   }
+
+   switch (read_proc(pid, &start))
+   {
+      case PROC_ZOMBIE:
+         return false;
+      case PROC_RUNNING:
+         // the pid may have been given to another process
+         return slot->owner_start == 0 || start == 0 || start == slot->owner_start;
+      default:
+         // without /proc, trust the pid
+         return true;
+   }
+}
+
+int dvfs_journal_open(dvfs_journal **ppJournal, const char *path)
+{
+   journal_header header;
+   struct stat st;
+
+   assert(ppJournal != NULL);
+   if (ppJournal == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (path == NULL)
+   {
+      path = getenv(DVFS_JOURNAL_PATH_ENV);
+      if (path == NULL || path[0] == '\0')
+      {
+         path = DVFS_JOURNAL_DEFAULT_PATH;
+      }
+   }
+
+   dvfs_journal *journal = malloc(sizeof(*journal));
+   if (journal == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   journal->len = sizeof(journal_header) + DVFS_JOURNAL_NB_SLOTS * sizeof(dvfs_journal_slot);
+   journal->pid = getpid();
+   read_proc(journal->pid, &journal->start);
+   journal->handle = __atomic_add_fetch(&last_handle, 1, __ATOMIC_RELAXED);
+
+   journal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+   if (journal->fd < 0)
+   {
+      free(journal);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   // the first process initializes the file, the others wait for it
+   flock(journal->fd, LOCK_EX);
+   if (fstat(journal->fd, &st) != 0)
+   {
+      flock(journal->fd, LOCK_UN);
+      close(journal->fd);
+      free(journal);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   if (st.st_size == 0)
+   {
+      memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+      header.version = JOURNAL_VERSION;
+      header.nb_slots = DVFS_JOURNAL_NB_SLOTS;
+      // the slots are the zeros of the sparse file
+      if (ftruncate(journal->fd, journal->len) != 0
+          || pwrite(journal->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+      {
+         flock(journal->fd, LOCK_UN);
+         close(journal->fd);
+         free(journal);
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+   else if ((size_t) st.st_size != journal->len
+            || pread(journal->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+            || memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0
+            || header.version != JOURNAL_VERSION || header.nb_slots != DVFS_JOURNAL_NB_SLOTS)
+   {
+      flock(journal->fd, LOCK_UN);
+      close(journal->fd);
+      free(journal);
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   flock(journal->fd, LOCK_UN);
+
+   journal->map = mmap(NULL, journal->len, PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+   if (journal->map == MAP_FAILED)
+   {
+      close(journal->fd);
+      free(journal);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   journal->slots = (dvfs_journal_slot *) ((char *) journal->map + sizeof(journal_header));
+
+   *ppJournal = journal;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Tells if a slot is owned by the journal.
+ */
+static bool owned(const dvfs_journal *journal, const dvfs_journal_slot *slot)
+{
+   return __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE) == journal->pid
+          && slot->owner_start == journal->start && slot->handle == journal->handle;
+}
+
+int dvfs_journal_close(dvfs_journal *journal)
+{
+   unsigned int i;
+
+   assert(journal != NULL);
+   if (journal == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   flock(journal->fd, LOCK_EX);
+   for (i = 0; i < DVFS_JOURNAL_NB_SLOTS; i++)
+   {
+      dvfs_journal_slot *slot = &journal->slots[i];
+      if (owned(journal, slot))
+      {
+         __atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+      }
+   }
+   flock(journal->fd, LOCK_UN);
+
+   munmap(journal->map, journal->len);
+   close(journal->fd);
+   free(journal);
+
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Gets the slot of a core, NULL if the core is not journaled: the slots are
+ * restored through sysfs, the state of the other backends (the P-state of the
+ * MSR backend) would not be put back.
+ */
+static dvfs_journal_slot *core_slot(dvfs_journal *journal, const dvfs_core *core)
+{
+   if (core->id >= DVFS_JOURNAL_NB_SLOTS || core->backend != &dvfs_backend_sysfs)
+   {
+      return NULL;
+   }
+   return &journal->slots[core->id];
+}
+
+/**
+ * Sets the owner of a slot, last: a crash in between leaves a free slot.
+ */
+static void own_slot(dvfs_journal *journal, dvfs_journal_slot *slot, unsigned int unit_id)
+{
+   slot->owner_start = journal->start;
+   slot->handle = journal->handle;
+   slot->unit = (int32_t) unit_id;
+
+   __atomic_store_n(&slot->owner, journal->pid, __ATOMIC_RELEASE);
+}
+
+/**
+ * Records the initial state of a core in a free slot.
+ */
+static void record_slot(dvfs_journal *journal, dvfs_journal_slot *slot, const dvfs_core *core, unsigned int unit_id)
+{
+   memset(&slot->state, 0, sizeof(slot->state));
+   slot->state.id = core->id;
+   slot->ctrl = core->ctrl;
+   slot->state.freq = core->init_freq;
+   slot->state.min_freq = core->init_min_freq;
+   slot->state.max_freq = core->init_max_freq;
+   snprintf(slot->state.gov, sizeof(slot->state.gov), "%.*s", (int) sizeof(slot->state.gov) - 1, core->init_gov);
+
+   own_slot(journal, slot, unit_id);
+}
+
+int dvfs_journal_record(dvfs_journal *journal, const dvfs_core *core, unsigned int unit_id)
+{
+   assert(journal != NULL);
+   assert(core != NULL);
+   if (journal == NULL || core == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_journal_slot *slot = core_slot(journal, core);
+   if (slot == NULL)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   // a dead owner whose restore failed still holds the original state, it is
+   // kept for a later recovery
+   flock(journal->fd, LOCK_EX);
+   if (__atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE) == 0)
+   {
+      record_slot(journal, slot, core, unit_id);
+   }
+   flock(journal->fd, LOCK_UN);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_journal_take(dvfs_journal *journal, const dvfs_core *core, unsigned int unit_id)
+{
+   assert(journal != NULL);
+   assert(core != NULL);
+   if (journal == NULL || core == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_journal_slot *slot = core_slot(journal, core);
+   if (slot == NULL)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   flock(journal->fd, LOCK_EX);
+   if (__atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE) == 0)
+   {
+      record_slot(journal, slot, core, unit_id);
+   }
+   else if (!owned(journal, slot) && owner_alive(slot))
+   {
+      // the state recorded by the previous owner is the original one
+      __atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+      own_slot(journal, slot, unit_id);
+   }
+   flock(journal->fd, LOCK_UN);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_journal_release(dvfs_journal *journal, const dvfs_core *core)
+{
+   assert(journal != NULL);
+   assert(core != NULL);
+   if (journal == NULL || core == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_journal_slot *slot = core_slot(journal, core);
+   if (slot == NULL)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   flock(journal->fd, LOCK_EX);
+   if (owned(journal, slot))
+   {
+      __atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+   }
+   flock(journal->fd, LOCK_UN);
+
+   return DVFS_SUCCESS;
+}
+
+static int write_core_str(const char *pattern, unsigned int id, const char *val)
+{
+   char fname[256];
+
+   if (dvfs_sysfs_path(fname, sizeof(fname), pattern, id) != DVFS_SUCCESS)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   FILE *fd = fopen(fname, "w");
+   if (fd == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   int ret = fprintf(fd, "%s\n", val);
+   // sysfs reports write errors on close
+   if (fclose(fd) != 0 || ret < 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int write_core_uint(const char *pattern, unsigned int id, unsigned int val)
+{
+   char fname[256];
+
+   if (dvfs_sysfs_path(fname, sizeof(fname), pattern, id) != DVFS_SUCCESS)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   return dvfs_sysfs_write_uint(fname, val);
+}
+
+/**
+ * Restores the state of a slot, in the order used by the cores.
+ */
+static int restore_slot(const dvfs_journal_slot *slot)
+{
+   const dvfs_core_state *state = &slot->state;
+   int ret = DVFS_SUCCESS;
+
+   if (state->gov[0] != '\0')
+   {
+      ret = write_core_str(SCALING_GOVERNOR_FILE_PATTERN, state->id, state->gov);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+   }
+
+   if (slot->ctrl == DVFS_CTRL_MINMAX && state->max_freq != 0)
+   {
+      char fname[256];
+      unsigned int cur_max = 0;
+
+      // keep the range valid: raise the upper limit first when moving up
+      if (dvfs_sysfs_path(fname, sizeof(fname), SCALING_MAXFREQ_FILE_PATTERN, state->id) == DVFS_SUCCESS)
+      {
+         dvfs_sysfs_read_uint(fname, &cur_max);
+      }
+
+      if (state->min_freq > cur_max)
+      {
+         if ((ret = write_core_uint(SCALING_MAXFREQ_FILE_PATTERN, state->id, state->max_freq)) == DVFS_SUCCESS)
+         {
+            ret = write_core_uint(SCALING_MINFREQ_FILE_PATTERN, state->id, state->min_freq);
+         }
+      }
+      else
+      {
+         if ((ret = write_core_uint(SCALING_MINFREQ_FILE_PATTERN, state->id, state->min_freq)) == DVFS_SUCCESS)
+         {
+            ret = write_core_uint(SCALING_MAXFREQ_FILE_PATTERN, state->id, state->max_freq);
+         }
+      }
+   }
+   else if (strcmp(state->gov, "userspace") == 0 && state->freq != 0)
+   {
+      ret = write_core_uint(SCALING_SETSPEED_FILE_PATTERN, state->id, state->freq);
+   }
+
+   return ret;
+}
+
+int dvfs_journal_recover(dvfs_journal *journal, unsigned int *pNbRestored)
+{
+   unsigned int i, nb = 0;
+   int ret = DVFS_SUCCESS;
+
+   assert(journal != NULL);
+   if (journal == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   flock(journal->fd, LOCK_EX);
+   for (i = 0; i < DVFS_JOURNAL_NB_SLOTS; i++)
+   {
+      dvfs_journal_slot *slot = &journal->slots[i];
+
+      if (__atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE) == 0 || owner_alive(slot))
+      {
+         continue;
+      }
+
+      // a living leaseholder of the unit controls the core now
+      bool leased = false;
+      if (slot->unit >= 0 && dvfs_lease_is_held(slot->unit, &leased) == DVFS_SUCCESS && leased)
+      {
+         continue;
+      }
+
+      int sret = restore_slot(slot);
+      if (sret != DVFS_SUCCESS)
+      {
+         ret = sret;
+         continue;
+      }
+
+      __atomic_store_n(&slot->owner, 0, __ATOMIC_RELEASE);
+      nb++;
+   }
+   flock(journal->fd, LOCK_UN);
+
+   if (pNbRestored != NULL)
+   {
+      *pNbRestored = nb;
+   }
+
+   return ret;
+}
@@ -0,0 +1,171 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "dvfs_core.h"
+#include "dvfs_snapshot.h"
+
+/**
+ * @file dvfs_journal.h
+ *
+ * Crash-safe journal of the initial state of the cores. When a process
+ * controlling the frequencies gets killed, \c dvfs_stop() never runs and the
+ * cores stay pinned at whatever frequency the process set. The journal is a
+ * small file mapped in memory, holding for each core its owner (a context,
+ * identified by its process and a handle) and its state before being opened.
+ * Writing a slot costs no system call once the file is mapped.
+ *
+ * Without leases, the first context opening a core owns its slot until it is
+ * stopped. The slots follow the leases (see dvfs_lease.h): leasing a unit takes
+ * the slots of its cores over, keeping the state they hold, and releasing it
+ * frees them. A context leasing units only journals the units it leases.
+ *
+ * \c dvfs_start() recovers the slots of dead owners before opening the cores,
+ * so the next job restores the node. The units leased by a living context are
+ * left to it. The recovery can also be triggered
+ * independently with the \c dvfs_recover helper (for instance from a job
+ * epilogue). Only the backends controlling the hardware use the journal.
+ *
+ * The journal is \c /run/libdvfs.journal unless the \c LIBDVFS_JOURNAL_PATH
+ * environment variable is set. When it cannot be opened (missing permissions),
+ * the library works without it.
+ */
+
+/** Environment variable overriding the path of the journal */
+#define DVFS_JOURNAL_PATH_ENV "LIBDVFS_JOURNAL_PATH"
+
+/** Default path of the journal */
+#define DVFS_JOURNAL_DEFAULT_PATH "/run/libdvfs.journal"
+
+/** Number of slots of the journal, the cores with a higher id are not journaled */
+#define DVFS_JOURNAL_NB_SLOTS 4096
+
+/**
+ * Slot of a core in the journal. The owner is written last and cleared first,
+ * a slot without owner is free.
+ */
+typedef struct {
+   int32_t owner;             //!< Pid of the owner, 0 if free
+   uint32_t ctrl;             //!< How the frequency is controlled (dvfs_freq_ctrl)
+   uint64_t owner_start;      //!< Start time of the owner (against pid reuse), 0 if unknown
+   uint32_t handle;           //!< Journal of the owner within its process
+   int32_t unit;              //!< Id of the unit of the core (the record of its lease), -1 if unknown
+   dvfs_core_state state;     //!< State of the core before being opened (the preference is not journaled)
+} dvfs_journal_slot;
+
+/**
+ * An opened journal.
+ */
+typedef struct dvfs_journal {
+   int fd;                    //!< Descriptor toward the journal file, also locked during updates
+   void *map;                 //!< Mapping of the file
+   size_t len;                //!< Size of the mapping
+   dvfs_journal_slot *slots;  //!< Slots, indexed by core id
+   pid_t pid;                 //!< Pid of the current process
+   uint64_t start;            //!< Start time of the current process
+   uint32_t handle;           //!< Handle of this journal, unique in the process
+} dvfs_journal;
+
+/**
+ * Opens the journal, creating it if needed.
+ *
+ * @param ppJournal Will be filled with the journal.
+ * @param path The journal file, NULL for the default one.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppJournal is NULL or the file is not a journal.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be opened or mapped.
+ *
+ * @sa dvfs_journal_close()
+ */
+int dvfs_journal_open(dvfs_journal **ppJournal, const char *path);
+
+/**
+ * Releases the slots owned by this journal and closes it. The slots of the
+ * other journals of the process are kept. Call it once the cores have been
+ * restored.
+ *
+ * @param journal The journal.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c journal is NULL.
+ */
+int dvfs_journal_close(dvfs_journal *journal);
+
+/**
+ * Records the initial state of a core, which must have just been opened. Only
+ * a free slot is taken: when another context owns the core, alive or dead
+ * with a failed recovery, its state is the original one and the slot is left
+ * untouched. Only the cores of the sysfs backend are journaled, the recovery
+ * cannot restore the others.
+ *
+ * @param journal The journal.
+ * @param core The core.
+ * @param unit_id The id of the unit of the core, which identifies its lease.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right (including when the core cannot be journaled).
+ *         \retval DVFS_ERROR_INVALID_ARG if \c journal or \c core are NULL.
+ */
+int dvfs_journal_record(dvfs_journal *journal, const dvfs_core *core, unsigned int unit_id);
+
+/**
+ * Takes the slot of a core whose unit has just been leased. A free slot is
+ * recorded as by dvfs_journal_record(). The slot of another living context
+ * changes owner but keeps its state, the original one. The slot of a dead
+ * owner is left for the recovery.
+ *
+ * @param journal The journal.
+ * @param core The core.
+ * @param unit_id The id of the leased unit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right (including when the core cannot be journaled).
+ *         \retval DVFS_ERROR_INVALID_ARG if \c journal or \c core are NULL.
+ */
+int dvfs_journal_take(dvfs_journal *journal, const dvfs_core *core, unsigned int unit_id);
+
+/**
+ * Frees the slot of a core if this journal owns it, once the core has been
+ * restored or when it is no longer controlled by the context.
+ *
+ * @param journal The journal.
+ * @param core The core.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c journal or \c core are NULL.
+ */
+int dvfs_journal_release(dvfs_journal *journal, const dvfs_core *core);
+
+/**
+ * Restores the cores whose owner died and frees their slots. The governor is
+ * written first, then the frequency (for "userspace") or the limits, directly
+ * in sysfs: the cores do not need to be opened. The slots of the units leased
+ * by a living context are skipped, it will restore them itself.
+ *
+ * @param journal The journal.
+ * @param pNbRestored If not NULL, filled with the number of cores restored.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c journal is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a core could not be restored (its slot is kept for a later attempt).
+ */
+int dvfs_journal_recover(dvfs_journal *journal, unsigned int *pNbRestored);
@@ -0,0 +1,431 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_journal.h"
+#include "dvfs_lease.h"
+
+static const char *lease_path(void)
+{
+   const char *path = getenv(DVFS_LEASE_PATH_ENV);
+
+   if (path == NULL || path[0] == '\0')
+   {
+      return DVFS_LEASE_DEFAULT_PATH;
+   }
+   return path;
+}
+
+/**
+ * Locks or unlocks the record of a unit, without waiting.
+ */
+static int lock_record(int fd, unsigned int unit_id, short type)
+{
+   struct flock fl = {
+      .l_type = type,
+      .l_whence = SEEK_SET,
+      .l_start = unit_id * sizeof(dvfs_lease_record),
+      .l_len = sizeof(dvfs_lease_record),
+      .l_pid = 0,
+   };
+
+   if (fcntl(fd, F_OFD_SETLK, &fl) != 0)
+   {
+      return errno == EAGAIN || errno == EACCES ? DVFS_ERROR_LEASE_HELD : DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Fences or unfences the cores of a unit, and their idle states.
+ */
+static void fence_unit(dvfs_ctx *ctx, dvfs_unit *unit, bool fenced)
+{
+   unsigned int i;
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      unit->cores[i]->fenced = fenced;
+      if (ctx->idle != NULL && unit->cores[i]->id < ctx->idle->nb_cores)
+      {
+         ctx->idle->cores[unit->cores[i]->id].fenced = fenced;
+      }
+   }
+}
+
+/**
+ * Fences the uncore domains shared with a fenced unit: changing them would
+ * change the units of another context too.
+ */
+static void fence_uncores(dvfs_ctx *ctx)
+{
+   const dvfs_uncore *uncore;
+   unsigned int i, j;
+
+   for (i = 0; i < ctx->nb_uncores; i++)
+   {
+      ctx->uncores[i]->fenced = false;
+   }
+
+   for (i = 0; ctx->nb_uncores != 0 && i < ctx->nb_units; i++)
+   {
+      if (!ctx->units[i]->cores[0]->fenced || dvfs_get_uncore_by_unit(ctx, ctx->units[i], &uncore) != DVFS_SUCCESS)
+      {
+         continue;
+      }
+      for (j = 0; j < ctx->nb_uncores; j++)
+      {
+         if (ctx->uncores[j] == uncore)
+         {
+            ctx->uncores[j]->fenced = true;
+         }
+      }
+   }
+}
+
+/**
+ * Takes or frees the journal slots of the cores of a unit.
+ */
+static void journal_unit(dvfs_ctx *ctx, const dvfs_unit *unit, bool take)
+{
+   unsigned int i;
+
+   if (ctx->journal == NULL)
+   {
+      return;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      if (take)
+      {
+         dvfs_journal_take(ctx->journal, unit->cores[i], unit->id);
+      }
+      else
+      {
+         dvfs_journal_release(ctx->journal, unit->cores[i]);
+      }
+   }
+}
+
+/**
+ * Checks that a unit belongs to the context.
+ */
+static bool in_context(const dvfs_ctx *ctx, const dvfs_unit *unit)
+{
+   return unit != NULL && unit->id < ctx->nb_units && ctx->units[unit->id] == unit;
+}
+
+/**
+ * Opens the lock file and partitions the context.
+ */
+static int open_lease(dvfs_ctx *ctx)
+{
+   unsigned int i;
+
+   dvfs_lease *lease = malloc(sizeof(*lease));
+   if (lease == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   lease->nb_units = ctx->nb_units;
+   lease->held = calloc(ctx->nb_units, sizeof(*lease->held));
+   if (lease->held == NULL)
+   {
+      free(lease);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   lease->fd = open(lease_path(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+   if (lease->fd < 0)
+   {
+      free(lease->held);
+      free(lease);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   // the fenced units are no longer restored by the context, their slots
+   // belong to their leaseholder
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      fence_unit(ctx, ctx->units[i], true);
+      journal_unit(ctx, ctx->units[i], false);
+   }
+   fence_uncores(ctx);
+
+   ctx->lease = lease;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_lease_acquire(dvfs_ctx *ctx, const char *owner, unsigned int nb_units, const dvfs_unit **units)
+{
+   dvfs_lease_record record;
+   unsigned int i, j;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   assert(owner != NULL);
+   assert(units != NULL);
+   if (ctx == NULL || owner == NULL || units == NULL || owner[0] == '\0' || strlen(owner) >= DVFS_LEASE_OWNER_LEN
+         || ctx->read_only)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      if (!in_context(ctx, units[i]))
+      {
+         return DVFS_ERROR_INVALID_INDEX;
+      }
+   }
+
+   if (ctx->lease == NULL)
+   {
+      ret = open_lease(ctx);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+   }
+   dvfs_lease *lease = ctx->lease;
+
+   // all or nothing: the new locks are dropped on the first conflict
+   for (i = 0; i < nb_units; i++)
+   {
+      if (lease->held[units[i]->id])
+      {
+         continue;
+      }
+
+      ret = lock_record(lease->fd, units[i]->id, F_WRLCK);
+      if (ret != DVFS_SUCCESS)
+      {
+         for (j = 0; j < i; j++)
+         {
+            if (!lease->held[units[j]->id])
+            {
+               lock_record(lease->fd, units[j]->id, F_UNLCK);
+            }
+         }
+         return ret;
+      }
+   }
+
+   memset(&record, 0, sizeof(record));
+   snprintf(record.owner, sizeof(record.owner), "%s", owner);
+   record.pid = getpid();
+
+   for (i = 0; i < nb_units; i++)
+   {
+      if (!lease->held[units[i]->id])
+      {
+         journal_unit(ctx, units[i], true);
+      }
+      lease->held[units[i]->id] = true;
+      fence_unit(ctx, ctx->units[units[i]->id], false);
+
+      // the name is informative, the lock is what matters
+      if (pwrite(lease->fd, &record, sizeof(record), units[i]->id * sizeof(record)) != (ssize_t) sizeof(record))
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+   }
+   fence_uncores(ctx);
+
+   return ret;
+}
+
+int dvfs_lease_release(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units)
+{
+   unsigned int i, j;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   assert(units != NULL);
+   if (ctx == NULL || units == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      if (!in_context(ctx, units[i]))
+      {
+         return DVFS_ERROR_INVALID_INDEX;
+      }
+      if (ctx->lease == NULL || !ctx->lease->held[units[i]->id])
+      {
+         return DVFS_ERROR_NOT_LEASED;
+      }
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      unsigned int id = units[i]->id;
+
+      // a unit listed twice is only released once
+      if (!ctx->lease->held[id])
+      {
+         continue;
+      }
+
+      // restored while still held, the next owner starts from the initial state
+      for (j = 0; j < ctx->units[id]->nb_cores; j++)
+      {
+         int res = dvfs_core_restore(ctx->units[id]->cores[j]);
+         ret = ret != DVFS_SUCCESS ? ret : res;
+      }
+
+      // the stale name is ignored once unlocked
+      journal_unit(ctx, ctx->units[id], false);
+      fence_unit(ctx, ctx->units[id], true);
+      ctx->lease->held[id] = false;
+      lock_record(ctx->lease->fd, id, F_UNLCK);
+   }
+   fence_uncores(ctx);
+
+   return ret;
+}
+
+int dvfs_lease_get_owner(const dvfs_ctx *ctx, const dvfs_unit *unit, char *buf, size_t buf_len, pid_t *pPid)
+{
+   dvfs_lease_record record;
+   int fd;
+
+   assert(ctx != NULL);
+   assert(buf != NULL);
+   if (ctx == NULL || unit == NULL || buf == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   if (!in_context(ctx, unit))
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   // another description of the file sees the locks of this context too
+   fd = open(lease_path(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      if (errno != ENOENT)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+      record.owner[0] = '\0';
+      record.pid = 0;
+   }
+   else
+   {
+      struct flock fl = {
+         .l_type = F_WRLCK,
+         .l_whence = SEEK_SET,
+         .l_start = unit->id * sizeof(record),
+         .l_len = sizeof(record),
+         .l_pid = 0,
+      };
+
+      int ret = fcntl(fd, F_OFD_GETLK, &fl);
+      if (ret == 0 && fl.l_type != F_UNLCK
+          && pread(fd, &record, sizeof(record), unit->id * sizeof(record)) == (ssize_t) sizeof(record))
+      {
+         record.owner[sizeof(record.owner) - 1] = '\0';
+      }
+      else
+      {
+         record.owner[0] = '\0';
+         record.pid = 0;
+      }
+      close(fd);
+
+      if (ret != 0)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+
+   if (pPid != NULL)
+   {
+      *pPid = record.pid;
+   }
+   if (snprintf(buf, buf_len, "%s", record.owner) >= (int) buf_len)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_lease_is_held(unsigned int unit_id, bool *pHeld)
+{
+   struct flock fl = {
+      .l_type = F_WRLCK,
+      .l_whence = SEEK_SET,
+      .l_start = unit_id * sizeof(dvfs_lease_record),
+      .l_len = sizeof(dvfs_lease_record),
+      .l_pid = 0,
+   };
+
+   assert(pHeld != NULL);
+   if (pHeld == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *pHeld = false;
+   int fd = open(lease_path(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+   {
+      return errno == ENOENT ? DVFS_SUCCESS : DVFS_ERROR_FILE_ERROR;
+   }
+
+   int ret = fcntl(fd, F_OFD_GETLK, &fl);
+   close(fd);
+   if (ret != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *pHeld = fl.l_type != F_UNLCK;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_lease_close(dvfs_lease *lease)
+{
+   assert(lease != NULL);
+   if (lease == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // closing the description drops all its locks
+   close(lease->fd);
+   free(lease->held);
+   free(lease);
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_lease.h
+ *
+ * Exclusive leases of DVFS units, for jobs sharing a node. A context leases
+ * the units it tunes under an owner name; the other contexts, in the same or
+ * in other processes, can no longer lease them.
+ *
+ * The leases are open file description locks (F_OFD_SETLK) on a shared lock
+ * file (\c /run/libdvfs.leases, or the LIBDVFS_LEASE_PATH environment
+ * variable), one record per unit holding the owner name. The kernel releases
+ * the locks when the context is stopped or the process exits, even when it is
+ * killed: a dead owner never keeps its units.
+ *
+ * From its first lease on, a context is partitioned: the cores of the units it
+ * does not lease are fenced, and so are the uncore domains of these units. Changing them (governor, frequency, limits, energy/performance
+ * preference, idle latency, turbo, uncore limits) fails with
+ * \c DVFS_ERROR_NOT_LEASED, the operations on the whole context
+ * (dvfs_set_freq(), dvfs_set_gov(), dvfs_acquire_idle_latency()) skip them, and
+ * dvfs_stop() does not restore their initial state. The slots of the
+ * crash-safe journal follow the leases (see dvfs_journal.h).
+ */
+
+/** Environment variable overriding the path of the lock file */
+#define DVFS_LEASE_PATH_ENV "LIBDVFS_LEASE_PATH"
+
+/** Default path of the lock file */
+#define DVFS_LEASE_DEFAULT_PATH "/run/libdvfs.leases"
+
+/** Longest owner name, with the NUL byte */
+#define DVFS_LEASE_OWNER_LEN 48
+
+/**
+ * Record of a unit in the lock file. Only meaningful while locked.
+ */
+typedef struct {
+   char owner[DVFS_LEASE_OWNER_LEN];   //!< Name of the owner
+   int32_t pid;                        //!< Process of the owner
+   uint32_t pad[3];                    //!< Unused
+} dvfs_lease_record;
+
+/**
+ * Leases of a context.
+ */
+typedef struct dvfs_lease {
+   int fd;                 //!< Lock file, the locks belong to this open file description
+   unsigned int nb_units;  //!< Number of units of the context
+   bool *held;             //!< Units leased by the context
+} dvfs_lease;
+
+/**
+ * Leases units to an owner. Either all the units are leased or none. Leasing
+ * a unit already leased by the context only renames its owner.
+ *
+ * @param ctx The context.
+ * @param owner The name of the owner, shorter than DVFS_LEASE_OWNER_LEN.
+ * @param nb_units The number of units.
+ * @param units The units to lease.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if an argument is NULL, if the owner name is empty or too long, or if the context is read-only.
+ *         \retval DVFS_ERROR_INVALID_INDEX if a unit is not in the context.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the lock file cannot be used.
+ *         \retval DVFS_ERROR_LEASE_HELD if a unit is leased by another context.
+ */
+int dvfs_lease_acquire(dvfs_ctx *ctx, const char *owner, unsigned int nb_units, const dvfs_unit **units);
+
+/**
+ * Releases leased units. Their cores are put back in the state found by
+ * dvfs_start() (see dvfs_core_restore()), then fenced again. The units are
+ * released even if their state could not be restored.
+ *
+ * @param ctx The context.
+ * @param nb_units The number of units.
+ * @param units The units to release.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c units are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if a unit is not in the context.
+ *         \retval DVFS_ERROR_NOT_LEASED if a unit is not leased by the context.
+ *         \retval DVFS_ERROR_FILE_ERROR if the state of a core could not be restored.
+ */
+int dvfs_lease_release(dvfs_ctx *ctx, unsigned int nb_units, const dvfs_unit **units);
+
+/**
+ * Gets the owner of a unit.
+ *
+ * @param ctx The context.
+ * @param unit The unit.
+ * @param buf Will be filled with the owner name, empty if the unit is not leased.
+ * @param buf_len The size of the buffer.
+ * @param pPid Will be filled with the process of the owner, 0 if the unit is not leased. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx, \c unit or \c buf are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the context.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the name does not fit in the buffer.
+ *         \retval DVFS_ERROR_FILE_ERROR if the lock file cannot be read.
+ */
+int dvfs_lease_get_owner(const dvfs_ctx *ctx, const dvfs_unit *unit, char *buf, size_t buf_len, pid_t *pPid);
+
+/**
+ * Tells if a unit is leased, by any context of any process. Used by the
+ * journal recovery, which leaves the leased units to their owner.
+ *
+ * @param unit_id The id of the unit.
+ * @param pHeld Will be filled with true if the unit is leased.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c pHeld is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the lock file cannot be read.
+ */
+int dvfs_lease_is_held(unsigned int unit_id, bool *pHeld);
+
+/**
+ * Releases all the leases of a context. You are not supposed to directly call
+ * this function, the leases are released by \c dvfs_stop().
+ *
+ * @param lease The leases.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c lease is NULL.
+ */
+int dvfs_lease_close(dvfs_lease *lease);
@@ -0,0 +1,350 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "dvfs_error.h"
+#include "dvfs_model.h"
+
+// Default coefficients, kept until a calibration
+#define MODEL_DEFAULT_STATIC_W 10.0
+#define MODEL_DEFAULT_DYN_W 2.0
+#define MODEL_DEFAULT_STALL_RATIO 0.3
+
+// Latency of a last level cache miss, used to estimate the stall cycles when
+// the processor does not count them
+#define MODEL_MISS_LATENCY_NS 80.0
+
+int dvfs_model_open(dvfs_model **ppModel, unsigned int nb_units)
+{
+   dvfs_model *model;
+   unsigned int i;
+
+   assert(ppModel != NULL);
+   if (ppModel == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   model = malloc(sizeof(*model));
+   if (model == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   model->nb_units = nb_units;
+   model->coeffs = malloc(nb_units * sizeof(*model->coeffs));
+   if (nb_units != 0 && model->coeffs == NULL)
+   {
+      free(model);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      model->coeffs[i].static_w = MODEL_DEFAULT_STATIC_W;
+      model->coeffs[i].dyn_w = MODEL_DEFAULT_DYN_W;
+      model->coeffs[i].stall_ratio = MODEL_DEFAULT_STALL_RATIO;
+      model->coeffs[i].calibrated = false;
+   }
+
+   *ppModel = model;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_model_close(dvfs_model *model)
+{
+   assert(model != NULL);
+   if (model == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   free(model->coeffs);
+   free(model);
+   return DVFS_SUCCESS;
+}
+
+static double ghz3(unsigned int freq)
+{
+   double ghz = freq / 1e6;
+   return ghz * ghz * ghz;
+}
+
+/**
+ * Fits the power of the compute kernel as static + dyn * f^3 by least
+ * squares. Returns false if the curve holds less than two measures.
+ */
+static bool fit_compute(const dvfs_profile_curve *curve, double *pStatic, double *pDyn)
+{
+   double sx = 0, sy = 0, sxx = 0, sxy = 0, det;
+   unsigned int i, n = 0;
+
+   for (i = 0; i < curve->nb_points; i++)
+   {
+      const dvfs_profile_point *p = &curve->points[i];
+      double x, y;
+
+      if (p->energy < 0 || p->time <= 0)
+      {
+         continue;
+      }
+
+      x = ghz3(p->freq);
+      y = p->energy / p->time;
+      sx += x, sy += y, sxx += x * x, sxy += x * y;
+      n++;
+   }
+
+   det = n * sxx - sx * sx;
+   if (n < 2 || det <= 0)
+   {
+      return false;
+   }
+
+   *pDyn = (n * sxy - sx * sy) / det;
+   *pStatic = (sy - *pDyn * sx) / n;
+   return *pDyn > 0;
+}
+
+/**
+ * Fits the share of the dynamic power drawn by the DRAM kernel, which spends
+ * most of its cycles stalled. Returns false without measures.
+ */
+static bool fit_stall(const dvfs_profile_curve *curve, double static_w, double dyn_w, double *pRatio)
+{
+   double sxx = 0, sxy = 0;
+   unsigned int i;
+
+   for (i = 0; i < curve->nb_points; i++)
+   {
+      const dvfs_profile_point *p = &curve->points[i];
+      double x;
+
+      if (p->energy < 0 || p->time <= 0)
+      {
+         continue;
+      }
+
+      x = dyn_w * ghz3(p->freq);
+      sxx += x * x;
+      sxy += x * (p->energy / p->time - static_w);
+   }
+
+   if (sxx <= 0)
+   {
+      return false;
+   }
+
+   *pRatio = sxy / sxx;
+   if (*pRatio < 0)
+   {
+      *pRatio = 0;
+   }
+   else if (*pRatio > 1)
+   {
+      *pRatio = 1;
+   }
+   return true;
+}
+
+int dvfs_model_calibrate(dvfs_model *model, const dvfs_profile *profile, unsigned int *pNb)
+{
+   unsigned int i, nb = 0;
+
+   assert(model != NULL);
+   assert(profile != NULL);
+   if (model == NULL || profile == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < model->nb_units && i < profile->nb_units; i++)
+   {
+      const dvfs_profile_curve *compute = &profile->curves[i * DVFS_KERNEL_NB + DVFS_KERNEL_COMPUTE];
+      const dvfs_profile_curve *dram = &profile->curves[i * DVFS_KERNEL_NB + DVFS_KERNEL_DRAM];
+      dvfs_model_coeffs *c = &model->coeffs[i];
+      double static_w, dyn_w, ratio;
+
+      if (!fit_compute(compute, &static_w, &dyn_w))
+      {
+         continue;
+      }
+
+      c->static_w = static_w > 0 ? static_w : 0;
+      c->dyn_w = dyn_w;
+      if (fit_stall(dram, c->static_w, c->dyn_w, &ratio))
+      {
+         c->stall_ratio = ratio;
+      }
+      c->calibrated = true;
+      nb++;
+   }
+
+   if (pNb != NULL)
+   {
+      *pNb = nb;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_model_sample_from_counters(const dvfs_counters_sample *prev, const dvfs_counters_sample *cur, unsigned int freq, dvfs_model_sample *pSample)
+{
+   double misses;
+
+   assert(prev != NULL);
+   assert(cur != NULL);
+   assert(pSample != NULL);
+   if (prev == NULL || cur == NULL || pSample == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pSample->freq = freq;
+   pSample->cycles = (double) (cur->values[DVFS_COUNTER_CYCLES] - prev->values[DVFS_COUNTER_CYCLES]);
+   pSample->stalls = (double) (cur->values[DVFS_COUNTER_STALLS] - prev->values[DVFS_COUNTER_STALLS]);
+
+   // Without stall counter, each miss stalls the core for a memory access
+   misses = (double) (cur->values[DVFS_COUNTER_LLC_MISSES] - prev->values[DVFS_COUNTER_LLC_MISSES]);
+   if (pSample->stalls == 0 && misses > 0)
+   {
+      pSample->stalls = misses * MODEL_MISS_LATENCY_NS * freq / 1e6;
+   }
+
+   if (pSample->stalls > pSample->cycles)
+   {
+      pSample->stalls = pSample->cycles;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Checks the arguments shared by the predictions.
+ */
+static int check_args(const dvfs_model *model, const dvfs_unit *unit, const dvfs_model_sample *sample)
+{
+   if (model == NULL || unit == NULL || sample == NULL || sample->freq == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (unit->id >= model->nb_units)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+   return DVFS_SUCCESS;
+}
+
+static void predict(const dvfs_model_coeffs *c, const dvfs_model_sample *sample, unsigned int freq, dvfs_model_prediction *p)
+{
+   double stalls = sample->stalls < sample->cycles ? sample->stalls : sample->cycles;
+   double t_cpu = (sample->cycles - stalls) / (freq * 1e3);
+   double t_mem = stalls / (sample->freq * 1e3);
+   double dyn = c->dyn_w * ghz3(freq);
+
+   p->freq = freq;
+   p->time = t_cpu + t_mem;
+   p->energy = c->static_w * p->time + dyn * (t_cpu + c->stall_ratio * t_mem);
+}
+
+int dvfs_model_predict(const dvfs_model *model, const dvfs_unit *unit, const dvfs_model_sample *sample, dvfs_model_prediction *predictions)
+{
+   const dvfs_core *core;
+   unsigned int i;
+   int ret;
+
+   assert(model != NULL);
+   assert(unit != NULL);
+   assert(sample != NULL);
+   assert(predictions != NULL);
+   if (predictions == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   ret = check_args(model, unit, sample);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   core = unit->cores[0];
+   for (i = 0; i < core->nb_freqs; i++)
+   {
+      predict(&model->coeffs[unit->id], sample, core->freqs[i], &predictions[i]);
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_unit_best_freq(const dvfs_model *model, const dvfs_unit *unit, const dvfs_model_sample *sample, dvfs_objective objective, unsigned int *pFreq)
+{
+   const dvfs_core *core;
+   double best = 0;
+   unsigned int i;
+   int ret;
+
+   assert(model != NULL);
+   assert(unit != NULL);
+   assert(sample != NULL);
+   assert(pFreq != NULL);
+   if (pFreq == NULL || objective >= DVFS_OBJ_NB)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   ret = check_args(model, unit, sample);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   core = unit->cores[0];
+   *pFreq = core->freqs[0];
+   for (i = 0; i < core->nb_freqs; i++)
+   {
+      dvfs_model_prediction p;
+      double score = 0;
+
+      predict(&model->coeffs[unit->id], sample, core->freqs[i], &p);
+      switch (objective)
+      {
+         case DVFS_OBJ_TIME:
+            score = p.time;
+            break;
+         case DVFS_OBJ_ENERGY:
+            score = p.energy;
+            break;
+         case DVFS_OBJ_EDP:
+            score = p.energy * p.time;
+            break;
+         case DVFS_OBJ_ED2P:
+            score = p.energy * p.time * p.time;
+            break;
+         default:
+            break;
+      }
+
+      if (i == 0 || score < best)
+      {
+         best = score;
+         *pFreq = p.freq;
+      }
+   }
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "dvfs_counters.h"
+#include "dvfs_profile.h"
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_model.h
+ *
+ * Runtime and energy model predicting, from a short counter sample taken at
+ * the current frequency, the behaviour of a unit at every frequency of its
+ * table. Trying the frequencies one after the other is too slow for short
+ * phases, the model answers in a few microseconds.
+ *
+ * The cycles of the sample are split into core-bound cycles, which scale with
+ * the frequency, and stall cycles waiting for the memory, whose duration does
+ * not depend on the core frequency:
+ *
+ *    T(f) = (cycles - stalls) / f + stalls / f0
+ *
+ * The power is a static part plus a dynamic part growing as the cube of the
+ * frequency, reduced while the core is stalled:
+ *
+ *    E(f) = P_static * T(f) + P_dyn * f^3 * ((cycles - stalls) / f + r * stalls / f0)
+ *
+ * The coefficients (P_static, P_dyn, r) are calibrated per unit from the
+ * compute and DRAM curves of a sensitivity profile (see dvfs_profile.h).
+ */
+
+/**
+ * Objectives of the frequency selection.
+ */
+typedef enum {
+   DVFS_OBJ_TIME = 0,      //!< Lowest runtime
+   DVFS_OBJ_ENERGY,        //!< Lowest energy
+   DVFS_OBJ_EDP,           //!< Lowest energy-delay product
+   DVFS_OBJ_ED2P,          //!< Lowest energy-delay squared product
+   DVFS_OBJ_NB             //!< Number of objectives
+} dvfs_objective;
+
+/**
+ * Coefficients of the model of a unit.
+ */
+typedef struct {
+   double static_w;     //!< Power not depending on the frequency (W)
+   double dyn_w;        //!< Dynamic power of a busy core at 1 GHz (W), growing as the cube of the frequency
+   double stall_ratio;  //!< Share of the dynamic power drawn while stalled on memory (0 to 1)
+   bool calibrated;     //!< True if the coefficients come from a profile, false for the defaults
+} dvfs_model_coeffs;
+
+/**
+ * Counter sample of a unit over a short period.
+ */
+typedef struct {
+   unsigned int freq;   //!< Frequency of the unit during the sample (kHz)
+   double cycles;       //!< Cycles of the sample
+   double stalls;       //!< Cycles stalled on memory, at most \c cycles
+} dvfs_model_sample;
+
+/**
+ * Prediction at a frequency.
+ */
+typedef struct {
+   unsigned int freq;   //!< Frequency (kHz)
+   double time;         //!< Predicted runtime of the work of the sample (s)
+   double energy;       //!< Predicted energy of the work of the sample (J)
+} dvfs_model_prediction;
+
+/**
+ * Models of the units of a context.
+ */
+typedef struct {
+   unsigned int nb_units;        //!< Number of units
+   dvfs_model_coeffs *coeffs;    //!< Coefficients per unit id
+} dvfs_model;
+
+/**
+ * Creates a model with default coefficients for every unit.
+ *
+ * @param ppModel Will be filled with the model.
+ * @param nb_units The number of units.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppModel is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_model_close()
+ */
+int dvfs_model_open(dvfs_model **ppModel, unsigned int nb_units);
+
+/**
+ * Frees a model.
+ *
+ * @param model The model.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c model is NULL.
+ */
+int dvfs_model_close(dvfs_model *model);
+
+/**
+ * Calibrates the coefficients of the units from a profile: the static and
+ * dynamic powers are fitted on the power of the compute kernel at every
+ * frequency, the stall ratio on the power of the DRAM kernel. The units
+ * without energy measures in the profile keep their coefficients.
+ *
+ * @param model The model.
+ * @param profile The profile.
+ * @param pNb Will be filled with the number of units calibrated. Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c model or \c profile are NULL.
+ */
+int dvfs_model_calibrate(dvfs_model *model, const dvfs_profile *profile, unsigned int *pNb);
+
+/**
+ * Builds a model sample from two samples of the performance counters of a
+ * unit with the default events (see dvfs_counters.h).
+ *
+ * @param prev The older counter sample.
+ * @param cur The newer counter sample.
+ * @param freq The frequency of the unit between the samples (kHz).
+ * @param pSample Will be filled with the model sample.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c prev, \c cur or \c pSample are NULL.
+ */
+int dvfs_model_sample_from_counters(const dvfs_counters_sample *prev, const dvfs_counters_sample *cur, unsigned int freq, dvfs_model_sample *pSample);
+
+/**
+ * Predicts the runtime and the energy of the work of a sample at every
+ * frequency of a unit.
+ *
+ * @param model The model.
+ * @param unit The unit.
+ * @param sample The sample.
+ * @param predictions Will be filled with a prediction per frequency of the unit, by increasing frequency (nb_freqs entries).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if an argument is NULL or if the sample has no frequency.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the model.
+ */
+int dvfs_model_predict(const dvfs_model *model, const dvfs_unit *unit, const dvfs_model_sample *sample, dvfs_model_prediction *predictions);
+
+/**
+ * Gets the frequency of the unit predicted to be the best for an objective.
+ * Ties go to the lowest frequency.
+ *
+ * @param model The model.
+ * @param unit The unit.
+ * @param sample The sample taken at the current frequency.
+ * @param objective The objective.
+ * @param pFreq Will be filled with the frequency (kHz).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if an argument is NULL, if the sample has no frequency or if the objective is unknown.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the model.
+ */
+int dvfs_unit_best_freq(const dvfs_model *model, const dvfs_unit *unit, const dvfs_model_sample *sample, dvfs_objective objective, unsigned int *pFreq);
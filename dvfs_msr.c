@@ -0,0 +1,81 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_msr.h"
+
+#define DEFAULT_MSR_PATH_PATTERN "/dev/cpu/%u/msr"
+
+int dvfs_msr_open(unsigned int core_id, int flags, int *pFd)
+{
+   char fname[256];
+   const char *pattern = getenv(DVFS_MSR_PATH_ENV);
+   const char *conv;
+
+   assert(pFd != NULL);
+
+   if (pattern == NULL || *pattern == '\0')
+   {
+      pattern = DEFAULT_MSR_PATH_PATTERN;
+   }
+
+   // the pattern is never used as a format: it must hold a single %u
+   conv = strchr(pattern, '%');
+   if (conv == NULL || conv[1] != 'u' || strchr(conv + 2, '%') != NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (snprintf(fname, sizeof(fname), "%.*s%u%s", (int) (conv - pattern), pattern, core_id, conv + 2) >= (int) sizeof(fname))
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   *pFd = open(fname, flags | O_CLOEXEC);
+   if (*pFd < 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_msr_read(int fd, uint32_t reg, uint64_t *pVal)
+{
+   if (pread(fd, pVal, sizeof(*pVal), reg) != sizeof(*pVal))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_msr_write(int fd, uint32_t reg, uint64_t val)
+{
+   if (pwrite(fd, &val, sizeof(val), reg) != sizeof(val))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @file dvfs_msr.h
+ *
+ * Access to the model specific registers through the \c msr driver
+ * (\c /dev/cpu/N/msr). The driver must be loaded (modprobe msr) and the
+ * caller needs the CAP_SYS_RAWIO capability.
+ *
+ * The MSR device path can be redirected with the \c LIBDVFS_MSR_PATH
+ * environment variable, a pattern containing a single \c %u replaced by the
+ * core id (for instance \c /tmp/fake/cpu%u/msr). Regular files can then be
+ * used in place of the devices.
+ */
+
+/** Environment variable overriding the MSR device path pattern */
+#define DVFS_MSR_PATH_ENV "LIBDVFS_MSR_PATH"
+
+#define DVFS_MSR_PLATFORM_INFO 0xCE         /*!< Min/max non-turbo ratios */
+#define DVFS_MSR_IA32_MPERF 0xE7            /*!< Cycles at the base frequency while not halted */
+#define DVFS_MSR_IA32_APERF 0xE8            /*!< Actual cycles while not halted */
+#define DVFS_MSR_IA32_PERF_STATUS 0x198     /*!< Current P-state ratio */
+#define DVFS_MSR_IA32_PERF_CTL 0x199        /*!< Requested P-state ratio */
+#define DVFS_MSR_TURBO_RATIO_LIMIT 0x1AD    /*!< Maximal turbo ratios */
+#define DVFS_MSR_IA32_PM_ENABLE 0x770       /*!< Hardware P-states (HWP) enable */
+#define DVFS_MSR_IA32_HWP_REQUEST 0x774     /*!< HWP performance hints and preference */
+
+/** Bus clock multiplied by the ratios, in kHz */
+#define DVFS_MSR_BUS_CLOCK 100000
+
+/**
+ * Opens the MSR device of a core.
+ *
+ * @param core_id The core id.
+ * @param flags The open flags (O_RDONLY or O_RDWR).
+ * @param pFd Will be filled with the file descriptor.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if the pattern of \c LIBDVFS_MSR_PATH does not hold exactly one \c %u and no other conversion.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the device path is too long.
+ *         \retval DVFS_ERROR_FILE_ERROR if the device cannot be opened (you can check errno for more details).
+ */
+int dvfs_msr_open(unsigned int core_id, int flags, int *pFd);
+
+/**
+ * Reads a model specific register.
+ *
+ * @param fd The MSR device of the core.
+ * @param reg The register.
+ * @param pVal Will be filled with the register value.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_FILE_ERROR if the register cannot be read.
+ */
+int dvfs_msr_read(int fd, uint32_t reg, uint64_t *pVal);
+
+/**
+ * Writes a model specific register.
+ *
+ * @param fd The MSR device of the core.
+ * @param reg The register.
+ * @param val The value to write.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_FILE_ERROR if the register cannot be written.
+ */
+int dvfs_msr_write(int fd, uint32_t reg, uint64_t val);
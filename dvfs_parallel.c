@@ -0,0 +1,120 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#include "dvfs_error.h"
+#include "dvfs_parallel.h"
+
+/**
+ * Work shared by the threads, the indexes are taken in order.
+ */
+typedef struct {
+   unsigned int nb;        //!< Number of indexes
+   unsigned int next;      //!< Next index to process
+   dvfs_parallel_fn fn;    //!< Operation
+   void *arg;              //!< Argument of the operation
+   int result;             //!< Last error, DVFS_SUCCESS if none
+} parallel_work;
+
+static void *parallel_worker(void *arg)
+{
+   parallel_work *work = arg;
+   unsigned int index;
+
+   while ((index = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED)) < work->nb)
+   {
+      int ret = work->fn(index, work->arg);
+      if (ret != DVFS_SUCCESS)
+      {
+         __atomic_store_n(&work->result, ret, __ATOMIC_RELAXED);
+      }
+   }
+
+   return NULL;
+}
+
+/**
+ * Gets the highest number of threads to use, the calling thread included.
+ */
+static unsigned int max_threads(void)
+{
+   const char *env = getenv(DVFS_THREADS_ENV);
+   unsigned long val;
+
+   if (env == NULL || *env == '\0')
+   {
+      return DVFS_PARALLEL_MAX_THREADS;
+   }
+
+   val = strtoul(env, NULL, 10);
+   if (val < 1)
+   {
+      return 1;
+   }
+   return val < DVFS_PARALLEL_MAX_THREADS ? val : DVFS_PARALLEL_MAX_THREADS;
+}
+
+int dvfs_parallel_run(unsigned int nb, dvfs_parallel_fn fn, void *arg)
+{
+   pthread_t threads[DVFS_PARALLEL_MAX_THREADS];
+   unsigned int i, nb_threads = 0;
+   unsigned int max = max_threads();
+   sigset_t all, old;
+   parallel_work work = {
+      .nb = nb,
+      .next = 0,
+      .fn = fn,
+      .arg = arg,
+      .result = DVFS_SUCCESS,
+   };
+
+   if (fn == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // the calling thread takes its share, so one thread less is needed. The
+   // threads inherit a mask blocking all the signals.
+   if (nb > 1 && max > 1)
+   {
+      sigfillset(&all);
+      pthread_sigmask(SIG_SETMASK, &all, &old);
+      for (i = 1; i < nb && i < max; i++)
+      {
+         if (pthread_create(&threads[nb_threads], NULL, parallel_worker, &work) != 0)
+         {
+            break;
+         }
+         nb_threads++;
+      }
+      pthread_sigmask(SIG_SETMASK, &old, NULL);
+   }
+
+   // without threads, everything runs here
+   parallel_worker(&work);
+
+   for (i = 0; i < nb_threads; i++)
+   {
+      pthread_join(threads[i], NULL);
+   }
+
+   return work.result;
+}
@@ -0,0 +1,63 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @file dvfs_parallel.h
+ *
+ * Internal helper running independent operations (typically one per DVFS
+ * unit) on a small pool of threads. The cost of the sysfs accesses is mostly
+ * spent waiting for the cpufreq drivers, so the operations of different
+ * frequency domains overlap even on a single CPU.
+ *
+ * The threads are started on every call and only live during it. Setting
+ * DVFS_THREADS_ENV to 1 runs the operations in the calling thread, for the
+ * processes that must not start threads (teardown after fork(), sandboxes
+ * limiting the threads).
+ */
+
+/** Highest number of threads started by dvfs_parallel_run() */
+#define DVFS_PARALLEL_MAX_THREADS 32
+
+/** Environment variable limiting the threads used by dvfs_parallel_run(), the calling thread included */
+#define DVFS_THREADS_ENV "LIBDVFS_THREADS"
+
+/**
+ * Operation run for each index. Must only touch the data of its index.
+ *
+ * @return A libdvfs error code.
+ */
+typedef int (*dvfs_parallel_fn)(unsigned int index, void *arg);
+
+/**
+ * Runs the operation for every index from 0 to \c nb - 1 and waits for all of
+ * them. The operations run in the calling thread when there is a single one,
+ * when DVFS_THREADS_ENV is 1 or when no thread can be started: the indexes
+ * left by the threads that could not be started are run by the calling
+ * thread. The threads block all the signals, which stay delivered to the
+ * calling thread.
+ *
+ * @param nb The number of indexes.
+ * @param fn The operation.
+ * @param arg The argument given to every call.
+ *
+ * @return \retval DVFS_SUCCESS if all the operations succeeded.
+ *         The error of one of the failing operations otherwise.
+ */
+int dvfs_parallel_run(unsigned int nb, dvfs_parallel_fn fn, void *arg);
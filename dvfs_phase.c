@@ -0,0 +1,467 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dvfs_error.h"
+#include "dvfs_phase.h"
+#include "dvfs_timer.h"
+
+// Header of the traces, followed by one line per sample:
+// unit freq time_enabled cycles instructions llc_misses stalls
+#define TRACE_HEADER "dvfs_phase_trace stalls=%d\n"
+
+// Ratios followed by the CUSUM
+#define RATIO_ACTIVITY 0
+#define RATIO_MEMORY 1
+
+int dvfs_phase_open(dvfs_phase **ppPhase, dvfs_ctx *ctx, dvfs_counters *counters, const dvfs_phase_config *config)
+{
+   unsigned int i;
+
+   assert(ppPhase != NULL);
+   assert(ctx != NULL);
+   assert(config != NULL);
+   if (ppPhase == NULL || ctx == NULL || config == NULL || config->idle_threshold <= 0 || config->memory_threshold <= 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_phase *phase = calloc(1, sizeof(*phase));
+   if (phase == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   phase->ctx = ctx;
+   phase->counters = counters;
+   phase->config = *config;
+   // the path is only used here
+   phase->config.record_path = NULL;
+   phase->stalls = counters != NULL && (counters->available & (1U << DVFS_COUNTER_STALLS)) != 0;
+
+   phase->units = calloc(ctx->nb_units, sizeof(*phase->units));
+   phase->samples = calloc(ctx->nb_units, sizeof(*phase->samples));
+   if (phase->units == NULL || phase->samples == NULL)
+   {
+      free(phase->units);
+      free(phase->samples);
+      free(phase);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   if (config->record_path != NULL)
+   {
+      phase->record = fopen(config->record_path, "w");
+      if (phase->record == NULL)
+      {
+         free(phase->units);
+         free(phase->samples);
+         free(phase);
+         return DVFS_ERROR_FILE_ERROR;
+      }
+      fprintf(phase->record, TRACE_HEADER, phase->stalls);
+   }
+
+   // without the governor, the frequencies chosen would not be applied
+   int ret = dvfs_set_gov(ctx, "userspace");
+   if (ret != DVFS_SUCCESS)
+   {
+      if (phase->record != NULL)
+      {
+         fclose(phase->record);
+      }
+      free(phase->units);
+      free(phase->samples);
+      free(phase);
+      return ret;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      phase->units[i].stats.current = DVFS_PHASE_NB;
+      phase->units[i].freq = 0;
+      dvfs_unit_get_freq(ctx->units[i], &phase->units[i].freq);
+   }
+
+   dvfs_timer_cond_init(&phase->cond);
+   pthread_mutex_init(&phase->lock, NULL);
+
+   *ppPhase = phase;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_phase_close(dvfs_phase *phase)
+{
+   assert(phase != NULL);
+   if (phase == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (phase->running)
+   {
+      dvfs_phase_stop(phase);
+   }
+   pthread_mutex_destroy(&phase->lock);
+   pthread_cond_destroy(&phase->cond);
+
+   if (phase->record != NULL)
+   {
+      fclose(phase->record);
+   }
+   free(phase->units);
+   free(phase->samples);
+   free(phase);
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Runs the change-point detection on the normalized ratios of a period.
+ *
+ * @return True if a change point was detected.
+ */
+static bool detect(dvfs_phase *phase, dvfs_phase_unit *u, const double *x)
+{
+   bool change = false;
+   unsigned int k;
+
+   if (u->seg_len != 0)
+   {
+      for (k = 0; k < 2; k++)
+      {
+         u->pos[k] = u->pos[k] + x[k] - u->mean[k] - phase->config.drift;
+         u->neg[k] = u->neg[k] + u->mean[k] - x[k] - phase->config.drift;
+         u->pos[k] = u->pos[k] > 0 ? u->pos[k] : 0;
+         u->neg[k] = u->neg[k] > 0 ? u->neg[k] : 0;
+         change = change || u->pos[k] > phase->config.limit || u->neg[k] > phase->config.limit;
+      }
+   }
+
+   // a new segment starts with the first sample and at every change point
+   if (u->seg_len == 0 || change)
+   {
+      for (k = 0; k < 2; k++)
+      {
+         u->mean[k] = x[k];
+         u->pos[k] = u->neg[k] = 0;
+      }
+      u->seg_len = 1;
+      return change;
+   }
+
+   u->seg_len++;
+   for (k = 0; k < 2; k++)
+   {
+      u->mean[k] += (x[k] - u->mean[k]) / u->seg_len;
+   }
+   return false;
+}
+
+/**
+ * Classifies a sample of a unit and sets the frequency of its class. Called
+ * with the lock held.
+ *
+ * @param freq The frequency of the unit during the period of the sample.
+ */
+static int feed(dvfs_phase *phase, unsigned int id, const dvfs_counters_sample *sample, unsigned int freq)
+{
+   dvfs_phase_unit *u = &phase->units[id];
+   const uint64_t *cur = sample->values;
+   const uint64_t *prev = u->prev.values;
+   dvfs_phase_class class;
+   double x[2];
+   int ret = DVFS_SUCCESS;
+
+   if (!u->primed || sample->time_enabled <= u->prev.time_enabled || cur[DVFS_COUNTER_CYCLES] < prev[DVFS_COUNTER_CYCLES])
+   {
+      // first sample or counters reopened
+      u->prev = *sample;
+      u->primed = true;
+      return DVFS_SUCCESS;
+   }
+
+   double dt = sample->time_enabled - u->prev.time_enabled;
+   double cycles = cur[DVFS_COUNTER_CYCLES] - prev[DVFS_COUNTER_CYCLES];
+   double instructions = cur[DVFS_COUNTER_INSTRUCTIONS] - prev[DVFS_COUNTER_INSTRUCTIONS];
+   double misses = cur[DVFS_COUNTER_LLC_MISSES] - prev[DVFS_COUNTER_LLC_MISSES];
+   double stalls = cur[DVFS_COUNTER_STALLS] - prev[DVFS_COUNTER_STALLS];
+   u->prev = *sample;
+
+   // the enabled times are summed over the cores of the unit, a core runs freq / 10^6 cycles per ns
+   u->stats.activity = freq != 0 ? cycles / (dt * freq / 1e6) : 0;
+   u->stats.activity = u->stats.activity < 1 ? u->stats.activity : 1;
+   if (phase->stalls)
+   {
+      u->stats.memory = cycles != 0 ? stalls / cycles : 0;
+   }
+   else
+   {
+      u->stats.memory = instructions != 0 ? misses * 1000 / instructions : 0;
+   }
+
+   x[RATIO_ACTIVITY] = u->stats.activity / phase->config.idle_threshold;
+   x[RATIO_MEMORY] = u->stats.memory / phase->config.memory_threshold;
+   if (detect(phase, u, x))
+   {
+      u->stats.nb_change_points++;
+   }
+
+   if (u->mean[RATIO_ACTIVITY] < 1)
+   {
+      class = DVFS_PHASE_IDLE;
+   }
+   else if (u->mean[RATIO_MEMORY] >= 1)
+   {
+      class = DVFS_PHASE_MEMORY;
+   }
+   else
+   {
+      class = DVFS_PHASE_COMPUTE;
+   }
+
+   u->stats.nb_samples++;
+   u->stats.residency[class]++;
+   if (class != u->stats.current)
+   {
+      u->stats.current = class;
+      u->stats.nb_switches++;
+   }
+
+   // a failed change is retried at the next sample
+   unsigned int target = phase->config.freqs[class];
+   if (target != 0 && target != u->freq)
+   {
+      ret = dvfs_unit_set_freq(phase->ctx->units[id], target);
+      u->stats.last_status = ret;
+      if (ret == DVFS_SUCCESS)
+      {
+         u->freq = target;
+         u->stats.nb_freq_changes++;
+      }
+   }
+   return ret;
+}
+
+/**
+ * Gets the id of a unit of the context.
+ */
+static int unit_index(const dvfs_phase *phase, const dvfs_unit *unit)
+{
+   if (unit->id >= phase->ctx->nb_units || phase->ctx->units[unit->id] != unit)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_phase_feed(dvfs_phase *phase, const dvfs_unit *unit, const dvfs_counters_sample *sample)
+{
+   int ret;
+
+   assert(phase != NULL);
+   assert(unit != NULL);
+   assert(sample != NULL);
+   if (phase == NULL || unit == NULL || sample == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   ret = unit_index(phase, unit);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   pthread_mutex_lock(&phase->lock);
+   ret = feed(phase, unit->id, sample, phase->units[unit->id].freq);
+   pthread_mutex_unlock(&phase->lock);
+   return ret;
+}
+
+int dvfs_phase_step(dvfs_phase *phase)
+{
+   const dvfs_counters_sample *s;
+   unsigned int i;
+   int ret;
+
+   assert(phase != NULL);
+   if (phase == NULL || phase->counters == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&phase->lock);
+   ret = dvfs_counters_read_units(phase->counters, 0, NULL, phase->samples);
+   if (ret != DVFS_SUCCESS)
+   {
+      pthread_mutex_unlock(&phase->lock);
+      return ret;
+   }
+
+   for (i = 0; i < phase->ctx->nb_units; i++)
+   {
+      s = &phase->samples[i];
+      if (phase->record != NULL)
+      {
+         fprintf(phase->record, "%u %u %llu %llu %llu %llu %llu\n", i, phase->units[i].freq,
+                 (unsigned long long) s->time_enabled,
+                 (unsigned long long) s->values[DVFS_COUNTER_CYCLES],
+                 (unsigned long long) s->values[DVFS_COUNTER_INSTRUCTIONS],
+                 (unsigned long long) s->values[DVFS_COUNTER_LLC_MISSES],
+                 (unsigned long long) s->values[DVFS_COUNTER_STALLS]);
+      }
+
+      int uret = feed(phase, i, s, phase->units[i].freq);
+      ret = ret == DVFS_SUCCESS ? uret : ret;
+   }
+   pthread_mutex_unlock(&phase->lock);
+   return ret;
+}
+
+int dvfs_phase_replay(dvfs_phase *phase, const char *path)
+{
+   dvfs_counters_sample sample;
+   unsigned long long values[5];
+   unsigned int id, freq;
+   int stalls, n;
+   int ret = DVFS_SUCCESS;
+
+   assert(phase != NULL);
+   assert(path != NULL);
+   if (phase == NULL || path == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   FILE *trace = fopen(path, "r");
+   if (trace == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   if (fscanf(trace, TRACE_HEADER, &stalls) != 1)
+   {
+      fclose(trace);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   pthread_mutex_lock(&phase->lock);
+   phase->stalls = stalls != 0;
+
+   memset(&sample, 0, sizeof(sample));
+   while ((n = fscanf(trace, "%u %u %llu %llu %llu %llu %llu", &id, &freq,
+                      &values[0], &values[1], &values[2], &values[3], &values[4])) == 7)
+   {
+      if (id >= phase->ctx->nb_units)
+      {
+         ret = DVFS_ERROR_INVALID_INDEX;
+         break;
+      }
+
+      sample.time_enabled = sample.time_running = values[0];
+      sample.values[DVFS_COUNTER_CYCLES] = values[1];
+      sample.values[DVFS_COUNTER_INSTRUCTIONS] = values[2];
+      sample.values[DVFS_COUNTER_LLC_MISSES] = values[3];
+      sample.values[DVFS_COUNTER_STALLS] = values[4];
+
+      // the ratios are computed at the frequency of the recording
+      int uret = feed(phase, id, &sample, freq);
+      ret = ret == DVFS_SUCCESS ? uret : ret;
+   }
+   if (ret == DVFS_SUCCESS && n != EOF)
+   {
+      ret = DVFS_ERROR_FILE_ERROR;
+   }
+   pthread_mutex_unlock(&phase->lock);
+
+   fclose(trace);
+   return ret;
+}
+
+static int sampling(void *arg)
+{
+   return dvfs_phase_step(arg);
+}
+
+static void *sampling_main(void *arg)
+{
+   dvfs_phase *phase = arg;
+
+   dvfs_timer_loop(&phase->cond, &phase->lock, &phase->stop, phase->config.period_ms * 1000000ULL, sampling, phase);
+   return NULL;
+}
+
+int dvfs_phase_start(dvfs_phase *phase)
+{
+   assert(phase != NULL);
+   if (phase == NULL || phase->counters == NULL || phase->running || phase->config.period_ms == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   phase->stop = false;
+   if (pthread_create(&phase->thread, NULL, sampling_main, phase) != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   phase->running = true;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_phase_stop(dvfs_phase *phase)
+{
+   assert(phase != NULL);
+   if (phase == NULL || !phase->running)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&phase->lock);
+   phase->stop = true;
+   pthread_cond_signal(&phase->cond);
+   pthread_mutex_unlock(&phase->lock);
+
+   pthread_join(phase->thread, NULL);
+   phase->running = false;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_phase_get_stats(dvfs_phase *phase, const dvfs_unit *unit, dvfs_phase_stats *pStats)
+{
+   int ret;
+
+   assert(phase != NULL);
+   assert(unit != NULL);
+   assert(pStats != NULL);
+   if (phase == NULL || unit == NULL || pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   ret = unit_index(phase, unit);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   pthread_mutex_lock(&phase->lock);
+   *pStats = phase->units[unit->id].stats;
+   pthread_mutex_unlock(&phase->lock);
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,228 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dvfs_context.h"
+#include "dvfs_counters.h"
+
+/**
+ * @file dvfs_phase.h
+ *
+ * Phase detector classifying the behaviour of every DVFS unit from its
+ * performance counters (see dvfs_counters.h), without annotating the
+ * applications, and setting the frequency configured for each class.
+ *
+ * Every period, two ratios are computed per unit from the counts of the
+ * period:
+ * - the activity, cycles over the cycles of a core running all the time at
+ *   the unit frequency,
+ * - the memory ratio, stall cycles over cycles, or LLC misses per thousand
+ *   instructions when the stalls are not counted.
+ *
+ * The ratios are normalized by their class thresholds and fed to a two-sided
+ * CUSUM change-point detector per ratio. Between two change points, the unit
+ * is classified from the mean of the ratios since the last change point: idle
+ * under the activity threshold, memory-bound over the memory threshold,
+ * compute-bound otherwise. The frequency of the class is only set when the
+ * class changes.
+ *
+ * The samples can be recorded to a trace and replayed later with
+ * dvfs_phase_replay(), to tune the detector offline and test it
+ * deterministically.
+ */
+
+/**
+ * Behaviour of a unit.
+ */
+typedef enum {
+   DVFS_PHASE_COMPUTE = 0,    //!< Compute-bound
+   DVFS_PHASE_MEMORY,         //!< Memory-bound
+   DVFS_PHASE_IDLE,           //!< Mostly idle
+   DVFS_PHASE_NB              //!< Number of classes, also used before the first classification
+} dvfs_phase_class;
+
+/**
+ * Configuration of the detector.
+ */
+typedef struct {
+   unsigned int freqs[DVFS_PHASE_NB];  //!< Frequency set for each class (kHz), 0 to leave the frequency unchanged
+   double idle_threshold;              //!< Units less active than this are idle (0 to 1)
+   double memory_threshold;            //!< Units with a higher memory ratio are memory-bound
+   double drift;                       //!< Drift of the CUSUM, the changes smaller than this are ignored (in thresholds)
+   double limit;                       //!< Decision limit of the CUSUM (in thresholds)
+   unsigned int period_ms;             //!< Sampling period of the thread started by dvfs_phase_start() (ms)
+   const char *record_path;            //!< Trace the samples of dvfs_phase_step() are recorded to, NULL for none
+} dvfs_phase_config;
+
+/**
+ * Counters of a unit.
+ */
+typedef struct {
+   dvfs_phase_class current;           //!< Current class
+   double activity;                    //!< Activity over the last period
+   double memory;                      //!< Memory ratio over the last period
+   unsigned long long nb_samples;      //!< Samples classified
+   unsigned long long nb_change_points;   //!< Change points detected
+   unsigned long long nb_switches;     //!< Class changes, the first classification included
+   unsigned long long nb_freq_changes; //!< Frequencies set
+   unsigned long long residency[DVFS_PHASE_NB];   //!< Samples classified in each class
+   int last_status;                    //!< Result of the last frequency change
+} dvfs_phase_stats;
+
+/**
+ * Detector state of a unit.
+ */
+typedef struct {
+   bool primed;                  //!< True once a first sample is known
+   dvfs_counters_sample prev;    //!< Previous sample
+   unsigned int freq;            //!< Frequency found at the opening or last set by the detector (kHz)
+   unsigned long long seg_len;   //!< Number of samples since the last change point
+   double mean[2];               //!< Mean of the normalized activity and memory ratio since the last change point
+   double pos[2];                //!< Upper CUSUM of the normalized activity and memory ratio
+   double neg[2];                //!< Lower CUSUM of the normalized activity and memory ratio
+   dvfs_phase_stats stats;       //!< Counters
+} dvfs_phase_unit;
+
+/**
+ * Phase detector of the units of a context.
+ */
+typedef struct {
+   dvfs_ctx *ctx;                   //!< Context of the units
+   dvfs_counters *counters;         //!< Counters sampled by dvfs_phase_step(), NULL for replay only
+   dvfs_phase_config config;        //!< Configuration
+   bool stalls;                     //!< True if the stall cycles are counted
+   dvfs_phase_unit *units;          //!< Detector state per unit id
+   dvfs_counters_sample *samples;   //!< Samples of the current step
+   FILE *record;                    //!< Trace being recorded, NULL if none
+
+   pthread_mutex_t lock;            //!< Serializes the samples
+   pthread_cond_t cond;             //!< Wakes up the sampling thread to stop it
+   pthread_t thread;                //!< Sampling thread
+   bool running;                    //!< True if the sampling thread runs
+   bool stop;                       //!< Tells the sampling thread to exit
+} dvfs_phase;
+
+/**
+ * Creates a detector. The governor of the units is set to "userspace".
+ *
+ * @param ppPhase Will be filled with the detector.
+ * @param ctx The context.
+ * @param counters The counters of the context, with the default events (dvfs_counter_id). NULL to only feed the detector with dvfs_phase_feed() or dvfs_phase_replay().
+ * @param config The configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppPhase, \c ctx or \c config are NULL, or if a threshold is not positive.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the trace cannot be created.
+ *         Otherwise, the error of dvfs_set_gov() when the "userspace" governor cannot be set.
+ *
+ * @sa dvfs_phase_close()
+ */
+int dvfs_phase_open(dvfs_phase **ppPhase, dvfs_ctx *ctx, dvfs_counters *counters, const dvfs_phase_config *config);
+
+/**
+ * Stops the sampling thread if needed and frees the detector. The units keep
+ * their last frequency and the counters stay open.
+ *
+ * @param phase The detector.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase is NULL.
+ */
+int dvfs_phase_close(dvfs_phase *phase);
+
+/**
+ * Feeds a sample of the counters of a unit to the detector. The first sample
+ * of a unit only serves as a reference.
+ *
+ * @param phase The detector.
+ * @param unit The unit.
+ * @param sample The counts of the unit, as returned by dvfs_counters_read_unit().
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase, \c unit or \c sample are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the context.
+ *         Otherwise, the error met while setting the frequency.
+ */
+int dvfs_phase_feed(dvfs_phase *phase, const dvfs_unit *unit, const dvfs_counters_sample *sample);
+
+/**
+ * Reads the counters of all the units and feeds them to the detector.
+ *
+ * @param phase The detector.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase is NULL or has no counters.
+ *         Otherwise, the error met while reading the counters or setting a frequency.
+ */
+int dvfs_phase_step(dvfs_phase *phase);
+
+/**
+ * Feeds the samples of a recorded trace to the detector, as if they were read
+ * from the counters. The ratios are computed at the frequencies of the
+ * recording, the frequencies of the classes are set on the units of the
+ * context.
+ *
+ * @param phase The detector.
+ * @param path The trace.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase or \c path are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the trace cannot be read or is malformed.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the trace holds a unit not in the context.
+ *         Otherwise, the error met while setting a frequency.
+ */
+int dvfs_phase_replay(dvfs_phase *phase, const char *path);
+
+/**
+ * Starts a thread calling dvfs_phase_step() every \c period_ms.
+ *
+ * @param phase The detector.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase is NULL or has no counters, if the thread already runs or if \c period_ms is 0.
+ *         \retval DVFS_ERROR_FILE_ERROR if the thread cannot be created.
+ */
+int dvfs_phase_start(dvfs_phase *phase);
+
+/**
+ * Stops the sampling thread.
+ *
+ * @param phase The detector.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase is NULL or if the thread does not run.
+ */
+int dvfs_phase_stop(dvfs_phase *phase);
+
+/**
+ * Gets the counters of a unit.
+ *
+ * @param phase The detector.
+ * @param unit The unit.
+ * @param pStats Will be filled with the counters.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c phase, \c unit or \c pStats are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the context.
+ */
+int dvfs_phase_get_stats(dvfs_phase *phase, const dvfs_unit *unit, dvfs_phase_stats *pStats);
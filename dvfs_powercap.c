@@ -0,0 +1,524 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_powercap.h"
+#include "dvfs_sysfs.h"
+#include "dvfs_timer.h"
+
+#define ENERGY_FILE_PATTERN "/class/powercap/intel-rapl:%u/energy_uj"
+#define RANGE_FILE_PATTERN "/class/powercap/intel-rapl:%u/max_energy_range_uj"
+
+// Highest number of package domains looked for
+#define POWERCAP_MAX_DOMAINS 64
+
+/**
+ * Reads an energy counter through its open descriptor.
+ */
+static int read_energy(int fd, unsigned long long *pEnergy)
+{
+   char buf[32];
+
+   ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+   if (len <= 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+
+   char *end;
+   *pEnergy = strtoull(buf, &end, 10);
+   if (end == buf)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the wrap-around value of an energy counter, 0 if unknown.
+ */
+static unsigned long long read_range(unsigned int domain)
+{
+   char path[512];
+   unsigned long long range = 0;
+
+   if (dvfs_sysfs_path(path, sizeof(path), RANGE_FILE_PATTERN, domain) != DVFS_SUCCESS)
+   {
+      return 0;
+   }
+
+   FILE *fd = fopen(path, "r");
+   if (fd == NULL)
+   {
+      return 0;
+   }
+   if (fscanf(fd, "%llu", &range) != 1)
+   {
+      range = 0;
+   }
+   fclose(fd);
+   return range;
+}
+
+/**
+ * Opens the energy counters of the package domains.
+ */
+static int open_domains(dvfs_powercap *cap)
+{
+   char path[512];
+   unsigned int i;
+
+   cap->fds = malloc(POWERCAP_MAX_DOMAINS * sizeof(*cap->fds));
+   cap->ranges = malloc(POWERCAP_MAX_DOMAINS * sizeof(*cap->ranges));
+   cap->energies = malloc(POWERCAP_MAX_DOMAINS * sizeof(*cap->energies));
+   if (cap->fds == NULL || cap->ranges == NULL || cap->energies == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   // the package domains are numbered from 0, the subdomains are not considered
+   for (i = 0; i < POWERCAP_MAX_DOMAINS; i++)
+   {
+      if (dvfs_sysfs_path(path, sizeof(path), ENERGY_FILE_PATTERN, i) != DVFS_SUCCESS)
+      {
+         break;
+      }
+
+      cap->fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+      if (cap->fds[i] < 0)
+      {
+         break;
+      }
+      cap->nb_domains++;
+
+      if (read_energy(cap->fds[i], &cap->energies[i]) != DVFS_SUCCESS)
+      {
+         return DVFS_ERROR_POWERCAP_UNAVAILABLE;
+      }
+      cap->ranges[i] = read_range(i);
+   }
+
+   if (cap->nb_domains == 0)
+   {
+      return DVFS_ERROR_POWERCAP_UNAVAILABLE;
+   }
+   cap->last_ns = dvfs_timer_now_ns();
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Finds the index of the frequency of a unit in its table, the highest
+ * frequency if unknown.
+ */
+static unsigned int get_level(const dvfs_unit *unit)
+{
+   const dvfs_core *core = unit->cores[0];
+   unsigned int freq = 0;
+   unsigned int i;
+
+   if (dvfs_unit_get_freq(unit, &freq) != DVFS_SUCCESS)
+   {
+      return core->nb_freqs - 1;
+   }
+
+   for (i = core->nb_freqs; i > 1 && core->freqs[i - 1] > freq; i--);
+   return i - 1;
+}
+
+int dvfs_powercap_open(dvfs_powercap **ppCap, dvfs_ctx *ctx, const dvfs_powercap_config *config)
+{
+   unsigned int range = 0;
+   unsigned int i;
+   int ret;
+
+   assert(ppCap != NULL);
+   assert(ctx != NULL);
+   assert(config != NULL);
+   if (ppCap == NULL || ctx == NULL || config == NULL || config->nb_periods == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_powercap *cap = calloc(1, sizeof(*cap));
+   if (cap == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   cap->ctx = ctx;
+   cap->config = *config;
+
+   dvfs_timer_cond_init(&cap->cond);
+   pthread_mutex_init(&cap->lock, NULL);
+
+   ret = open_domains(cap);
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_powercap_close(cap);
+      return ret;
+   }
+
+   cap->priorities = calloc(ctx->nb_units, sizeof(*cap->priorities));
+   cap->levels = malloc(ctx->nb_units * sizeof(*cap->levels));
+   cap->applied = malloc(ctx->nb_units * sizeof(*cap->applied));
+   if (cap->priorities == NULL || cap->levels == NULL || cap->applied == NULL)
+   {
+      dvfs_powercap_close(cap);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   ret = dvfs_set_gov(ctx, "userspace");
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_powercap_close(cap);
+      return ret;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      cap->levels[i] = get_level(ctx->units[i]);
+      cap->applied[i] = cap->levels[i];
+      range += ctx->units[i]->cores[0]->nb_freqs - 1;
+   }
+   cap->max_move = (range + config->nb_periods - 1) / config->nb_periods;
+   if (cap->max_move == 0)
+   {
+      cap->max_move = 1;
+   }
+
+   *ppCap = cap;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_powercap_close(dvfs_powercap *cap)
+{
+   unsigned int i;
+
+   assert(cap != NULL);
+   if (cap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (cap->running)
+   {
+      dvfs_powercap_stop(cap);
+   }
+   pthread_mutex_destroy(&cap->lock);
+   pthread_cond_destroy(&cap->cond);
+
+   for (i = 0; i < cap->nb_domains; i++)
+   {
+      close(cap->fds[i]);
+   }
+   free(cap->fds);
+   free(cap->ranges);
+   free(cap->energies);
+   free(cap->priorities);
+   free(cap->levels);
+   free(cap->applied);
+   free(cap);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_powercap_set_target(dvfs_powercap *cap, unsigned int target_mw)
+{
+   assert(cap != NULL);
+   if (cap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&cap->lock);
+   cap->config.target_mw = target_mw;
+   pthread_mutex_unlock(&cap->lock);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_powercap_set_priority(dvfs_powercap *cap, const dvfs_unit *unit, unsigned int priority)
+{
+   assert(cap != NULL);
+   assert(unit != NULL);
+   if (cap == NULL || unit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (unit->id >= cap->ctx->nb_units || cap->ctx->units[unit->id] != unit)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   pthread_mutex_lock(&cap->lock);
+   cap->priorities[unit->id] = priority;
+   pthread_mutex_unlock(&cap->lock);
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Measures the power since the last read.
+ */
+static int measure(dvfs_powercap *cap, unsigned int elapsed_us, unsigned int *pPower_mw)
+{
+   unsigned long long total = 0;
+   unsigned long long energy;
+   unsigned int i;
+
+   for (i = 0; i < cap->nb_domains; i++)
+   {
+      if (read_energy(cap->fds[i], &energy) != DVFS_SUCCESS)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+
+      // the counters wrap around
+      if (energy >= cap->energies[i])
+      {
+         total += energy - cap->energies[i];
+      }
+      else if (cap->ranges[i] > cap->energies[i])
+      {
+         total += cap->ranges[i] - cap->energies[i] + energy;
+      }
+      cap->energies[i] = energy;
+   }
+
+   unsigned long long now = dvfs_timer_now_ns();
+   unsigned long long dt = elapsed_us != 0 ? elapsed_us : (now - cap->last_ns) / 1000;
+   cap->last_ns = now;
+   if (dt == 0)
+   {
+      dt = 1;
+   }
+
+   // uJ per us are W
+   *pPower_mw = total * 1000 / dt;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Picks the unit to move by one step, -1 if none can move.
+ */
+static int pick_unit(const dvfs_powercap *cap, bool up)
+{
+   int best = -1;
+   unsigned int i;
+
+   for (i = 0; i < cap->ctx->nb_units; i++)
+   {
+      unsigned int top = cap->ctx->units[i]->cores[0]->nb_freqs - 1;
+
+      if ((up && cap->levels[i] == top) || (!up && cap->levels[i] == 0))
+      {
+         continue;
+      }
+      if (best < 0)
+      {
+         best = i;
+         continue;
+      }
+
+      // raise the highest priority first, lower the lowest priority first,
+      // then keep the units of the same priority together
+      if (cap->priorities[i] != cap->priorities[best])
+      {
+         if ((cap->priorities[i] > cap->priorities[best]) == up)
+         {
+            best = i;
+         }
+      }
+      else if (up ? cap->levels[i] < cap->levels[best] : cap->levels[i] > cap->levels[best])
+      {
+         best = i;
+      }
+   }
+
+   return best;
+}
+
+int dvfs_powercap_step(dvfs_powercap *cap, unsigned int elapsed_us, unsigned int *pPower_mw)
+{
+   unsigned int power;
+   unsigned int level_sum = 0;
+   unsigned int i;
+   int move = 0;
+   int ret;
+
+   assert(cap != NULL);
+   if (cap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&cap->lock);
+
+   ret = measure(cap, elapsed_us, &power);
+   if (ret != DVFS_SUCCESS)
+   {
+      pthread_mutex_unlock(&cap->lock);
+      return ret;
+   }
+   if (pPower_mw != NULL)
+   {
+      *pPower_mw = power;
+   }
+
+   for (i = 0; i < cap->ctx->nb_units; i++)
+   {
+      level_sum += cap->applied[i];
+   }
+
+   // the cost of a step is learnt from the response to the last move
+   if (cap->prev_power_mw != 0 && level_sum != cap->prev_level_sum)
+   {
+      double cost = ((double) power - cap->prev_power_mw) / ((double) level_sum - cap->prev_level_sum);
+      if (cost > 0)
+      {
+         cap->stats.mw_per_step = cap->stats.mw_per_step == 0 ? cost : (cap->stats.mw_per_step + cost) / 2;
+      }
+   }
+   if (cap->stats.mw_per_step == 0)
+   {
+      // first guess: the power is proportional to the frequency steps
+      cap->stats.mw_per_step = (double) (power != 0 ? power : 1) / (level_sum + cap->ctx->nb_units);
+   }
+   cap->prev_power_mw = power;
+   cap->prev_level_sum = level_sum;
+
+   if (power > cap->config.target_mw)
+   {
+      double steps = (power - cap->config.target_mw) / cap->stats.mw_per_step;
+      move = -(int) (steps + 0.999);
+   }
+   else if (cap->config.target_mw - power > cap->config.tolerance_mw)
+   {
+      move = (cap->config.target_mw - power) / cap->stats.mw_per_step;
+   }
+   if (move > (int) cap->max_move)
+   {
+      move = cap->max_move;
+   }
+   if (move < -(int) cap->max_move)
+   {
+      move = -cap->max_move;
+   }
+
+   // the changes are collected before writing, a unit may move several steps
+   for (; move != 0; move += move > 0 ? -1 : 1)
+   {
+      int unit = pick_unit(cap, move > 0);
+      if (unit < 0)
+      {
+         break;
+      }
+      cap->levels[unit] += move > 0 ? 1 : -1;
+   }
+
+   for (i = 0; i < cap->ctx->nb_units; i++)
+   {
+      if (cap->applied[i] == cap->levels[i])
+      {
+         continue;
+      }
+
+      // a failed change is retried at the next step
+      const dvfs_unit *unit = cap->ctx->units[i];
+      int result = dvfs_unit_set_freq(unit, unit->cores[0]->freqs[cap->levels[i]]);
+      if (result != DVFS_SUCCESS)
+      {
+         ret = ret == DVFS_SUCCESS ? result : ret;
+         continue;
+      }
+      cap->applied[i] = cap->levels[i];
+      cap->stats.nb_changes++;
+   }
+
+   cap->stats.nb_steps++;
+   cap->stats.power_mw = power;
+   pthread_mutex_unlock(&cap->lock);
+   return ret;
+}
+
+static int control(void *arg)
+{
+   return dvfs_powercap_step(arg, 0, NULL);
+}
+
+static void *control_main(void *arg)
+{
+   dvfs_powercap *cap = arg;
+
+   dvfs_timer_loop(&cap->cond, &cap->lock, &cap->stop, cap->config.period_ms * 1000000ULL, control, cap);
+   return NULL;
+}
+
+int dvfs_powercap_start(dvfs_powercap *cap)
+{
+   assert(cap != NULL);
+   if (cap == NULL || cap->running || cap->config.period_ms == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   cap->stop = false;
+   if (pthread_create(&cap->thread, NULL, control_main, cap) != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   cap->running = true;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_powercap_stop(dvfs_powercap *cap)
+{
+   assert(cap != NULL);
+   if (cap == NULL || !cap->running)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&cap->lock);
+   cap->stop = true;
+   pthread_cond_signal(&cap->cond);
+   pthread_mutex_unlock(&cap->lock);
+
+   pthread_join(cap->thread, NULL);
+   cap->running = false;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_powercap_get_stats(dvfs_powercap *cap, dvfs_powercap_stats *pStats)
+{
+   assert(cap != NULL);
+   assert(pStats != NULL);
+   if (cap == NULL || pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&cap->lock);
+   *pStats = cap->stats;
+   pthread_mutex_unlock(&cap->lock);
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_powercap.h
+ *
+ * Power capping controller picking the frequency of every DVFS unit so the
+ * package power stays under a target. Unlike the firmware power limit, which
+ * throttles all the cores alike, the controller lowers the units of lowest
+ * priority first: give a low priority to the units running memory-bound work,
+ * which lose little performance at a lower frequency.
+ *
+ * The power is read from the energy counters of the package domains of the
+ * powercap sysfs interface (\c class/powercap/intel-rapl:N/energy_uj). Every
+ * control period (dvfs_powercap_step()), the controller measures the power
+ * over the period, estimates how much power a frequency step of a unit costs
+ * from the last changes, and moves the units by as many steps as needed. A
+ * move is limited so that crossing the whole frequency range takes
+ * \c nb_periods periods.
+ */
+
+/**
+ * Configuration of the controller.
+ */
+typedef struct {
+   unsigned int target_mw;       //!< Power target of all the packages (mW)
+   unsigned int tolerance_mw;    //!< Frequencies are only raised when the power is more than this below the target (mW)
+   unsigned int period_ms;       //!< Control period of the thread started by dvfs_powercap_start() (ms)
+   unsigned int nb_periods;      //!< Number of periods to cross the whole frequency range, at least 1
+} dvfs_powercap_config;
+
+/**
+ * Counters of the controller.
+ */
+typedef struct {
+   unsigned long long nb_steps;     //!< Control periods run
+   unsigned long long nb_changes;   //!< Frequency changes of the units
+   unsigned int power_mw;           //!< Power measured over the last period (mW)
+   double mw_per_step;              //!< Current estimate of the power of one frequency step of one unit (mW)
+} dvfs_powercap_stats;
+
+/**
+ * Power capping controller.
+ */
+typedef struct {
+   dvfs_ctx *ctx;                   //!< Context of the units
+   dvfs_powercap_config config;     //!< Configuration
+
+   unsigned int nb_domains;         //!< Number of package domains
+   int *fds;                        //!< Descriptors toward the \c energy_uj files
+   unsigned long long *ranges;      //!< Wrap-around values of the energy counters (uJ)
+   unsigned long long *energies;    //!< Last energy read per domain (uJ)
+   unsigned long long last_ns;      //!< Date of the last read (CLOCK_MONOTONIC)
+
+   unsigned int *priorities;        //!< Priority per unit, the lowest ones are lowered first
+   unsigned int *levels;            //!< Index of the frequency chosen for each unit in its table
+   unsigned int *applied;           //!< Index of the frequency last set on each unit
+   unsigned int max_move;           //!< Highest number of steps moved per period
+
+   unsigned int prev_power_mw;      //!< Power of the previous period, 0 if none
+   unsigned int prev_level_sum;     //!< Sum of the levels during the previous period
+
+   pthread_mutex_t lock;            //!< Serializes the steps and the priority changes
+   pthread_cond_t cond;             //!< Wakes up the control thread to stop it
+   pthread_t thread;                //!< Control thread
+   bool running;                    //!< True if the control thread runs
+   bool stop;                       //!< Tells the control thread to exit
+
+   dvfs_powercap_stats stats;       //!< Counters
+} dvfs_powercap;
+
+/**
+ * Creates a controller. The units keep their current frequency until the
+ * first step, their governor is set to "userspace". All the units get the
+ * priority 0.
+ *
+ * @param ppCap Will be filled with the controller.
+ * @param ctx The context.
+ * @param config The configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppCap, \c ctx or \c config are NULL, or if \c nb_periods is 0.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_POWERCAP_UNAVAILABLE if no package domain can be read.
+ *
+ * @sa dvfs_powercap_close()
+ */
+int dvfs_powercap_open(dvfs_powercap **ppCap, dvfs_ctx *ctx, const dvfs_powercap_config *config);
+
+/**
+ * Stops the control thread if needed and frees the controller. The units keep
+ * their last frequency.
+ *
+ * @param cap The controller.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap is NULL.
+ */
+int dvfs_powercap_close(dvfs_powercap *cap);
+
+/**
+ * Changes the power target.
+ *
+ * @param cap The controller.
+ * @param target_mw The new target (mW).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap is NULL.
+ */
+int dvfs_powercap_set_target(dvfs_powercap *cap, unsigned int target_mw);
+
+/**
+ * Sets the priority of a unit. Under the target, the units of highest priority
+ * are raised first. Over the target, the units of lowest priority are lowered
+ * first. Units of the same priority are kept at close frequencies.
+ *
+ * @param cap The controller.
+ * @param unit The unit.
+ * @param priority The priority.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap or \c unit are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the context.
+ */
+int dvfs_powercap_set_priority(dvfs_powercap *cap, const dvfs_unit *unit, unsigned int priority);
+
+/**
+ * Runs one control period: measures the power since the previous step (or the
+ * opening) and moves the frequencies of the units toward the target.
+ *
+ * @param cap The controller.
+ * @param elapsed_us The duration of the period (us), 0 to measure it.
+ * @param pPower_mw Will be filled with the measured power (mW). Can be NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the energy cannot be read.
+ *         Otherwise, the error met while setting a frequency.
+ */
+int dvfs_powercap_step(dvfs_powercap *cap, unsigned int elapsed_us, unsigned int *pPower_mw);
+
+/**
+ * Starts a thread calling dvfs_powercap_step() every \c period_ms.
+ *
+ * @param cap The controller.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap is NULL, if the thread already runs or if \c period_ms is 0.
+ *         \retval DVFS_ERROR_FILE_ERROR if the thread cannot be created.
+ */
+int dvfs_powercap_start(dvfs_powercap *cap);
+
+/**
+ * Stops the control thread.
+ *
+ * @param cap The controller.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap is NULL or if the thread does not run.
+ */
+int dvfs_powercap_stop(dvfs_powercap *cap);
+
+/**
+ * Gets the counters of the controller.
+ *
+ * @param cap The controller.
+ * @param pStats Will be filled with the counters.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c cap or \c pStats are NULL.
+ */
+int dvfs_powercap_get_stats(dvfs_powercap *cap, dvfs_powercap_stats *pStats);
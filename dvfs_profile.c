@@ -0,0 +1,787 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_msr.h"
+#include "dvfs_profile.h"
+#include "dvfs_snapshot.h"
+#include "dvfs_sysfs.h"
+
+#define PLATFORM_INFO_MAX_RATIO(val) (((val) >> 8) & 0xFF)
+
+// Cache sizes assumed when sysfs does not describe them (bytes)
+#define DEFAULT_L1_SIZE (32 * 1024)
+#define DEFAULT_L2_SIZE (1024 * 1024)
+#define DEFAULT_L3_SIZE (8 * 1024 * 1024)
+
+// Smallest working set of the DRAM stream (bytes)
+#define MIN_DRAM_SIZE (64 * 1024 * 1024)
+
+// Iterations of the compute kernel per unit of work
+#define COMPUTE_BLOCK 4096
+
+static const char *kernel_names[DVFS_KERNEL_NB] = {
+   [DVFS_KERNEL_COMPUTE] = "compute",
+   [DVFS_KERNEL_L1] = "l1",
+   [DVFS_KERNEL_L2] = "l2",
+   [DVFS_KERNEL_L3] = "l3",
+   [DVFS_KERNEL_DRAM] = "dram",
+   [DVFS_KERNEL_USER] = "user",
+};
+
+typedef void (*user_kernel_fn)(unsigned long long n);
+
+/**
+ * Kernel being characterized: its working set or its entry point.
+ */
+typedef struct {
+   dvfs_kernel kernel;
+   uint64_t *buf;             //!< Working set of the streams
+   size_t len;                //!< Number of elements of \c buf
+   user_kernel_fn user;       //!< Entry point of the user kernel
+} kernel_ctx;
+
+/**
+ * Package energy and APERF/MPERF of the unit around the repetitions.
+ */
+typedef struct {
+   int energy_fd;             //!< RAPL energy counter of the package, -1 if not available
+   unsigned long long energy_range;   //!< Wrap-around value of the energy counter (uJ)
+   int msr_fd;                //!< MSR device of the first core, -1 if not available
+   unsigned int base_freq;    //!< Frequency MPERF counts at (kHz), 0 if unknown
+} meters;
+
+// Keeps the results of the kernels alive
+static volatile uint64_t sink;
+
+static double now_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_kernel(const kernel_ctx *k, unsigned long long n)
+{
+   unsigned long long i;
+   size_t j;
+
+   switch (k->kernel)
+   {
+      case DVFS_KERNEL_COMPUTE:
+      {
+         double x = 1.0;
+         for (i = 0; i < n * COMPUTE_BLOCK; i++)
+         {
+            x = x * 1.0000001 + 1e-9;
+         }
+         sink = (uint64_t) x;
+         break;
+      }
+      case DVFS_KERNEL_USER:
+         k->user(n);
+         break;
+      default:
+      {
+         // n passes over the working set, independent sums to stream at full bandwidth
+         uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+         for (i = 0; i < n; i++)
+         {
+            for (j = 0; j + 3 < k->len; j += 4)
+            {
+               s0 += k->buf[j];
+               s1 += k->buf[j + 1];
+               s2 += k->buf[j + 2];
+               s3 += k->buf[j + 3];
+            }
+         }
+         sink = s0 + s1 + s2 + s3;
+         break;
+      }
+   }
+}
+
+/**
+ * Reads the size of the data cache of a level for a core, 0 if not described.
+ */
+static size_t cache_size(unsigned int core_id, unsigned int level)
+{
+   char fname[1024];
+   char type[32], size[32];
+   unsigned int index, val;
+
+   for (index = 0; ; index++)
+   {
+      if (dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/cache/index%u/level", core_id, index) != DVFS_SUCCESS
+          || dvfs_sysfs_read_uint(fname, &val) != DVFS_SUCCESS)
+      {
+         return 0;
+      }
+      if (val != level)
+      {
+         continue;
+      }
+
+      FILE *f;
+      dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/cache/index%u/type", core_id, index);
+      f = fopen(fname, "r");
+      if (f == NULL || fscanf(f, "%31s", type) != 1)
+      {
+         if (f != NULL)
+         {
+            fclose(f);
+         }
+         continue;
+      }
+      fclose(f);
+      if (strcmp(type, "Instruction") == 0)
+      {
+         continue;
+      }
+
+      // "32K", "1024K", "32M"
+      dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/cache/index%u/size", core_id, index);
+      f = fopen(fname, "r");
+      if (f == NULL)
+      {
+         return 0;
+      }
+      if (fscanf(f, "%u%31s", &val, size) < 1)
+      {
+         fclose(f);
+         return 0;
+      }
+      fclose(f);
+      return (size_t) val * (size[0] == 'M' ? 1024 * 1024 : size[0] == 'K' ? 1024 : 1);
+   }
+}
+
+/**
+ * Prepares the working set or the entry point of a kernel.
+ */
+static int prepare_kernel(kernel_ctx *k, dvfs_kernel kernel, unsigned int core_id, void *user)
+{
+   size_t sizes[3] = { DEFAULT_L1_SIZE, DEFAULT_L2_SIZE, DEFAULT_L3_SIZE };
+   size_t bytes, j;
+   unsigned int i;
+
+   k->kernel = kernel;
+   k->buf = NULL;
+   k->len = 0;
+   k->user = NULL;
+
+   switch (kernel)
+   {
+      case DVFS_KERNEL_COMPUTE:
+         return DVFS_SUCCESS;
+      case DVFS_KERNEL_USER:
+         *(void **) &k->user = dlsym(user, DVFS_PROFILE_USER_SYMBOL);
+         return k->user != NULL ? DVFS_SUCCESS : DVFS_ERROR_FILE_ERROR;
+      default:
+         break;
+   }
+
+   for (i = 0; i < 3; i++)
+   {
+      size_t size = cache_size(core_id, i + 1);
+      if (size != 0)
+      {
+         sizes[i] = size;
+      }
+   }
+
+   // half of the cache, leaving room for the rest of the process
+   if (kernel == DVFS_KERNEL_DRAM)
+   {
+      bytes = 4 * sizes[2] > MIN_DRAM_SIZE ? 4 * sizes[2] : MIN_DRAM_SIZE;
+   }
+   else
+   {
+      bytes = sizes[kernel - DVFS_KERNEL_L1] / 2;
+   }
+
+   k->len = bytes / sizeof(*k->buf);
+   k->buf = malloc(k->len * sizeof(*k->buf));
+   if (k->buf == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   for (j = 0; j < k->len; j++)
+   {
+      k->buf[j] = j;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Opens the energy counter of the package of a core and its MSR device.
+ */
+static void open_meters(meters *m, const dvfs_ctx *ctx, unsigned int core_id)
+{
+   char fname[1024];
+   unsigned int package = 0;
+   uint64_t info;
+   FILE *f;
+
+   m->energy_fd = -1;
+   m->energy_range = 0;
+   m->msr_fd = -1;
+   m->base_freq = 0;
+
+   if (dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/topology/physical_package_id", core_id) == DVFS_SUCCESS)
+   {
+      dvfs_sysfs_read_uint(fname, &package);
+   }
+   if (dvfs_sysfs_path(fname, sizeof(fname), "/class/powercap/intel-rapl:%u/energy_uj", package) == DVFS_SUCCESS)
+   {
+      m->energy_fd = open(fname, O_RDONLY | O_CLOEXEC);
+   }
+   if (m->energy_fd != -1 && dvfs_sysfs_path(fname, sizeof(fname), "/class/powercap/intel-rapl:%u/max_energy_range_uj", package) == DVFS_SUCCESS)
+   {
+      f = fopen(fname, "r");
+      if (f != NULL)
+      {
+         if (fscanf(f, "%llu", &m->energy_range) != 1)
+         {
+            m->energy_range = 0;
+         }
+         fclose(f);
+      }
+   }
+
+   // MPERF counts at the highest non-turbo ratio
+   if (ctx->features.aperf_mperf && dvfs_msr_open(core_id, O_RDONLY, &m->msr_fd) == DVFS_SUCCESS)
+   {
+      if (dvfs_msr_read(m->msr_fd, DVFS_MSR_PLATFORM_INFO, &info) == DVFS_SUCCESS)
+      {
+         m->base_freq = PLATFORM_INFO_MAX_RATIO(info) * DVFS_MSR_BUS_CLOCK;
+      }
+      if (m->base_freq == 0)
+      {
+         close(m->msr_fd);
+         m->msr_fd = -1;
+      }
+   }
+   else
+   {
+      m->msr_fd = -1;
+   }
+}
+
+static void close_meters(meters *m)
+{
+   if (m->energy_fd != -1)
+   {
+      close(m->energy_fd);
+   }
+   if (m->msr_fd != -1)
+   {
+      close(m->msr_fd);
+   }
+}
+
+static int read_energy(const meters *m, unsigned long long *pEnergy)
+{
+   char buf[32];
+   ssize_t len;
+
+   if (m->energy_fd == -1)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   len = pread(m->energy_fd, buf, sizeof(buf) - 1, 0);
+   if (len <= 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+   *pEnergy = strtoull(buf, NULL, 10);
+   return DVFS_SUCCESS;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+/**
+ * Runs the repetitions of a kernel at the current frequency.
+ */
+static void measure(const kernel_ctx *k, unsigned long long n, const dvfs_profile_config *config, const meters *m, double *times, dvfs_profile_point *point)
+{
+   unsigned long long energy_start = 0, energy_end = 0;
+   uint64_t aperf_start = 0, mperf_start = 0, aperf_end = 0, mperf_end = 0;
+   bool energy, aperf;
+   unsigned int i;
+
+   for (i = 0; i < config->warmup; i++)
+   {
+      run_kernel(k, n);
+   }
+
+   energy = read_energy(m, &energy_start) == DVFS_SUCCESS;
+   aperf = m->msr_fd != -1
+           && dvfs_msr_read(m->msr_fd, DVFS_MSR_IA32_APERF, &aperf_start) == DVFS_SUCCESS
+           && dvfs_msr_read(m->msr_fd, DVFS_MSR_IA32_MPERF, &mperf_start) == DVFS_SUCCESS;
+
+   for (i = 0; i < config->repetitions; i++)
+   {
+      double start = now_s();
+      run_kernel(k, n);
+      times[i] = now_s() - start;
+   }
+
+   energy = energy && read_energy(m, &energy_end) == DVFS_SUCCESS;
+   aperf = aperf
+           && dvfs_msr_read(m->msr_fd, DVFS_MSR_IA32_APERF, &aperf_end) == DVFS_SUCCESS
+           && dvfs_msr_read(m->msr_fd, DVFS_MSR_IA32_MPERF, &mperf_end) == DVFS_SUCCESS;
+
+   qsort(times, config->repetitions, sizeof(*times), cmp_double);
+   point->time = times[config->repetitions / 2];
+
+   // the counter wraps around
+   point->energy = -1;
+   if (energy && energy_end >= energy_start)
+   {
+      point->energy = (energy_end - energy_start) * 1e-6 / config->repetitions;
+   }
+   else if (energy && m->energy_range > energy_start)
+   {
+      point->energy = (m->energy_range - energy_start + energy_end) * 1e-6 / config->repetitions;
+   }
+
+   point->eff_freq = 0;
+   if (aperf && mperf_end > mperf_start)
+   {
+      point->eff_freq = (double) m->base_freq * (aperf_end - aperf_start) / (mperf_end - mperf_start);
+   }
+}
+
+/**
+ * Finds the amount of work of a repetition lasting the requested duration at
+ * the current frequency.
+ */
+static unsigned long long calibrate(const kernel_ctx *k, unsigned int duration_us)
+{
+   unsigned long long n = 1;
+   double target = duration_us * 1e-6;
+   double elapsed;
+
+   run_kernel(k, n);
+   for (;;)
+   {
+      double start = now_s();
+      run_kernel(k, n);
+      elapsed = now_s() - start;
+      if (elapsed >= target / 2 || n >= (1ULL << 40))
+      {
+         break;
+      }
+      n *= 2;
+   }
+
+   if (elapsed > 0 && elapsed < target)
+   {
+      n = n * target / elapsed;
+   }
+   return n > 0 ? n : 1;
+}
+
+/**
+ * Runs a kernel at every frequency of the unit.
+ */
+static int sweep(const dvfs_unit *unit, const kernel_ctx *k, const dvfs_profile_config *config, const meters *m, dvfs_profile_curve *curve)
+{
+   const dvfs_core *core = unit->cores[0];
+   double *times;
+   unsigned long long n;
+   unsigned int i;
+   int ret;
+
+   dvfs_profile_point *points = calloc(core->nb_freqs, sizeof(*points));
+   times = malloc(config->repetitions * sizeof(*times));
+   if (points == NULL || times == NULL)
+   {
+      free(points);
+      free(times);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   // the amount of work is the same at every frequency
+   ret = dvfs_unit_set_freq(unit, core->freqs[core->nb_freqs - 1]);
+   if (ret != DVFS_SUCCESS)
+   {
+      free(points);
+      free(times);
+      return ret;
+   }
+   n = calibrate(k, config->duration_us);
+
+   for (i = 0; i < core->nb_freqs; i++)
+   {
+      ret = dvfs_unit_set_freq(unit, core->freqs[i]);
+      if (ret != DVFS_SUCCESS)
+      {
+         free(points);
+         free(times);
+         return ret;
+      }
+      points[i].freq = core->freqs[i];
+      measure(k, n, config, m, times, &points[i]);
+   }
+
+   free(times);
+   free(curve->points);
+   curve->points = points;
+   curve->nb_points = core->nb_freqs;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_profile_create(dvfs_profile **ppProfile, unsigned int nb_units)
+{
+   char line[256];
+   FILE *f;
+
+   assert(ppProfile != NULL);
+   if (ppProfile == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_profile *profile = calloc(1, sizeof(*profile));
+   if (profile == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   profile->nb_units = nb_units;
+   profile->curves = calloc((size_t) nb_units * DVFS_KERNEL_NB, sizeof(*profile->curves));
+   if (profile->curves == NULL && nb_units != 0)
+   {
+      free(profile);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   snprintf(profile->machine, sizeof(profile->machine), "unknown");
+   f = fopen("/proc/cpuinfo", "r");
+   if (f != NULL)
+   {
+      while (fgets(line, sizeof(line), f) != NULL)
+      {
+         char *value = strchr(line, ':');
+         if (strncmp(line, "model name", 10) == 0 && value != NULL)
+         {
+            value += strspn(value + 1, " ") + 1;
+            value[strcspn(value, "\n")] = '\0';
+            snprintf(profile->machine, sizeof(profile->machine), "%s", value);
+            break;
+         }
+      }
+      fclose(f);
+   }
+
+   *ppProfile = profile;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_profile_free(dvfs_profile *profile)
+{
+   unsigned int i;
+
+   assert(profile != NULL);
+   if (profile == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < profile->nb_units * DVFS_KERNEL_NB; i++)
+   {
+      free(profile->curves[i].points);
+   }
+   free(profile->curves);
+   free(profile);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_profile_characterize(dvfs_ctx *ctx, const dvfs_unit *unit, const dvfs_profile_config *config, dvfs_profile *profile)
+{
+   cpu_set_t old_set, set;
+   bool pinned;
+   dvfs_snapshot *snap = NULL;
+   void *user = NULL;
+   kernel_ctx k;
+   meters m;
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   assert(unit != NULL);
+   assert(config != NULL);
+   assert(profile != NULL);
+   if (ctx == NULL || unit == NULL || config == NULL || profile == NULL || config->repetitions == 0
+       || ((config->kernels & (1U << DVFS_KERNEL_USER)) && config->user_kernel == NULL))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+   if (unit->id >= profile->nb_units)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   if (config->kernels & (1U << DVFS_KERNEL_USER))
+   {
+      user = dlopen(config->user_kernel, RTLD_NOW | RTLD_LOCAL);
+      if (user == NULL)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+
+   // the governor, the requested frequency and the limits are put back at the
+   // end, and the sweep is meaningless if the frequencies cannot be chosen
+   ret = dvfs_snapshot_take(ctx, &snap);
+   if (ret == DVFS_SUCCESS)
+   {
+      ret = dvfs_unit_set_gov(unit, "userspace");
+   }
+   if (ret != DVFS_SUCCESS)
+   {
+      if (snap != NULL)
+      {
+         dvfs_snapshot_restore(ctx, snap, NULL);
+         dvfs_snapshot_free(snap);
+      }
+      if (user != NULL)
+      {
+         dlclose(user);
+      }
+      return ret;
+   }
+
+   // the kernels run on the unit, unless the core is not available to the process
+   CPU_ZERO(&set);
+   CPU_SET(unit->cores[0]->id, &set);
+   pinned = pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set) == 0
+            && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+
+   open_meters(&m, ctx, unit->cores[0]->id);
+
+   for (i = 0; i < DVFS_KERNEL_NB && ret == DVFS_SUCCESS; i++)
+   {
+      if ((config->kernels & (1U << i)) == 0)
+      {
+         continue;
+      }
+
+      ret = prepare_kernel(&k, i, unit->cores[0]->id, user);
+      if (ret == DVFS_SUCCESS)
+      {
+         ret = sweep(unit, &k, config, &m, &profile->curves[unit->id * DVFS_KERNEL_NB + i]);
+      }
+      free(k.buf);
+   }
+
+   close_meters(&m);
+   dvfs_snapshot_restore(ctx, snap, NULL);
+   dvfs_snapshot_free(snap);
+   if (pinned)
+   {
+      pthread_setaffinity_np(pthread_self(), sizeof(old_set), &old_set);
+   }
+   if (user != NULL)
+   {
+      dlclose(user);
+   }
+   return ret;
+}
+
+int dvfs_profile_get_curve(const dvfs_profile *profile, unsigned int unit_id, dvfs_kernel kernel, const dvfs_profile_curve **ppCurve)
+{
+   assert(profile != NULL);
+   assert(ppCurve != NULL);
+   if (profile == NULL || ppCurve == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (unit_id >= profile->nb_units || kernel >= DVFS_KERNEL_NB)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   *ppCurve = &profile->curves[unit_id * DVFS_KERNEL_NB + kernel];
+   return DVFS_SUCCESS;
+}
+
+const char *dvfs_profile_kernel_name(dvfs_kernel kernel)
+{
+   return kernel < DVFS_KERNEL_NB ? kernel_names[kernel] : NULL;
+}
+
+static const char *profile_path(const char *path)
+{
+   if (path == NULL)
+   {
+      path = getenv(DVFS_PROFILE_PATH_ENV);
+      if (path == NULL || path[0] == '\0')
+      {
+         path = DVFS_PROFILE_DEFAULT_PATH;
+      }
+   }
+   return path;
+}
+
+int dvfs_profile_save(const dvfs_profile *profile, const char *path)
+{
+   unsigned int u, k, i;
+
+   assert(profile != NULL);
+   if (profile == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   FILE *f = fopen(profile_path(path), "w");
+   if (f == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   // a curve per unit and kernel run, then a line per frequency: freq time energy eff_freq
+   fprintf(f, "dvfs_profile 1\nmachine %s\nunits %u\n", profile->machine, profile->nb_units);
+   for (u = 0; u < profile->nb_units; u++)
+   {
+      for (k = 0; k < DVFS_KERNEL_NB; k++)
+      {
+         const dvfs_profile_curve *curve = &profile->curves[u * DVFS_KERNEL_NB + k];
+         if (curve->nb_points == 0)
+         {
+            continue;
+         }
+
+         fprintf(f, "curve %u %s %u\n", u, kernel_names[k], curve->nb_points);
+         for (i = 0; i < curve->nb_points; i++)
+         {
+            fprintf(f, "%u %.9g %.9g %u\n", curve->points[i].freq, curve->points[i].time, curve->points[i].energy, curve->points[i].eff_freq);
+         }
+      }
+   }
+
+   if (fclose(f) != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the curves of a profile file.
+ */
+static int load_curves(FILE *f, dvfs_profile *profile)
+{
+   char name[32];
+   unsigned int u, k, i, nb;
+
+   while (fscanf(f, " curve %u %31s %u", &u, name, &nb) == 3)
+   {
+      for (k = 0; k < DVFS_KERNEL_NB && strcmp(name, kernel_names[k]) != 0; k++);
+      if (u >= profile->nb_units || k == DVFS_KERNEL_NB || nb == 0)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+
+      dvfs_profile_curve *curve = &profile->curves[u * DVFS_KERNEL_NB + k];
+      free(curve->points);
+      curve->nb_points = 0;
+      curve->points = malloc(nb * sizeof(*curve->points));
+      if (curve->points == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+
+      for (i = 0; i < nb; i++)
+      {
+         dvfs_profile_point *point = &curve->points[i];
+         if (fscanf(f, "%u %lf %lf %u", &point->freq, &point->time, &point->energy, &point->eff_freq) != 4)
+         {
+            return DVFS_ERROR_FILE_ERROR;
+         }
+      }
+      curve->nb_points = nb;
+   }
+
+   return feof(f) ? DVFS_SUCCESS : DVFS_ERROR_FILE_ERROR;
+}
+
+int dvfs_profile_load(dvfs_profile **ppProfile, const char *path)
+{
+   char machine[sizeof(((dvfs_profile *) NULL)->machine)];
+   unsigned int version, nb_units;
+   int ret;
+
+   assert(ppProfile != NULL);
+   if (ppProfile == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   FILE *f = fopen(profile_path(path), "r");
+   if (f == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   if (fscanf(f, "dvfs_profile %u machine ", &version) != 1 || version != 1
+       || fgets(machine, sizeof(machine), f) == NULL
+       || fscanf(f, "units %u", &nb_units) != 1)
+   {
+      fclose(f);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   ret = dvfs_profile_create(ppProfile, nb_units);
+   if (ret != DVFS_SUCCESS)
+   {
+      fclose(f);
+      return ret;
+   }
+   machine[strcspn(machine, "\n")] = '\0';
+   snprintf((*ppProfile)->machine, sizeof((*ppProfile)->machine), "%s", machine);
+
+   ret = load_curves(f, *ppProfile);
+   fclose(f);
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_profile_free(*ppProfile);
+      *ppProfile = NULL;
+   }
+   return ret;
+}
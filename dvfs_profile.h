@@ -0,0 +1,203 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_profile.h
+ *
+ * Frequency sensitivity profile of the machine: how the runtime and the
+ * energy of typical kernels scale with the frequency of every unit. The
+ * profile is measured once per machine (dvfs_profile_characterize() or the
+ * \c dvfs_characterize tool), saved to a file and loaded by the code choosing
+ * the frequencies.
+ *
+ * The built-in kernels are a compute-bound dependency chain and read streams
+ * over working sets sized from the caches of the unit (L1, L2, L3 and DRAM).
+ * A kernel from a shared object can be added: it exports
+ * <tt>void dvfs_kernel_run(unsigned long long n)</tt>, running \c n units of
+ * work. Every kernel is calibrated at the highest frequency so a repetition
+ * lasts about the requested duration, then run at every frequency of the unit
+ * with warm-up and measured repetitions.
+ *
+ * For each frequency, the profile holds the median time of a repetition, the
+ * energy of the package of the unit when the RAPL counters of the powercap
+ * sysfs interface are present, and the effective frequency measured with
+ * APERF/MPERF when the MSR devices can be read.
+ */
+
+/** Environment variable overriding the path of the profile */
+#define DVFS_PROFILE_PATH_ENV "LIBDVFS_PROFILE_PATH"
+
+/** Default path of the profile */
+#define DVFS_PROFILE_DEFAULT_PATH "/var/lib/libdvfs/profile"
+
+/** Symbol of the kernels given as shared objects */
+#define DVFS_PROFILE_USER_SYMBOL "dvfs_kernel_run"
+
+/**
+ * Kernels of the profile.
+ */
+typedef enum {
+   DVFS_KERNEL_COMPUTE = 0,   //!< Dependency chain of floating point operations
+   DVFS_KERNEL_L1,            //!< Read stream fitting in the L1 cache
+   DVFS_KERNEL_L2,            //!< Read stream fitting in the L2 cache
+   DVFS_KERNEL_L3,            //!< Read stream fitting in the L3 cache
+   DVFS_KERNEL_DRAM,          //!< Read stream larger than the L3 cache
+   DVFS_KERNEL_USER,          //!< Kernel of a shared object
+   DVFS_KERNEL_NB             //!< Number of kernels
+} dvfs_kernel;
+
+/**
+ * Measures of a kernel at a frequency.
+ */
+typedef struct {
+   unsigned int freq;         //!< Frequency requested (kHz)
+   double time;               //!< Median time of a repetition (s)
+   double energy;             //!< Energy of the package per repetition (J), -1 if not measured
+   unsigned int eff_freq;     //!< Effective frequency (kHz), 0 if not measured
+} dvfs_profile_point;
+
+/**
+ * Measures of a kernel on a unit, by increasing frequency.
+ */
+typedef struct {
+   unsigned int nb_points;       //!< Number of frequencies measured, 0 if the kernel was not run
+   dvfs_profile_point *points;   //!< Measures per frequency
+} dvfs_profile_curve;
+
+/**
+ * Sensitivity profile of the units of a machine.
+ */
+typedef struct {
+   char machine[128];            //!< Processor model the profile was measured on
+   unsigned int nb_units;        //!< Number of units
+   dvfs_profile_curve *curves;   //!< Curves, the one of kernel k on unit u at u * DVFS_KERNEL_NB + k
+} dvfs_profile;
+
+/**
+ * Configuration of a characterization.
+ */
+typedef struct {
+   uint32_t kernels;             //!< Kernels to run, bit k for the kernel k
+   unsigned int warmup;          //!< Repetitions run before measuring
+   unsigned int repetitions;     //!< Repetitions measured, at least 1
+   unsigned int duration_us;     //!< Duration of a repetition at the highest frequency (us)
+   const char *user_kernel;      //!< Shared object of the DVFS_KERNEL_USER kernel, NULL for none
+} dvfs_profile_config;
+
+/**
+ * Creates an empty profile for a number of units. The machine is
+ * identified by the model name of \c /proc/cpuinfo.
+ *
+ * @param ppProfile Will be filled with the profile.
+ * @param nb_units The number of units.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppProfile is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_profile_free()
+ */
+int dvfs_profile_create(dvfs_profile **ppProfile, unsigned int nb_units);
+
+/**
+ * Frees a profile.
+ *
+ * @param profile The profile.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c profile is NULL.
+ */
+int dvfs_profile_free(dvfs_profile *profile);
+
+/**
+ * Runs the kernels at every frequency of a unit and stores the curves in the
+ * profile. The calling thread is pinned to the first core of the unit during
+ * the sweep and the governor of the unit is set to "userspace". The state of
+ * the context (governors, requested frequencies, limits) is captured with
+ * dvfs_snapshot_take() before and restored at the end. Nothing is measured
+ * when the state cannot be captured or the governor cannot be set. The
+ * machine should be otherwise idle.
+ *
+ * @param ctx The context.
+ * @param unit The unit.
+ * @param config The configuration.
+ * @param profile The profile to fill, created for the units of the context.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if an argument is NULL, if no repetition is measured or if the user kernel is requested without shared object.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit is not in the profile.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the user kernel cannot be loaded.
+ *         Otherwise, the error of dvfs_snapshot_take() or the error met while setting the governor or a frequency.
+ */
+int dvfs_profile_characterize(dvfs_ctx *ctx, const dvfs_unit *unit, const dvfs_profile_config *config, dvfs_profile *profile);
+
+/**
+ * Gets the curve of a kernel on a unit.
+ *
+ * @param profile The profile.
+ * @param unit_id The unit id.
+ * @param kernel The kernel.
+ * @param ppCurve Will be filled with the curve, empty if the kernel was not run.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c profile or \c ppCurve are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if the unit or the kernel is not in the profile.
+ */
+int dvfs_profile_get_curve(const dvfs_profile *profile, unsigned int unit_id, dvfs_kernel kernel, const dvfs_profile_curve **ppCurve);
+
+/**
+ * Gets the name of a kernel, as written in the profile files.
+ *
+ * @param kernel The kernel.
+ *
+ * @return The name, NULL for an unknown kernel.
+ */
+const char *dvfs_profile_kernel_name(dvfs_kernel kernel);
+
+/**
+ * Saves a profile.
+ *
+ * @param profile The profile.
+ * @param path The file, NULL for the default one (\c LIBDVFS_PROFILE_PATH or \c /var/lib/libdvfs/profile).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c profile is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be written.
+ */
+int dvfs_profile_save(const dvfs_profile *profile, const char *path);
+
+/**
+ * Loads a profile.
+ *
+ * @param ppProfile Will be filled with the profile.
+ * @param path The file, NULL for the default one (\c LIBDVFS_PROFILE_PATH or \c /var/lib/libdvfs/profile).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppProfile is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be read or is malformed.
+ *
+ * @sa dvfs_profile_free()
+ */
+int dvfs_profile_load(dvfs_profile **ppProfile, const char *path);
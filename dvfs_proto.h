@@ -0,0 +1,87 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @file dvfs_proto.h
+ *
+ * Internal protocol between the \c dvfsd daemon (dvfs_server.h) and its
+ * clients (dvfs_client.h). The Unix socket is only used to set up a client:
+ * the client sends a hello message, the daemon checks its credentials and
+ * answers with two descriptors, a shared memory ring (memfd) carrying the
+ * requests and their completions, and an eventfd the client writes to ring
+ * the daemon. The client waits for the completions with a futex on the ring.
+ */
+
+/** Environment variable overriding the path of the daemon socket */
+#define DVFS_SOCKET_PATH_ENV "LIBDVFS_SOCKET_PATH"
+
+/** Default path of the daemon socket */
+#define DVFS_SOCKET_DEFAULT_PATH "/run/dvfsd.sock"
+
+#define DVFS_PROTO_MAGIC 0x53465644     // "DVFS"
+#define DVFS_PROTO_VERSION 1
+
+/** Number of requests in the ring of a client */
+#define DVFS_PROTO_RING_SIZE 64
+
+/** Status of a request not completed yet */
+#define DVFS_PROTO_PENDING 1
+
+/**
+ * First message, from the client.
+ */
+typedef struct {
+   uint32_t magic;      //!< DVFS_PROTO_MAGIC
+   uint32_t version;    //!< DVFS_PROTO_VERSION
+} dvfs_proto_hello;
+
+/**
+ * Answer of the daemon, sent with the ring and eventfd descriptors on success.
+ */
+typedef struct {
+   int32_t status;      //!< DVFS_SUCCESS or the reason of the refusal
+   uint32_t nb_units;   //!< Number of DVFS units controlled by the daemon
+} dvfs_proto_welcome;
+
+/**
+ * A frequency request.
+ */
+typedef struct {
+   uint32_t unit;       //!< Index of the DVFS unit
+   uint32_t freq;       //!< Requested frequency
+   int32_t status;      //!< DVFS_PROTO_PENDING until completed
+   uint32_t pad;        //!< Unused
+} dvfs_proto_request;
+
+/**
+ * Ring shared by a client and the daemon. The counters only grow, the slot of
+ * a request is its counter modulo the size. Each counter has its own cache line.
+ */
+typedef struct {
+   uint32_t head;             //!< Requests submitted, written by the client
+   uint32_t pad0[15];
+   uint32_t tail;             //!< Requests read, written by the daemon
+   uint32_t pad1[15];
+   uint32_t done;             //!< Requests completed, written by the daemon (futex)
+   uint32_t pad2[15];
+   dvfs_proto_request slots[DVFS_PROTO_RING_SIZE];  //!< Requests
+} dvfs_proto_ring;
@@ -0,0 +1,238 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "dvfs_error.h"
+#include "dvfs_ratelimit.h"
+#include "dvfs_timer.h"
+
+/**
+ * Sets the frequency on the unit. Called with the lock held.
+ */
+static int apply(dvfs_ratelimit *limit, unsigned int freq)
+{
+   int ret = dvfs_unit_set_freq(limit->unit, freq);
+
+   if (ret == DVFS_SUCCESS)
+   {
+      limit->cur_freq = freq;
+      limit->last_ns = dvfs_timer_now_ns();
+      limit->stats.nb_writes++;
+   }
+   return ret;
+}
+
+static void *timer_main(void *arg)
+{
+   dvfs_ratelimit *limit = arg;
+
+   pthread_mutex_lock(&limit->lock);
+   while (!limit->stop)
+   {
+      if (limit->pending == 0)
+      {
+         pthread_cond_wait(&limit->cond, &limit->lock);
+         continue;
+      }
+
+      unsigned long long end = limit->last_ns + limit->config.min_dwell_us * 1000ULL;
+      if (dvfs_timer_now_ns() < end)
+      {
+         dvfs_timer_wait_until(&limit->cond, &limit->lock, end);
+         continue;
+      }
+
+      limit->stats.last_status = apply(limit, limit->pending);
+      limit->stats.nb_deferred++;
+      limit->pending = 0;
+   }
+   pthread_mutex_unlock(&limit->lock);
+
+   return NULL;
+}
+
+int dvfs_ratelimit_open(dvfs_ratelimit **ppLimit, const dvfs_unit *unit, const dvfs_ratelimit_config *config)
+{
+   assert(ppLimit != NULL);
+   assert(unit != NULL);
+   assert(config != NULL);
+   if (ppLimit == NULL || unit == NULL || config == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_ratelimit *limit = calloc(1, sizeof(*limit));
+   if (limit == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   limit->unit = unit;
+   limit->config = *config;
+   if (dvfs_unit_get_freq(unit, &limit->cur_freq) != DVFS_SUCCESS)
+   {
+      limit->cur_freq = 0;
+   }
+
+   dvfs_timer_cond_init(&limit->cond);
+   pthread_mutex_init(&limit->lock, NULL);
+
+   if (pthread_create(&limit->timer, NULL, timer_main, limit) != 0)
+   {
+      pthread_mutex_destroy(&limit->lock);
+      pthread_cond_destroy(&limit->cond);
+      free(limit);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *ppLimit = limit;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_ratelimit_close(dvfs_ratelimit *limit)
+{
+   int ret = DVFS_SUCCESS;
+
+   assert(limit != NULL);
+   if (limit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&limit->lock);
+   limit->stop = true;
+   pthread_cond_signal(&limit->cond);
+   pthread_mutex_unlock(&limit->lock);
+
+   pthread_join(limit->timer, NULL);
+
+   // the last request of the controller is not lost
+   if (limit->pending != 0)
+   {
+      ret = apply(limit, limit->pending);
+      limit->pending = 0;
+   }
+
+   pthread_mutex_destroy(&limit->lock);
+   pthread_cond_destroy(&limit->cond);
+   free(limit);
+   return ret;
+}
+
+/**
+ * Tells if a frequency is close enough to the current one to be ignored.
+ */
+static bool within_thresholds(const dvfs_ratelimit *limit, unsigned int freq)
+{
+   if (limit->cur_freq == 0)
+   {
+      return false;
+   }
+   if (freq >= limit->cur_freq)
+   {
+      return freq - limit->cur_freq < limit->config.up_threshold || freq == limit->cur_freq;
+   }
+   return limit->cur_freq - freq < limit->config.down_threshold;
+}
+
+int dvfs_ratelimit_set_freq(dvfs_ratelimit *limit, unsigned int freq)
+{
+   const dvfs_core *core;
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(limit != NULL);
+   if (limit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // a deferred request cannot report an unknown frequency
+   core = limit->unit->cores[0];
+   for (i = 0; i < core->nb_freqs && core->freqs[i] != freq; i++);
+   if (i == core->nb_freqs)
+   {
+      return DVFS_ERROR_INVALID_FREQ;
+   }
+
+   pthread_mutex_lock(&limit->lock);
+   limit->stats.nb_requests++;
+
+   // the last request replaces the pending one
+   if (limit->pending != 0)
+   {
+      limit->pending = 0;
+      limit->stats.nb_suppressed++;
+   }
+
+   if (within_thresholds(limit, freq))
+   {
+      limit->stats.nb_suppressed++;
+   }
+   else if (limit->last_ns == 0 || dvfs_timer_now_ns() >= limit->last_ns + limit->config.min_dwell_us * 1000ULL)
+   {
+      ret = apply(limit, freq);
+   }
+   else
+   {
+      limit->pending = freq;
+      pthread_cond_signal(&limit->cond);
+   }
+
+   pthread_mutex_unlock(&limit->lock);
+   return ret;
+}
+
+int dvfs_ratelimit_flush(dvfs_ratelimit *limit)
+{
+   int ret = DVFS_SUCCESS;
+
+   assert(limit != NULL);
+   if (limit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&limit->lock);
+   if (limit->pending != 0)
+   {
+      ret = apply(limit, limit->pending);
+      limit->pending = 0;
+   }
+   pthread_mutex_unlock(&limit->lock);
+
+   return ret;
+}
+
+int dvfs_ratelimit_get_stats(dvfs_ratelimit *limit, dvfs_ratelimit_stats *pStats)
+{
+   assert(limit != NULL);
+   assert(pStats != NULL);
+   if (limit == NULL || pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&limit->lock);
+   *pStats = limit->stats;
+   pthread_mutex_unlock(&limit->lock);
+
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_ratelimit.h
+ *
+ * Optional rate limiter in front of dvfs_unit_set_freq(), for controllers
+ * requesting changes faster than the hardware settles. Two consecutive
+ * transitions of the unit are separated by at least a minimum dwell time: a
+ * request arriving within the window is kept pending and applied by a timer
+ * thread when the window expires. Only the last pending request is applied,
+ * the previous ones are suppressed. Small moves around the current frequency
+ * are suppressed as well, with distinct thresholds upward and downward
+ * (hysteresis).
+ */
+
+/**
+ * Configuration of a rate limiter.
+ */
+typedef struct {
+   unsigned int min_dwell_us;    //!< Minimum time between two transitions (us)
+   unsigned int up_threshold;    //!< Increases smaller than this are suppressed (kHz)
+   unsigned int down_threshold;  //!< Decreases smaller than this are suppressed (kHz)
+} dvfs_ratelimit_config;
+
+/**
+ * Transition counters of a rate limiter.
+ */
+typedef struct {
+   unsigned long long nb_requests;     //!< Requests received
+   unsigned long long nb_writes;       //!< Transitions applied, immediately or when a dwell window expired
+   unsigned long long nb_deferred;     //!< Transitions applied by the timer thread
+   unsigned long long nb_suppressed;   //!< Requests never written (within the thresholds or replaced while pending)
+   int last_status;                    //!< Result of the last transition applied by the timer thread
+} dvfs_ratelimit_stats;
+
+/**
+ * Rate limiter of a DVFS unit and its timer thread.
+ */
+typedef struct {
+   const dvfs_unit *unit;           //!< The unit
+   dvfs_ratelimit_config config;    //!< Configuration
+
+   pthread_mutex_t lock;            //!< Protects the state below
+   pthread_cond_t cond;             //!< Wakes up the timer thread
+   pthread_t timer;                 //!< Timer thread applying the pending request
+   bool stop;                       //!< Tells the timer thread to exit
+
+   unsigned int cur_freq;           //!< Frequency set by the last transition, 0 if unknown
+   unsigned long long last_ns;      //!< Date of the last transition (CLOCK_MONOTONIC), 0 if none
+   unsigned int pending;            //!< Request waiting for the end of the dwell window, 0 if none
+
+   dvfs_ratelimit_stats stats;      //!< Counters
+} dvfs_ratelimit;
+
+/**
+ * Creates a rate limiter for a unit and starts its timer thread. The unit
+ * should then only be changed through the limiter.
+ *
+ * @param ppLimit Will be filled with the limiter.
+ * @param unit The unit.
+ * @param config The configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppLimit, \c unit or \c config are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the thread cannot be created.
+ *
+ * @sa dvfs_ratelimit_close()
+ */
+int dvfs_ratelimit_open(dvfs_ratelimit **ppLimit, const dvfs_unit *unit, const dvfs_ratelimit_config *config);
+
+/**
+ * Stops the timer thread, applies the pending request, ignoring the dwell
+ * window, and frees the limiter. The limiter is freed even when the pending
+ * request cannot be applied.
+ *
+ * @param limit The limiter.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c limit is NULL.
+ *         Otherwise, the error of dvfs_unit_set_freq() for the pending request.
+ */
+int dvfs_ratelimit_close(dvfs_ratelimit *limit);
+
+/**
+ * Requests a frequency for the unit. The frequency is set immediately when
+ * the dwell window of the last transition expired, later by the timer thread
+ * otherwise, or never when it is within the thresholds of the current
+ * frequency.
+ *
+ * @param limit The limiter.
+ * @param freq The frequency.
+ *
+ * @return \retval DVFS_SUCCESS if the frequency was set, deferred or suppressed.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c limit is NULL.
+ *         \retval DVFS_ERROR_INVALID_FREQ if the frequency is not available.
+ *         Otherwise, the error of dvfs_unit_set_freq() when set immediately.
+ */
+int dvfs_ratelimit_set_freq(dvfs_ratelimit *limit, unsigned int freq);
+
+/**
+ * Applies the pending request now, ignoring the dwell window.
+ *
+ * @param limit The limiter.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right or if nothing was pending.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c limit is NULL.
+ *         Otherwise, the error of dvfs_unit_set_freq().
+ */
+int dvfs_ratelimit_flush(dvfs_ratelimit *limit);
+
+/**
+ * Gets the transition counters of the limiter.
+ *
+ * @param limit The limiter.
+ * @param pStats Will be filled with the counters.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c limit or \c pStats are NULL.
+ */
+int dvfs_ratelimit_get_stats(dvfs_ratelimit *limit, dvfs_ratelimit_stats *pStats);
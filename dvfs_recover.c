@@ -0,0 +1,62 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Restores the cores left behind by the processes killed while controlling
+ * the frequencies (see dvfs_journal.h). Meant to be run by a job epilogue or a
+ * system service, as root.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libdvfs.h"
+
+int main(int argc, char **argv) {
+   const char *path = NULL;
+   dvfs_journal *journal = NULL;
+   unsigned int nb = 0;
+
+   if (argc > 1) {
+      if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help") || argc > 2) {
+         printf("Restores the cores whose controlling process died without releasing them\n\n");
+         printf("Usage: %s [journal]\n", argv[0]);
+         printf("The journal is %s unless given or set in the %s environment variable.\n", DVFS_JOURNAL_DEFAULT_PATH, DVFS_JOURNAL_PATH_ENV);
+         return argc > 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+      }
+      path = argv[1];
+   }
+
+   int result = dvfs_journal_open(&journal, path);
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to open the journal (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   result = dvfs_journal_recover(journal, &nb);
+   dvfs_journal_close(journal);
+
+   printf("%u core(s) restored\n", nb);
+   if (result != DVFS_SUCCESS) {
+      printf("Some cores could not be restored (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
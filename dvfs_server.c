@@ -0,0 +1,805 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_proto.h"
+#include "dvfs_server.h"
+
+// Maximum number of events handled per iteration of the loop
+#define SERVER_MAX_EVENTS 64
+
+// Number of pending connections on the socket
+#define SERVER_BACKLOG 64
+
+/**
+ * Source of an event in the loop.
+ */
+typedef enum {
+   EVENT_LISTEN,     //!< New connection on the socket
+   EVENT_STOP,       //!< dvfs_server_stop() was called
+   EVENT_SOCKET,     //!< Hello message or disconnection of a client
+   EVENT_DOORBELL,   //!< New requests in the ring of a client
+} server_event_type;
+
+struct server_client;
+
+/**
+ * Data registered in epoll.
+ */
+typedef struct {
+   server_event_type type;          //!< Source of the event
+   struct server_client *client;    //!< Client concerned (EVENT_SOCKET and EVENT_DOORBELL only)
+} server_event;
+
+/**
+ * A connected client.
+ */
+typedef struct server_client {
+   int sock;                  //!< Connection of the client
+   int doorbell;              //!< eventfd written by the client after submitting requests, -1 before the hello
+   dvfs_proto_ring *ring;     //!< Shared request ring, NULL before the hello
+   uid_t uid;                 //!< User of the client
+   pid_t pid;                 //!< Process of the client
+   unsigned int min_freq;     //!< Lowest frequency allowed by the policy of the user
+   unsigned int max_freq;     //!< Highest frequency allowed by the policy of the user
+   unsigned int *requests;    //!< Last accepted request per unit, 0 if none
+   uint32_t tail;             //!< Requests read from the ring
+   uint32_t done;             //!< Requests completed (the shared counters are not trusted)
+   bool closed;               //!< Disconnected, freed at the end of the iteration
+   server_event ev_sock;      //!< Event data of \c sock
+   server_event ev_doorbell;  //!< Event data of \c doorbell
+   struct server_client *next;   //!< Next connected client
+} server_client;
+
+/**
+ * Frequency range allowed to a user.
+ */
+typedef struct {
+   uid_t uid;
+   unsigned int min_freq;
+   unsigned int max_freq;
+} server_policy;
+
+struct dvfs_server {
+   dvfs_ctx *ctx;             //!< Context the requests are applied to
+   int listen_fd;             //!< Listening socket
+   int epoll_fd;              //!< Event loop
+   int stop_fd;               //!< eventfd written by dvfs_server_stop()
+   char path[sizeof(((struct sockaddr_un *) 0)->sun_path)];  //!< Path of the socket
+   server_event ev_listen;    //!< Event data of \c listen_fd
+   server_event ev_stop;      //!< Event data of \c stop_fd
+   server_client *clients;    //!< Connected clients
+   unsigned int nb_policies;  //!< Number of user policies
+   server_policy *policies;   //!< User policies
+   bool has_default;          //!< Whether the users without a policy are accepted
+   server_policy def_policy;  //!< Range of the users without a policy
+   unsigned int *applied;     //!< Frequency set per unit by the server, 0 if none
+   int *status;               //!< Result of the last change per unit, given to the requests
+   bool *dirty;               //!< Units with new requests in this iteration
+   dvfs_server_stats stats;   //!< Counters
+};
+
+#define SERVER_RECORD(server, counter) __atomic_fetch_add(&(server)->stats.counter, 1, __ATOMIC_RELAXED)
+
+static unsigned int unit_nb_freqs(const dvfs_unit *unit)
+{
+   return unit->cores[0]->nb_freqs;
+}
+
+static const unsigned int *unit_freqs(const dvfs_unit *unit)
+{
+   return unit->cores[0]->freqs;
+}
+
+int dvfs_server_open(dvfs_server **ppServer, dvfs_ctx *ctx, const char *path)
+{
+   struct sockaddr_un addr;
+   struct epoll_event ev;
+   int ret;
+
+   assert(ppServer != NULL);
+   assert(ctx != NULL);
+   if (ppServer == NULL || ctx == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (path == NULL)
+   {
+      path = getenv(DVFS_SOCKET_PATH_ENV);
+      if (path == NULL || path[0] == '\0')
+      {
+         path = DVFS_SOCKET_DEFAULT_PATH;
+      }
+   }
+
+   dvfs_server *server = calloc(1, sizeof(*server));
+   if (server == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   server->ctx = ctx;
+   server->listen_fd = -1;
+   server->epoll_fd = -1;
+   server->stop_fd = -1;
+   server->ev_listen.type = EVENT_LISTEN;
+   server->ev_stop.type = EVENT_STOP;
+
+   if (snprintf(server->path, sizeof(server->path), "%s", path) >= (int) sizeof(server->path))
+   {
+      free(server);
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   server->applied = calloc(ctx->nb_units, sizeof(*server->applied));
+   server->status = calloc(ctx->nb_units, sizeof(*server->status));
+   server->dirty = calloc(ctx->nb_units, sizeof(*server->dirty));
+   if (server->applied == NULL || server->status == NULL || server->dirty == NULL)
+   {
+      dvfs_server_close(server);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   ret = dvfs_set_gov(ctx, "userspace");
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_server_close(server);
+      return ret;
+   }
+
+   server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   server->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   server->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+   if (server->epoll_fd < 0 || server->stop_fd < 0 || server->listen_fd < 0)
+   {
+      dvfs_server_close(server);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   memcpy(addr.sun_path, server->path, strlen(server->path));
+   unlink(server->path);
+   if (bind(server->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+         || chmod(server->path, 0666) != 0
+         || listen(server->listen_fd, SERVER_BACKLOG) != 0)
+   {
+      dvfs_server_close(server);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   ev.events = EPOLLIN;
+   ev.data.ptr = &server->ev_listen;
+   ret = epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev);
+   ev.data.ptr = &server->ev_stop;
+   ret |= epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->stop_fd, &ev);
+   if (ret != 0)
+   {
+      dvfs_server_close(server);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *ppServer = server;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Releases a client. Its requests must already have been withdrawn.
+ */
+static void free_client(server_client *client)
+{
+   if (client->ring != NULL)
+   {
+      munmap(client->ring, sizeof(*client->ring));
+   }
+   if (client->doorbell >= 0)
+   {
+      close(client->doorbell);
+   }
+   close(client->sock);
+   free(client->requests);
+   free(client);
+}
+
+int dvfs_server_close(dvfs_server *server)
+{
+   assert(server != NULL);
+   if (server == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   while (server->clients != NULL)
+   {
+      server_client *next = server->clients->next;
+      free_client(server->clients);
+      server->clients = next;
+   }
+
+   if (server->listen_fd >= 0)
+   {
+      close(server->listen_fd);
+      unlink(server->path);
+   }
+   if (server->stop_fd >= 0)
+   {
+      close(server->stop_fd);
+   }
+   if (server->epoll_fd >= 0)
+   {
+      close(server->epoll_fd);
+   }
+
+   free(server->policies);
+   free(server->applied);
+   free(server->status);
+   free(server->dirty);
+   free(server);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_server_set_policy(dvfs_server *server, uid_t uid, unsigned int min_freq, unsigned int max_freq)
+{
+   unsigned int i;
+
+   assert(server != NULL);
+   if (server == NULL || min_freq > max_freq)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < server->nb_policies; i++)
+   {
+      if (server->policies[i].uid == uid)
+      {
+         break;
+      }
+   }
+
+   if (i == server->nb_policies)
+   {
+      server_policy *policies = realloc(server->policies, (i + 1) * sizeof(*policies));
+      if (policies == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      server->policies = policies;
+      server->nb_policies++;
+   }
+
+   server->policies[i].uid = uid;
+   server->policies[i].min_freq = min_freq;
+   server->policies[i].max_freq = max_freq;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_server_set_default_policy(dvfs_server *server, unsigned int min_freq, unsigned int max_freq)
+{
+   assert(server != NULL);
+   if (server == NULL || min_freq > max_freq)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   server->has_default = true;
+   server->def_policy.min_freq = min_freq;
+   server->def_policy.max_freq = max_freq;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Accepts a new connection. The client is only served once it sent its hello.
+ */
+static void accept_client(dvfs_server *server)
+{
+   struct epoll_event ev;
+
+   int sock = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+   if (sock < 0)
+   {
+      return;
+   }
+
+   server_client *client = calloc(1, sizeof(*client));
+   if (client == NULL)
+   {
+      close(sock);
+      return;
+   }
+   client->sock = sock;
+   client->doorbell = -1;
+   client->ev_sock.type = EVENT_SOCKET;
+   client->ev_sock.client = client;
+   client->ev_doorbell.type = EVENT_DOORBELL;
+   client->ev_doorbell.client = client;
+
+   ev.events = EPOLLIN;
+   ev.data.ptr = &client->ev_sock;
+   if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0)
+   {
+      free_client(client);
+      return;
+   }
+
+   client->next = server->clients;
+   server->clients = client;
+   SERVER_RECORD(server, nb_accepted);
+}
+
+/**
+ * Sends the answer to the hello message, with the ring and the doorbell on
+ * success.
+ */
+static int send_welcome(const dvfs_server *server, const server_client *client, int status, int ring_fd)
+{
+   dvfs_proto_welcome welcome = { .status = status, .nb_units = server->ctx->nb_units };
+   struct iovec iov = { .iov_base = &welcome, .iov_len = sizeof(welcome) };
+   char control[CMSG_SPACE(2 * sizeof(int))];
+   struct msghdr msg;
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+
+   if (status == DVFS_SUCCESS)
+   {
+      int fds[2] = { ring_fd, client->doorbell };
+
+      memset(control, 0, sizeof(control));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+      memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+   }
+
+   if (sendmsg(client->sock, &msg, MSG_NOSIGNAL) != (ssize_t) sizeof(welcome))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the hello of a client, identifies it and sets up its ring.
+ */
+static int handshake(dvfs_server *server, server_client *client)
+{
+   dvfs_proto_hello hello;
+   struct ucred cred;
+   socklen_t cred_len = sizeof(cred);
+   struct epoll_event ev;
+   unsigned int i;
+   int ret;
+
+   if (recv(client->sock, &hello, sizeof(hello), MSG_DONTWAIT) != (ssize_t) sizeof(hello))
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   if (hello.magic != DVFS_PROTO_MAGIC || hello.version != DVFS_PROTO_VERSION)
+   {
+      send_welcome(server, client, DVFS_ERROR_INVALID_ARG, -1);
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // the credentials come from the kernel, the client cannot lie about them
+   if (getsockopt(client->sock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   client->uid = cred.uid;
+   client->pid = cred.pid;
+   for (i = 0; i < server->nb_policies && server->policies[i].uid != client->uid; i++);
+   if (i < server->nb_policies)
+   {
+      client->min_freq = server->policies[i].min_freq;
+      client->max_freq = server->policies[i].max_freq;
+   }
+   else if (server->has_default)
+   {
+      client->min_freq = server->def_policy.min_freq;
+      client->max_freq = server->def_policy.max_freq;
+   }
+   else
+   {
+      send_welcome(server, client, DVFS_ERROR_ACCESS_DENIED, -1);
+      return DVFS_ERROR_ACCESS_DENIED;
+   }
+
+   client->requests = calloc(server->ctx->nb_units, sizeof(*client->requests));
+   if (client->requests == NULL)
+   {
+      send_welcome(server, client, DVFS_ERROR_MEM_ALLOC_FAILED, -1);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   int ring_fd = memfd_create("dvfsd_ring", MFD_CLOEXEC);
+   if (ring_fd < 0)
+   {
+      send_welcome(server, client, DVFS_ERROR_FILE_ERROR, -1);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   if (ftruncate(ring_fd, sizeof(*client->ring)) != 0)
+   {
+      close(ring_fd);
+      send_welcome(server, client, DVFS_ERROR_FILE_ERROR, -1);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   client->ring = mmap(NULL, sizeof(*client->ring), PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+   if (client->ring == MAP_FAILED)
+   {
+      client->ring = NULL;
+      close(ring_fd);
+      send_welcome(server, client, DVFS_ERROR_FILE_ERROR, -1);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   client->doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   ev.events = EPOLLIN;
+   ev.data.ptr = &client->ev_doorbell;
+   if (client->doorbell < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, client->doorbell, &ev) != 0)
+   {
+      close(ring_fd);
+      send_welcome(server, client, DVFS_ERROR_FILE_ERROR, -1);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   ret = send_welcome(server, client, DVFS_SUCCESS, ring_fd);
+   close(ring_fd);
+   if (ret == DVFS_SUCCESS)
+   {
+      __atomic_fetch_add(&server->stats.nb_clients, 1, __ATOMIC_RELAXED);
+   }
+   return ret;
+}
+
+/**
+ * Disconnects a client and withdraws its requests. The client is freed at the
+ * end of the iteration, other events may still refer to it.
+ */
+static void drop_client(dvfs_server *server, server_client *client)
+{
+   unsigned int i;
+
+   if (client->closed)
+   {
+      return;
+   }
+   client->closed = true;
+
+   epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->sock, NULL);
+   if (client->doorbell >= 0)
+   {
+      epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->doorbell, NULL);
+   }
+
+   if (client->requests != NULL)
+   {
+      for (i = 0; i < server->ctx->nb_units; i++)
+      {
+         if (client->requests[i] != 0)
+         {
+            server->dirty[i] = true;
+         }
+      }
+   }
+
+   if (client->ring != NULL)
+   {
+      __atomic_fetch_sub(&server->stats.nb_clients, 1, __ATOMIC_RELAXED);
+   }
+}
+
+/**
+ * Checks a request and records it as the wish of the client for the unit.
+ *
+ * @return DVFS_PROTO_PENDING if the request is accepted, the error otherwise.
+ */
+static int accept_request(dvfs_server *server, server_client *client, unsigned int unit_id, unsigned int freq)
+{
+   unsigned int i;
+
+   if (unit_id >= server->ctx->nb_units)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   const dvfs_unit *unit = server->ctx->units[unit_id];
+   const unsigned int *freqs = unit_freqs(unit);
+   unsigned int nb_freqs = unit_nb_freqs(unit);
+
+   for (i = 0; i < nb_freqs && freqs[i] != freq; i++);
+   if (i == nb_freqs)
+   {
+      return DVFS_ERROR_INVALID_FREQ;
+   }
+
+   // clamp to the policy, rounding down to an available frequency
+   if (freq > client->max_freq)
+   {
+      for (i = nb_freqs; i > 0 && freqs[i - 1] > client->max_freq; i--);
+      if (i == 0 || freqs[i - 1] < client->min_freq)
+      {
+         return DVFS_ERROR_INVALID_FREQ;
+      }
+      freq = freqs[i - 1];
+   }
+   else if (freq < client->min_freq)
+   {
+      for (i = 0; i < nb_freqs && freqs[i] < client->min_freq; i++);
+      if (i == nb_freqs || freqs[i] > client->max_freq)
+      {
+         return DVFS_ERROR_INVALID_FREQ;
+      }
+      freq = freqs[i];
+   }
+
+   client->requests[unit_id] = freq;
+   server->dirty[unit_id] = true;
+   return DVFS_PROTO_PENDING;
+}
+
+/**
+ * Reads the new requests in the ring of a client.
+ */
+static void read_ring(dvfs_server *server, server_client *client)
+{
+   dvfs_proto_ring *ring = client->ring;
+   uint64_t value;
+
+   if (read(client->doorbell, &value, sizeof(value)) < 0 && errno != EAGAIN)
+   {
+      drop_client(server, client);
+      return;
+   }
+
+   uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+   if (head - client->done > DVFS_PROTO_RING_SIZE)
+   {
+      // the client overwrote requests not completed yet
+      drop_client(server, client);
+      return;
+   }
+
+   for (; client->tail != head; client->tail++)
+   {
+      dvfs_proto_request *req = &ring->slots[client->tail % DVFS_PROTO_RING_SIZE];
+      unsigned int unit_id = __atomic_load_n(&req->unit, __ATOMIC_RELAXED);
+      unsigned int freq = __atomic_load_n(&req->freq, __ATOMIC_RELAXED);
+
+      req->status = accept_request(server, client, unit_id, freq);
+      SERVER_RECORD(server, nb_requests);
+   }
+   __atomic_store_n(&ring->tail, client->tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Sets the highest frequency requested on the units with new requests, or the
+ * top frequency on the units left without requests.
+ */
+static void apply_units(dvfs_server *server)
+{
+   const server_client *client;
+   unsigned int i;
+
+   for (i = 0; i < server->ctx->nb_units; i++)
+   {
+      unsigned int freq = 0;
+
+      if (!server->dirty[i])
+      {
+         continue;
+      }
+      server->dirty[i] = false;
+
+      for (client = server->clients; client != NULL; client = client->next)
+      {
+         if (!client->closed && client->requests != NULL && client->requests[i] > freq)
+         {
+            freq = client->requests[i];
+         }
+      }
+
+      if (freq == server->applied[i])
+      {
+         server->status[i] = DVFS_SUCCESS;
+         continue;
+      }
+
+      // without requests left, the unit goes back to its top frequency
+      const dvfs_unit *unit = server->ctx->units[i];
+      unsigned int target = freq != 0 ? freq : unit_freqs(unit)[unit_nb_freqs(unit) - 1];
+
+      server->status[i] = dvfs_unit_set_freq(unit, target);
+      if (server->status[i] == DVFS_SUCCESS)
+      {
+         server->applied[i] = freq;
+         SERVER_RECORD(server, nb_writes);
+      }
+   }
+}
+
+/**
+ * Completes the requests read from the ring of a client and wakes it up.
+ */
+static void complete_ring(dvfs_server *server, server_client *client)
+{
+   dvfs_proto_ring *ring = client->ring;
+
+   if (client->done == client->tail)
+   {
+      return;
+   }
+
+   for (; client->done != client->tail; client->done++)
+   {
+      dvfs_proto_request *req = &ring->slots[client->done % DVFS_PROTO_RING_SIZE];
+
+      if (req->status == DVFS_PROTO_PENDING)
+      {
+         // the slot is shared, the unit is checked again
+         unsigned int unit_id = req->unit;
+         req->status = unit_id < server->ctx->nb_units ? server->status[unit_id] : DVFS_ERROR_INVALID_INDEX;
+      }
+   }
+
+   __atomic_store_n(&ring->done, client->done, __ATOMIC_RELEASE);
+   syscall(SYS_futex, &ring->done, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+int dvfs_server_run(dvfs_server *server)
+{
+   struct epoll_event events[SERVER_MAX_EVENTS];
+   server_client **pClient;
+   bool stop = false;
+   uint64_t value;
+   int nb, i;
+
+   assert(server != NULL);
+   if (server == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   while (!stop)
+   {
+      nb = epoll_wait(server->epoll_fd, events, SERVER_MAX_EVENTS, -1);
+      if (nb < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return DVFS_ERROR_FILE_ERROR;
+      }
+
+      for (i = 0; i < nb; i++)
+      {
+         server_event *ev = events[i].data.ptr;
+
+         switch (ev->type)
+         {
+            case EVENT_LISTEN:
+               accept_client(server);
+               break;
+            case EVENT_STOP:
+               if (read(server->stop_fd, &value, sizeof(value)) > 0)
+               {
+                  stop = true;
+               }
+               break;
+            case EVENT_SOCKET:
+               if (ev->client->closed)
+               {
+                  break;
+               }
+               // nothing is expected on the socket after the hello but the disconnection
+               if (ev->client->ring != NULL || handshake(server, ev->client) != DVFS_SUCCESS)
+               {
+                  drop_client(server, ev->client);
+               }
+               break;
+            case EVENT_DOORBELL:
+               if (!ev->client->closed)
+               {
+                  read_ring(server, ev->client);
+               }
+               break;
+         }
+      }
+
+      // all the requests of the iteration are applied at once
+      apply_units(server);
+
+      pClient = &server->clients;
+      while (*pClient != NULL)
+      {
+         server_client *client = *pClient;
+
+         if (client->closed)
+         {
+            *pClient = client->next;
+            free_client(client);
+            continue;
+         }
+         if (client->ring != NULL)
+         {
+            complete_ring(server, client);
+         }
+         pClient = &client->next;
+      }
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_server_stop(dvfs_server *server)
+{
+   uint64_t value = 1;
+
+   assert(server != NULL);
+   if (server == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // write is async-signal-safe
+   if (write(server->stop_fd, &value, sizeof(value)) < 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_server_get_stats(const dvfs_server *server, dvfs_server_stats *pStats)
+{
+   assert(server != NULL);
+   assert(pStats != NULL);
+   if (server == NULL || pStats == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pStats->nb_clients = __atomic_load_n(&server->stats.nb_clients, __ATOMIC_RELAXED);
+   pStats->nb_accepted = __atomic_load_n(&server->stats.nb_accepted, __ATOMIC_RELAXED);
+   pStats->nb_requests = __atomic_load_n(&server->stats.nb_requests, __ATOMIC_RELAXED);
+   pStats->nb_writes = __atomic_load_n(&server->stats.nb_writes, __ATOMIC_RELAXED);
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_server.h
+ *
+ * Server side of the \c dvfsd daemon: a single DVFS context shared by many
+ * unprivileged clients (see dvfs_client.h). The daemon listens on a Unix
+ * socket, identifies the clients from their credentials (SO_PEERCRED) and
+ * hands them a shared memory request ring. The requests then never go through
+ * the socket.
+ *
+ * The requests are arbitrated per DVFS unit: every client keeps its last
+ * request per unit, clamped to the policy of its user, and the unit runs at
+ * the highest of them. All the requests read in one iteration of the event
+ * loop are coalesced, so a unit is written at most once per iteration and only
+ * when the arbitrated frequency changes. The request of a client is forgotten
+ * when it disconnects, and a unit left without requests goes back to its top
+ * frequency.
+ *
+ * Only the users given a policy are served, unless a default policy is set.
+ *
+ * The units are switched to the "userspace" governor when the server is
+ * opened.
+ */
+
+/**
+ * The server, opaque.
+ */
+typedef struct dvfs_server dvfs_server;
+
+/**
+ * Counters of the server.
+ */
+typedef struct {
+   unsigned int nb_clients;         //!< Number of connected clients
+   unsigned long long nb_accepted;  //!< Number of clients accepted since the start
+   unsigned long long nb_requests;  //!< Number of requests read from the rings
+   unsigned long long nb_writes;    //!< Number of frequency changes applied on the units
+} dvfs_server_stats;
+
+/**
+ * Opens the server socket. The path is taken from the LIBDVFS_SOCKET_PATH
+ * environment variable when \c path is NULL, and defaults to
+ * \c /run/dvfsd.sock. A stale socket file is replaced. The socket is made
+ * accessible to every user, the access is then limited by the policies: the
+ * users without a policy are refused until a default policy is set.
+ *
+ * @param ppServer Will be filled with the new server.
+ * @param ctx The DVFS context the requests are applied to. Must outlive the server.
+ * @param path The path of the socket, or NULL.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppServer or \c ctx are NULL or if the path is too long.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the socket cannot be created.
+ *
+ * @sa dvfs_server_close()
+ */
+int dvfs_server_open(dvfs_server **ppServer, dvfs_ctx *ctx, const char *path);
+
+/**
+ * Closes the server: disconnects the clients and removes the socket file. The
+ * frequencies of the units are left as they are.
+ *
+ * @param server The server.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server is NULL.
+ */
+int dvfs_server_close(dvfs_server *server);
+
+/**
+ * Sets the frequency range allowed to the clients of a user. The requests are
+ * clamped to the range, then rounded down to an available frequency. The
+ * clients of the users without a policy are refused (see
+ * dvfs_server_set_default_policy()). Must not be called while the server is
+ * running.
+ *
+ * @param server The server.
+ * @param uid The user.
+ * @param min_freq The lowest frequency the user may request.
+ * @param max_freq The highest frequency the user may request.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server is NULL or if \c min_freq is above \c max_freq.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ */
+int dvfs_server_set_policy(dvfs_server *server, uid_t uid, unsigned int min_freq, unsigned int max_freq);
+
+/**
+ * Sets the frequency range allowed to the users without a policy of their
+ * own. Without it, their clients are refused. Must not be called while the
+ * server is running.
+ *
+ * @param server The server.
+ * @param min_freq The lowest frequency the users may request.
+ * @param max_freq The highest frequency the users may request.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server is NULL or if \c min_freq is above \c max_freq.
+ *
+ * @sa dvfs_server_set_policy()
+ */
+int dvfs_server_set_default_policy(dvfs_server *server, unsigned int min_freq, unsigned int max_freq);
+
+/**
+ * Runs the event loop of the server until dvfs_server_stop() is called.
+ *
+ * @param server The server.
+ *
+ * @return \retval DVFS_SUCCESS if the server was stopped.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if waiting for the events failed.
+ */
+int dvfs_server_run(dvfs_server *server);
+
+/**
+ * Stops the event loop. Can be called from another thread or from a signal
+ * handler.
+ *
+ * @param server The server.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server is NULL.
+ */
+int dvfs_server_stop(dvfs_server *server);
+
+/**
+ * Gets the counters of the server.
+ *
+ * @param server The server.
+ * @param pStats Will be filled with the counters.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c server or \c pStats are NULL.
+ */
+int dvfs_server_get_stats(const dvfs_server *server, dvfs_server_stats *pStats);
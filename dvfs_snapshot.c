@@ -0,0 +1,428 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dvfs_error.h"
+#include "dvfs_parallel.h"
+#include "dvfs_snapshot.h"
+
+// Magic number of the serialized snapshots, followed by the version
+#define SNAPSHOT_MAGIC "DVFSSNAP"
+#define SNAPSHOT_VERSION 1
+
+// the states are serialized as is
+_Static_assert(sizeof(dvfs_core_state) == 64, "dvfs_core_state must not be padded");
+
+/**
+ * Header of a serialized snapshot, followed by the states.
+ */
+typedef struct {
+   char magic[8];       //!< SNAPSHOT_MAGIC, without NUL byte
+   uint32_t version;    //!< SNAPSHOT_VERSION
+   uint32_t nb_cores;   //!< Number of states following
+} snapshot_header;
+
+/**
+ * Arguments shared by the per-unit operations.
+ */
+typedef struct {
+   const dvfs_ctx *ctx;          //!< The context
+   dvfs_core_state *states;      //!< States of the snapshot
+   unsigned int *first;          //!< Index of the first state of each unit (take)
+   int *index;                   //!< Index of the state of each core id, -1 if none (restore)
+   unsigned int nb_ids;          //!< Size of index
+   unsigned int nb_changed;      //!< Number of cores changed (restore)
+} snapshot_work;
+
+/**
+ * Copies a value read from sysfs, stopping at the first blank.
+ */
+static void copy_word(char *dst, size_t dst_len, const char *src)
+{
+   size_t len = strcspn(src, " \n");
+
+   if (len >= dst_len)
+   {
+      len = dst_len - 1;
+   }
+   memcpy(dst, src, len);
+   dst[len] = '\0';
+}
+
+static int take_core(const dvfs_core *core, dvfs_core_state *state)
+{
+   char buf[128];
+
+   memset(state, 0, sizeof(*state));
+   state->id = core->id;
+
+   int ret = dvfs_core_get_gov(core, buf, sizeof(buf));
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+   copy_word(state->gov, sizeof(state->gov), buf);
+
+   // the requested frequency, the measured one may not be in the table; it
+   // only matters with the "userspace" governor
+   if (core->ctrl == DVFS_CTRL_MINMAX)
+   {
+      state->min_freq = core->min_freq;
+      state->max_freq = core->max_freq;
+   }
+   else if (strcmp(state->gov, "userspace") == 0)
+   {
+      unsigned int freq = 0;
+      ret = dvfs_core_get_target(core, &freq);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+      state->freq = freq;
+   }
+
+   // the preference is only exposed by some drivers, and simulated cores must
+   // not read the one of the actual hardware
+   if (core->backend->hardware && dvfs_core_get_epp(core, buf, sizeof(buf)) == DVFS_SUCCESS)
+   {
+      copy_word(state->epp, sizeof(state->epp), buf);
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int take_unit(unsigned int index, void *arg)
+{
+   snapshot_work *work = arg;
+   const dvfs_unit *unit = work->ctx->units[index];
+   unsigned int i;
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      int ret = take_core(unit->cores[i], &work->states[work->first[index] + i]);
+      if (ret != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_snapshot_take(const dvfs_ctx *ctx, dvfs_snapshot **ppSnap)
+{
+   unsigned int i, nb_cores = 0;
+
+   assert(ctx != NULL);
+   assert(ppSnap != NULL);
+   if (ctx == NULL || ppSnap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   unsigned int *first = malloc((ctx->nb_units + 1) * sizeof(*first));
+   if (first == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      first[i] = nb_cores;
+      nb_cores += ctx->units[i]->nb_cores;
+   }
+
+   dvfs_snapshot *snap = malloc(sizeof(*snap));
+   dvfs_core_state *states = calloc(nb_cores > 0 ? nb_cores : 1, sizeof(*states));
+   if (snap == NULL || states == NULL)
+   {
+      free(first);
+      free(snap);
+      free(states);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   snap->nb_cores = nb_cores;
+   snap->states = states;
+
+   snapshot_work work = {
+      .ctx = ctx,
+      .states = states,
+      .first = first,
+   };
+   int ret = dvfs_parallel_run(ctx->nb_units, take_unit, &work);
+   free(first);
+
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_snapshot_free(snap);
+      return ret;
+   }
+
+   *ppSnap = snap;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Restores the state of a core, writing only what differs.
+ *
+ * @return DVFS_SUCCESS if the core already matches or was changed.
+ */
+static int restore_core(const dvfs_core *core, const dvfs_core_state *state, bool *pChanged)
+{
+   char buf[128];
+   char cur[128];
+   int ret;
+
+   *pChanged = false;
+
+   if (state->gov[0] != '\0')
+   {
+      if ((ret = dvfs_core_get_gov(core, buf, sizeof(buf))) != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+      copy_word(cur, sizeof(cur), buf);
+      if (strcmp(cur, state->gov) != 0)
+      {
+         if ((ret = dvfs_core_set_gov(core, state->gov)) != DVFS_SUCCESS)
+         {
+            return ret;
+         }
+         *pChanged = true;
+      }
+   }
+
+   if (state->epp[0] != '\0' && core->backend->hardware)
+   {
+      cur[0] = '\0';
+      if (dvfs_core_get_epp(core, buf, sizeof(buf)) == DVFS_SUCCESS)
+      {
+         copy_word(cur, sizeof(cur), buf);
+      }
+      if (strcmp(cur, state->epp) != 0)
+      {
+         if ((ret = dvfs_core_set_epp(core, state->epp)) != DVFS_SUCCESS)
+         {
+            return ret;
+         }
+         *pChanged = true;
+      }
+   }
+
+   if (core->ctrl == DVFS_CTRL_MINMAX)
+   {
+      if (state->max_freq != 0 && (core->min_freq != state->min_freq || core->max_freq != state->max_freq))
+      {
+         if ((ret = dvfs_core_set_limits(core, state->min_freq, state->max_freq)) != DVFS_SUCCESS)
+         {
+            return ret;
+         }
+         *pChanged = true;
+      }
+   }
+   else if (state->freq != 0 && strcmp(state->gov, "userspace") == 0)
+   {
+      unsigned int freq = 0;
+      if (dvfs_core_get_target(core, &freq) != DVFS_SUCCESS || freq != state->freq)
+      {
+         if ((ret = dvfs_core_set_freq(core, state->freq)) != DVFS_SUCCESS)
+         {
+            return ret;
+         }
+         *pChanged = true;
+      }
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int restore_unit(unsigned int index, void *arg)
+{
+   snapshot_work *work = arg;
+   const dvfs_unit *unit = work->ctx->units[index];
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      const dvfs_core *core = unit->cores[i];
+      bool changed = false;
+
+      if (core->id >= work->nb_ids || work->index[core->id] < 0)
+      {
+         continue;
+      }
+
+      int cret = restore_core(core, &work->states[work->index[core->id]], &changed);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+      if (changed)
+      {
+         __atomic_fetch_add(&work->nb_changed, 1, __ATOMIC_RELAXED);
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_snapshot_restore(const dvfs_ctx *ctx, const dvfs_snapshot *snap, unsigned int *pNbChanged)
+{
+   unsigned int i, j, nb_ids = 0;
+   int ret = DVFS_SUCCESS;
+
+   assert(ctx != NULL);
+   assert(snap != NULL);
+   if (ctx == NULL || snap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      for (j = 0; j < ctx->units[i]->nb_cores; j++)
+      {
+         if (ctx->units[i]->cores[j]->id >= nb_ids)
+         {
+            nb_ids = ctx->units[i]->cores[j]->id + 1;
+         }
+      }
+   }
+
+   int *index = malloc((nb_ids > 0 ? nb_ids : 1) * sizeof(*index));
+   if (index == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   for (i = 0; i < nb_ids; i++)
+   {
+      index[i] = -1;
+   }
+   for (i = 0; i < snap->nb_cores; i++)
+   {
+      if (snap->states[i].id >= nb_ids)
+      {
+         ret = DVFS_ERROR_INVALID_CORE_ID;
+         continue;
+      }
+      index[snap->states[i].id] = i;
+   }
+
+   snapshot_work work = {
+      .ctx = ctx,
+      .states = snap->states,
+      .index = index,
+      .nb_ids = nb_ids,
+      .nb_changed = 0,
+   };
+   int rret = dvfs_parallel_run(ctx->nb_units, restore_unit, &work);
+   free(index);
+
+   if (pNbChanged != NULL)
+   {
+      *pNbChanged = work.nb_changed;
+   }
+
+   return rret != DVFS_SUCCESS ? rret : ret;
+}
+
+int dvfs_snapshot_free(dvfs_snapshot *snap)
+{
+   assert(snap != NULL);
+   if (snap == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   free(snap->states);
+   free(snap);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_snapshot_serialize(const dvfs_snapshot *snap, void *buf, size_t buf_len, size_t *pLen)
+{
+   snapshot_header header;
+
+   assert(snap != NULL);
+   assert(pLen != NULL);
+   if (snap == NULL || pLen == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *pLen = sizeof(header) + snap->nb_cores * sizeof(*snap->states);
+   if (buf == NULL || buf_len < *pLen)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+   header.version = SNAPSHOT_VERSION;
+   header.nb_cores = snap->nb_cores;
+
+   memcpy(buf, &header, sizeof(header));
+   memcpy((char *) buf + sizeof(header), snap->states, snap->nb_cores * sizeof(*snap->states));
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_snapshot_deserialize(dvfs_snapshot **ppSnap, const void *buf, size_t len)
+{
+   snapshot_header header;
+   unsigned int i;
+
+   assert(ppSnap != NULL);
+   assert(buf != NULL);
+   if (ppSnap == NULL || buf == NULL || len < sizeof(header))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   memcpy(&header, buf, sizeof(header));
+   if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION
+       || len != sizeof(header) + (size_t) header.nb_cores * sizeof(dvfs_core_state))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   dvfs_snapshot *snap = malloc(sizeof(*snap));
+   dvfs_core_state *states = malloc((header.nb_cores > 0 ? header.nb_cores : 1) * sizeof(*states));
+   if (snap == NULL || states == NULL)
+   {
+      free(snap);
+      free(states);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   memcpy(states, (const char *) buf + sizeof(header), header.nb_cores * sizeof(*states));
+
+   // never trust the strings of a blob
+   for (i = 0; i < header.nb_cores; i++)
+   {
+      states[i].gov[sizeof(states[i].gov) - 1] = '\0';
+      states[i].epp[sizeof(states[i].epp) - 1] = '\0';
+   }
+
+   snap->nb_cores = header.nb_cores;
+   snap->states = states;
+   *ppSnap = snap;
+   return DVFS_SUCCESS;
+}
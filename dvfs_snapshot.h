@@ -0,0 +1,135 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dvfs_context.h"
+#include "dvfs_gov.h"
+
+/**
+ * @file dvfs_snapshot.h
+ *
+ * Snapshots of the DVFS state of the whole machine: governor, frequency,
+ * limits and energy/performance preference of every core. A snapshot can be
+ * taken and restored at any time, for instance to checkpoint the configuration
+ * before a phase of an application and roll it back afterwards. It can also
+ * be serialized into a compact blob (a header and 64 bytes per core) to be
+ * stored or sent to another process of the same machine.
+ *
+ * The cores are read and written in parallel, one DVFS unit per thread, and
+ * restoring only writes the settings differing from the snapshot.
+ */
+
+/** Maximal length of an energy/performance preference in a snapshot, terminating NUL included */
+#define DVFS_SNAPSHOT_EPP_LEN 32
+
+/**
+ * State of a core in a snapshot. The record has a fixed size and no padding:
+ * it is serialized as is.
+ */
+typedef struct {
+   uint32_t id;                        //!< Core id as declared by Linux
+   uint32_t freq;                      //!< Frequency requested with the "userspace" governor (DVFS_CTRL_SETSPEED only, 0 otherwise)
+   uint32_t min_freq;                  //!< Lower limit (DVFS_CTRL_MINMAX only, 0 otherwise)
+   uint32_t max_freq;                  //!< Upper limit (DVFS_CTRL_MINMAX only, 0 otherwise)
+   char gov[DVFS_GOV_NAME_LEN];        //!< Governor
+   char epp[DVFS_SNAPSHOT_EPP_LEN];    //!< Energy/performance preference, empty if not available
+} dvfs_core_state;
+
+/**
+ * Snapshot of the state of all the cores of a context.
+ */
+typedef struct {
+   unsigned int nb_cores;     //!< Number of cores
+   dvfs_core_state *states;   //!< State of each core, in the order of the units of the context
+} dvfs_snapshot;
+
+/**
+ * Takes a snapshot of all the cores of the context.
+ *
+ * @param ctx The DVFS context.
+ * @param ppSnap Will be filled with the new snapshot.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c ppSnap are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the governor or frequency of a core cannot be read.
+ *
+ * @sa dvfs_snapshot_free()
+ */
+int dvfs_snapshot_take(const dvfs_ctx *ctx, dvfs_snapshot **ppSnap);
+
+/**
+ * Restores a snapshot. For each core, the governor is restored first, then the
+ * preference, then the frequency or the limits. Only the settings differing
+ * from the snapshot are written.
+ *
+ * @param ctx The DVFS context.
+ * @param snap The snapshot.
+ * @param pNbChanged If not NULL, filled with the number of cores actually changed.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ctx or \c snap are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if a core of the snapshot is not in the context (the other ones are restored).
+ *         Any error of the setters otherwise (the other cores are restored).
+ */
+int dvfs_snapshot_restore(const dvfs_ctx *ctx, const dvfs_snapshot *snap, unsigned int *pNbChanged);
+
+/**
+ * Frees a snapshot.
+ *
+ * @param snap The snapshot.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c snap is NULL.
+ */
+int dvfs_snapshot_free(dvfs_snapshot *snap);
+
+/**
+ * Serializes a snapshot. The blob is only meant to be read on the same
+ * machine (host byte order).
+ *
+ * @param snap The snapshot.
+ * @param buf The buffer to fill, may be NULL to only get the size.
+ * @param buf_len The size of the buffer.
+ * @param pLen Filled with the size of the blob.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c snap or \c pLen are NULL.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer is too short (\c pLen is still filled).
+ */
+int dvfs_snapshot_serialize(const dvfs_snapshot *snap, void *buf, size_t buf_len, size_t *pLen);
+
+/**
+ * Builds a snapshot from a blob made by dvfs_snapshot_serialize().
+ *
+ * @param ppSnap Will be filled with the new snapshot.
+ * @param buf The blob.
+ * @param len The size of the blob.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppSnap or \c buf are NULL or the blob is not a valid snapshot.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_snapshot_free()
+ */
+int dvfs_snapshot_deserialize(dvfs_snapshot **ppSnap, const void *buf, size_t len);
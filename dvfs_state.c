@@ -0,0 +1,297 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dvfs_error.h"
+#include "dvfs_gov.h"
+#include "dvfs_state.h"
+#include "dvfs_timer.h"
+
+/**
+ * Makes the sequence odd. The writers of a record are serialized by the
+ * sequence itself: only one of them moves it from even to odd.
+ */
+static uint32_t write_begin(dvfs_state_record *record)
+{
+   uint32_t seq = __atomic_load_n(&record->seq, __ATOMIC_RELAXED);
+
+   for (;;)
+   {
+      if ((seq & 1) == 0
+          && __atomic_compare_exchange_n(&record->seq, &seq, seq + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      {
+         break;
+      }
+      seq = __atomic_load_n(&record->seq, __ATOMIC_RELAXED);
+   }
+
+   // the odd sequence is visible before the fields change
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   return seq;
+}
+
+static void write_end(dvfs_state_record *record, uint32_t seq)
+{
+   __atomic_store_n(&record->timestamp_ns, dvfs_timer_now_ns(), __ATOMIC_RELAXED);
+   __atomic_store_n(&record->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void dvfs_state_publish_target(dvfs_state_record *record, unsigned int freq)
+{
+   uint32_t seq = write_begin(record);
+   __atomic_store_n(&record->target, freq, __ATOMIC_RELAXED);
+   write_end(record, seq);
+}
+
+void dvfs_state_publish_gov(dvfs_state_record *record, unsigned int gov_id)
+{
+   uint32_t seq = write_begin(record);
+   __atomic_store_n(&record->gov_id, gov_id, __ATOMIC_RELAXED);
+   write_end(record, seq);
+}
+
+static void publish_sample(dvfs_state_record *record, unsigned int freq, unsigned int gov_id)
+{
+   uint32_t seq = write_begin(record);
+   __atomic_store_n(&record->freq, freq, __ATOMIC_RELAXED);
+   __atomic_store_n(&record->gov_id, gov_id, __ATOMIC_RELAXED);
+   write_end(record, seq);
+}
+
+int dvfs_unit_read_state(const dvfs_unit *unit, dvfs_unit_state *pState)
+{
+   const dvfs_state_record *record;
+   uint32_t seq;
+
+   assert(unit != NULL);
+   assert(pState != NULL);
+   if (unit == NULL || pState == NULL || unit->state == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   record = unit->state;
+   do
+   {
+      seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1)
+      {
+         continue;
+      }
+
+      pState->target = __atomic_load_n(&record->target, __ATOMIC_RELAXED);
+      pState->freq = __atomic_load_n(&record->freq, __ATOMIC_RELAXED);
+      pState->gov_id = __atomic_load_n(&record->gov_id, __ATOMIC_RELAXED);
+      pState->timestamp_ns = __atomic_load_n(&record->timestamp_ns, __ATOMIC_RELAXED);
+
+      // the copy is done before checking the sequence again
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || __atomic_load_n(&record->seq, __ATOMIC_RELAXED) != seq);
+
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Gives the record to the unit and to its cores, which publish their changes.
+ */
+static void set_record(dvfs_unit *unit, dvfs_state_record *record)
+{
+   unsigned int i;
+
+   unit->state = record;
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      unit->cores[i]->state = record;
+   }
+}
+
+int dvfs_state_open(dvfs_state **ppState, dvfs_ctx *ctx, const dvfs_state_config *config)
+{
+   dvfs_state *state;
+   unsigned int i;
+
+   assert(ppState != NULL);
+   assert(ctx != NULL);
+   assert(config != NULL);
+   if (ppState == NULL || ctx == NULL || config == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      if (ctx->units[i]->state != NULL)
+      {
+         return DVFS_ERROR_INVALID_ARG;
+      }
+   }
+
+   state = calloc(1, sizeof(*state));
+   if (state == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   state->ctx = ctx;
+   state->config = *config;
+   if (ctx->nb_units != 0)
+   {
+      state->records = aligned_alloc(sizeof(*state->records), ctx->nb_units * sizeof(*state->records));
+      if (state->records == NULL)
+      {
+         free(state);
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      memset(state->records, 0, ctx->nb_units * sizeof(*state->records));
+   }
+
+   dvfs_timer_cond_init(&state->cond);
+   pthread_mutex_init(&state->lock, NULL);
+
+   for (i = 0; i < ctx->nb_units; i++)
+   {
+      state->records[i].gov_id = DVFS_STATE_NO_GOV;
+      set_record(ctx->units[i], &state->records[i]);
+   }
+
+   dvfs_state_sample(state);
+
+   *ppState = state;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_state_close(dvfs_state *state)
+{
+   unsigned int i;
+
+   assert(state != NULL);
+   if (state == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (state->running)
+   {
+      dvfs_state_stop(state);
+   }
+
+   for (i = 0; i < state->ctx->nb_units; i++)
+   {
+      set_record(state->ctx->units[i], NULL);
+   }
+
+   pthread_mutex_destroy(&state->lock);
+   pthread_cond_destroy(&state->cond);
+   free(state->records);
+   free(state);
+   return DVFS_SUCCESS;
+}
+
+int dvfs_state_sample(dvfs_state *state)
+{
+   char gov[DVFS_GOV_NAME_LEN];
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(state != NULL);
+   if (state == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < state->ctx->nb_units; i++)
+   {
+      const dvfs_unit *unit = state->ctx->units[i];
+      dvfs_state_record *record = &state->records[i];
+      unsigned int freq = 0;
+      unsigned int gov_id = __atomic_load_n(&record->gov_id, __ATOMIC_RELAXED);
+      int cret;
+
+      cret = dvfs_unit_get_freq(unit, &freq);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+         continue;
+      }
+
+      // an unknown governor keeps the published one
+      if (dvfs_core_get_gov(unit->cores[0], gov, sizeof(gov)) == DVFS_SUCCESS)
+      {
+         dvfs_gov_intern(gov, &gov_id);
+      }
+
+      publish_sample(record, freq, gov_id);
+   }
+
+   pthread_mutex_lock(&state->lock);
+   state->nb_samples++;
+   state->last_status = ret;
+   pthread_mutex_unlock(&state->lock);
+   return ret;
+}
+
+static int sample(void *arg)
+{
+   return dvfs_state_sample(arg);
+}
+
+static void *sample_main(void *arg)
+{
+   dvfs_state *state = arg;
+
+   dvfs_timer_loop(&state->cond, &state->lock, &state->stop, state->config.period_us * 1000ULL, sample, state);
+   return NULL;
+}
+
+int dvfs_state_start(dvfs_state *state)
+{
+   assert(state != NULL);
+   if (state == NULL || state->running || state->config.period_us == 0)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   state->stop = false;
+   if (pthread_create(&state->thread, NULL, sample_main, state) != 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   state->running = true;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_state_stop(dvfs_state *state)
+{
+   assert(state != NULL);
+   if (state == NULL || !state->running)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   pthread_mutex_lock(&state->lock);
+   state->stop = true;
+   pthread_cond_signal(&state->cond);
+   pthread_mutex_unlock(&state->lock);
+
+   pthread_join(state->thread, NULL);
+   state->running = false;
+   return DVFS_SUCCESS;
+}
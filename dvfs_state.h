@@ -0,0 +1,190 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dvfs_context.h"
+
+/**
+ * @file dvfs_state.h
+ *
+ * Published state of the DVFS units, read by any number of threads without
+ * system call nor lock. Reading the frequency through dvfs_unit_get_freq()
+ * goes to the backend under the semaphore of the cores, so monitoring threads
+ * polling it slow down the threads changing the frequencies.
+ *
+ * Once published (dvfs_state_open()), every unit holds a record with the
+ * target frequency, the last sampled frequency, the governor id and the date
+ * of the last update, under a sequence lock: writers make the sequence odd,
+ * update the record and make it even again, readers retry when the sequence
+ * was odd or changed during their copy. The records are on separate cache
+ * lines so the readers of a unit do not disturb the others.
+ *
+ * The target and the governor are the last ones set on any core of the unit:
+ * they are published by dvfs_core_set_freq(), dvfs_core_set_gov() and
+ * dvfs_core_set_gov_id() on success, hence by the unit setters, the
+ * asynchronous requests and the snapshot restores, and by
+ * dvfs_bulk_set_freq(), which bypasses the cores. The sampled frequency and
+ * governor are published by dvfs_state_sample(), called every \c period_us by
+ * the thread of dvfs_state_start(). Changes made by other processes only
+ * appear after the next sample.
+ */
+
+/** Governor id published while the governor is not known */
+#define DVFS_STATE_NO_GOV ((unsigned int) -1)
+
+/**
+ * Record of a unit under a sequence lock. Only accessed through the functions
+ * of this file.
+ */
+typedef struct dvfs_state_record {
+   uint32_t seq;              //!< Sequence, odd while a writer updates the record
+   unsigned int target;       //!< Last frequency set through the library (kHz), 0 if none
+   unsigned int freq;         //!< Last frequency sampled (kHz)
+   unsigned int gov_id;       //!< Id of the governor (see dvfs_gov.h), DVFS_STATE_NO_GOV if not known
+   uint64_t timestamp_ns;     //!< Date of the last update (CLOCK_MONOTONIC)
+} __attribute__((aligned(64))) dvfs_state_record;
+
+/**
+ * Consistent copy of the record of a unit.
+ */
+typedef struct {
+   unsigned int target;       //!< Last frequency set through the library (kHz), 0 if none
+   unsigned int freq;         //!< Last frequency sampled (kHz)
+   unsigned int gov_id;       //!< Id of the governor (see dvfs_gov.h), DVFS_STATE_NO_GOV if not known
+   uint64_t timestamp_ns;     //!< Date of the last update (CLOCK_MONOTONIC)
+} dvfs_unit_state;
+
+/**
+ * Configuration of the published state.
+ */
+typedef struct {
+   unsigned int period_us;    //!< Sampling period of the thread started by dvfs_state_start() (us)
+} dvfs_state_config;
+
+/**
+ * Published state of the units of a context.
+ */
+typedef struct {
+   dvfs_ctx *ctx;                   //!< Context of the units
+   dvfs_state_config config;        //!< Configuration
+   dvfs_state_record *records;      //!< Record per unit id
+
+   pthread_mutex_t lock;            //!< Protects the thread state
+   pthread_cond_t cond;             //!< Wakes up the sampling thread to stop it
+   pthread_t thread;                //!< Sampling thread
+   bool running;                    //!< True if the sampling thread runs
+   bool stop;                       //!< Tells the sampling thread to exit
+
+   unsigned long long nb_samples;   //!< Samples taken
+   int last_status;                 //!< Status of the last sample
+} dvfs_state;
+
+/**
+ * Publishes the state of the units of a context. The units are sampled once
+ * before returning.
+ *
+ * @param ppState Will be filled with the published state.
+ * @param ctx The context.
+ * @param config The configuration.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppState, \c ctx or \c config are NULL, or if the state of the context is already published.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_state_close()
+ */
+int dvfs_state_open(dvfs_state **ppState, dvfs_ctx *ctx, const dvfs_state_config *config);
+
+/**
+ * Stops the sampling thread if needed and stops publishing the state. The
+ * records are freed: no thread may still read them, nor change the units of
+ * the context, since the setters publish into them. Close the state after the
+ * readers and the writers (asynchronous queue, governors, ...) are stopped.
+ *
+ * @param state The published state.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c state is NULL.
+ */
+int dvfs_state_close(dvfs_state *state);
+
+/**
+ * Samples the frequency and the governor of every unit and publishes them.
+ *
+ * @param state The published state.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c state is NULL.
+ *         Otherwise, the last error met while reading a unit.
+ */
+int dvfs_state_sample(dvfs_state *state);
+
+/**
+ * Starts a thread calling dvfs_state_sample() every \c period_us.
+ *
+ * @param state The published state.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c state is NULL, if the thread already runs or if \c period_us is 0.
+ *         \retval DVFS_ERROR_FILE_ERROR if the thread cannot be created.
+ */
+int dvfs_state_start(dvfs_state *state);
+
+/**
+ * Stops the sampling thread.
+ *
+ * @param state The published state.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c state is NULL or if the thread does not run.
+ */
+int dvfs_state_stop(dvfs_state *state);
+
+/**
+ * Reads the published state of a unit, without system call nor lock. Safe to
+ * call from any number of threads.
+ *
+ * @param unit The unit.
+ * @param pState Will be filled with a consistent copy of the record.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c unit or \c pState are NULL, or if the state of the unit is not published.
+ */
+int dvfs_unit_read_state(const dvfs_unit *unit, dvfs_unit_state *pState);
+
+/**
+ * Publishes the frequency set on a unit. You are not supposed to directly call
+ * this function, it is called by dvfs_core_set_freq() and dvfs_bulk_set_freq().
+ *
+ * @param record The record of the unit.
+ * @param freq The frequency set.
+ */
+void dvfs_state_publish_target(dvfs_state_record *record, unsigned int freq);
+
+/**
+ * Publishes the governor set on a unit. You are not supposed to directly call
+ * this function, it is called by dvfs_core_set_gov() and dvfs_core_set_gov_id().
+ *
+ * @param record The record of the unit.
+ * @param gov_id The id of the governor.
+ */
+void dvfs_state_publish_gov(dvfs_state_record *record, unsigned int gov_id);
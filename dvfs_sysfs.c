@@ -0,0 +1,105 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dvfs_sysfs.h"
+#include "dvfs_error.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_SYSFS_ROOT "/sys"
+
+const char *dvfs_sysfs_root(void)
+{
+   const char *root = getenv(DVFS_SYSFS_ROOT_ENV);
+
+   if (root == NULL || *root == '\0')
+   {
+      return DEFAULT_SYSFS_ROOT;
+   }
+   return root;
+}
+
+int dvfs_sysfs_path(char *buf, size_t buf_len, const char *pattern, ...)
+{
+   va_list ap;
+
+   assert(buf != NULL);
+   assert(pattern != NULL);
+
+   int len = snprintf(buf, buf_len, "%s", dvfs_sysfs_root());
+   if (len < 0 || (size_t) len >= buf_len)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   va_start(ap, pattern);
+   int plen = vsnprintf(buf + len, buf_len - len, pattern, ap);
+   va_end(ap);
+
+   if (plen < 0 || (size_t) plen >= buf_len - len)
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_sysfs_read_uint(const char *fname, unsigned int *pVal)
+{
+   assert(fname != NULL);
+   assert(pVal != NULL);
+
+   FILE *fd = fopen(fname, "r");
+   if (fd == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   int ret = fscanf(fd, "%u", pVal);
+   fclose(fd);
+
+   if (ret != 1)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_sysfs_write_uint(const char *fname, unsigned int val)
+{
+   assert(fname != NULL);
+
+   FILE *fd = fopen(fname, "w");
+   if (fd == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   int ret = fprintf(fd, "%u", val);
+   // sysfs reports write errors on close
+   if (fclose(fd) != 0 || ret < 0)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   return DVFS_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @file dvfs_sysfs.h
+ *
+ * Internal helpers to access the sysfs files. All the sysfs paths used by the
+ * library are relative to the sysfs root, which is \c /sys unless the
+ * \c LIBDVFS_SYSFS_ROOT environment variable is set. Pointing it to a fake
+ * tree allows testing the library without the actual hardware.
+ */
+
+/** Environment variable overriding the sysfs root */
+#define DVFS_SYSFS_ROOT_ENV "LIBDVFS_SYSFS_ROOT"
+
+/**
+ * Gets the sysfs root used by the library.
+ *
+ * @return The sysfs root, \c /sys by default.
+ */
+const char *dvfs_sysfs_root(void);
+
+/**
+ * Builds the absolute path of a sysfs file.
+ *
+ * @param buf The buffer to fill.
+ * @param buf_len The size of the buffer.
+ * @param pattern The path pattern relative to the sysfs root (printf format).
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the path does not fit in the buffer.
+ */
+int dvfs_sysfs_path(char *buf, size_t buf_len, const char *pattern, ...)
+   __attribute__ ((format (printf, 3, 4)));
+
+/**
+ * Reads an unsigned integer from a file.
+ *
+ * @param fname The absolute path of the file.
+ * @param pVal Will be filled with the value.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be opened or parsed.
+ */
+int dvfs_sysfs_read_uint(const char *fname, unsigned int *pVal);
+
+/**
+ * Writes an unsigned integer in a file.
+ *
+ * @param fname The absolute path of the file.
+ * @param val The value to write.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be opened or written.
+ */
+int dvfs_sysfs_write_uint(const char *fname, unsigned int val);
@@ -0,0 +1,71 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <time.h>
+
+#include "dvfs_timer.h"
+
+unsigned long long dvfs_timer_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void dvfs_timer_cond_init(pthread_cond_t *cond)
+{
+   pthread_condattr_t attr;
+
+   // the deadlines are computed on the monotonic clock
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(cond, &attr);
+   pthread_condattr_destroy(&attr);
+}
+
+int dvfs_timer_wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, unsigned long long deadline_ns)
+{
+   struct timespec deadline;
+
+   deadline.tv_sec = deadline_ns / 1000000000ULL;
+   deadline.tv_nsec = deadline_ns % 1000000000ULL;
+   return pthread_cond_timedwait(cond, lock, &deadline);
+}
+
+void dvfs_timer_loop(pthread_cond_t *cond, pthread_mutex_t *lock, const bool *stop,
+                     unsigned long long period_ns, dvfs_timer_fn fn, void *arg)
+{
+   unsigned long long deadline = dvfs_timer_now_ns();
+
+   pthread_mutex_lock(lock);
+   while (!*stop)
+   {
+      deadline += period_ns;
+      while (!*stop && dvfs_timer_wait_until(cond, lock, deadline) != ETIMEDOUT);
+      if (*stop)
+      {
+         break;
+      }
+
+      pthread_mutex_unlock(lock);
+      fn(arg);
+      pthread_mutex_lock(lock);
+   }
+   pthread_mutex_unlock(lock);
+}
@@ -0,0 +1,78 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * @file dvfs_timer.h
+ *
+ * Internal helpers shared by the modules running a thread on a period or until
+ * a deadline (rate limiter, power capping, dithering, phase detection,
+ * published state). All the dates are on the monotonic clock, in nanoseconds.
+ */
+
+/**
+ * Gets the current date.
+ *
+ * @return The date on the monotonic clock (ns).
+ */
+unsigned long long dvfs_timer_now_ns(void);
+
+/**
+ * Initializes a condition variable whose timed waits use the monotonic clock.
+ *
+ * @param cond The condition variable, destroyed with pthread_cond_destroy().
+ */
+void dvfs_timer_cond_init(pthread_cond_t *cond);
+
+/**
+ * Waits on a condition variable initialized by dvfs_timer_cond_init() until it
+ * is signalled or a date is reached. The mutex is held by the caller.
+ *
+ * @param cond The condition variable.
+ * @param lock The mutex held.
+ * @param deadline_ns The date to wake up at (ns).
+ *
+ * @return The result of pthread_cond_timedwait(), ETIMEDOUT once the date is reached.
+ */
+int dvfs_timer_wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, unsigned long long deadline_ns);
+
+/**
+ * Operation run on every period by dvfs_timer_loop().
+ *
+ * @return A libdvfs error code, ignored by the loop.
+ */
+typedef int (*dvfs_timer_fn)(void *arg);
+
+/**
+ * Body of a periodic thread: calls the operation every period until \c *stop
+ * is set, under the mutex, and the condition variable is signalled. The
+ * periods do not drift with the duration of the operation, which runs without
+ * the mutex.
+ *
+ * @param cond The condition variable, initialized by dvfs_timer_cond_init().
+ * @param lock The mutex protecting \c *stop, not held by the caller.
+ * @param stop Tells the thread to exit.
+ * @param period_ns The period (ns).
+ * @param fn The operation.
+ * @param arg The argument of the operation.
+ */
+void dvfs_timer_loop(pthread_cond_t *cond, pthread_mutex_t *lock, const bool *stop,
+                     unsigned long long period_ns, dvfs_timer_fn fn, void *arg);
@@ -0,0 +1,489 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dvfs_topology.h"
+#include "dvfs_error.h"
+#include "dvfs_sysfs.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// These patterns should be used in dvfs_sysfs_path functions
+#define CPU_DIR_PATTERN "/devices/system/cpu/cpu%u"
+#define PACKAGE_ID_FILE_PATTERN "/devices/system/cpu/cpu%u/topology/physical_package_id"
+#define DIE_ID_FILE_PATTERN "/devices/system/cpu/cpu%u/topology/die_id"
+#define CACHE_LEVEL_FILE_PATTERN "/devices/system/cpu/cpu%u/cache/index%u/level"
+#define CACHE_ID_FILE_PATTERN "/devices/system/cpu/cpu%u/cache/index%u/id"
+
+// Maximal number of cache indexes looked at to find the L3
+#define MAX_CACHE_INDEX 8
+
+/**
+ * Reads an unsigned value from a topology file.
+ * Returns false if the file does not exist or is ill-formed.
+ */
+static bool read_topo_value(const char *fname, unsigned int *pVal)
+{
+   FILE *fd = fopen(fname, "r");
+   if (fd == NULL)
+   {
+      return false;
+   }
+
+   int val = 0;
+   int ret = fscanf(fd, "%d", &val);
+   fclose(fd);
+
+   // die_id is -1 on some kernels where dies are not supported
+   if (ret != 1 || val < 0)
+   {
+      return false;
+   }
+
+   *pVal = val;
+   return true;
+}
+
+static unsigned int read_package_id(unsigned int core_id)
+{
+   char fname[256];
+   unsigned int id = DVFS_TOPO_UNKNOWN_ID;
+
+   dvfs_sysfs_path(fname, sizeof(fname), PACKAGE_ID_FILE_PATTERN, core_id);
+   read_topo_value(fname, &id);
+   return id;
+}
+
+static unsigned int read_die_id(unsigned int core_id)
+{
+   char fname[256];
+   unsigned int id = DVFS_TOPO_UNKNOWN_ID;
+
+   dvfs_sysfs_path(fname, sizeof(fname), DIE_ID_FILE_PATTERN, core_id);
+   read_topo_value(fname, &id);
+   return id;
+}
+
+static unsigned int read_numa_node_id(unsigned int core_id)
+{
+   char dname[256];
+   unsigned int id;
+
+   // the cpu directory contains a nodeX link toward its NUMA node
+   dvfs_sysfs_path(dname, sizeof(dname), CPU_DIR_PATTERN, core_id);
+   DIR *dir = opendir(dname);
+   if (dir == NULL)
+   {
+      return DVFS_TOPO_UNKNOWN_ID;
+   }
+
+   struct dirent *entry;
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (sscanf(entry->d_name, "node%u", &id) == 1)
+      {
+         closedir(dir);
+         return id;
+      }
+   }
+   closedir(dir);
+
+   return DVFS_TOPO_UNKNOWN_ID;
+}
+
+static unsigned int read_l3_id(unsigned int core_id)
+{
+   char fname[256];
+   unsigned int i;
+
+   for (i = 0; i < MAX_CACHE_INDEX; i++)
+   {
+      unsigned int level = 0;
+      dvfs_sysfs_path(fname, sizeof(fname), CACHE_LEVEL_FILE_PATTERN, core_id, i);
+      if (!read_topo_value(fname, &level))
+      {
+         break;
+      }
+
+      if (level == 3)
+      {
+         unsigned int id = DVFS_TOPO_UNKNOWN_ID;
+         dvfs_sysfs_path(fname, sizeof(fname), CACHE_ID_FILE_PATTERN, core_id, i);
+         read_topo_value(fname, &id);
+         return id;
+      }
+   }
+
+   // no L3: the NUMA node is the cache group
+   return DVFS_TOPO_UNKNOWN_ID;
+}
+
+static dvfs_topo_node *new_node(dvfs_topo_level level, unsigned int id, dvfs_topo_node *parent)
+{
+   dvfs_topo_node *node = calloc(1, sizeof(*node));
+   if (node == NULL)
+   {
+      return NULL;
+   }
+
+   node->level = level;
+   node->id = id;
+   node->parent = parent;
+
+   if (parent != NULL)
+   {
+      dvfs_topo_node **children = realloc(parent->children, (parent->nb_children + 1) * sizeof(*children));
+      if (children == NULL)
+      {
+         free(node);
+         return NULL;
+      }
+      parent->children = children;
+      parent->children[parent->nb_children++] = node;
+   }
+
+   return node;
+}
+
+static void free_node(dvfs_topo_node *node)
+{
+   unsigned int i;
+
+   for (i = 0; i < node->nb_children; i++)
+   {
+      free_node(node->children[i]);
+   }
+   free(node->children);
+   free(node->units);
+   free(node);
+}
+
+/**
+ * Gets the child of the given node with the given id, creates it if needed.
+ */
+static dvfs_topo_node *get_or_add_child(dvfs_topo_node *parent, dvfs_topo_level level, unsigned int id)
+{
+   unsigned int i;
+
+   for (i = 0; i < parent->nb_children; i++)
+   {
+      if (parent->children[i]->id == id)
+      {
+         return parent->children[i];
+      }
+   }
+
+   return new_node(level, id, parent);
+}
+
+/**
+ * Registers a unit in the flattened unit list of the node and all its
+ * ancestors.
+ */
+static int register_unit(dvfs_topo_node *node, dvfs_unit *unit)
+{
+   for (; node != NULL; node = node->parent)
+   {
+      dvfs_unit **units = realloc(node->units, (node->nb_units + 1) * sizeof(*units));
+      if (units == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      node->units = units;
+      node->units[node->nb_units++] = unit;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+static int add_unit(dvfs_topology *topo, dvfs_unit *unit)
+{
+   unsigned int i;
+
+   assert(unit->nb_cores > 0);
+
+   // the unit is placed according to its first core
+   unsigned int first_core = unit->cores[0]->id;
+   unsigned int ids[DVFS_TOPO_NB_LEVELS] = {
+      [DVFS_TOPO_PACKAGE] = read_package_id(first_core),
+      [DVFS_TOPO_DIE] = read_die_id(first_core),
+      [DVFS_TOPO_NUMA_NODE] = read_numa_node_id(first_core),
+      [DVFS_TOPO_L3] = read_l3_id(first_core),
+   };
+
+   dvfs_topo_node *node = topo->root;
+   dvfs_topo_level level;
+   for (level = DVFS_TOPO_PACKAGE; level < DVFS_TOPO_UNIT; level++)
+   {
+      node = get_or_add_child(node, level, ids[level]);
+      if (node == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+   }
+
+   dvfs_topo_node *unit_node = new_node(DVFS_TOPO_UNIT, unit->id, node);
+   if (unit_node == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+   unit_node->unit = unit;
+
+   int ret = register_unit(unit_node, unit);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++)
+   {
+      dvfs_core *core = unit->cores[i];
+      dvfs_topo_node *core_node = new_node(DVFS_TOPO_CORE, core->id, unit_node);
+      if (core_node == NULL)
+      {
+         return DVFS_ERROR_MEM_ALLOC_FAILED;
+      }
+      core_node->unit = unit;
+      core_node->core = core;
+
+      // grow the core index if needed
+      if (core->id >= topo->nb_core_nodes)
+      {
+         dvfs_topo_node **core_nodes = realloc(topo->core_nodes, (core->id + 1) * sizeof(*core_nodes));
+         if (core_nodes == NULL)
+         {
+            return DVFS_ERROR_MEM_ALLOC_FAILED;
+         }
+         memset(core_nodes + topo->nb_core_nodes, 0, (core->id + 1 - topo->nb_core_nodes) * sizeof(*core_nodes));
+         topo->core_nodes = core_nodes;
+         topo->nb_core_nodes = core->id + 1;
+      }
+      topo->core_nodes[core->id] = core_node;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topology_open(dvfs_topology **ppTopo, unsigned int nb_units, dvfs_unit **units)
+{
+   unsigned int i;
+
+   assert(ppTopo != NULL);
+   assert(units != NULL || nb_units == 0);
+   if (ppTopo == NULL || (units == NULL && nb_units != 0))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppTopo = calloc(1, sizeof(**ppTopo));
+   if (*ppTopo == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   (*ppTopo)->root = new_node(DVFS_TOPO_MACHINE, 0, NULL);
+   if ((*ppTopo)->root == NULL)
+   {
+      dvfs_topology_close(*ppTopo);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      int ret = add_unit(*ppTopo, units[i]);
+      if (ret != DVFS_SUCCESS)
+      {
+         dvfs_topology_close(*ppTopo);
+         return ret;
+      }
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topology_close(dvfs_topology *topo)
+{
+   assert(topo != NULL);
+   if (topo == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (topo->root != NULL)
+   {
+      free_node(topo->root);
+   }
+   free(topo->core_nodes);
+   free(topo);
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_root(const dvfs_topology *topo, const dvfs_topo_node **ppNode)
+{
+   assert(topo != NULL);
+   assert(ppNode != NULL);
+   if (topo == NULL || ppNode == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppNode = topo->root;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_core_node(const dvfs_topology *topo, const dvfs_topo_node **ppNode, unsigned int core_id)
+{
+   assert(topo != NULL);
+   assert(ppNode != NULL);
+   if (topo == NULL || ppNode == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (core_id >= topo->nb_core_nodes || topo->core_nodes[core_id] == NULL)
+   {
+      return DVFS_ERROR_INVALID_CORE_ID;
+   }
+
+   *ppNode = topo->core_nodes[core_id];
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_parent(const dvfs_topo_node *node, const dvfs_topo_node **ppParent)
+{
+   assert(node != NULL);
+   assert(ppParent != NULL);
+   if (node == NULL || ppParent == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppParent = node->parent;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_ancestor(const dvfs_topo_node *node, dvfs_topo_level level, const dvfs_topo_node **ppAncestor)
+{
+   assert(node != NULL);
+   assert(ppAncestor != NULL);
+   if (node == NULL || ppAncestor == NULL || level > node->level)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // the tree has a fixed depth, every level is present on the path
+   while (node->level != level)
+   {
+      node = node->parent;
+   }
+
+   *ppAncestor = node;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_nb_children(const dvfs_topo_node *node, unsigned int *pNb)
+{
+   assert(node != NULL);
+   assert(pNb != NULL);
+   if (node == NULL || pNb == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *pNb = node->nb_children;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_get_child(const dvfs_topo_node *node, const dvfs_topo_node **ppChild, unsigned int index)
+{
+   assert(node != NULL);
+   assert(ppChild != NULL);
+   if (node == NULL || ppChild == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (index >= node->nb_children)
+   {
+      return DVFS_ERROR_INVALID_INDEX;
+   }
+
+   *ppChild = node->children[index];
+   return DVFS_SUCCESS;
+}
+
+int dvfs_topo_set_gov(const dvfs_topo_node *node, const char *gov)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(node != NULL);
+   assert(gov != NULL);
+   if (node == NULL || gov == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (node->level == DVFS_TOPO_CORE)
+   {
+      return dvfs_core_set_gov(node->core, gov);
+   }
+
+   for (i = 0; i < node->nb_units; i++)
+   {
+      int cret = dvfs_unit_set_gov(node->units[i], gov);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
+
+int dvfs_topo_set_freq(const dvfs_topo_node *node, unsigned int freq)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(node != NULL);
+   if (node == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (node->level == DVFS_TOPO_CORE)
+   {
+      return dvfs_core_set_freq(node->core, freq);
+   }
+
+   for (i = 0; i < node->nb_units; i++)
+   {
+      int cret = dvfs_unit_set_freq(node->units[i], freq);
+      if (cret != DVFS_SUCCESS)
+      {
+         ret = cret;
+      }
+   }
+
+   return ret;
+}
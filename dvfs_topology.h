@@ -0,0 +1,215 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <limits.h>
+
+#include "dvfs_unit.h"
+#include "dvfs_core.h"
+
+/**
+ * @file dvfs_topology.h
+ *
+ * Hierarchical view of the machine built above the DVFS units. The tree goes
+ * from the whole machine down to the cores:
+ * machine -> package -> die -> NUMA node -> L3 group -> DVFS unit -> core.
+ *
+ * A DVFS unit is attached below the L3 group of its first core. On CPUs where a
+ * unit spans several groups (for instance Intel processors, where a unit is a
+ * whole package), the unit only appears once, below the first group.
+ *
+ * @sa dvfs_unit
+ */
+
+/**
+ * Levels of the topology tree, from the root to the leaves.
+ */
+typedef enum {
+   DVFS_TOPO_MACHINE = 0,  //!< The whole machine (root of the tree)
+   DVFS_TOPO_PACKAGE,      //!< A physical package (socket)
+   DVFS_TOPO_DIE,          //!< A die within a package
+   DVFS_TOPO_NUMA_NODE,    //!< A NUMA node
+   DVFS_TOPO_L3,           //!< A group of cores sharing a last level cache
+   DVFS_TOPO_UNIT,         //!< A DVFS unit
+   DVFS_TOPO_CORE,         //!< A CPU core
+   DVFS_TOPO_NB_LEVELS     //!< Number of levels in the tree
+} dvfs_topo_level;
+
+/**
+ * Id of the nodes whose topology file is not provided by the kernel (no
+ * \c die_id on old kernels, no NUMA link, no L3...). The cores missing the
+ * same file are grouped in a single node of this id, apart from the nodes of
+ * the known ids.
+ */
+#define DVFS_TOPO_UNKNOWN_ID UINT_MAX
+
+/**
+ * A node of the topology tree.
+ */
+typedef struct dvfs_topo_node {
+   dvfs_topo_level level;              //!< Level of the node in the tree
+   unsigned int id;                    //!< Id of the node as declared by Linux (package id, NUMA node id, core id, ...), DVFS_TOPO_UNKNOWN_ID if not provided
+   struct dvfs_topo_node *parent;      //!< Parent node, NULL for the root
+   unsigned int nb_children;           //!< Number of children
+   struct dvfs_topo_node **children;   //!< Children nodes
+
+   unsigned int nb_units;              //!< Number of DVFS units below this node
+   dvfs_unit **units;                  //!< DVFS units below this node, used to batch operations
+
+   dvfs_unit *unit;                    //!< The DVFS unit of this node (unit and core levels only)
+   dvfs_core *core;                    //!< The core of this node (core level only)
+} dvfs_topo_node;
+
+/**
+ * The whole topology tree with an index of the core nodes.
+ */
+typedef struct {
+   dvfs_topo_node *root;               //!< Root of the tree (machine level)
+   unsigned int nb_core_nodes;         //!< Size of the \c core_nodes index (highest core id + 1)
+   dvfs_topo_node **core_nodes;        //!< Core nodes indexed by core id. Can contain NULL entries.
+} dvfs_topology;
+
+/**
+ * Builds the topology tree above the given DVFS units from the sysfs topology
+ * files. You are not supposed to directly call this function, the tree is
+ * built by \c dvfs_start().
+ *
+ * The nodes whose topology file is not provided by the kernel get the id
+ * DVFS_TOPO_UNKNOWN_ID, so that they are never mistaken for the node 0.
+ *
+ * @param ppTopo Will be filled with the new topology.
+ * @param nb_units The number of DVFS units.
+ * @param units The DVFS units to organize.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppTopo or \c units are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_topology_close()
+ */
+int dvfs_topology_open(dvfs_topology **ppTopo, unsigned int nb_units, dvfs_unit **units);
+
+/**
+ * Frees the memory associated to a topology tree. The units and cores are not
+ * closed.
+ *
+ * @param topo The topology to free.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c topo is NULL.
+ */
+int dvfs_topology_close(dvfs_topology *topo);
+
+/**
+ * Gets the root of the topology tree (machine level).
+ *
+ * @param topo The topology.
+ * @param ppNode Will be filled with the root node.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c topo or \c ppNode are NULL.
+ */
+int dvfs_topo_get_root(const dvfs_topology *topo, const dvfs_topo_node **ppNode);
+
+/**
+ * Gets the node of the given core in constant time.
+ *
+ * @param topo The topology.
+ * @param ppNode Will be filled with the core node.
+ * @param core_id The core id as declared by Linux.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c topo or \c ppNode are NULL.
+ *         \retval DVFS_ERROR_INVALID_CORE_ID if the core is not in the topology.
+ */
+int dvfs_topo_get_core_node(const dvfs_topology *topo, const dvfs_topo_node **ppNode, unsigned int core_id);
+
+/**
+ * Gets the parent of a node.
+ *
+ * @param node The node.
+ * @param ppParent Will be filled with the parent, or NULL for the root.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node or \c ppParent are NULL.
+ */
+int dvfs_topo_get_parent(const dvfs_topo_node *node, const dvfs_topo_node **ppParent);
+
+/**
+ * Gets the closest ancestor of a node at the given level. A node is its own
+ * ancestor at its own level.
+ *
+ * @param node The node.
+ * @param level The requested level.
+ * @param ppAncestor Will be filled with the ancestor.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node or \c ppAncestor are NULL or if
+ *         \c level is below the level of \c node.
+ */
+int dvfs_topo_get_ancestor(const dvfs_topo_node *node, dvfs_topo_level level, const dvfs_topo_node **ppAncestor);
+
+/**
+ * Gets the number of children of a node.
+ *
+ * @param node The node.
+ * @param pNb Will be filled with the number of children.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node or \c pNb are NULL.
+ */
+int dvfs_topo_get_nb_children(const dvfs_topo_node *node, unsigned int *pNb);
+
+/**
+ * Gets a child of a node.
+ *
+ * @param node The node.
+ * @param ppChild Will be filled with the child.
+ * @param index The index of the child.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node or \c ppChild are NULL.
+ *         \retval DVFS_ERROR_INVALID_INDEX if \c index does not match any child.
+ */
+int dvfs_topo_get_child(const dvfs_topo_node *node, const dvfs_topo_node **ppChild, unsigned int index);
+
+/**
+ * Sets a governor on all the DVFS units below the node. For a core node, the
+ * governor is only set on the core.
+ *
+ * @param node The node.
+ * @param gov The governor to set.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node or \c gov are NULL.
+ */
+int dvfs_topo_set_gov(const dvfs_topo_node *node, const char *gov);
+
+/**
+ * Sets a frequency on all the DVFS units below the node. For a core node, the
+ * frequency is only requested for the core. The effect is unknown if the
+ * current governor is not "userspace".
+ *
+ * @param node The node.
+ * @param freq The frequency to set.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c node is NULL.
+ */
+int dvfs_topo_set_freq(const dvfs_topo_node *node, unsigned int freq);
@@ -0,0 +1,501 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dvfs_error.h"
+#include "dvfs_trace.h"
+
+#define TRACE_MAGIC "DVFSTRC1"
+#define TRACE_MAGIC_LEN 8
+
+#define RECORD_GOV 0x01
+#define RECORD_SAMPLE 0x02
+
+// Longest variable-length encoding of a 64 bits integer
+#define VARINT_MAX_LEN 10
+
+static size_t put_varint(uint8_t *buf, uint64_t val)
+{
+   size_t len = 0;
+
+   while (val >= 0x80)
+   {
+      buf[len++] = (uint8_t) (val | 0x80);
+      val >>= 7;
+   }
+   buf[len++] = (uint8_t) val;
+   return len;
+}
+
+static size_t put_delta(uint8_t *buf, uint64_t cur, uint64_t prev)
+{
+   int64_t delta = (int64_t) (cur - prev);
+   return put_varint(buf, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+}
+
+static bool get_varint(FILE *f, uint64_t *pVal)
+{
+   unsigned int shift;
+   int c;
+
+   *pVal = 0;
+   for (shift = 0; shift < 64; shift += 7)
+   {
+      c = getc(f);
+      if (c == EOF)
+      {
+         return false;
+      }
+      *pVal |= (uint64_t) (c & 0x7f) << shift;
+      if ((c & 0x80) == 0)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+static bool get_delta(FILE *f, uint64_t prev, uint64_t *pVal)
+{
+   uint64_t zz;
+
+   if (!get_varint(f, &zz))
+   {
+      return false;
+   }
+   *pVal = prev + (uint64_t) ((int64_t) (zz >> 1) ^ -(int64_t) (zz & 1));
+   return true;
+}
+
+/**
+ * Allocates a trace and the arrays of its previous sample from its header.
+ */
+static dvfs_trace *trace_alloc(const dvfs_trace_header *header)
+{
+   dvfs_trace *trace = calloc(1, sizeof(*trace));
+   unsigned int i;
+
+   if (trace == NULL)
+   {
+      return NULL;
+   }
+
+   trace->header = *header;
+   trace->header.core_ids = malloc(header->nb_cores * sizeof(*trace->header.core_ids));
+   trace->prev.freqs = calloc(header->nb_cores, sizeof(*trace->prev.freqs));
+   trace->prev.gov_ids = malloc(header->nb_cores * sizeof(*trace->prev.gov_ids));
+   trace->prev.eff_freqs = calloc(header->nb_cores, sizeof(*trace->prev.eff_freqs));
+   trace->prev.energies = calloc(header->nb_packages + 1, sizeof(*trace->prev.energies));
+   trace->buf = malloc(1 + VARINT_MAX_LEN * (1 + 3 * header->nb_cores + header->nb_packages));
+   if (trace->header.core_ids == NULL || trace->prev.freqs == NULL || trace->prev.gov_ids == NULL
+       || trace->prev.eff_freqs == NULL || trace->prev.energies == NULL || trace->buf == NULL)
+   {
+      dvfs_trace_close(trace);
+      return NULL;
+   }
+
+   memcpy(trace->header.core_ids, header->core_ids, header->nb_cores * sizeof(*header->core_ids));
+   for (i = 0; i < header->nb_cores; i++)
+   {
+      trace->prev.gov_ids[i] = DVFS_TRACE_NO_GOV;
+   }
+   return trace;
+}
+
+int dvfs_trace_create(dvfs_trace **ppTrace, const char *path, const dvfs_trace_header *header)
+{
+   uint8_t buf[VARINT_MAX_LEN * 6];
+   dvfs_trace *trace;
+   unsigned int i;
+   size_t len = 0;
+   bool ok;
+
+   assert(ppTrace != NULL);
+   assert(path != NULL);
+   assert(header != NULL);
+   if (ppTrace == NULL || path == NULL || header == NULL || header->nb_cores == 0 || header->core_ids == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   trace = trace_alloc(header);
+   if (trace == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   trace->writing = true;
+   trace->f = fopen(path, "wb");
+   if (trace->f == NULL)
+   {
+      dvfs_trace_close(trace);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   len += put_varint(buf + len, header->flags);
+   len += put_varint(buf + len, header->interval_ns);
+   len += put_varint(buf + len, header->start_ns);
+   len += put_varint(buf + len, header->nb_cores);
+   ok = fwrite(TRACE_MAGIC, TRACE_MAGIC_LEN, 1, trace->f) == 1 && fwrite(buf, len, 1, trace->f) == 1;
+   for (i = 0; i < header->nb_cores && ok; i++)
+   {
+      len = put_varint(buf, header->core_ids[i]);
+      ok = fwrite(buf, len, 1, trace->f) == 1;
+   }
+   len = put_varint(buf, header->nb_packages);
+   if (!ok || fwrite(buf, len, 1, trace->f) != 1)
+   {
+      dvfs_trace_close(trace);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   *ppTrace = trace;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Writes the names of the governors not named yet.
+ */
+static int write_gov_names(dvfs_trace *trace, const dvfs_trace_sample *sample)
+{
+   uint8_t buf[1 + 2 * VARINT_MAX_LEN];
+   unsigned int i;
+
+   for (i = 0; i < trace->header.nb_cores; i++)
+   {
+      unsigned int id = sample->gov_ids[i];
+      const char *name;
+      size_t len, name_len;
+
+      if (id >= DVFS_GOV_MAX || (trace->known_govs & (1U << id)) != 0)
+      {
+         continue;
+      }
+
+      trace->known_govs |= 1U << id;
+      if (dvfs_gov_get_name(id, &name) != DVFS_SUCCESS)
+      {
+         continue;
+      }
+
+      name_len = strlen(name);
+      buf[0] = RECORD_GOV;
+      len = 1 + put_varint(buf + 1, id);
+      len += put_varint(buf + len, name_len);
+      if (fwrite(buf, len, 1, trace->f) != 1 || fwrite(name, name_len, 1, trace->f) != 1)
+      {
+         return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+   return DVFS_SUCCESS;
+}
+
+int dvfs_trace_write(dvfs_trace *trace, const dvfs_trace_sample *sample)
+{
+   const dvfs_trace_header *header;
+   dvfs_trace_sample *prev;
+   unsigned int i;
+   size_t len = 0;
+   int ret;
+
+   assert(trace != NULL);
+   assert(sample != NULL);
+   if (trace == NULL || sample == NULL || !trace->writing)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   header = &trace->header;
+   prev = &trace->prev;
+   ret = write_gov_names(trace, sample);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   trace->buf[len++] = RECORD_SAMPLE;
+   len += put_delta(trace->buf + len, sample->time_ns - prev->time_ns, header->interval_ns);
+   prev->time_ns = sample->time_ns;
+   for (i = 0; i < header->nb_cores; i++)
+   {
+      len += put_delta(trace->buf + len, sample->freqs[i], prev->freqs[i]);
+      len += put_varint(trace->buf + len, sample->gov_ids[i] < DVFS_GOV_MAX ? sample->gov_ids[i] + 1 : 0);
+      prev->freqs[i] = sample->freqs[i];
+      if (header->flags & DVFS_TRACE_EFF_FREQ)
+      {
+         len += put_delta(trace->buf + len, sample->eff_freqs[i], prev->eff_freqs[i]);
+         prev->eff_freqs[i] = sample->eff_freqs[i];
+      }
+   }
+   if (header->flags & DVFS_TRACE_ENERGY)
+   {
+      for (i = 0; i < header->nb_packages; i++)
+      {
+         len += put_varint(trace->buf + len, sample->energies[i]);
+      }
+   }
+
+   if (fwrite(trace->buf, len, 1, trace->f) != 1)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   trace->nb_samples++;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the header of a trace, after the magic. The core ids are allocated
+ * with malloc.
+ */
+static int read_header(FILE *f, dvfs_trace_header *header)
+{
+   uint64_t flags, nb_cores, nb_packages, id;
+   unsigned int i;
+
+   if (!get_varint(f, &flags) || !get_varint(f, &header->interval_ns) || !get_varint(f, &header->start_ns)
+       || !get_varint(f, &nb_cores) || nb_cores == 0 || nb_cores > UINT16_MAX)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   header->flags = flags;
+   header->nb_cores = nb_cores;
+   header->core_ids = malloc(nb_cores * sizeof(*header->core_ids));
+   if (header->core_ids == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < nb_cores; i++)
+   {
+      if (!get_varint(f, &id))
+      {
+         break;
+      }
+      header->core_ids[i] = id;
+   }
+
+   if (i < nb_cores || !get_varint(f, &nb_packages) || nb_packages > UINT16_MAX)
+   {
+      free(header->core_ids), header->core_ids = NULL;
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   header->nb_packages = nb_packages;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_trace_open(dvfs_trace **ppTrace, const char *path)
+{
+   char magic[TRACE_MAGIC_LEN];
+   dvfs_trace_header header;
+   dvfs_trace *trace;
+   FILE *f;
+   int ret;
+
+   assert(ppTrace != NULL);
+   assert(path != NULL);
+   if (ppTrace == NULL || path == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   f = fopen(path, "rb");
+   if (f == NULL)
+   {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   if (fread(magic, TRACE_MAGIC_LEN, 1, f) != 1 || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+   {
+      fclose(f);
+      return DVFS_ERROR_FILE_ERROR;
+   }
+
+   ret = read_header(f, &header);
+   if (ret != DVFS_SUCCESS)
+   {
+      fclose(f);
+      return ret;
+   }
+
+   trace = trace_alloc(&header);
+   free(header.core_ids);
+   if (trace == NULL)
+   {
+      fclose(f);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   trace->f = f;
+   *ppTrace = trace;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the body of a governor record. Returns false if the record is cut.
+ */
+static bool read_gov_name(dvfs_trace *trace)
+{
+   char name[DVFS_GOV_NAME_LEN];
+   uint64_t id, len;
+
+   if (!get_varint(trace->f, &id) || !get_varint(trace->f, &len) || len >= DVFS_GOV_NAME_LEN
+       || fread(name, 1, len, trace->f) != len)
+   {
+      return false;
+   }
+
+   name[len] = '\0';
+   if (id < DVFS_GOV_MAX)
+   {
+      memcpy(trace->gov_names[id], name, len + 1);
+      trace->known_govs |= 1U << id;
+   }
+   return true;
+}
+
+/**
+ * Reads the body of a sample record. Returns false if the record is cut.
+ */
+static bool read_sample(dvfs_trace *trace)
+{
+   const dvfs_trace_header *header = &trace->header;
+   dvfs_trace_sample *prev = &trace->prev;
+   uint64_t val;
+   unsigned int i;
+
+   if (!get_delta(trace->f, header->interval_ns, &val))
+   {
+      return false;
+   }
+   prev->time_ns += val;
+
+   for (i = 0; i < header->nb_cores; i++)
+   {
+      if (!get_delta(trace->f, prev->freqs[i], &val))
+      {
+         return false;
+      }
+      prev->freqs[i] = val;
+
+      if (!get_varint(trace->f, &val))
+      {
+         return false;
+      }
+      prev->gov_ids[i] = val == 0 ? DVFS_TRACE_NO_GOV : val - 1;
+
+      if (header->flags & DVFS_TRACE_EFF_FREQ)
+      {
+         if (!get_delta(trace->f, prev->eff_freqs[i], &val))
+         {
+            return false;
+         }
+         prev->eff_freqs[i] = val;
+      }
+   }
+
+   if (header->flags & DVFS_TRACE_ENERGY)
+   {
+      for (i = 0; i < header->nb_packages; i++)
+      {
+         if (!get_varint(trace->f, &prev->energies[i]))
+         {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+int dvfs_trace_read(dvfs_trace *trace, const dvfs_trace_sample **ppSample)
+{
+   int tag;
+
+   assert(trace != NULL);
+   assert(ppSample != NULL);
+   if (trace == NULL || ppSample == NULL || trace->writing)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppSample = NULL;
+   for (;;)
+   {
+      tag = getc(trace->f);
+      if (tag == EOF)
+      {
+         return DVFS_SUCCESS;
+      }
+
+      switch (tag)
+      {
+         case RECORD_GOV:
+            if (!read_gov_name(trace))
+            {
+               return DVFS_SUCCESS;
+            }
+            break;
+         case RECORD_SAMPLE:
+            if (read_sample(trace))
+            {
+               trace->nb_samples++;
+               *ppSample = &trace->prev;
+            }
+            return DVFS_SUCCESS;
+         default:
+            return DVFS_ERROR_FILE_ERROR;
+      }
+   }
+}
+
+const char *dvfs_trace_gov_name(const dvfs_trace *trace, unsigned int id)
+{
+   if (trace == NULL || id >= DVFS_GOV_MAX || (trace->known_govs & (1U << id)) == 0)
+   {
+      return NULL;
+   }
+   return trace->gov_names[id];
+}
+
+int dvfs_trace_close(dvfs_trace *trace)
+{
+   int ret = DVFS_SUCCESS;
+
+   assert(trace != NULL);
+   if (trace == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (trace->f != NULL && fclose(trace->f) != 0 && trace->writing)
+   {
+      ret = DVFS_ERROR_FILE_ERROR;
+   }
+
+   free(trace->header.core_ids);
+   free(trace->prev.freqs);
+   free(trace->prev.gov_ids);
+   free(trace->prev.eff_freqs);
+   free(trace->prev.energies);
+   free(trace->buf);
+   free(trace);
+   return ret;
+}
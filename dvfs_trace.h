@@ -0,0 +1,167 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dvfs_gov.h"
+
+/**
+ * @file dvfs_trace.h
+ *
+ * Compact time series of the frequencies of the cores, written by the
+ * \c dvfsmon monitor. After a header describing the cores, every sample is
+ * stored as the difference with the previous one in variable-length integers
+ * (7 bits per byte, zigzag encoding for the signed differences): a core whose
+ * frequency did not change costs two bytes, its frequency and governor id.
+ *
+ * The records are:
+ * - a governor name, emitted before the first sample using its id:
+ *   \c 0x01, id, length, name;
+ * - a sample: \c 0x02, difference between the time elapsed since the
+ *   previous sample and the interval (ns), then per core the frequency
+ *   difference (kHz), the governor id plus one (0 if unknown), and the
+ *   effective frequency difference (kHz) if recorded, then per package the
+ *   energy consumed since the previous sample (uJ) if recorded.
+ *
+ * A record cut by the end of the file (monitor killed) ends the trace.
+ */
+
+/** The effective frequency (APERF/MPERF) of the cores is recorded */
+#define DVFS_TRACE_EFF_FREQ 0x1
+/** The energy of the packages is recorded */
+#define DVFS_TRACE_ENERGY 0x2
+
+/** Governor id of the samples when the governor is not known */
+#define DVFS_TRACE_NO_GOV ((unsigned int) -1)
+
+/**
+ * Description of the series.
+ */
+typedef struct {
+   uint32_t flags;            //!< Optional values recorded (DVFS_TRACE_EFF_FREQ, DVFS_TRACE_ENERGY)
+   uint64_t interval_ns;      //!< Sampling interval requested (ns)
+   uint64_t start_ns;         //!< Date of the start (CLOCK_REALTIME, ns)
+   unsigned int nb_cores;     //!< Number of cores
+   unsigned int *core_ids;    //!< Ids of the cores
+   unsigned int nb_packages;  //!< Number of packages (energy values per sample)
+} dvfs_trace_header;
+
+/**
+ * A sample of all the cores. The arrays are sized after the header.
+ */
+typedef struct {
+   uint64_t time_ns;          //!< Date since the start (ns)
+   unsigned int *freqs;       //!< Current frequency per core (kHz), 0 if not read
+   unsigned int *gov_ids;     //!< Governor id per core, DVFS_TRACE_NO_GOV if not read
+   unsigned int *eff_freqs;   //!< Effective frequency per core since the previous sample (kHz), if DVFS_TRACE_EFF_FREQ
+   uint64_t *energies;        //!< Energy per package since the previous sample (uJ), if DVFS_TRACE_ENERGY
+} dvfs_trace_sample;
+
+/**
+ * A trace being written or read.
+ */
+typedef struct {
+   FILE *f;                   //!< File of the trace
+   bool writing;              //!< True if the trace is written
+   dvfs_trace_header header;  //!< Description of the series
+   dvfs_trace_sample prev;    //!< Previous sample, the last one read when reading
+   uint32_t known_govs;       //!< Governors whose name was written or read, bit i for id i
+   char gov_names[DVFS_GOV_MAX][DVFS_GOV_NAME_LEN];   //!< Names of the governors read
+   uint8_t *buf;              //!< Encoding buffer of a sample record
+   unsigned long long nb_samples;   //!< Samples written or read
+} dvfs_trace;
+
+/**
+ * Creates a trace and writes its header.
+ *
+ * @param ppTrace Will be filled with the trace.
+ * @param path The file to write.
+ * @param header The description of the series, copied.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if an argument is NULL or if the header has no core.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be written.
+ *
+ * @sa dvfs_trace_close()
+ */
+int dvfs_trace_create(dvfs_trace **ppTrace, const char *path, const dvfs_trace_header *header);
+
+/**
+ * Appends a sample to a trace. The names of the governors met for the first
+ * time are written before it.
+ *
+ * @param trace The trace, created with dvfs_trace_create().
+ * @param sample The sample, dated after the previous one.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c trace or \c sample are NULL, or if the trace is read.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be written.
+ */
+int dvfs_trace_write(dvfs_trace *trace, const dvfs_trace_sample *sample);
+
+/**
+ * Opens a trace to read it. The header is available in \c header.
+ *
+ * @param ppTrace Will be filled with the trace.
+ * @param path The file to read.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppTrace or \c path are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file cannot be read or is not a trace.
+ *
+ * @sa dvfs_trace_close()
+ */
+int dvfs_trace_open(dvfs_trace **ppTrace, const char *path);
+
+/**
+ * Reads the next sample of a trace.
+ *
+ * @param trace The trace, opened with dvfs_trace_open().
+ * @param ppSample Will be filled with the sample, valid until the next read, or NULL at the end of the trace.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c trace or \c ppSample are NULL, or if the trace is written.
+ *         \retval DVFS_ERROR_FILE_ERROR if the file holds an unknown record.
+ */
+int dvfs_trace_read(dvfs_trace *trace, const dvfs_trace_sample **ppSample);
+
+/**
+ * Gets the name of a governor read in a trace.
+ *
+ * @param trace The trace.
+ * @param id The id of the governor in the samples.
+ *
+ * @return The name, or NULL if the trace did not name this id.
+ */
+const char *dvfs_trace_gov_name(const dvfs_trace *trace, unsigned int id);
+
+/**
+ * Flushes and closes a trace.
+ *
+ * @param trace The trace.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c trace is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the end of the trace cannot be written.
+ */
+int dvfs_trace_close(dvfs_trace *trace);
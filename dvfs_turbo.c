@@ -0,0 +1,355 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dvfs_error.h"
+#include "dvfs_sysfs.h"
+#include "dvfs_turbo.h"
+
+#define INTEL_PSTATE_NO_TURBO_PATTERN "/devices/system/cpu/intel_pstate/no_turbo"
+#define CPUFREQ_BOOST_PATTERN "/devices/system/cpu/cpufreq/boost"
+#define POLICY_BOOST_PATTERN "/devices/system/cpu/cpu%u/cpufreq/boost"
+
+/**
+ * Gets the file holding the system wide setting.
+ */
+static int global_file(const dvfs_turbo *turbo, char *fname, size_t len)
+{
+   const char *pattern = turbo->ctrl == DVFS_TURBO_CTRL_INTEL_PSTATE ? INTEL_PSTATE_NO_TURBO_PATTERN : CPUFREQ_BOOST_PATTERN;
+   return dvfs_sysfs_path(fname, len, "%s", pattern);
+}
+
+/**
+ * Gets the boost file of the policy of a unit. The cpufreq directory of every
+ * core links to the directory of its policy, the first core is used.
+ */
+static int unit_file(const dvfs_unit *unit, char *fname, size_t len)
+{
+   return dvfs_sysfs_path(fname, len, POLICY_BOOST_PATTERN, unit->cores[0]->id);
+}
+
+static int read_global(const dvfs_turbo *turbo, bool *pEnabled)
+{
+   char fname[256];
+   unsigned int val;
+
+   int ret = global_file(turbo, fname, sizeof(fname));
+   if (ret == DVFS_SUCCESS)
+   {
+      ret = dvfs_sysfs_read_uint(fname, &val);
+   }
+   if (ret == DVFS_SUCCESS)
+   {
+      // no_turbo holds the opposite setting
+      *pEnabled = turbo->ctrl == DVFS_TURBO_CTRL_INTEL_PSTATE ? val == 0 : val != 0;
+   }
+   return ret;
+}
+
+static int write_global(const dvfs_turbo *turbo, bool enable)
+{
+   char fname[256];
+
+   int ret = global_file(turbo, fname, sizeof(fname));
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+   return dvfs_sysfs_write_uint(fname, turbo->ctrl == DVFS_TURBO_CTRL_INTEL_PSTATE ? !enable : enable);
+}
+
+static int read_unit(const dvfs_unit *unit, bool *pEnabled)
+{
+   char fname[256];
+   unsigned int val;
+
+   int ret = unit_file(unit, fname, sizeof(fname));
+   if (ret == DVFS_SUCCESS)
+   {
+      ret = dvfs_sysfs_read_uint(fname, &val);
+   }
+   if (ret == DVFS_SUCCESS)
+   {
+      *pEnabled = val != 0;
+   }
+   return ret;
+}
+
+static int write_unit(const dvfs_unit *unit, bool enable)
+{
+   char fname[256];
+
+   int ret = unit_file(unit, fname, sizeof(fname));
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+   return dvfs_sysfs_write_uint(fname, enable);
+}
+
+/**
+ * Looks for the index of a unit in the control.
+ */
+static int find_unit(const dvfs_turbo *turbo, const dvfs_unit *unit, unsigned int *pIdx)
+{
+   unsigned int i;
+
+   for (i = 0; i < turbo->nb_units; i++)
+   {
+      if (turbo->units[i] == unit)
+      {
+         *pIdx = i;
+         return DVFS_SUCCESS;
+      }
+   }
+   return DVFS_ERROR_INVALID_ARG;
+}
+
+/**
+ * Sets up the per policy control, requires a boost file for every unit.
+ */
+static int open_policies(dvfs_turbo *turbo, unsigned int nb_units, dvfs_unit **units)
+{
+   unsigned int i;
+
+   turbo->units = malloc(nb_units * sizeof(*turbo->units));
+   turbo->init_unit_enabled = malloc(nb_units * sizeof(*turbo->init_unit_enabled));
+   turbo->unit_changed = calloc(nb_units, sizeof(*turbo->unit_changed));
+   if (turbo->units == NULL || turbo->init_unit_enabled == NULL || turbo->unit_changed == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < nb_units; i++)
+   {
+      if (read_unit(units[i], &turbo->init_unit_enabled[i]) != DVFS_SUCCESS)
+      {
+         // the control is not available
+         return DVFS_SUCCESS;
+      }
+      turbo->units[i] = units[i];
+   }
+
+   turbo->nb_units = nb_units;
+   turbo->ctrl = DVFS_TURBO_CTRL_POLICY_BOOST;
+   return DVFS_SUCCESS;
+}
+
+int dvfs_turbo_open(dvfs_turbo **ppTurbo, unsigned int nb_units, dvfs_unit **units)
+{
+   assert(ppTurbo != NULL);
+   assert(units != NULL || nb_units == 0);
+   if (ppTurbo == NULL || (units == NULL && nb_units != 0))
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppTurbo = calloc(1, sizeof(**ppTurbo));
+   if (*ppTurbo == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   dvfs_turbo *turbo = *ppTurbo;
+
+   // system wide controls first, the per policy files may also exist but the
+   // global setting prevails
+   turbo->ctrl = DVFS_TURBO_CTRL_INTEL_PSTATE;
+   if (read_global(turbo, &turbo->init_enabled) == DVFS_SUCCESS)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   turbo->ctrl = DVFS_TURBO_CTRL_CPUFREQ_BOOST;
+   if (read_global(turbo, &turbo->init_enabled) == DVFS_SUCCESS)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   turbo->ctrl = DVFS_TURBO_CTRL_NONE;
+   if (nb_units == 0)
+   {
+      return DVFS_SUCCESS;
+   }
+
+   int ret = open_policies(turbo, nb_units, units);
+   if (ret != DVFS_SUCCESS)
+   {
+      dvfs_turbo_close(turbo);
+      *ppTurbo = NULL;
+   }
+   return ret;
+}
+
+int dvfs_turbo_close(dvfs_turbo *turbo)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(turbo != NULL);
+   if (turbo == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (turbo->changed && write_global(turbo, turbo->init_enabled) != DVFS_SUCCESS)
+   {
+      ret = DVFS_ERROR_FILE_ERROR;
+   }
+
+   for (i = 0; i < turbo->nb_units; i++)
+   {
+      if (turbo->unit_changed[i] && write_unit(turbo->units[i], turbo->init_unit_enabled[i]) != DVFS_SUCCESS)
+      {
+         ret = DVFS_ERROR_FILE_ERROR;
+      }
+   }
+
+   free(turbo->units);
+   free(turbo->init_unit_enabled);
+   free(turbo->unit_changed);
+   free(turbo);
+   return ret;
+}
+
+int dvfs_turbo_set(dvfs_turbo *turbo, bool enable)
+{
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(turbo != NULL);
+   if (turbo == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   switch (turbo->ctrl)
+   {
+      case DVFS_TURBO_CTRL_INTEL_PSTATE:
+      case DVFS_TURBO_CTRL_CPUFREQ_BOOST:
+         turbo->changed = true;
+         return write_global(turbo, enable);
+
+      case DVFS_TURBO_CTRL_POLICY_BOOST:
+         for (i = 0; i < turbo->nb_units; i++)
+         {
+            turbo->unit_changed[i] = true;
+            int uret = write_unit(turbo->units[i], enable);
+            if (uret != DVFS_SUCCESS)
+            {
+               ret = uret;
+            }
+         }
+         return ret;
+
+      default:
+         return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+}
+
+int dvfs_turbo_get(const dvfs_turbo *turbo, bool *pEnabled)
+{
+   unsigned int i;
+
+   assert(turbo != NULL);
+   assert(pEnabled != NULL);
+   if (turbo == NULL || pEnabled == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   switch (turbo->ctrl)
+   {
+      case DVFS_TURBO_CTRL_INTEL_PSTATE:
+      case DVFS_TURBO_CTRL_CPUFREQ_BOOST:
+         return read_global(turbo, pEnabled);
+
+      case DVFS_TURBO_CTRL_POLICY_BOOST:
+         *pEnabled = false;
+         for (i = 0; i < turbo->nb_units && !*pEnabled; i++)
+         {
+            int ret = read_unit(turbo->units[i], pEnabled);
+            if (ret != DVFS_SUCCESS)
+            {
+               return ret;
+            }
+         }
+         return DVFS_SUCCESS;
+
+      default:
+         return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+}
+
+int dvfs_turbo_set_unit(dvfs_turbo *turbo, const dvfs_unit *unit, bool enable)
+{
+   unsigned int idx;
+
+   assert(turbo != NULL);
+   assert(unit != NULL);
+   if (turbo == NULL || unit == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (turbo->ctrl != DVFS_TURBO_CTRL_POLICY_BOOST)
+   {
+      return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+
+   int ret = find_unit(turbo, unit, &idx);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   if (unit->cores[0]->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   turbo->unit_changed[idx] = true;
+   return write_unit(unit, enable);
+}
+
+int dvfs_turbo_get_unit(const dvfs_turbo *turbo, const dvfs_unit *unit, bool *pEnabled)
+{
+   assert(turbo != NULL);
+   assert(unit != NULL);
+   assert(pEnabled != NULL);
+   if (turbo == NULL || unit == NULL || pEnabled == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   switch (turbo->ctrl)
+   {
+      case DVFS_TURBO_CTRL_INTEL_PSTATE:
+      case DVFS_TURBO_CTRL_CPUFREQ_BOOST:
+         return read_global(turbo, pEnabled);
+
+      case DVFS_TURBO_CTRL_POLICY_BOOST:
+         return read_unit(unit, pEnabled);
+
+      default:
+         return DVFS_ERROR_TURBO_UNAVAILABLE;
+   }
+}
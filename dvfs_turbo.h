@@ -0,0 +1,143 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "dvfs_unit.h"
+
+/**
+ * @file dvfs_turbo.h
+ *
+ * Enables or disables the turbo frequencies. Depending on the cpufreq driver,
+ * the turbo is controlled for the whole system (\c intel_pstate/no_turbo or
+ * \c cpufreq/boost) or per cpufreq policy, that is per DVFS unit (per-policy
+ * \c boost file, for instance with \c amd-pstate). The setting found when
+ * opening the control is restored when closing it.
+ */
+
+/**
+ * Interfaces controlling the turbo frequencies.
+ */
+typedef enum {
+   DVFS_TURBO_CTRL_NONE = 0,        //!< The turbo cannot be controlled
+   DVFS_TURBO_CTRL_INTEL_PSTATE,    //!< System wide, through intel_pstate/no_turbo
+   DVFS_TURBO_CTRL_CPUFREQ_BOOST,   //!< System wide, through cpufreq/boost
+   DVFS_TURBO_CTRL_POLICY_BOOST,    //!< Per DVFS unit, through the boost file of each policy
+} dvfs_turbo_ctrl;
+
+/**
+ * Turbo control of the system.
+ */
+typedef struct {
+   dvfs_turbo_ctrl ctrl;         //!< Interface used to control the turbo
+   bool init_enabled;            //!< System wide setting when the control got initialised
+   bool changed;                 //!< True if the system wide setting has been changed
+   unsigned int nb_units;        //!< Number of DVFS units (per policy control only)
+   dvfs_unit **units;            //!< The DVFS units (per policy control only)
+   bool *init_unit_enabled;      //!< Setting of each unit when the control got initialised
+   bool *unit_changed;           //!< True if the setting of the unit has been changed
+} dvfs_turbo;
+
+/**
+ * Opens the turbo control, looking for the interfaces in the order
+ * \c intel_pstate/no_turbo, \c cpufreq/boost and per-policy \c boost. You are
+ * not supposed to directly call this function, the control is opened by
+ * \c dvfs_start().
+ *
+ * @param ppTurbo Will be filled with the turbo control.
+ * @param nb_units The number of DVFS units.
+ * @param units The DVFS units of the system.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right, even if no interface is available.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppTurbo or \c units are NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *
+ * @sa dvfs_turbo_close()
+ */
+int dvfs_turbo_open(dvfs_turbo **ppTurbo, unsigned int nb_units, dvfs_unit **units);
+
+/**
+ * Closes the turbo control. Sets back the settings that were in place when
+ * opening it.
+ *
+ * @param turbo The turbo control.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c turbo is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if a setting could not be restored.
+ */
+int dvfs_turbo_close(dvfs_turbo *turbo);
+
+/**
+ * Enables or disables the turbo frequencies on the whole system.
+ *
+ * @param turbo The turbo control.
+ * @param enable True to allow the turbo frequencies.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c turbo is NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the setting could not be written.
+ */
+int dvfs_turbo_set(dvfs_turbo *turbo, bool enable);
+
+/**
+ * Tells if the turbo frequencies are enabled. With a per policy control, the
+ * turbo is considered enabled if it is enabled on one of the units.
+ *
+ * @param turbo The turbo control.
+ * @param pEnabled Will be filled with the setting.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c turbo or \c pEnabled are NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the setting could not be read.
+ */
+int dvfs_turbo_get(const dvfs_turbo *turbo, bool *pEnabled);
+
+/**
+ * Enables or disables the turbo frequencies on one DVFS unit. Only available
+ * with a per policy control.
+ *
+ * @param turbo The turbo control.
+ * @param unit The DVFS unit.
+ * @param enable True to allow the turbo frequencies.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c turbo or \c unit are NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled per unit.
+ *         \retval DVFS_ERROR_FILE_ERROR if the setting could not be written.
+ *         \retval DVFS_ERROR_NOT_LEASED if the unit is fenced (see dvfs_lease.h).
+ */
+int dvfs_turbo_set_unit(dvfs_turbo *turbo, const dvfs_unit *unit, bool enable);
+
+/**
+ * Tells if the turbo frequencies are enabled on one DVFS unit. With a system
+ * wide control, gives the system wide setting.
+ *
+ * @param turbo The turbo control.
+ * @param unit The DVFS unit.
+ * @param pEnabled Will be filled with the setting.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c turbo, \c unit or \c pEnabled are NULL.
+ *         \retval DVFS_ERROR_TURBO_UNAVAILABLE if the turbo cannot be controlled.
+ *         \retval DVFS_ERROR_FILE_ERROR if the setting could not be read.
+ */
+int dvfs_turbo_get_unit(const dvfs_turbo *turbo, const dvfs_unit *unit, bool *pEnabled);
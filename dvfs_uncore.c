@@ -0,0 +1,203 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dvfs_uncore.h"
+#include "dvfs_error.h"
+#include "dvfs_sysfs.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// These patterns should be used in dvfs_sysfs_path functions
+#define UNCORE_DIR_PATTERN "/devices/system/cpu/intel_uncore_frequency/package_%02u_die_%02u"
+
+// Files in the domain directory
+#define UNCORE_HW_MIN_FILE "initial_min_freq_khz"
+#define UNCORE_HW_MAX_FILE "initial_max_freq_khz"
+#define UNCORE_MIN_FILE "min_freq_khz"
+#define UNCORE_MAX_FILE "max_freq_khz"
+#define UNCORE_CUR_FILE "current_freq_khz"
+
+static int read_uncore_file(const dvfs_uncore *uncore, const char *file, unsigned int *pVal)
+{
+   char fname[512];
+
+   if (snprintf(fname, sizeof(fname), "%s/%s", uncore->path, file) >= (int) sizeof(fname))
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   return dvfs_sysfs_read_uint(fname, pVal);
+}
+
+static int write_uncore_file(const dvfs_uncore *uncore, const char *file, unsigned int val)
+{
+   char fname[512];
+
+   if (snprintf(fname, sizeof(fname), "%s/%s", uncore->path, file) >= (int) sizeof(fname))
+   {
+      return DVFS_ERROR_BUFFER_TOO_SHORT;
+   }
+
+   return dvfs_sysfs_write_uint(fname, val);
+}
+
+int dvfs_uncore_open(dvfs_uncore **ppUncore, unsigned int package_id, unsigned int die_id)
+{
+   int ret;
+
+   assert(ppUncore != NULL);
+   if (ppUncore == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   *ppUncore = malloc(sizeof(**ppUncore));
+   if (*ppUncore == NULL)
+   {
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   dvfs_uncore *uncore = *ppUncore;
+   uncore->package_id = package_id;
+   uncore->die_id = die_id;
+   uncore->fenced = false;
+
+   ret = dvfs_sysfs_path(uncore->path, sizeof(uncore->path), UNCORE_DIR_PATTERN, package_id, die_id);
+   if (ret != DVFS_SUCCESS)
+   {
+      free(uncore), *ppUncore = NULL;
+      return ret;
+   }
+
+   // hardware range, then the limits to restore when closing
+   if ((ret = read_uncore_file(uncore, UNCORE_HW_MIN_FILE, &uncore->hw_min_freq)) != DVFS_SUCCESS
+       || (ret = read_uncore_file(uncore, UNCORE_HW_MAX_FILE, &uncore->hw_max_freq)) != DVFS_SUCCESS
+       || (ret = read_uncore_file(uncore, UNCORE_MIN_FILE, &uncore->init_min_freq)) != DVFS_SUCCESS
+       || (ret = read_uncore_file(uncore, UNCORE_MAX_FILE, &uncore->init_max_freq)) != DVFS_SUCCESS)
+   {
+      free(uncore), *ppUncore = NULL;
+      return ret;
+   }
+
+   return DVFS_SUCCESS;
+}
+
+int dvfs_uncore_close(dvfs_uncore *uncore)
+{
+   assert(uncore != NULL);
+   if (uncore == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   // restore the previous state, unless another context controls the domain
+   int ret = DVFS_SUCCESS;
+   if (!uncore->fenced)
+   {
+      ret = dvfs_uncore_set_limits(uncore, uncore->init_min_freq, uncore->init_max_freq);
+   }
+
+   free(uncore);
+
+   return ret;
+}
+
+int dvfs_uncore_set_limits(const dvfs_uncore *uncore, unsigned int min_freq, unsigned int max_freq)
+{
+   unsigned int cur_max = 0;
+   int ret;
+
+   assert(uncore != NULL);
+   if (uncore == NULL || min_freq > max_freq)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   if (min_freq < uncore->hw_min_freq || max_freq > uncore->hw_max_freq)
+   {
+      return DVFS_ERROR_INVALID_FREQ;
+   }
+
+   if (uncore->fenced)
+   {
+      return DVFS_ERROR_NOT_LEASED;
+   }
+
+   ret = read_uncore_file(uncore, UNCORE_MAX_FILE, &cur_max);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   // the driver rejects a lower limit above the upper one: when moving the
+   // range up, the upper limit goes first
+   if (min_freq > cur_max)
+   {
+      if ((ret = write_uncore_file(uncore, UNCORE_MAX_FILE, max_freq)) != DVFS_SUCCESS)
+      {
+         return ret;
+      }
+      return write_uncore_file(uncore, UNCORE_MIN_FILE, min_freq);
+   }
+
+   if ((ret = write_uncore_file(uncore, UNCORE_MIN_FILE, min_freq)) != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+   return write_uncore_file(uncore, UNCORE_MAX_FILE, max_freq);
+}
+
+int dvfs_uncore_set_freq(const dvfs_uncore *uncore, unsigned int freq)
+{
+   return dvfs_uncore_set_limits(uncore, freq, freq);
+}
+
+int dvfs_uncore_get_limits(const dvfs_uncore *uncore, unsigned int *pMin, unsigned int *pMax)
+{
+   int ret;
+
+   assert(uncore != NULL);
+   assert(pMin != NULL);
+   assert(pMax != NULL);
+   if (uncore == NULL || pMin == NULL || pMax == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   ret = read_uncore_file(uncore, UNCORE_MIN_FILE, pMin);
+   if (ret != DVFS_SUCCESS)
+   {
+      return ret;
+   }
+
+   return read_uncore_file(uncore, UNCORE_MAX_FILE, pMax);
+}
+
+int dvfs_uncore_get_current_freq(const dvfs_uncore *uncore, unsigned int *pFreq)
+{
+   assert(uncore != NULL);
+   assert(pFreq != NULL);
+   if (uncore == NULL || pFreq == NULL)
+   {
+      return DVFS_ERROR_INVALID_ARG;
+   }
+
+   return read_uncore_file(uncore, UNCORE_CUR_FILE, pFreq);
+}
@@ -0,0 +1,131 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * @file dvfs_uncore.h
+ *
+ * Structures and functions to control the uncore frequency (caches, memory
+ * controller, interconnect) of a package die. The control relies on the
+ * \c intel_uncore_frequency driver, which exposes a frequency range per die.
+ * All the frequencies are expressed in kHz, as for the cores.
+ */
+
+/**
+ * Represents an uncore frequency domain, that is a die of a package.
+ */
+typedef struct {
+   unsigned int package_id;      //!< Package id as declared by Linux
+   unsigned int die_id;          //!< Die id in the package
+   char path[256];               //!< Directory of the domain in sysfs
+
+   unsigned int hw_min_freq;     //!< Lowest frequency allowed by the hardware
+   unsigned int hw_max_freq;     //!< Highest frequency allowed by the hardware
+
+   unsigned int init_min_freq;   //!< Lower limit set when the domain got initialised
+   unsigned int init_max_freq;   //!< Upper limit set when the domain got initialised
+
+   bool fenced;                  //!< True if the domain is shared with units leased by another context (see dvfs_lease.h): changes are refused and the state is not restored
+} dvfs_uncore;
+
+/**
+ * Opens the uncore frequency domain of the given package die. You are not
+ * supposed to directly call this function, the domains are opened by
+ * \c dvfs_start().
+ *
+ * @param ppUncore Will be filled with the new domain.
+ * @param package_id The package id.
+ * @param die_id The die id in the package.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c ppUncore is NULL.
+ *         \retval DVFS_ERROR_MEM_ALLOC_FAILED if memory allocation failed.
+ *         \retval DVFS_ERROR_BUFFER_TOO_SHORT if the buffer for the path to the domain is too short.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ *
+ * @sa dvfs_uncore_close()
+ */
+int dvfs_uncore_open(dvfs_uncore **ppUncore, unsigned int package_id, unsigned int die_id);
+
+/**
+ * Closes an uncore frequency domain. Sets back the limits that were in place
+ * when opening it, unless the domain is fenced.
+ *
+ * @param uncore The domain to close.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c uncore is NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR if the initial limits could not be restored.
+ */
+int dvfs_uncore_close(dvfs_uncore *uncore);
+
+/**
+ * Sets the frequency range of the uncore domain. The limits are written in
+ * the order keeping the range valid at any time.
+ *
+ * @param uncore The uncore domain.
+ * @param min_freq The lower limit.
+ * @param max_freq The upper limit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c uncore is NULL or the range is empty.
+ *         \retval DVFS_ERROR_INVALID_FREQ if the range is out of the hardware limits.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ *         \retval DVFS_ERROR_NOT_LEASED if the domain is fenced.
+ */
+int dvfs_uncore_set_limits(const dvfs_uncore *uncore, unsigned int min_freq, unsigned int max_freq);
+
+/**
+ * Pins the uncore domain to the given frequency (lower and upper limits are
+ * both set to it).
+ *
+ * @param uncore The uncore domain.
+ * @param freq The frequency to set.
+ *
+ * @return See dvfs_uncore_set_limits().
+ */
+int dvfs_uncore_set_freq(const dvfs_uncore *uncore, unsigned int freq);
+
+/**
+ * Gets the frequency range currently set on the uncore domain.
+ *
+ * @param uncore The uncore domain.
+ * @param pMin Will be filled with the lower limit.
+ * @param pMax Will be filled with the upper limit.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c uncore, \c pMin or \c pMax are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ */
+int dvfs_uncore_get_limits(const dvfs_uncore *uncore, unsigned int *pMin, unsigned int *pMax);
+
+/**
+ * Gets the current frequency of the uncore domain. Requires a kernel exposing
+ * \c current_freq_khz.
+ *
+ * @param uncore The uncore domain.
+ * @param pFreq Will be filled with the current frequency.
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c uncore or \c pFreq are NULL.
+ *         \retval DVFS_ERROR_FILE_ERROR operation on file failed (you can check errno for more details).
+ */
+int dvfs_uncore_get_current_freq(const dvfs_uncore *uncore, unsigned int *pFreq);
@@ -40,6 +40,7 @@ int dvfs_unit_open(dvfs_unit** ppUnit, unsigned int nb_cores, dvfs_core **cores,
    (*ppUnit)->nb_cores = nb_cores;
    (*ppUnit)->cores = cores;
    (*ppUnit)->id = unit_id;
+   (*ppUnit)->state = NULL;
 
    return DVFS_SUCCESS;
 }
@@ -86,6 +87,28 @@ int dvfs_unit_set_gov(const dvfs_unit *unit, const char *gov) {
    return ret;
 }
 
+int dvfs_unit_set_gov_id(const dvfs_unit *unit, unsigned int id) {
+   unsigned int i;
+   int ret = DVFS_SUCCESS;
+
+   assert(unit != NULL);
+   if ( unit == NULL )
+   {
+       return DVFS_ERROR_INVALID_ARG;
+   }
+
+   for (i = 0; i < unit->nb_cores; i++) {
+      int cret = dvfs_core_set_gov_id (unit->cores[i], id);
+      if (cret != DVFS_SUCCESS )
+      {
+         fprintf (stderr, "[LIBDVFS][ERROR] unitSetGovId: error for core #%u\n", i);
+         ret=cret; // Report last error to calling function
+      }
+   }
+
+   return ret;
+}
+
 int dvfs_unit_set_freq(const dvfs_unit *unit, unsigned int freq) {
    unsigned int i;
    int ret = DVFS_SUCCESS;
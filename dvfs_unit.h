@@ -20,6 +20,8 @@
 
 #include "dvfs_core.h"
 
+struct dvfs_state_record;
+
 /**
  * @file dvfs_unit.h
  *
@@ -41,6 +43,7 @@ typedef struct {
    unsigned int id;      //!< Unit id as described in the dvfs_context structure
    unsigned int nb_cores;     //!< Number of cores in the unit
    dvfs_core **cores;         //!< Cores in the unit
+   struct dvfs_state_record *state;   //!< Published state of the unit (see dvfs_state.h), NULL if not published
 } dvfs_unit;
 
 /**
@@ -88,6 +91,18 @@ int dvfs_unit_close(dvfs_unit *unit);
  */
 int dvfs_unit_set_gov(const dvfs_unit *unit, const char *gov);
 
+/**
+ * Sets a governor given by id on all the cores we are in charge of.
+ *
+ * @param unit The DVFS unit.
+ * @param id The id of the governor, see dvfs_gov_get_id().
+ *
+ * @return \retval DVFS_SUCCESS if everything goes right.
+ *         \retval DVFS_ERROR_INVALID_ARG if \c unit is NULL.
+ *         \retval DVFS_ERROR_INVALID_GOV if the governor is not available on a core.
+ */
+int dvfs_unit_set_gov_id(const dvfs_unit *unit, unsigned int id);
+
 /**
  * Sets the given frequency on all the unit cores. The effect is unknown if the
  * current governor is not "userspace".
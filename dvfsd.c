@@ -0,0 +1,142 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Daemon owning the DVFS context of the machine and serving the frequency
+ * requests of unprivileged processes (see dvfs_server.h and dvfs_client.h).
+ * Meant to be run as root by a system service.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+#include "dvfs_proto.h"
+
+static dvfs_server *server;
+
+static void on_signal(int sig) {
+   (void) sig;
+   dvfs_server_stop(server);
+}
+
+static void usage(const char *name) {
+   printf("Serves the frequency requests of unprivileged processes\n\n");
+   printf("Usage: %s [-s socket] [-p uid:min_freq:max_freq]... [-d min_freq:max_freq] [-m]\n", name);
+   printf("  -s  Path of the socket, %s unless set in the %s environment variable\n", DVFS_SOCKET_DEFAULT_PATH, DVFS_SOCKET_PATH_ENV);
+   printf("  -p  Limits the frequencies requested by the processes of a user\n");
+   printf("  -d  Accepts the users without a policy within these frequencies, they are refused otherwise\n");
+   printf("  -m  Uses the in-memory mock backend instead of the hardware (testing)\n");
+}
+
+int main(int argc, char **argv) {
+   const dvfs_backend *backend = &dvfs_backend_sysfs;
+   const char *path = NULL;
+   dvfs_ctx *ctx = NULL;
+   unsigned int nb_policies = 0;
+   unsigned int uids[64], mins[64], maxs[64];
+   unsigned int def_min = 0, def_max = 0;
+   bool has_default = false;
+   struct sigaction sa;
+   unsigned int i;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "s:p:d:mh")) != -1) {
+      switch (opt) {
+         case 's':
+            path = optarg;
+            break;
+         case 'p':
+            if (nb_policies == sizeof(uids) / sizeof(*uids)
+                  || sscanf(optarg, "%u:%u:%u", &uids[nb_policies], &mins[nb_policies], &maxs[nb_policies]) != 3) {
+               usage(argv[0]);
+               return EXIT_FAILURE;
+            }
+            nb_policies++;
+            break;
+         case 'd':
+            if (sscanf(optarg, "%u:%u", &def_min, &def_max) != 2) {
+               usage(argv[0]);
+               return EXIT_FAILURE;
+            }
+            has_default = true;
+            break;
+         case 'm':
+            backend = &dvfs_backend_mock;
+            break;
+         case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+         default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+
+   int result = dvfs_start_backend(&ctx, false, backend);
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to start the library (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   result = dvfs_server_open(&server, ctx, path);
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to open the socket (%s).\n", dvfs_strerror(result));
+      dvfs_stop(ctx);
+      return EXIT_FAILURE;
+   }
+
+   for (i = 0; i < nb_policies; i++) {
+      result = dvfs_server_set_policy(server, uids[i], mins[i], maxs[i]);
+      if (result != DVFS_SUCCESS) {
+         printf("Invalid policy for user %u (%s).\n", uids[i], dvfs_strerror(result));
+         dvfs_server_close(server);
+         dvfs_stop(ctx);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (has_default) {
+      result = dvfs_server_set_default_policy(server, def_min, def_max);
+      if (result != DVFS_SUCCESS) {
+         printf("Invalid default policy (%s).\n", dvfs_strerror(result));
+         dvfs_server_close(server);
+         dvfs_stop(ctx);
+         return EXIT_FAILURE;
+      }
+   }
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = on_signal;
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+
+   result = dvfs_server_run(server);
+
+   dvfs_server_stats stats;
+   dvfs_server_get_stats(server, &stats);
+   printf("%llu client(s), %llu request(s), %llu frequency change(s)\n", stats.nb_accepted, stats.nb_requests, stats.nb_writes);
+
+   dvfs_server_close(server);
+   dvfs_stop(ctx);
+   return result == DVFS_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,688 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Monitor sampling the current frequency and the governor of every core, and
+ * optionally their effective frequency (APERF/MPERF) and the energy of the
+ * packages, at up to several kHz. The samples are written in a compact trace
+ * (see dvfs_trace.h), exported afterwards as CSV or as a summary. The monitor
+ * pins itself on a core so it does not disturb the workload, and reports its
+ * own CPU overhead.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+#include "dvfs_bulk.h"
+#include "dvfs_msr.h"
+#include "dvfs_sysfs.h"
+#include "dvfs_trace.h"
+
+#define PLATFORM_INFO_MAX_RATIO(val) (((val) >> 8) & 0xFF)
+
+// Sampling rates of the overhead measure (Hz)
+static const unsigned int bench_rates[] = { 10, 100, 1000, 5000 };
+
+static volatile sig_atomic_t stop;
+
+/**
+ * Meters of the cores and the packages.
+ */
+typedef struct {
+   dvfs_ctx *ctx;
+   uint32_t flags;
+
+   unsigned int nb_cores;
+   const dvfs_core **cores;
+   unsigned int *core_ids;
+   dvfs_bulk *bulk;
+   int *gov_fds;
+   int *msr_fds;
+   unsigned int *base_freqs;
+   uint64_t *aperfs;
+   uint64_t *mperfs;
+
+   unsigned int nb_packages;
+   int *energy_fds;
+   unsigned long long *energy_ranges;
+   unsigned long long *energies;
+
+   dvfs_trace_sample sample;
+} monitor;
+
+/**
+ * Overhead of a run.
+ */
+typedef struct {
+   unsigned long long nb_samples;
+   unsigned long long nb_missed;
+   double elapsed;
+   double cpu;
+} overhead;
+
+static void on_signal(int sig) {
+   (void) sig;
+   stop = 1;
+}
+
+static void usage(const char *name) {
+   printf("Samples the frequency of the cores\n\n");
+   printf("Usage: %s [-i interval] [-d duration] [-c core] [-a] [-e] [-m] -o trace\n", name);
+   printf("       %s [-d duration] [-c core] [-a] [-e] [-m] -B\n", name);
+   printf("       %s [-s] -x trace\n", name);
+   printf("  -o  Records the samples in the trace\n");
+   printf("  -i  Sampling interval in microseconds (default 10000)\n");
+   printf("  -d  Duration in seconds, 0 to run until interrupted (default 0, 1 with -B)\n");
+   printf("  -c  Core the monitor runs on\n");
+   printf("  -a  Records the effective frequency (APERF/MPERF)\n");
+   printf("  -e  Records the energy of the packages (RAPL)\n");
+   printf("  -m  Uses the in-memory mock backend instead of the hardware (testing)\n");
+   printf("  -B  Measures the overhead of the monitor at several sampling rates\n");
+   printf("  -x  Exports a trace as CSV\n");
+   printf("  -s  Prints a summary of the trace instead of the CSV\n");
+}
+
+static uint64_t now_ns(clockid_t clock) {
+   struct timespec ts;
+
+   clock_gettime(clock, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int read_energy(int fd, unsigned long long *pEnergy) {
+   char buf[32];
+   ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+   if (len <= 0) {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+   *pEnergy = strtoull(buf, NULL, 10);
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Opens the energy counters of the packages of the cores.
+ */
+static void open_energy(monitor *mon) {
+   unsigned int packages[256];
+   char fname[1024];
+   unsigned int i, j;
+
+   for (i = 0; i < mon->nb_cores; i++) {
+      unsigned int package = 0;
+
+      if (dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/topology/physical_package_id", mon->core_ids[i]) == DVFS_SUCCESS) {
+         dvfs_sysfs_read_uint(fname, &package);
+      }
+      for (j = 0; j < mon->nb_packages && packages[j] != package; j++);
+      if (j == mon->nb_packages && mon->nb_packages < sizeof(packages) / sizeof(*packages)) {
+         packages[mon->nb_packages++] = package;
+      }
+   }
+
+   for (i = 0; i < mon->nb_packages; i++) {
+      FILE *f;
+
+      mon->energy_fds[i] = -1;
+      mon->energy_ranges[i] = 0;
+      if (dvfs_sysfs_path(fname, sizeof(fname), "/class/powercap/intel-rapl:%u/energy_uj", packages[i]) == DVFS_SUCCESS) {
+         mon->energy_fds[i] = open(fname, O_RDONLY | O_CLOEXEC);
+      }
+      if (mon->energy_fds[i] == -1
+          || dvfs_sysfs_path(fname, sizeof(fname), "/class/powercap/intel-rapl:%u/max_energy_range_uj", packages[i]) != DVFS_SUCCESS) {
+         continue;
+      }
+      f = fopen(fname, "r");
+      if (f != NULL) {
+         if (fscanf(f, "%llu", &mon->energy_ranges[i]) != 1) {
+            mon->energy_ranges[i] = 0;
+         }
+         fclose(f);
+      }
+   }
+}
+
+/**
+ * Opens the files read at every sample without the semaphore of the cores: the
+ * current frequencies through a bulk access, and the governors. The cores of
+ * the other backends keep the accessors of the library.
+ */
+static void open_sysfs(monitor *mon) {
+   char fname[1024];
+   unsigned int i;
+
+   for (i = 0; i < mon->nb_cores; i++) {
+      mon->gov_fds[i] = -1;
+      if (mon->cores[i]->backend == &dvfs_backend_sysfs
+          && dvfs_sysfs_path(fname, sizeof(fname), "/devices/system/cpu/cpu%u/cpufreq/scaling_governor", mon->core_ids[i]) == DVFS_SUCCESS) {
+         mon->gov_fds[i] = open(fname, O_RDONLY | O_CLOEXEC);
+      }
+   }
+
+   // the io_uring workers could run on the cores of the workload
+   if (dvfs_bulk_open(&mon->bulk, mon->ctx->nb_units, mon->ctx->units, false) != DVFS_SUCCESS) {
+      mon->bulk = NULL;
+   }
+}
+
+static int read_gov(int fd, unsigned int *pId) {
+   char buf[DVFS_GOV_NAME_LEN];
+   ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+   if (len <= 0) {
+      return DVFS_ERROR_FILE_ERROR;
+   }
+   buf[len] = '\0';
+   buf[strcspn(buf, "\n")] = '\0';
+   return dvfs_gov_intern(buf, pId);
+}
+
+/**
+ * Opens the MSR devices of the cores to read APERF/MPERF.
+ */
+static void open_msrs(monitor *mon) {
+   unsigned int i;
+   uint64_t info;
+
+   for (i = 0; i < mon->nb_cores; i++) {
+      mon->msr_fds[i] = -1;
+      mon->base_freqs[i] = 0;
+      if (!mon->ctx->features.aperf_mperf || dvfs_msr_open(mon->core_ids[i], O_RDONLY, &mon->msr_fds[i]) != DVFS_SUCCESS) {
+         mon->msr_fds[i] = -1;
+         continue;
+      }
+
+      // MPERF counts at the highest non-turbo ratio
+      if (dvfs_msr_read(mon->msr_fds[i], DVFS_MSR_PLATFORM_INFO, &info) == DVFS_SUCCESS) {
+         mon->base_freqs[i] = PLATFORM_INFO_MAX_RATIO(info) * DVFS_MSR_BUS_CLOCK;
+      }
+      if (mon->base_freqs[i] == 0) {
+         close(mon->msr_fds[i]);
+         mon->msr_fds[i] = -1;
+      }
+   }
+}
+
+static void monitor_close(monitor *mon) {
+   unsigned int i;
+
+   if (mon->bulk != NULL) {
+      dvfs_bulk_close(mon->bulk);
+   }
+   for (i = 0; mon->gov_fds != NULL && i < mon->nb_cores; i++) {
+      if (mon->gov_fds[i] != -1) {
+         close(mon->gov_fds[i]);
+      }
+   }
+   for (i = 0; mon->msr_fds != NULL && i < mon->nb_cores; i++) {
+      if (mon->msr_fds[i] != -1) {
+         close(mon->msr_fds[i]);
+      }
+   }
+   for (i = 0; mon->energy_fds != NULL && i < mon->nb_packages; i++) {
+      if (mon->energy_fds[i] != -1) {
+         close(mon->energy_fds[i]);
+      }
+   }
+   free(mon->cores);
+   free(mon->core_ids);
+   free(mon->gov_fds);
+   free(mon->msr_fds);
+   free(mon->base_freqs);
+   free(mon->aperfs);
+   free(mon->mperfs);
+   free(mon->energy_fds);
+   free(mon->energy_ranges);
+   free(mon->energies);
+   free(mon->sample.freqs);
+   free(mon->sample.gov_ids);
+   free(mon->sample.eff_freqs);
+   free(mon->sample.energies);
+}
+
+static int monitor_open(monitor *mon, dvfs_ctx *ctx, uint32_t flags) {
+   unsigned int i, j, n = 0;
+
+   memset(mon, 0, sizeof(*mon));
+   mon->ctx = ctx;
+   mon->flags = flags;
+   for (i = 0; i < ctx->nb_units; i++) {
+      mon->nb_cores += ctx->units[i]->nb_cores;
+   }
+
+   mon->cores = malloc(mon->nb_cores * sizeof(*mon->cores));
+   mon->core_ids = malloc(mon->nb_cores * sizeof(*mon->core_ids));
+   mon->gov_fds = malloc(mon->nb_cores * sizeof(*mon->gov_fds));
+   mon->msr_fds = malloc(mon->nb_cores * sizeof(*mon->msr_fds));
+   mon->base_freqs = malloc(mon->nb_cores * sizeof(*mon->base_freqs));
+   mon->aperfs = calloc(mon->nb_cores, sizeof(*mon->aperfs));
+   mon->mperfs = calloc(mon->nb_cores, sizeof(*mon->mperfs));
+   mon->energy_fds = malloc(mon->nb_cores * sizeof(*mon->energy_fds));
+   mon->energy_ranges = malloc(mon->nb_cores * sizeof(*mon->energy_ranges));
+   mon->energies = calloc(mon->nb_cores, sizeof(*mon->energies));
+   mon->sample.freqs = calloc(mon->nb_cores, sizeof(*mon->sample.freqs));
+   mon->sample.gov_ids = calloc(mon->nb_cores, sizeof(*mon->sample.gov_ids));
+   mon->sample.eff_freqs = calloc(mon->nb_cores, sizeof(*mon->sample.eff_freqs));
+   mon->sample.energies = calloc(mon->nb_cores, sizeof(*mon->sample.energies));
+   if (mon->cores == NULL || mon->core_ids == NULL || mon->gov_fds == NULL || mon->msr_fds == NULL || mon->base_freqs == NULL
+       || mon->aperfs == NULL || mon->mperfs == NULL || mon->energy_fds == NULL || mon->energy_ranges == NULL
+       || mon->energies == NULL || mon->sample.freqs == NULL || mon->sample.gov_ids == NULL
+       || mon->sample.eff_freqs == NULL || mon->sample.energies == NULL) {
+      monitor_close(mon);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < ctx->nb_units; i++) {
+      for (j = 0; j < ctx->units[i]->nb_cores; j++, n++) {
+         mon->cores[n] = ctx->units[i]->cores[j];
+         mon->core_ids[n] = mon->cores[n]->id;
+         mon->gov_fds[n] = -1;
+         mon->msr_fds[n] = -1;
+      }
+   }
+
+   open_sysfs(mon);
+
+   if (flags & DVFS_TRACE_EFF_FREQ) {
+      open_msrs(mon);
+   }
+   if (flags & DVFS_TRACE_ENERGY) {
+      open_energy(mon);
+   }
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Reads the meters. The effective frequencies and the energies are the ones
+ * since the previous read. The sysfs cores are read without their semaphore,
+ * which would serialize the monitor with every transition of the machine.
+ */
+static void monitor_sample(monitor *mon) {
+   char gov[DVFS_GOV_NAME_LEN];
+   unsigned int i;
+
+   // the bulk fills 0 for the frequencies it cannot read
+   if (mon->bulk != NULL) {
+      dvfs_bulk_read_freqs(mon->bulk, mon->sample.freqs);
+   }
+
+   for (i = 0; i < mon->nb_cores; i++) {
+      const dvfs_core *core = mon->cores[i];
+      uint64_t aperf, mperf;
+
+      if (mon->bulk == NULL && dvfs_core_get_current_freq(core, &mon->sample.freqs[i]) != DVFS_SUCCESS) {
+         mon->sample.freqs[i] = 0;
+      }
+
+      if (mon->gov_fds[i] != -1) {
+         if (read_gov(mon->gov_fds[i], &mon->sample.gov_ids[i]) != DVFS_SUCCESS) {
+            mon->sample.gov_ids[i] = DVFS_TRACE_NO_GOV;
+         }
+      } else if (dvfs_core_get_gov(core, gov, sizeof(gov)) != DVFS_SUCCESS
+                 || dvfs_gov_intern(gov, &mon->sample.gov_ids[i]) != DVFS_SUCCESS) {
+         mon->sample.gov_ids[i] = DVFS_TRACE_NO_GOV;
+      }
+
+      if (mon->msr_fds[i] == -1
+          || dvfs_msr_read(mon->msr_fds[i], DVFS_MSR_IA32_APERF, &aperf) != DVFS_SUCCESS
+          || dvfs_msr_read(mon->msr_fds[i], DVFS_MSR_IA32_MPERF, &mperf) != DVFS_SUCCESS) {
+         mon->sample.eff_freqs[i] = 0;
+         continue;
+      }
+
+      // a halted core has no effective frequency
+      mon->sample.eff_freqs[i] = mperf == mon->mperfs[i] ? 0
+         : (double) mon->base_freqs[i] * (aperf - mon->aperfs[i]) / (mperf - mon->mperfs[i]);
+      mon->aperfs[i] = aperf;
+      mon->mperfs[i] = mperf;
+   }
+
+   for (i = 0; i < mon->nb_packages; i++) {
+      unsigned long long energy;
+
+      mon->sample.energies[i] = 0;
+      if (mon->energy_fds[i] == -1 || read_energy(mon->energy_fds[i], &energy) != DVFS_SUCCESS) {
+         continue;
+      }
+      if (energy >= mon->energies[i]) {
+         mon->sample.energies[i] = energy - mon->energies[i];
+      } else if (mon->energy_ranges[i] != 0) {
+         mon->sample.energies[i] = mon->energy_ranges[i] - mon->energies[i] + energy;
+      }
+      mon->energies[i] = energy;
+   }
+}
+
+/**
+ * Samples every interval until the duration or a signal, and writes the
+ * samples in the trace if any.
+ */
+static int monitor_run(monitor *mon, dvfs_trace *trace, uint64_t interval_ns, uint64_t duration_ns, overhead *pOverhead) {
+   uint64_t start, next, now, cpu_start;
+   struct timespec deadline;
+   int result = DVFS_SUCCESS;
+
+   memset(pOverhead, 0, sizeof(*pOverhead));
+   cpu_start = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+   start = now_ns(CLOCK_MONOTONIC);
+
+   // the first read only sets the references of the differences
+   monitor_sample(mon);
+
+   next = start + interval_ns;
+   while (!stop && (duration_ns == 0 || next - start <= duration_ns)) {
+      deadline.tv_sec = next / 1000000000ULL;
+      deadline.tv_nsec = next % 1000000000ULL;
+      if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0) {
+         continue;
+      }
+
+      now = now_ns(CLOCK_MONOTONIC);
+      monitor_sample(mon);
+      mon->sample.time_ns = now - start;
+      pOverhead->nb_samples++;
+      if (trace != NULL) {
+         result = dvfs_trace_write(trace, &mon->sample);
+         if (result != DVFS_SUCCESS) {
+            break;
+         }
+      }
+
+      // the deadlines already passed are skipped
+      next += interval_ns;
+      now = now_ns(CLOCK_MONOTONIC);
+      if (now > next) {
+         uint64_t late = (now - next) / interval_ns + 1;
+         pOverhead->nb_missed += late;
+         next += late * interval_ns;
+      }
+   }
+
+   pOverhead->elapsed = (now_ns(CLOCK_MONOTONIC) - start) * 1e-9;
+   pOverhead->cpu = (now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start) * 1e-9;
+   return result;
+}
+
+static void print_overhead(FILE *out, uint64_t interval_ns, const overhead *o) {
+   fprintf(out, "%8.0f Hz %10llu samples %8llu missed %8.2f us/sample %7.3f %% cpu\n",
+           1e9 / interval_ns, o->nb_samples, o->nb_missed,
+           o->nb_samples != 0 ? o->cpu * 1e6 / o->nb_samples : 0, o->elapsed > 0 ? o->cpu * 100 / o->elapsed : 0);
+}
+
+static void print_csv(dvfs_trace *trace) {
+   const dvfs_trace_header *header = &trace->header;
+   const dvfs_trace_sample *sample;
+   uint64_t prev_ns = 0;
+   unsigned int i;
+
+   printf("time_s");
+   for (i = 0; i < header->nb_cores; i++) {
+      printf(",cpu%u_khz,cpu%u_gov", header->core_ids[i], header->core_ids[i]);
+      if (header->flags & DVFS_TRACE_EFF_FREQ) {
+         printf(",cpu%u_eff_khz", header->core_ids[i]);
+      }
+   }
+   for (i = 0; (header->flags & DVFS_TRACE_ENERGY) && i < header->nb_packages; i++) {
+      printf(",pkg%u_w", i);
+   }
+   printf("\n");
+
+   while (dvfs_trace_read(trace, &sample) == DVFS_SUCCESS && sample != NULL) {
+      double dt = (sample->time_ns - prev_ns) * 1e-9;
+
+      printf("%.6f", sample->time_ns * 1e-9);
+      for (i = 0; i < header->nb_cores; i++) {
+         const char *gov = dvfs_trace_gov_name(trace, sample->gov_ids[i]);
+         printf(",%u,%s", sample->freqs[i], gov != NULL ? gov : "");
+         if (header->flags & DVFS_TRACE_EFF_FREQ) {
+            printf(",%u", sample->eff_freqs[i]);
+         }
+      }
+      for (i = 0; (header->flags & DVFS_TRACE_ENERGY) && i < header->nb_packages; i++) {
+         printf(",%.3f", dt > 0 ? sample->energies[i] * 1e-6 / dt : 0);
+      }
+      printf("\n");
+      prev_ns = sample->time_ns;
+   }
+}
+
+static int print_summary(dvfs_trace *trace, const char *path) {
+   const dvfs_trace_header *header = &trace->header;
+   const dvfs_trace_sample *sample;
+   unsigned int *mins, *maxs, *govs, *lasts;
+   double *sums, *eff_sums, *energies;
+   unsigned long long *changes;
+   uint64_t duration_ns = 0;
+   struct stat st;
+   unsigned int i;
+
+   mins = malloc(header->nb_cores * sizeof(*mins));
+   maxs = calloc(header->nb_cores, sizeof(*maxs));
+   govs = malloc(header->nb_cores * sizeof(*govs));
+   lasts = calloc(header->nb_cores, sizeof(*lasts));
+   sums = calloc(header->nb_cores, sizeof(*sums));
+   eff_sums = calloc(header->nb_cores, sizeof(*eff_sums));
+   changes = calloc(header->nb_cores, sizeof(*changes));
+   energies = calloc(header->nb_packages + 1, sizeof(*energies));
+   if (mins == NULL || maxs == NULL || govs == NULL || lasts == NULL || sums == NULL || eff_sums == NULL
+       || changes == NULL || energies == NULL) {
+      free(mins), free(maxs), free(govs), free(lasts), free(sums), free(eff_sums), free(changes), free(energies);
+      return DVFS_ERROR_MEM_ALLOC_FAILED;
+   }
+
+   for (i = 0; i < header->nb_cores; i++) {
+      mins[i] = -1U;
+      govs[i] = DVFS_TRACE_NO_GOV;
+   }
+
+   while (dvfs_trace_read(trace, &sample) == DVFS_SUCCESS && sample != NULL) {
+      for (i = 0; i < header->nb_cores; i++) {
+         if (trace->nb_samples > 1 && sample->freqs[i] != lasts[i]) {
+            changes[i]++;
+         }
+         lasts[i] = sample->freqs[i];
+         mins[i] = sample->freqs[i] < mins[i] ? sample->freqs[i] : mins[i];
+         maxs[i] = sample->freqs[i] > maxs[i] ? sample->freqs[i] : maxs[i];
+         sums[i] += sample->freqs[i];
+         eff_sums[i] += sample->eff_freqs[i];
+         govs[i] = sample->gov_ids[i];
+      }
+      for (i = 0; (header->flags & DVFS_TRACE_ENERGY) && i < header->nb_packages; i++) {
+         energies[i] += sample->energies[i] * 1e-6;
+      }
+      duration_ns = sample->time_ns;
+   }
+
+   printf("%llu samples over %.3f s, interval %.0f us", trace->nb_samples, duration_ns * 1e-9, header->interval_ns * 1e-3);
+   if (trace->nb_samples != 0 && stat(path, &st) == 0) {
+      printf(", %.1f bytes/sample", (double) st.st_size / trace->nb_samples);
+   }
+   printf("\n");
+
+   for (i = 0; i < header->nb_cores && trace->nb_samples != 0; i++) {
+      const char *gov = dvfs_trace_gov_name(trace, govs[i]);
+      printf("cpu %3u %-12s min %8u kHz avg %8.0f kHz max %8u kHz %8llu changes", header->core_ids[i], gov != NULL ? gov : "?",
+             mins[i], sums[i] / trace->nb_samples, maxs[i], changes[i]);
+      if (header->flags & DVFS_TRACE_EFF_FREQ) {
+         printf(" effective %8.0f kHz", eff_sums[i] / trace->nb_samples);
+      }
+      printf("\n");
+   }
+   for (i = 0; (header->flags & DVFS_TRACE_ENERGY) && i < header->nb_packages; i++) {
+      printf("package %u %10.3f J %8.3f W\n", i, energies[i], duration_ns != 0 ? energies[i] / (duration_ns * 1e-9) : 0);
+   }
+
+   free(mins), free(maxs), free(govs), free(lasts), free(sums), free(eff_sums), free(changes), free(energies);
+   return DVFS_SUCCESS;
+}
+
+static int export(const char *path, bool summary) {
+   dvfs_trace *trace = NULL;
+   int result = dvfs_trace_open(&trace, path);
+
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to read the trace %s (%s).\n", path, dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   if (summary) {
+      result = print_summary(trace, path);
+   } else {
+      print_csv(trace);
+   }
+
+   dvfs_trace_close(trace);
+   return result == DVFS_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+   const dvfs_backend *backend = &dvfs_backend_sysfs;
+   const char *path = NULL, *export_path = NULL;
+   unsigned int interval_us = 10000, i;
+   double duration = -1;
+   int pin = -1;
+   bool bench = false, summary = false;
+   uint32_t flags = 0;
+   dvfs_ctx *ctx = NULL;
+   struct sigaction sa;
+   monitor mon;
+   overhead o;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "o:i:d:c:aemBx:sh")) != -1) {
+      switch (opt) {
+         case 'o':
+            path = optarg;
+            break;
+         case 'i':
+            interval_us = strtoul(optarg, NULL, 10);
+            break;
+         case 'd':
+            duration = strtod(optarg, NULL);
+            break;
+         case 'c':
+            pin = atoi(optarg);
+            break;
+         case 'a':
+            flags |= DVFS_TRACE_EFF_FREQ;
+            break;
+         case 'e':
+            flags |= DVFS_TRACE_ENERGY;
+            break;
+         case 'm':
+            backend = &dvfs_backend_mock;
+            break;
+         case 'B':
+            bench = true;
+            break;
+         case 'x':
+            export_path = optarg;
+            break;
+         case 's':
+            summary = true;
+            break;
+         default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   if (export_path != NULL) {
+      return export(export_path, summary);
+   }
+
+   if ((path == NULL && !bench) || interval_us == 0) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (pin >= 0) {
+      cpu_set_t set;
+
+      CPU_ZERO(&set);
+      CPU_SET(pin, &set);
+      if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+         perror("Unable to pin the monitor");
+         return EXIT_FAILURE;
+      }
+   }
+
+   // the monitor runs next to the controlling process, it must not restore
+   // the cores behind its back
+   int result = dvfs_start_read_only(&ctx, backend);
+   if (result != DVFS_SUCCESS) {
+      printf("DVFS Start (%s).\n", dvfs_strerror(result));
+      return EXIT_FAILURE;
+   }
+
+   result = monitor_open(&mon, ctx, flags);
+   if (result != DVFS_SUCCESS) {
+      printf("Unable to open the meters (%s).\n", dvfs_strerror(result));
+      dvfs_stop(ctx);
+      return EXIT_FAILURE;
+   }
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = on_signal;
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+
+   if (bench) {
+      // the overhead at every rate, without writing any trace
+      for (i = 0; i < sizeof(bench_rates) / sizeof(*bench_rates) && !stop; i++) {
+         uint64_t interval_ns = 1000000000ULL / bench_rates[i];
+         monitor_run(&mon, NULL, interval_ns, (duration > 0 ? duration : 1) * 1e9, &o);
+         print_overhead(stdout, interval_ns, &o);
+      }
+   } else {
+      dvfs_trace *trace = NULL;
+      dvfs_trace_header header = {
+         .flags = flags,
+         .interval_ns = interval_us * 1000ULL,
+         .start_ns = now_ns(CLOCK_REALTIME),
+         .nb_cores = mon.nb_cores,
+         .core_ids = mon.core_ids,
+         .nb_packages = mon.nb_packages,
+      };
+
+      result = dvfs_trace_create(&trace, path, &header);
+      if (result == DVFS_SUCCESS) {
+         result = monitor_run(&mon, trace, header.interval_ns, duration > 0 ? duration * 1e9 : 0, &o);
+         if (dvfs_trace_close(trace) != DVFS_SUCCESS && result == DVFS_SUCCESS) {
+            result = DVFS_ERROR_FILE_ERROR;
+         }
+         print_overhead(stderr, header.interval_ns, &o);
+      }
+      if (result != DVFS_SUCCESS) {
+         printf("Unable to write the trace %s (%s).\n", path, dvfs_strerror(result));
+      }
+   }
+
+   monitor_close(&mon);
+   dvfs_stop(ctx);
+   return result == DVFS_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
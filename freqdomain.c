@@ -5,6 +5,19 @@
 
 #include "libdvfs.h"
 
+static const char *level_names[DVFS_TOPO_NB_LEVELS] = {
+   "machine", "package", "die", "node", "l3", "unit", "core"
+};
+
+static void print_topo_node(const dvfs_topo_node *node, unsigned int depth) {
+   unsigned int i;
+
+   printf("%*s%s %u\n", depth * 2, "", level_names[node->level], node->id);
+   for (i = 0; i < node->nb_children; i++) {
+      print_topo_node(node->children[i], depth + 1);
+   }
+}
+
 #define CHECK_ERROR(ctx,fct,message) { int result = fct; \
     if (result != DVFS_SUCCESS) { \
         printf(message" (%s).\n",dvfs_strerror(result)); \
@@ -15,24 +28,30 @@
 int main(int argc, char **argv) {
    unsigned int i, j;
    int coreId = -1;
+   bool printTree = false;
    int result = DVFS_SUCCESS;
 
    // parse the arguments
    if (argc > 1) {
       if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
          printf("Determines the cpu cores on the same frequency domain\n\n");
-         printf("\nUsage: %s [core_id]\n", argv[0]);
+         printf("\nUsage: %s [-t | core_id]\n", argv[0]);
          printf("If core_id is provided, outputs the cores on the same frequency domain (including core_id).\n\n");
+         printf("With -t, the topology tree (package, die, NUMA node, L3 group, frequency domain, core) is printed.\n\n");
          printf("Otherwise, all the cores identifiers are printed, grouped by frequency domain. The groups are separated by the character '|'.\n\n");
          printf("For instance if core 0 and 1 lie in the same frequency domain, while cores 2 and 3 lie in a different frequency domain, the output will be\n");
          printf("0 1 | 2 3 \n");
          return EXIT_SUCCESS;
       }
 
-      coreId = strtol(argv[1], NULL, 10);
-      if (errno == EINVAL) {
-         printf("Invalid core id provided\n");
-         return EXIT_FAILURE;
+      if (!strcmp(argv[1], "-t")) {
+         printTree = true;
+      } else {
+         coreId = strtol(argv[1], NULL, 10);
+         if (errno == EINVAL) {
+            printf("Invalid core id provided\n");
+            return EXIT_FAILURE;
+         }
       }
    }
 
@@ -45,8 +64,18 @@ int main(int argc, char **argv) {
       return EXIT_FAILURE;
    }
 
+   // print the topology tree
+   if (printTree)
+   {
+      const dvfs_topology *topo = NULL;
+      const dvfs_topo_node *root = NULL;
+      CHECK_ERROR(ctx,dvfs_get_topology(ctx,&topo),"Failed to get topology");
+      CHECK_ERROR(ctx,dvfs_topo_get_root(topo,&root),"Failed to get topology root");
+
+      print_topo_node(root, 0);
+   }
    // print all the cores
-   if (coreId == -1)
+   else if (coreId == -1)
    {
       unsigned int nb_units = 0;
       CHECK_ERROR(ctx,dvfs_get_nb_units(ctx,&nb_units),"Failed to get number of DVFS units in context");
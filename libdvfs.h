@@ -25,9 +25,33 @@ extern "C" {
  * Libdvfs wrapper file to include in a project.
  */
 
+#include "dvfs_backend.h"
 #include "dvfs_core.h"
 #include "dvfs_unit.h"
 #include "dvfs_context.h"
+#include "dvfs_topology.h"
+#include "dvfs_uncore.h"
+#include "dvfs_features.h"
+#include "dvfs_turbo.h"
+#include "dvfs_epp.h"
+#include "dvfs_idle.h"
+#include "dvfs_async.h"
+#include "dvfs_bulk.h"
+#include "dvfs_gov.h"
+#include "dvfs_snapshot.h"
+#include "dvfs_journal.h"
+#include "dvfs_lease.h"
+#include "dvfs_ratelimit.h"
+#include "dvfs_dither.h"
+#include "dvfs_counters.h"
+#include "dvfs_phase.h"
+#include "dvfs_profile.h"
+#include "dvfs_model.h"
+#include "dvfs_state.h"
+#include "dvfs_trace.h"
+#include "dvfs_powercap.h"
+#include "dvfs_server.h"
+#include "dvfs_client.h"
 #include "dvfs_error.h"
 
 #ifdef __cplusplus
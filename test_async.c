@@ -0,0 +1,109 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+#define QUEUE_SIZE 8
+
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_async *async = NULL;
+   dvfs_async_result results[QUEUE_SIZE];
+   const dvfs_unit *unit = NULL;
+   unsigned long long id = 0;
+   unsigned int i, nb = 0, total = 0, nb_errors = 0;
+   int fd = -1;
+
+   CHECK(dvfs_async_open(&async, QUEUE_SIZE) == DVFS_SUCCESS, "Open queue");
+   CHECK(dvfs_async_get_fd(async, &fd) == DVFS_SUCCESS && fd >= 0, "Get eventfd");
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 1) == DVFS_SUCCESS, "Get unit");
+
+   // fill the queue, the next submission is refused until drained
+   for (i = 0; i < QUEUE_SIZE; i++) {
+      CHECK(dvfs_async_unit_set_freq(async, unit, unit->cores[0]->freqs[i % 2], &id) == DVFS_SUCCESS, "Submit");
+      CHECK(id == i, "Request ids");
+   }
+   CHECK(dvfs_async_unit_set_gov(async, unit, "userspace", NULL) == DVFS_ERROR_QUEUE_FULL, "Queue full");
+
+   while (total < QUEUE_SIZE) {
+      struct pollfd pfd = { .fd = fd, .events = POLLIN };
+      CHECK(poll(&pfd, 1, 5000) == 1, "Completion signalled");
+
+      // drain by small batches, the eventfd must stay readable
+      CHECK(dvfs_async_drain(async, results, 3, &nb) == DVFS_SUCCESS, "Drain");
+      for (i = 0; i < nb; i++) {
+         CHECK(results[i].id == total + i, "Completion order");
+         CHECK(results[i].op == DVFS_ASYNC_UNIT_SET_FREQ, "Completion operation");
+         CHECK(results[i].latency_ns >= results[i].exec_ns && results[i].exec_ns >= 20000, "Measured latency");
+         if (results[i].status != DVFS_SUCCESS) {
+            CHECK(results[i].status == DVFS_ERROR_FILE_ERROR, "Injected error status");
+            nb_errors++;
+         }
+      }
+      total += nb;
+   }
+   CHECK(nb_errors == 1, "One injected error");
+
+   CHECK(dvfs_async_drain(async, results, QUEUE_SIZE, &nb) == DVFS_SUCCESS && nb == 0, "Nothing left");
+   CHECK(dvfs_async_unit_set_gov(async, unit, "userspace", NULL) == DVFS_SUCCESS, "Submit after drain");
+   CHECK(dvfs_async_close(async) == DVFS_SUCCESS, "Close queue");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 4,
+      .cores_per_unit = 1,
+      .nb_freqs = 4,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 20000,
+      .error_period = 5,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+
+   // the error injection also hits the restoration
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_async: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,125 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define NB_CORES 4
+
+static int run_mode(dvfs_unit **units, bool use_uring)
+{
+   dvfs_bulk *bulk = NULL;
+   unsigned int freqs[NB_CORES];
+   unsigned int prev[NB_CORES];
+   unsigned int i;
+
+   FAKE_CHECK(dvfs_bulk_open(&bulk, 2, units, use_uring) == DVFS_SUCCESS, "Open bulk");
+   FAKE_CHECK(bulk->nb_cores == NB_CORES, "All the cores");
+
+   FAKE_CHECK(dvfs_bulk_read_freqs(bulk, freqs) == DVFS_SUCCESS, "Read frequencies");
+   for (i = 0; i < NB_CORES; i++)
+   {
+      FAKE_CHECK(freqs[i] == 1200000 + i * 100000, "Frequency of each core");
+   }
+
+   for (i = 0; i < NB_CORES; i++)
+   {
+      prev[i] = fake_setspeed(i);
+   }
+   FAKE_CHECK(dvfs_bulk_set_freq(bulk, 1600001) == DVFS_ERROR_INVALID_FREQ, "Unknown frequency");
+   for (i = 0; i < NB_CORES; i++)
+   {
+      FAKE_CHECK(fake_setspeed(i) == prev[i], "Nothing written");
+   }
+
+   FAKE_CHECK(dvfs_bulk_set_freq(bulk, 2000000) == DVFS_SUCCESS, "Set frequency");
+   for (i = 0; i < NB_CORES; i++)
+   {
+      FAKE_CHECK(fake_setspeed(i) == 2000000, "Frequency written on each core");
+   }
+
+   FAKE_CHECK(dvfs_bulk_set_freq(bulk, 1200000) == DVFS_SUCCESS, "Set frequency back");
+   for (i = 0; i < NB_CORES; i++)
+   {
+      FAKE_CHECK(fake_setspeed(i) == 1200000, "Frequency written back");
+   }
+
+   // the writes are sequentialized with the cores
+   int sval = 0;
+   FAKE_CHECK(bulk->sem == units[0]->cores[0]->sem, "Semaphore of the cores");
+   FAKE_CHECK(bulk->sem == NULL || (sem_getvalue(bulk->sem, &sval) == 0 && sval == 1), "Semaphore released");
+
+   FAKE_CHECK(dvfs_bulk_close(bulk) == DVFS_SUCCESS, "Close bulk");
+   return EXIT_SUCCESS;
+}
+
+static int run(void)
+{
+   dvfs_unit *units[2];
+   dvfs_unit *mock_unit = NULL;
+   dvfs_bulk *bulk = NULL;
+   unsigned int i, j;
+
+   // two units of two cores, the units own their array of cores
+   for (i = 0; i < 2; i++)
+   {
+      dvfs_core **cores = malloc(2 * sizeof(*cores));
+      FAKE_CHECK(cores != NULL, "Allocate cores");
+      for (j = 0; j < 2; j++)
+      {
+         fake_core(2 * i + j, "userspace", "ondemand userspace", "1200000 1600000 2000000", 1200000 + (2 * i + j) * 100000);
+         FAKE_CHECK(dvfs_core_open(&cores[j], 2 * i + j, true) == DVFS_SUCCESS, "Open core");
+      }
+      FAKE_CHECK(dvfs_unit_open(&units[i], 2, cores, i) == DVFS_SUCCESS, "Open unit");
+   }
+
+   FAKE_CHECK(run_mode(units, false) == EXIT_SUCCESS, "Plain system calls");
+   FAKE_CHECK(run_mode(units, true) == EXIT_SUCCESS, "io_uring batches");
+
+   // only the sysfs files can be batched
+   dvfs_core **mock_cores = malloc(sizeof(*mock_cores));
+   FAKE_CHECK(mock_cores != NULL, "Allocate mock core");
+   FAKE_CHECK(dvfs_core_open_backend(&mock_cores[0], 0, false, &dvfs_backend_mock) == DVFS_SUCCESS, "Open mock core");
+   FAKE_CHECK(dvfs_unit_open(&mock_unit, 1, mock_cores, 0) == DVFS_SUCCESS, "Open mock unit");
+   FAKE_CHECK(dvfs_bulk_open(&bulk, 1, &mock_unit, false) == DVFS_ERROR_INVALID_ARG, "Mock backend refused");
+   FAKE_CHECK(dvfs_unit_close(mock_unit) == DVFS_SUCCESS, "Close mock unit");
+
+   FAKE_CHECK(dvfs_unit_close(units[0]) == DVFS_SUCCESS, "Close first unit");
+   FAKE_CHECK(dvfs_unit_close(units[1]) == DVFS_SUCCESS, "Close second unit");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_bulk: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+static void spin(unsigned int ms)
+{
+   struct timespec start, now;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   do
+   {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+   } while ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < ms);
+}
+
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_counters *counters = NULL;
+   dvfs_counters_sample before, after, core_sample;
+   dvfs_counters_sample *samples;
+   const dvfs_unit *unit = NULL;
+   dvfs_core other = { .id = 100000 };
+   unsigned int nb_units;
+   // software events, always provided by the kernel, and an event it does not know
+   const dvfs_counters_event events[] = {
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+      { PERF_TYPE_SOFTWARE, 1000 },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+   };
+
+   CHECK(dvfs_counters_open(&counters, ctx, events, 0) == DVFS_ERROR_INVALID_ARG, "No event");
+   CHECK(dvfs_counters_open(&counters, ctx, events, DVFS_COUNTERS_MAX + 1) == DVFS_ERROR_INVALID_ARG, "Too many events");
+
+   // the hardware events may not be provided (virtual machines)
+   int ret = dvfs_counters_open(&counters, ctx, NULL, 0);
+   CHECK(ret == DVFS_SUCCESS || ret == DVFS_ERROR_COUNTERS_UNAVAILABLE, "Default events");
+   if (ret == DVFS_SUCCESS)
+   {
+      CHECK(counters->nb_events == DVFS_COUNTER_NB_DEFAULT, "Number of default events");
+      CHECK(dvfs_counters_close(counters) == DVFS_SUCCESS, "Close counters");
+   }
+
+   ret = dvfs_counters_open(&counters, ctx, events, 4);
+   if (ret == DVFS_ERROR_COUNTERS_UNAVAILABLE)
+   {
+      printf("test_counters: perf_event_open not allowed, skipped\n");
+      return EXIT_SUCCESS;
+   }
+   CHECK(ret == DVFS_SUCCESS, "Open counters");
+   CHECK(counters->available == 0xb, "Unknown event left out");
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_counters_read_unit(counters, unit, &before) == DVFS_SUCCESS, "Read unit");
+   spin(20);
+   CHECK(dvfs_counters_read_unit(counters, unit, &after) == DVFS_SUCCESS, "Read unit");
+   CHECK(after.values[0] >= before.values[0] + 10000000, "Clock counted");
+   CHECK(after.values[2] == 0, "Unavailable event");
+   CHECK(after.time_enabled > before.time_enabled && after.time_running > 0, "Enabled time");
+
+   CHECK(dvfs_counters_read_core(counters, unit->cores[0], &core_sample) == DVFS_SUCCESS, "Read core");
+   CHECK(core_sample.values[0] >= after.values[0] / unit->nb_cores, "Core counts");
+   CHECK(dvfs_counters_read_core(counters, &other, &core_sample) == DVFS_ERROR_INVALID_CORE_ID, "Core not counted");
+
+   CHECK(dvfs_get_nb_units(ctx, &nb_units) == DVFS_SUCCESS, "Get number of units");
+   samples = calloc(nb_units, sizeof(*samples));
+   CHECK(samples != NULL, "Allocate samples");
+   CHECK(dvfs_counters_read_units(counters, 0, NULL, samples) == DVFS_SUCCESS, "Read all units");
+   CHECK(samples[0].values[0] >= after.values[0], "Unit counts");
+   CHECK(dvfs_counters_read_units(counters, 1, &unit, samples) == DVFS_SUCCESS, "Read some units");
+   free(samples);
+
+   CHECK(counters->nb_read + counters->nb_rdpmc >= 4 + nb_units, "Reads counted");
+   CHECK(dvfs_counters_close(counters) == DVFS_SUCCESS, "Close counters");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   // the simulated cores are counted on the real ones
+   dvfs_mock_config config = {
+      .nb_cores = nb_cpus > 4 ? 4 : nb_cpus,
+      .cores_per_unit = nb_cpus > 1 ? 2 : 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_counters: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,126 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+static unsigned int unit_freq(const dvfs_unit *unit)
+{
+   unsigned int freq = 0;
+
+   dvfs_unit_get_freq(unit, &freq);
+   return freq;
+}
+
+static int run(dvfs_ctx *ctx, dvfs_mock_config *mock_config)
+{
+   dvfs_dither *dither = NULL;
+   dvfs_dither_stats stats;
+   const dvfs_unit *unit = NULL;
+   dvfs_dither_config config = {
+      .period_us = 4000,
+   };
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_dither_open(&dither, unit, &config) == DVFS_SUCCESS, "Open dithering");
+
+   CHECK(dvfs_dither_set_freq(dither, 900000) == DVFS_ERROR_INVALID_FREQ, "Below the table");
+   CHECK(dvfs_dither_set_freq(dither, 1750000) == DVFS_ERROR_INVALID_FREQ, "Above the table");
+
+   // a step of the table is set as is
+   CHECK(dvfs_dither_set_freq(dither, 1300000) == DVFS_SUCCESS, "Table frequency");
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(!stats.active && stats.low == 1300000 && stats.high == 1300000, "No dithering on a step");
+   CHECK(unit_freq(unit) == 1300000 && stats.average == 1300000, "Step set");
+
+   // a quarter of the period on the higher step
+   CHECK(dvfs_dither_set_freq(dither, 1025000) == DVFS_SUCCESS, "Intermediate frequency");
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.active && !stats.too_fast, "Dithering");
+   CHECK(stats.low == 1000000 && stats.high == 1100000, "Neighbouring steps");
+   usleep(400000);
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.nb_switches >= 100 && stats.last_status == DVFS_SUCCESS, "Switches");
+   CHECK(stats.average >= 1015000 && stats.average <= 1035000, "Achieved average");
+   CHECK(stats.transition_ns > 0, "Transition cost");
+
+   CHECK(dvfs_dither_set_freq(dither, 1600000) == DVFS_SUCCESS, "Back to a step");
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   unsigned long long nb_switches = stats.nb_switches;
+   usleep(20000);
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(!stats.active && stats.nb_switches == nb_switches, "Dithering stopped");
+   CHECK(unit_freq(unit) == 1600000, "Step kept");
+   CHECK(dvfs_dither_close(dither) == DVFS_SUCCESS, "Close dithering");
+
+   // transitions slower than the period
+   mock_config->latency_ns = 2000000;
+   CHECK(dvfs_mock_configure(mock_config) == DVFS_SUCCESS, "Slow transitions");
+   config.period_us = 1000;
+   CHECK(dvfs_dither_open(&dither, unit, &config) == DVFS_SUCCESS, "Open dithering");
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.latency_ns == 2000000 && stats.transition_ns == 2000000, "Declared latency");
+   CHECK(dvfs_dither_set_freq(dither, 1060000) == DVFS_SUCCESS, "Intermediate frequency");
+   CHECK(dvfs_dither_get_stats(dither, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(!stats.active && stats.too_fast, "Dithering turned off");
+   CHECK(stats.transition_ns >= 2000000, "Slow transition measured");
+   CHECK(stats.low == 1100000 && stats.high == 1100000, "Closest step");
+   CHECK(unit_freq(unit) == 1100000, "Closest step set");
+   CHECK(dvfs_dither_close(dither) == DVFS_SUCCESS, "Close dithering");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS
+       || dvfs_set_gov(ctx, "userspace") != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx, &config);
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_dither: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,174 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+static void *serve(void *arg)
+{
+   dvfs_server_run(arg);
+   return NULL;
+}
+
+static unsigned int unit_freq(const dvfs_ctx *ctx, unsigned int id)
+{
+   unsigned int freq = 0;
+
+   dvfs_unit_get_freq(ctx->units[id], &freq);
+   return freq;
+}
+
+static int run(dvfs_ctx *ctx, dvfs_server *server, const char *path)
+{
+   dvfs_client *a = NULL, *b = NULL;
+   dvfs_server_stats stats;
+   unsigned int nb = 0, i;
+
+   CHECK(dvfs_client_open(&a, path) == DVFS_SUCCESS, "Connect first client");
+   CHECK(dvfs_client_open(&b, path) == DVFS_SUCCESS, "Connect second client");
+   CHECK(dvfs_client_get_nb_units(a, &nb) == DVFS_SUCCESS && nb == 2, "Number of units");
+
+   CHECK(dvfs_client_unit_set_freq(a, 0, 1100000) == DVFS_SUCCESS, "Request");
+   CHECK(unit_freq(ctx, 0) == 1100000, "Request applied");
+
+   // the highest request wins
+   CHECK(dvfs_client_unit_set_freq(b, 0, 1000000) == DVFS_SUCCESS, "Lower request");
+   CHECK(unit_freq(ctx, 0) == 1100000, "Lower request arbitrated");
+
+   // clamped to the policy of the user
+   CHECK(dvfs_client_unit_set_freq(b, 0, 1300000) == DVFS_SUCCESS, "Request above the policy");
+   CHECK(unit_freq(ctx, 0) == 1200000, "Request clamped");
+
+   CHECK(dvfs_client_unit_set_freq(a, 0, 1050000) == DVFS_ERROR_INVALID_FREQ, "Unknown frequency");
+   CHECK(dvfs_client_unit_set_freq(a, 2, 1100000) == DVFS_ERROR_INVALID_INDEX, "Unknown unit");
+   CHECK(dvfs_client_unit_set_freq(a, 1, 1000000) == DVFS_SUCCESS, "Request on the other unit");
+   CHECK(unit_freq(ctx, 1) == 1000000 && unit_freq(ctx, 0) == 1200000, "Units independent");
+
+   // a request not changing the arbitrated frequency is not written
+   CHECK(dvfs_server_get_stats(server, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.nb_writes == 3, "Frequency changes");
+   CHECK(dvfs_client_unit_set_freq(a, 0, 1100000) == DVFS_SUCCESS, "Request below the winner");
+   CHECK(dvfs_server_get_stats(server, &stats) == DVFS_SUCCESS && stats.nb_writes == 3, "Request coalesced");
+   CHECK(stats.nb_clients == 2 && stats.nb_requests == 7, "Request counters");
+
+   // the requests of a client leave with it
+   CHECK(dvfs_client_close(b) == DVFS_SUCCESS, "Disconnect second client");
+   CHECK(dvfs_client_unit_set_freq(a, 1, 1000000) == DVFS_SUCCESS, "Request after the disconnection");
+   CHECK(unit_freq(ctx, 0) == 1100000, "Request withdrawn");
+   CHECK(dvfs_server_get_stats(server, &stats) == DVFS_SUCCESS && stats.nb_clients == 1, "Client counter");
+
+   // the last client leaving gives the units back their top frequency
+   CHECK(dvfs_client_close(a) == DVFS_SUCCESS, "Disconnect first client");
+   for (i = 0; i < 1000 && (unit_freq(ctx, 0) != 1300000 || unit_freq(ctx, 1) != 1300000); i++) {
+      usleep(1000);
+   }
+   CHECK(unit_freq(ctx, 0) == 1300000 && unit_freq(ctx, 1) == 1300000, "Requests released");
+   return EXIT_SUCCESS;
+}
+
+static int run_default_policy(dvfs_ctx *ctx, const char *path)
+{
+   dvfs_server *server = NULL;
+   dvfs_client *client = NULL;
+   pthread_t thread;
+   unsigned int freq = 0;
+   int ret;
+
+   CHECK(dvfs_server_open(&server, ctx, path) == DVFS_SUCCESS, "Open server without policy");
+   CHECK(pthread_create(&thread, NULL, serve, server) == 0, "Start server");
+   ret = dvfs_client_open(&client, path);
+   dvfs_server_stop(server);
+   pthread_join(thread, NULL);
+   CHECK(ret == DVFS_ERROR_ACCESS_DENIED, "User without policy refused");
+
+   CHECK(dvfs_server_set_default_policy(server, 1000000, 1100000) == DVFS_SUCCESS, "Default policy");
+   CHECK(pthread_create(&thread, NULL, serve, server) == 0, "Restart server");
+   ret = dvfs_client_open(&client, path);
+   if (ret == DVFS_SUCCESS) {
+      ret = dvfs_client_unit_set_freq(client, 0, 1300000);
+      freq = unit_freq(ctx, 0);
+      dvfs_client_close(client);
+   }
+   dvfs_server_stop(server);
+   pthread_join(thread, NULL);
+   dvfs_server_close(server);
+   CHECK(ret == DVFS_SUCCESS && freq == 1100000, "Default policy applied");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_server *server = NULL;
+   dvfs_client *client = NULL;
+   pthread_t thread;
+   char path[64];
+   dvfs_mock_config config = {
+      .nb_cores = 4,
+      .cores_per_unit = 2,
+      .nb_freqs = 4,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   snprintf(path, sizeof(path), "/tmp/test_dvfsd.%d.sock", (int) getpid());
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS
+       || dvfs_server_open(&server, ctx, path) != DVFS_SUCCESS
+       || dvfs_server_set_policy(server, getuid(), 1000000, 1250000) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   if (pthread_create(&thread, NULL, serve, server) != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx, server, path);
+
+   dvfs_server_stop(server);
+   pthread_join(thread, NULL);
+   dvfs_server_close(server);
+   if (ret == EXIT_SUCCESS && (dvfs_client_open(&client, path) != DVFS_ERROR_FILE_ERROR || access(path, F_OK) == 0)) {
+      printf("%s:%d: %s\n", __FILE__, __LINE__, "Socket removed");
+      ret = EXIT_FAILURE;
+   }
+   if (ret == EXIT_SUCCESS) {
+      ret = run_default_policy(ctx, path);
+   }
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_dvfsd: OK\n");
+   }
+   return ret;
+}
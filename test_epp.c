@@ -0,0 +1,165 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include <fcntl.h>
+
+#include "libdvfs.h"
+#include "dvfs_msr.h"
+
+#define EPP0 "/devices/system/cpu/cpu0/cpufreq/energy_performance_preference"
+#define EPP1 "/devices/system/cpu/cpu1/cpufreq/energy_performance_preference"
+#define EPP2 "/devices/system/cpu/cpu2/cpufreq/energy_performance_preference"
+#define MSR_FILE "/msr/cpu0"
+
+static int read_text(const char *rel, char *buf, size_t len)
+{
+   char path[512];
+
+   snprintf(path, sizeof(path), "%s%s", fake_root, rel);
+   FILE *fd = fopen(path, "r");
+   if (fd == NULL || fgets(buf, len, fd) == NULL) {
+      buf[0] = '\0';
+   }
+   if (fd != NULL) {
+      fclose(fd);
+   }
+   buf[strcspn(buf, "\n")] = '\0';
+   return 0;
+}
+
+static uint64_t msr_access(uint32_t reg, const uint64_t *pVal)
+{
+   char path[512];
+   uint64_t val = 0;
+
+   snprintf(path, sizeof(path), "%s" MSR_FILE, fake_root);
+   int fd = open(path, O_RDWR | O_CREAT, 0644);
+   if (fd >= 0) {
+      if (pVal != NULL) {
+         dvfs_msr_write(fd, reg, *pVal);
+      } else {
+         dvfs_msr_read(fd, reg, &val);
+      }
+      close(fd);
+   }
+   return val;
+}
+
+static int run(void)
+{
+   dvfs_ctx *ctx = NULL;
+   const dvfs_unit *unit0 = NULL, *unit1 = NULL;
+   const dvfs_core *core0 = NULL;
+   char buf[64], pattern[512];
+   dvfs_hwp_hints hints;
+   dvfs_features features;
+   dvfs_mock_config config = {
+      .nb_cores = 4, .cores_per_unit = 2, .nb_freqs = 4, .min_freq = 1000000, .freq_step = 100000,
+   };
+
+   fake_write(EPP0, "balance_performance\n");
+   fake_write(EPP1, "balance_performance\n");
+   fake_write(EPP2, "power\n");
+   fake_write("/devices/system/cpu/cpu3/cpufreq/energy_performance_preference", "power\n");
+
+   FAKE_CHECK(dvfs_mock_configure(&config) == DVFS_SUCCESS, "Configure mock");
+   // sequentialized: the setters take the semaphore of the cores
+   FAKE_CHECK(dvfs_start_backend(&ctx, true, &dvfs_backend_mock) == DVFS_SUCCESS, "Start");
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit0, 0) == DVFS_SUCCESS, "Get unit 0");
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit1, 1) == DVFS_SUCCESS, "Get unit 1");
+   FAKE_CHECK(dvfs_get_core(ctx, &core0, 0) == DVFS_SUCCESS, "Get core 0");
+
+   FAKE_CHECK(dvfs_unit_get_epp(unit0, buf, sizeof(buf)) == DVFS_SUCCESS && strcmp(buf, "balance_performance") == 0, "Read preference");
+   FAKE_CHECK(dvfs_core_get_epp(core0, buf, 4) == DVFS_ERROR_BUFFER_TOO_SHORT, "Short buffer");
+
+   // a profile maps every unit to a preference
+   dvfs_epp_setting profile[] = { { unit0, "performance" }, { unit1, "balance_power" } };
+   FAKE_CHECK(dvfs_set_epp_profile(ctx, 2, profile) == DVFS_SUCCESS, "Apply profile");
+   read_text(EPP1, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "performance") == 0, "Unit 0 preference written");
+   read_text(EPP2, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "balance_power") == 0, "Unit 1 preference written");
+
+   FAKE_CHECK(dvfs_core_set_epp_value(core0, 128) == DVFS_SUCCESS, "Numeric preference");
+   read_text(EPP0, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "128") == 0, "Numeric preference written");
+   FAKE_CHECK(dvfs_core_set_epp_value(core0, 256) == DVFS_ERROR_INVALID_ARG, "Out of range preference");
+
+   // unchanged preferences are served by the cache
+   fake_write(EPP0, "tampered\n");
+   FAKE_CHECK(dvfs_core_set_epp_value(core0, 128) == DVFS_SUCCESS, "Same preference");
+   read_text(EPP0, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "tampered") == 0, "No redundant write");
+
+   // HWP hints, on a processor reporting HWP
+   FAKE_CHECK(dvfs_features_detect(&features) == DVFS_SUCCESS, "Detect features");
+   features.hwp = true;
+   FAKE_CHECK(dvfs_features_override(&features) == DVFS_SUCCESS, "Processor with HWP");
+   snprintf(pattern, sizeof(pattern), "%s/msr/cpu%%u", fake_root);
+   setenv(DVFS_MSR_PATH_ENV, pattern, 1);
+   fake_write(MSR_FILE, "");
+   uint64_t val = 0;
+   msr_access(DVFS_MSR_IA32_PM_ENABLE, &val);
+   FAKE_CHECK(dvfs_core_get_hwp_hints(core0, &hints) == DVFS_ERROR_HWP_INACTIVE, "HWP disabled");
+
+   val = 1;
+   msr_access(DVFS_MSR_IA32_PM_ENABLE, &val);
+   val = 0x80002A2A08ULL;
+   msr_access(DVFS_MSR_IA32_HWP_REQUEST, &val);
+   FAKE_CHECK(dvfs_core_get_hwp_hints(core0, &hints) == DVFS_SUCCESS, "Get hints");
+   FAKE_CHECK(hints.min_perf == 8 && hints.max_perf == 42 && hints.desired_perf == 42, "Hints decoded");
+
+   hints.min_perf = 20;
+   hints.desired_perf = 0;
+   FAKE_CHECK(dvfs_core_set_hwp_hints(core0, &hints) == DVFS_SUCCESS, "Set hints");
+   FAKE_CHECK(msr_access(DVFS_MSR_IA32_HWP_REQUEST, NULL) == 0x8000002A14ULL, "Hints written, preference kept");
+   hints.min_perf = 50;
+   FAKE_CHECK(dvfs_core_set_hwp_hints(core0, &hints) == DVFS_ERROR_INVALID_ARG, "Empty range");
+   int sval = 0;
+   FAKE_CHECK(core0->sem == NULL || (sem_getvalue(core0->sem, &sval) == 0 && sval == 1), "Semaphore released");
+
+   // stopping restores everything
+   FAKE_CHECK(dvfs_stop(ctx) == DVFS_SUCCESS, "Stop");
+   read_text(EPP0, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "balance_performance") == 0, "Core 0 preference restored");
+   read_text(EPP2, buf, sizeof(buf));
+   FAKE_CHECK(strcmp(buf, "power") == 0, "Unit 1 preference restored");
+   FAKE_CHECK(msr_access(DVFS_MSR_IA32_HWP_REQUEST, NULL) == 0x80002A2A08ULL, "Hints restored");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_epp: OK\n");
+   }
+   return ret;
+}
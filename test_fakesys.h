@@ -0,0 +1,186 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Helpers for the tests running against a fake sysfs tree. The tree is created
+ * in a temporary directory and the library is redirected to it through the
+ * LIBDVFS_SYSFS_ROOT environment variable.
+ */
+
+#define _XOPEN_SOURCE 700
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dvfs_sysfs.h"
+
+static char fake_root[256];
+
+// cpufreq directory of a core, relative to the sysfs root
+#define FAKE_CPUFREQ "/devices/system/cpu/cpu%u/cpufreq"
+
+#define FAKE_CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+static int fake_mkdirs(char *path)
+{
+   char *slash;
+
+   for (slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+      *slash = '\0';
+      mkdir(path, 0755);
+      *slash = '/';
+   }
+   return 0;
+}
+
+/**
+ * Creates the fake tree and redirects the library to it.
+ */
+static int fake_root_create(void)
+{
+   snprintf(fake_root, sizeof(fake_root), "/tmp/libdvfs_fakesys_XXXXXX");
+   if (mkdtemp(fake_root) == NULL) {
+      perror("mkdtemp");
+      return -1;
+   }
+   setenv(DVFS_SYSFS_ROOT_ENV, fake_root, 1);
+   return 0;
+}
+
+/**
+ * Writes a file of the fake tree, the path being relative to the sysfs root.
+ */
+static void fake_write(const char *rel, const char *fmt, ...)
+{
+   char path[512];
+   va_list ap;
+
+   snprintf(path, sizeof(path), "%s%s", fake_root, rel);
+   fake_mkdirs(path);
+
+   FILE *fd = fopen(path, "w");
+   if (fd == NULL) {
+      perror(path);
+      return;
+   }
+   va_start(ap, fmt);
+   vfprintf(fd, fmt, ap);
+   va_end(ap);
+   fclose(fd);
+}
+
+/**
+ * Reads an unsigned value from a file of the fake tree.
+ */
+static __attribute__((unused)) unsigned int fake_read_uint(const char *rel)
+{
+   char path[512];
+   unsigned int val = 0;
+
+   snprintf(path, sizeof(path), "%s%s", fake_root, rel);
+   FILE *fd = fopen(path, "r");
+   if (fd != NULL) {
+      if (fscanf(fd, "%u", &val) != 1) {
+         val = 0;
+      }
+      fclose(fd);
+   }
+   return val;
+}
+
+/**
+ * Fakes the cpufreq files of a core controlled through scaling_setspeed.
+ */
+static __attribute__((unused)) void fake_core(unsigned int id, const char *gov, const char *govs, const char *freqs, unsigned int cur_freq)
+{
+   char rel[256];
+
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_governor", id);
+   fake_write(rel, "%s\n", gov);
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_available_governors", id);
+   fake_write(rel, "%s\n", govs);
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_available_frequencies", id);
+   fake_write(rel, "%s\n", freqs);
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_setspeed", id);
+   fake_write(rel, "0\n");
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_cur_freq", id);
+   fake_write(rel, "%u\n", cur_freq);
+}
+
+/**
+ * Checks the governor written in the fake tree for a core. Only the name is
+ * written, without any NUL byte. sysfs replaces the whole value but a regular
+ * file keeps the end of a longer value written before, so only the beginning
+ * of the file is compared.
+ */
+static __attribute__((unused)) bool fake_gov_is(unsigned int id, const char *gov)
+{
+   char path[512];
+   char buf[128] = {0};
+
+   snprintf(path, sizeof(path), "%s" FAKE_CPUFREQ "/scaling_governor", fake_root, id);
+   FILE *fd = fopen(path, "r");
+   if (fd == NULL) {
+      return false;
+   }
+   size_t len = fread(buf, 1, sizeof(buf) - 1, fd);
+   fclose(fd);
+   if (memchr(buf, '\0', len) != NULL) {
+      return false;
+   }
+   buf[len] = '\0';
+
+   return strncmp(buf, gov, strlen(gov)) == 0;
+}
+
+/**
+ * Reads the frequency written in scaling_setspeed for a core.
+ */
+static __attribute__((unused)) unsigned int fake_setspeed(unsigned int id)
+{
+   char rel[256];
+
+   snprintf(rel, sizeof(rel), FAKE_CPUFREQ "/scaling_setspeed", id);
+   return fake_read_uint(rel);
+}
+
+static int fake_unlink(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+   (void) sb;
+   (void) flag;
+   (void) ftw;
+   return remove(path);
+}
+
+/**
+ * Removes the fake tree.
+ */
+static void fake_root_remove(void)
+{
+   nftw(fake_root, fake_unlink, 16, FTW_DEPTH | FTW_PHYS);
+}
@@ -0,0 +1,92 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+static int run(void)
+{
+   dvfs_unit *unit = NULL;
+   unsigned int i, ondemand, userspace, performance, schedutil;
+   const char *name = NULL;
+   char buf[128];
+
+   dvfs_core **cores = malloc(2 * sizeof(*cores));
+   FAKE_CHECK(cores != NULL, "Allocate cores");
+   for (i = 0; i < 2; i++)
+   {
+      fake_core(i, "ondemand", i == 0 ? "conservative ondemand userspace performance" : "conservative ondemand userspace schedutil", "1200000 2000000", 1200000);
+      FAKE_CHECK(dvfs_core_open(&cores[i], i, false) == DVFS_SUCCESS, "Open core");
+   }
+   FAKE_CHECK(dvfs_unit_open(&unit, 2, cores, 0) == DVFS_SUCCESS, "Open unit");
+
+   // the governors of both cores are interned once
+   FAKE_CHECK(dvfs_gov_get_id("ondemand", &ondemand) == DVFS_SUCCESS, "Interned governor");
+   FAKE_CHECK(dvfs_gov_get_id("userspace", &userspace) == DVFS_SUCCESS, "Interned governor");
+   FAKE_CHECK(dvfs_gov_get_id("performance", &performance) == DVFS_SUCCESS, "Interned governor");
+   FAKE_CHECK(dvfs_gov_get_id("schedutil", &schedutil) == DVFS_SUCCESS, "Interned governor");
+   FAKE_CHECK(dvfs_gov_get_id("powersave", &i) == DVFS_ERROR_INVALID_GOV, "Unknown governor");
+   FAKE_CHECK(dvfs_gov_get_name(performance, &name) == DVFS_SUCCESS && strcmp(name, "performance") == 0, "Governor name");
+   FAKE_CHECK(dvfs_gov_get_name(DVFS_GOV_MAX, &name) == DVFS_ERROR_INVALID_GOV, "Invalid id");
+
+   FAKE_CHECK(dvfs_core_has_gov(cores[0], performance) && !dvfs_core_has_gov(cores[0], schedutil), "First core governors");
+   FAKE_CHECK(dvfs_core_has_gov(cores[1], schedutil) && !dvfs_core_has_gov(cores[1], performance), "Second core governors");
+
+   // typos are rejected before reaching the kernel
+   FAKE_CHECK(dvfs_core_set_gov(cores[0], "userspcae") == DVFS_ERROR_INVALID_GOV, "Typo rejected");
+   FAKE_CHECK(dvfs_core_set_gov(cores[1], "performance") == DVFS_ERROR_INVALID_GOV, "Unavailable governor rejected");
+   FAKE_CHECK(fake_gov_is(1, "ondemand"), "Nothing written");
+
+   FAKE_CHECK(dvfs_unit_set_gov_id(unit, userspace) == DVFS_SUCCESS, "Set governor by id");
+   FAKE_CHECK(fake_gov_is(0, "userspace") && fake_gov_is(1, "userspace"), "Governor written");
+   FAKE_CHECK(dvfs_core_get_gov(cores[0], buf, sizeof(buf)) == DVFS_SUCCESS && strcmp(buf, "userspace") == 0, "Governor read back");
+   FAKE_CHECK(dvfs_core_get_gov(cores[0], buf, 0) == DVFS_ERROR_BUFFER_TOO_SHORT, "Empty buffer");
+
+   FAKE_CHECK(dvfs_core_set_gov_id(cores[0], performance) == DVFS_SUCCESS, "Set available governor");
+   FAKE_CHECK(dvfs_core_set_gov_id(cores[1], performance) == DVFS_ERROR_INVALID_GOV, "Id not available");
+   FAKE_CHECK(fake_gov_is(0, "performance") && fake_gov_is(1, "userspace"), "Only the first core changed");
+
+   // a shorter name over a longer one
+   FAKE_CHECK(dvfs_core_set_gov(cores[0], "ondemand") == DVFS_SUCCESS, "Set governor by name");
+   FAKE_CHECK(fake_gov_is(0, "ondemand"), "Shorter name written");
+
+   // closing restores the initial governor through the same descriptor
+   FAKE_CHECK(dvfs_unit_close(unit) == DVFS_SUCCESS, "Close unit");
+   FAKE_CHECK(fake_gov_is(0, "ondemand") && fake_gov_is(1, "ondemand"), "Governor restored");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_gov: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,144 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+
+#include "libdvfs.h"
+
+#define STATE(core,state) "/devices/system/cpu/cpu" #core "/cpuidle/state" #state
+
+static int32_t read_qos(const char *path)
+{
+   int32_t val = -1;
+
+   FILE *fd = fopen(path, "r");
+   if (fd != NULL) {
+      if (fread(&val, sizeof(val), 1, fd) != 1) {
+         val = -1;
+      }
+      fclose(fd);
+   }
+   return val;
+}
+
+static int run(dvfs_unit *unit)
+{
+   dvfs_idle *idle = NULL;
+   const dvfs_idle_state *states = NULL;
+   unsigned int nb = 0;
+   char qos[512];
+
+   fake_write(STATE(0,0) "/name", "POLL\n");
+   fake_write(STATE(0,0) "/latency", "0\n");
+   fake_write(STATE(0,0) "/disable", "0\n");
+   fake_write(STATE(0,1) "/name", "C1\n");
+   fake_write(STATE(0,1) "/latency", "2\n");
+   fake_write(STATE(0,1) "/disable", "0\n");
+   fake_write(STATE(0,2) "/name", "C6\n");
+   fake_write(STATE(0,2) "/latency", "100\n");
+   fake_write(STATE(0,2) "/disable", "0\n");
+   fake_write(STATE(1,0) "/latency", "0\n");
+   fake_write(STATE(1,0) "/disable", "0\n");
+   fake_write(STATE(1,1) "/latency", "100\n");
+   fake_write(STATE(1,1) "/disable", "1\n");
+
+   FAKE_CHECK(dvfs_idle_open(&idle, 2) == DVFS_SUCCESS, "Open idle control");
+   FAKE_CHECK(dvfs_idle_get_states(idle, 0, &states, &nb) == DVFS_SUCCESS && nb == 3, "Enumerate states");
+   FAKE_CHECK(strcmp(states[2].name, "C6") == 0 && states[2].latency == 100, "State description");
+   FAKE_CHECK(dvfs_idle_get_states(idle, 2, &states, &nb) == DVFS_ERROR_INVALID_CORE_ID, "Unknown core");
+
+   // nested limits, the tightest applies
+   FAKE_CHECK(dvfs_idle_acquire_unit(idle, unit, 10) == DVFS_SUCCESS, "Limit the unit");
+   FAKE_CHECK(fake_read_uint(STATE(0,2) "/disable") == 1 && fake_read_uint(STATE(0,1) "/disable") == 0, "Deep state disabled");
+   FAKE_CHECK(dvfs_idle_acquire_core(idle, 0, 1) == DVFS_SUCCESS, "Limit a core further");
+   FAKE_CHECK(fake_read_uint(STATE(0,1) "/disable") == 1 && fake_read_uint(STATE(0,0) "/disable") == 0, "Shallow state disabled");
+   FAKE_CHECK(dvfs_idle_release_core(idle, 0, 1) == DVFS_SUCCESS, "Release the core limit");
+   FAKE_CHECK(fake_read_uint(STATE(0,1) "/disable") == 0 && fake_read_uint(STATE(0,2) "/disable") == 1, "Unit limit still held");
+   FAKE_CHECK(dvfs_idle_release_unit(idle, unit, 10) == DVFS_SUCCESS, "Release the unit limit");
+   FAKE_CHECK(fake_read_uint(STATE(0,2) "/disable") == 0, "State enabled again");
+   FAKE_CHECK(fake_read_uint(STATE(1,1) "/disable") == 1, "State disabled before stays disabled");
+   FAKE_CHECK(dvfs_idle_release_core(idle, 0, 10) == DVFS_ERROR_INVALID_ARG, "Limit not held");
+
+   // the cores of a unit leased by another context are fenced
+   unit->cores[0]->fenced = true;
+   idle->cores[0].fenced = true;
+   FAKE_CHECK(dvfs_idle_acquire_unit(idle, unit, 10) == DVFS_ERROR_NOT_LEASED, "Fenced unit");
+   FAKE_CHECK(dvfs_idle_acquire_core(idle, 0, 10) == DVFS_ERROR_NOT_LEASED, "Fenced core");
+   FAKE_CHECK(fake_read_uint(STATE(0,2) "/disable") == 0, "Fenced states untouched");
+   unit->cores[0]->fenced = false;
+   idle->cores[0].fenced = false;
+
+   // process wide constraint
+   snprintf(qos, sizeof(qos), "%s/cpu_dma_latency", fake_root);
+   setenv(DVFS_DMA_LATENCY_PATH_ENV, qos, 1);
+   fake_write("/cpu_dma_latency", "");
+   FAKE_CHECK(dvfs_idle_acquire_qos(idle, 50) == DVFS_SUCCESS, "Acquire constraint");
+   FAKE_CHECK((fcntl(idle->qos_fd, F_GETFD) & FD_CLOEXEC) != 0, "Close on exec");
+   FAKE_CHECK(dvfs_idle_acquire_qos(idle, 20) == DVFS_SUCCESS, "Acquire tighter constraint");
+   FAKE_CHECK(read_qos(qos) == 20, "Tightest constraint written");
+   FAKE_CHECK(dvfs_idle_release_qos(idle, 20) == DVFS_SUCCESS, "Release tighter constraint");
+   FAKE_CHECK(read_qos(qos) == 50, "Remaining constraint written");
+   FAKE_CHECK(dvfs_idle_release_qos(idle, 50) == DVFS_SUCCESS && idle->qos_fd < 0, "Device closed");
+
+   // closing restores the states even with limits held
+   FAKE_CHECK(dvfs_idle_acquire_unit(idle, unit, 0) == DVFS_SUCCESS, "Limit the unit");
+   FAKE_CHECK(fake_read_uint(STATE(0,1) "/disable") == 1 && fake_read_uint(STATE(1,1) "/disable") == 1, "States disabled");
+   FAKE_CHECK(dvfs_idle_close(idle) == DVFS_SUCCESS, "Close idle control");
+   FAKE_CHECK(fake_read_uint(STATE(0,1) "/disable") == 0 && fake_read_uint(STATE(0,2) "/disable") == 0, "States restored");
+   FAKE_CHECK(fake_read_uint(STATE(1,1) "/disable") == 1, "Disabled state restored");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_unit *unit = NULL;
+   dvfs_core **cores = malloc(2 * sizeof(*cores));
+   unsigned int i;
+
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0 || cores == NULL) {
+      return EXIT_FAILURE;
+   }
+
+   // the cores only provide their ids, use the mock backend
+   for (i = 0; i < 2; i++) {
+      if (dvfs_core_open_backend(&cores[i], i, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+         fake_root_remove();
+         return EXIT_FAILURE;
+      }
+   }
+   if (dvfs_unit_open(&unit, 2, cores, 0) != DVFS_SUCCESS) {
+      fake_root_remove();
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(unit);
+   fake_root_remove();
+   dvfs_unit_close(unit);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_idle: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,271 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "libdvfs.h"
+
+#define CPU0 "/devices/system/cpu/cpu0/cpufreq"
+#define CPU1 "/devices/system/cpu/cpu1/cpufreq"
+
+/**
+ * Opens the cores, records them and pins them at a low frequency, then waits
+ * to be killed.
+ */
+static void child(int fd_ready)
+{
+   dvfs_journal *journal = NULL;
+   dvfs_core *cores[2];
+
+   if (dvfs_core_open(&cores[0], 0, false) != DVFS_SUCCESS
+       || dvfs_core_open(&cores[1], 1, false) != DVFS_SUCCESS
+       || dvfs_journal_open(&journal, NULL) != DVFS_SUCCESS
+       || dvfs_journal_record(journal, cores[0], 0) != DVFS_SUCCESS
+       || dvfs_journal_record(journal, cores[1], 1) != DVFS_SUCCESS
+       || dvfs_core_set_gov(cores[0], "userspace") != DVFS_SUCCESS
+       || dvfs_core_set_freq(cores[0], 1200000) != DVFS_SUCCESS
+       || dvfs_core_set_freq(cores[1], 800000) != DVFS_SUCCESS) {
+      _exit(EXIT_FAILURE);
+   }
+
+   if (write(fd_ready, "r", 1) != 1) {
+      _exit(EXIT_FAILURE);
+   }
+   for (;;) {
+      pause();
+   }
+}
+
+static int run(void)
+{
+   dvfs_journal *journal = NULL;
+   unsigned int nb = 0;
+   int fds[2];
+   char c;
+   char path[512];
+
+   // a core with the userspace governor, a core controlled by its limits
+   fake_write(CPU0 "/scaling_governor", "ondemand\n");
+   fake_write(CPU0 "/scaling_available_governors", "ondemand userspace\n");
+   fake_write(CPU0 "/scaling_available_frequencies", "1200000 2000000\n");
+   fake_write(CPU0 "/scaling_cur_freq", "2000000\n");
+   fake_write(CPU1 "/scaling_governor", "powersave\n");
+   fake_write(CPU1 "/scaling_available_governors", "performance powersave\n");
+   fake_write(CPU1 "/scaling_cur_freq", "2000000\n");
+   fake_write(CPU1 "/cpuinfo_min_freq", "800000\n");
+   fake_write(CPU1 "/cpuinfo_max_freq", "3000000\n");
+   fake_write(CPU1 "/scaling_min_freq", "800000\n");
+   fake_write(CPU1 "/scaling_max_freq", "3000000\n");
+
+   snprintf(path, sizeof(path), "%s/journal", fake_root);
+   setenv(DVFS_JOURNAL_PATH_ENV, path, 1);
+
+   FAKE_CHECK(pipe(fds) == 0, "Create pipe");
+   pid_t pid = fork();
+   FAKE_CHECK(pid >= 0, "Fork");
+   if (pid == 0) {
+      close(fds[0]);
+      child(fds[1]);
+   }
+   close(fds[1]);
+   FAKE_CHECK(read(fds[0], &c, 1) == 1, "Child ready");
+   close(fds[0]);
+
+   FAKE_CHECK(fake_gov_is(0, "userspace"), "Governor changed by the child");
+   FAKE_CHECK(fake_read_uint(CPU1 "/scaling_max_freq") == 800000, "Limits pinned by the child");
+
+   // the owner is alive: nothing to recover
+   FAKE_CHECK(dvfs_journal_open(&journal, NULL) == DVFS_SUCCESS, "Open journal");
+   FAKE_CHECK(dvfs_journal_recover(journal, &nb) == DVFS_SUCCESS && nb == 0, "Living owner");
+
+   FAKE_CHECK(kill(pid, SIGKILL) == 0, "Kill child");
+   FAKE_CHECK(waitpid(pid, NULL, 0) == pid, "Wait child");
+
+   FAKE_CHECK(dvfs_journal_recover(journal, &nb) == DVFS_SUCCESS && nb == 2, "Dead owner");
+   FAKE_CHECK(fake_gov_is(0, "ondemand"), "Governor restored");
+   FAKE_CHECK(fake_read_uint(CPU1 "/scaling_min_freq") == 800000, "Lower limit restored");
+   FAKE_CHECK(fake_read_uint(CPU1 "/scaling_max_freq") == 3000000, "Upper limit restored");
+
+   FAKE_CHECK(dvfs_journal_recover(journal, &nb) == DVFS_SUCCESS && nb == 0, "Slots released");
+   FAKE_CHECK(dvfs_journal_close(journal) == DVFS_SUCCESS, "Close journal");
+
+   // a process stopping normally releases its slots
+   dvfs_core *core = NULL;
+   FAKE_CHECK(dvfs_core_open(&core, 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(dvfs_journal_open(&journal, NULL) == DVFS_SUCCESS, "Open journal");
+   FAKE_CHECK(dvfs_journal_record(journal, core, 0) == DVFS_SUCCESS, "Record core");
+   FAKE_CHECK(journal->slots[0].owner == getpid(), "Slot owned");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+   FAKE_CHECK(dvfs_journal_close(journal) == DVFS_SUCCESS, "Close journal");
+   FAKE_CHECK(dvfs_journal_open(&journal, NULL) == DVFS_SUCCESS, "Open journal");
+   FAKE_CHECK(journal->slots[0].owner == 0, "Slot released");
+
+   // the slot of a dead owner not recovered yet keeps the original state
+   journal->slots[0].owner = pid;
+   snprintf(journal->slots[0].state.gov, sizeof(journal->slots[0].state.gov), "ondemand");
+   fake_write(CPU0 "/scaling_governor", "userspace\n");
+   FAKE_CHECK(dvfs_core_open(&core, 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(dvfs_journal_record(journal, core, 0) == DVFS_SUCCESS, "Record core");
+   FAKE_CHECK(journal->slots[0].owner == pid, "Slot of a dead owner kept");
+   FAKE_CHECK(dvfs_journal_recover(journal, &nb) == DVFS_SUCCESS && nb == 1, "Slot of a dead owner recovered");
+   FAKE_CHECK(fake_gov_is(0, "ondemand"), "Original governor restored");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+
+   // the recovery only writes sysfs, the other backends are not journaled
+   FAKE_CHECK(dvfs_core_open_backend(&core, 1, false, &dvfs_backend_mock) == DVFS_SUCCESS, "Open mock core");
+   FAKE_CHECK(dvfs_journal_record(journal, core, 1) == DVFS_SUCCESS, "Record mock core");
+   FAKE_CHECK(journal->slots[1].owner == 0, "Mock core not journaled");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close mock core");
+   FAKE_CHECK(dvfs_journal_close(journal) == DVFS_SUCCESS, "Close journal");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Gets the pid of a process which exited.
+ */
+static pid_t dead_pid(void)
+{
+   pid_t pid = fork();
+
+   if (pid == 0) {
+      _exit(EXIT_SUCCESS);
+   }
+   if (pid > 0) {
+      waitpid(pid, NULL, 0);
+   }
+   return pid;
+}
+
+/**
+ * The slots belong to a context, not to its process.
+ */
+static int run_contexts(void)
+{
+   dvfs_journal *first = NULL, *second = NULL;
+   dvfs_core *core = NULL;
+
+   FAKE_CHECK(dvfs_core_open(&core, 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(dvfs_journal_open(&first, NULL) == DVFS_SUCCESS, "Open first journal");
+   FAKE_CHECK(dvfs_journal_open(&second, NULL) == DVFS_SUCCESS, "Open second journal");
+   FAKE_CHECK(first->handle != second->handle, "Distinct handles");
+
+   FAKE_CHECK(dvfs_journal_record(first, core, 0) == DVFS_SUCCESS, "Record core");
+   FAKE_CHECK(dvfs_journal_record(second, core, 0) == DVFS_SUCCESS, "Record core again");
+   FAKE_CHECK(first->slots[0].handle == first->handle, "First context owns the slot");
+   FAKE_CHECK(dvfs_journal_release(second, core) == DVFS_SUCCESS, "Release foreign slot");
+   FAKE_CHECK(first->slots[0].owner == getpid(), "Foreign slot kept");
+
+   // the slot changes hands with the state of the first context
+   first->slots[0].state.freq = 1200000;
+   FAKE_CHECK(dvfs_journal_take(second, core, 0) == DVFS_SUCCESS, "Take slot");
+   FAKE_CHECK(first->slots[0].owner == getpid() && first->slots[0].handle == second->handle, "Slot taken");
+   FAKE_CHECK(first->slots[0].state.freq == 1200000, "Original state kept");
+
+   FAKE_CHECK(dvfs_journal_close(first) == DVFS_SUCCESS, "Close first journal");
+   FAKE_CHECK(second->slots[0].owner == getpid(), "Slot of the second context kept");
+   FAKE_CHECK(dvfs_journal_release(second, core) == DVFS_SUCCESS, "Release slot");
+   FAKE_CHECK(second->slots[0].owner == 0, "Slot released");
+
+   // the slot of a dead owner is left to the recovery
+   pid_t dead = dead_pid();
+   FAKE_CHECK(dead > 0, "Dead process");
+   second->slots[0].owner = dead;
+   FAKE_CHECK(dvfs_journal_take(second, core, 0) == DVFS_SUCCESS, "Take dead slot");
+   FAKE_CHECK(second->slots[0].owner == dead, "Dead slot kept");
+   second->slots[0].owner = 0;
+
+   FAKE_CHECK(dvfs_journal_close(second) == DVFS_SUCCESS, "Close second journal");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * The slots follow the leases, and the recovery leaves the leased units alone.
+ */
+static int run_lease(void)
+{
+   dvfs_journal *journal = NULL, *other = NULL;
+   dvfs_unit *unit = NULL;
+   unsigned int nb = 0;
+   char path[512];
+
+   snprintf(path, sizeof(path), "%s/leases", fake_root);
+   setenv(DVFS_LEASE_PATH_ENV, path, 1);
+
+   dvfs_core **cores = malloc(sizeof(*cores));
+   FAKE_CHECK(cores != NULL, "Allocate cores");
+   FAKE_CHECK(dvfs_core_open(&cores[0], 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(dvfs_unit_open(&unit, 1, cores, 0) == DVFS_SUCCESS, "Open unit");
+   FAKE_CHECK(dvfs_journal_open(&journal, NULL) == DVFS_SUCCESS, "Open journal");
+   FAKE_CHECK(dvfs_journal_open(&other, NULL) == DVFS_SUCCESS, "Open other journal");
+   dvfs_ctx ctx = { .backend = &dvfs_backend_sysfs, .nb_units = 1, .units = &unit, .journal = journal };
+
+   // another context of the process journaled the core first
+   FAKE_CHECK(dvfs_journal_record(other, cores[0], 0) == DVFS_SUCCESS, "Record core");
+   const dvfs_unit *leased = unit;
+   FAKE_CHECK(dvfs_lease_acquire(&ctx, "job", 1, &leased) == DVFS_SUCCESS, "Lease unit");
+   FAKE_CHECK(journal->slots[0].owner == getpid() && journal->slots[0].handle == journal->handle, "Slot follows the lease");
+   FAKE_CHECK(journal->slots[0].unit == 0, "Unit journaled");
+
+   // as if the owner died while the unit is leased
+   pid_t dead = dead_pid();
+   FAKE_CHECK(dead > 0, "Dead process");
+   journal->slots[0].owner = dead;
+   FAKE_CHECK(dvfs_journal_recover(other, &nb) == DVFS_SUCCESS && nb == 0, "Leased unit not recovered");
+   FAKE_CHECK(journal->slots[0].owner == dead, "Slot of the leased unit kept");
+   journal->slots[0].owner = getpid();
+
+   FAKE_CHECK(dvfs_lease_release(&ctx, 1, &leased) == DVFS_SUCCESS, "Release unit");
+   FAKE_CHECK(journal->slots[0].owner == 0, "Slot freed with the lease");
+
+   FAKE_CHECK(dvfs_lease_close(ctx.lease) == DVFS_SUCCESS, "Close leases");
+   FAKE_CHECK(dvfs_journal_close(other) == DVFS_SUCCESS, "Close other journal");
+   FAKE_CHECK(dvfs_journal_close(journal) == DVFS_SUCCESS, "Close journal");
+   FAKE_CHECK(dvfs_unit_close(unit) == DVFS_SUCCESS, "Close unit");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   if (ret == EXIT_SUCCESS) {
+      ret = run_contexts();
+   }
+   if (ret == EXIT_SUCCESS) {
+      ret = run_lease();
+   }
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_journal: OK\n");
+   }
+   return ret;
+}
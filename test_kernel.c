@@ -0,0 +1,33 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Kernel loaded by test_profile as a shared object (see dvfs_profile.h).
+ */
+
+volatile unsigned long long test_kernel_sink;
+
+void dvfs_kernel_run(unsigned long long n)
+{
+   unsigned long long i, x = 1;
+
+   for (i = 0; i < n * 1000; i++)
+   {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+   }
+   test_kernel_sink = x;
+}
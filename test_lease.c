@@ -0,0 +1,173 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+/**
+ * Leases the last unit from another process and waits to be killed.
+ */
+static void child(int fd)
+{
+   dvfs_ctx *ctx = NULL;
+   const dvfs_unit *unit;
+
+   if (dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      _exit(EXIT_FAILURE);
+   }
+   unit = ctx->units[ctx->nb_units - 1];
+   if (dvfs_lease_acquire(ctx, "child", 1, &unit) != DVFS_SUCCESS
+       || write(fd, "x", 1) != 1) {
+      _exit(EXIT_FAILURE);
+   }
+   pause();
+   _exit(EXIT_SUCCESS);
+}
+
+static int run(dvfs_ctx *a, dvfs_ctx *b)
+{
+   const dvfs_unit *units[4];
+   dvfs_mock_stats stats;
+   char owner[DVFS_LEASE_OWNER_LEN];
+   char gov[32];
+   pid_t pid, owner_pid = 0;
+   int fds[2];
+   char c;
+
+   // another process holds the last unit until it is killed
+   CHECK(pipe(fds) == 0, "Create pipe");
+   pid = fork();
+   CHECK(pid >= 0, "Fork");
+   if (pid == 0) {
+      close(fds[0]);
+      child(fds[1]);
+   }
+   close(fds[1]);
+   CHECK(read(fds[0], &c, 1) == 1, "Child ready");
+   close(fds[0]);
+
+   units[0] = a->units[0];
+   units[1] = a->units[1];
+   CHECK(dvfs_lease_acquire(a, "jobA", 2, units) == DVFS_SUCCESS, "Lease first units");
+
+   // all or nothing
+   units[0] = b->units[1];
+   units[1] = b->units[2];
+   CHECK(dvfs_lease_acquire(b, "jobB", 2, units) == DVFS_ERROR_LEASE_HELD, "Unit leased by another context");
+   units[0] = b->units[2];
+   units[1] = b->units[3];
+   CHECK(dvfs_lease_acquire(b, "jobB", 2, units) == DVFS_ERROR_LEASE_HELD, "Unit leased by another process");
+   CHECK(dvfs_lease_acquire(b, "jobB", 1, units) == DVFS_SUCCESS, "Lease free unit after a failure");
+
+   CHECK(dvfs_lease_get_owner(b, b->units[0], owner, sizeof(owner), &owner_pid) == DVFS_SUCCESS, "Get owner");
+   CHECK(strcmp(owner, "jobA") == 0 && owner_pid == getpid(), "Owner of a leased unit");
+   CHECK(dvfs_lease_get_owner(a, a->units[3], owner, sizeof(owner), &owner_pid) == DVFS_SUCCESS, "Get owner");
+   CHECK(strcmp(owner, "child") == 0 && owner_pid == pid, "Owner in another process");
+
+   // the operations outside the lease are refused or skipped
+   CHECK(dvfs_unit_set_freq(a->units[2], 1200000) == DVFS_ERROR_NOT_LEASED, "Unit outside the lease");
+   CHECK(dvfs_core_set_gov(a->units[3]->cores[0], "performance") == DVFS_ERROR_NOT_LEASED, "Core outside the lease");
+   dvfs_mock_reset_stats();
+   CHECK(dvfs_set_gov(a, "userspace") == DVFS_SUCCESS, "Set governor on the context");
+   CHECK(dvfs_set_freq(a, 1200000) == DVFS_SUCCESS, "Set frequency on the context");
+   CHECK(dvfs_mock_get_stats(&stats) == DVFS_SUCCESS && stats.nb_set_freq == 2 && stats.nb_set_gov == 2, "Only the leased units changed");
+
+   // the kernel releases the leases of a dead process
+   CHECK(kill(pid, SIGKILL) == 0, "Kill child");
+   CHECK(waitpid(pid, NULL, 0) == pid, "Wait child");
+   CHECK(dvfs_lease_get_owner(a, a->units[3], owner, sizeof(owner), &owner_pid) == DVFS_SUCCESS, "Get owner");
+   CHECK(owner[0] == '\0' && owner_pid == 0, "Lease of a dead process released");
+   units[0] = b->units[3];
+   CHECK(dvfs_lease_acquire(b, "jobB", 1, units) == DVFS_SUCCESS, "Lease unit of a dead process");
+
+   // released units are fenced again and can be leased by others
+   units[0] = a->units[1];
+   CHECK(dvfs_lease_release(a, 1, units) == DVFS_SUCCESS, "Release unit");
+   CHECK(dvfs_core_get_gov(a->units[1]->cores[0], gov, sizeof(gov)) == DVFS_SUCCESS && strcmp(gov, "ondemand") == 0, "Released unit restored");
+   CHECK(dvfs_lease_release(a, 1, units) == DVFS_ERROR_NOT_LEASED, "Release unit twice");
+   CHECK(dvfs_unit_set_freq(a->units[1], 1200000) == DVFS_ERROR_NOT_LEASED, "Released unit fenced");
+   units[0] = b->units[1];
+   CHECK(dvfs_lease_acquire(b, "jobB", 1, units) == DVFS_SUCCESS, "Lease released unit");
+   CHECK(dvfs_unit_set_freq(b->units[1], 1200000) == DVFS_SUCCESS, "Leased unit changed");
+
+   return EXIT_SUCCESS;
+}
+
+static int run_read_only(void)
+{
+   dvfs_ctx *ctx = NULL;
+   const dvfs_unit *unit;
+   dvfs_mock_stats stats;
+   unsigned int freq = 0;
+
+   // a monitor reads the units, never writes nor restores them
+   CHECK(dvfs_start_read_only(&ctx, &dvfs_backend_mock) == DVFS_SUCCESS, "Start read-only context");
+   unit = ctx->units[0];
+   CHECK(dvfs_unit_get_freq(unit, &freq) == DVFS_SUCCESS && freq != 0, "Read the frequency");
+   CHECK(dvfs_unit_set_freq(unit, 1200000) == DVFS_ERROR_NOT_LEASED, "Change refused");
+   CHECK(dvfs_lease_acquire(ctx, "monitor", 1, &unit) == DVFS_ERROR_INVALID_ARG, "No lease");
+   CHECK(dvfs_set_freq(ctx, 1200000) == DVFS_ERROR_NOT_LEASED, "No unit to set the frequency of");
+   CHECK(dvfs_set_gov(ctx, "userspace") == DVFS_ERROR_NOT_LEASED, "No unit to set the governor of");
+   CHECK(dvfs_set_gov_id(ctx, 0) == DVFS_ERROR_NOT_LEASED, "No unit to set the governor id of");
+   dvfs_mock_reset_stats();
+   CHECK(dvfs_stop(ctx) == DVFS_SUCCESS, "Stop read-only context");
+   CHECK(dvfs_mock_get_stats(&stats) == DVFS_SUCCESS && stats.nb_set_freq == 0 && stats.nb_set_gov == 0, "Nothing restored");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *a = NULL, *b = NULL;
+   char path[64];
+
+   (void) argc;
+   (void) argv;
+
+   snprintf(path, sizeof(path), "/tmp/test_lease.%d", (int) getpid());
+   setenv(DVFS_LEASE_PATH_ENV, path, 1);
+
+   if (dvfs_start_backend(&a, false, &dvfs_backend_mock) != DVFS_SUCCESS
+       || dvfs_start_backend(&b, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(a, b);
+   if (ret == EXIT_SUCCESS) {
+      ret = run_read_only();
+   }
+
+   dvfs_stop(b);
+   dvfs_stop(a);
+   unlink(path);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_lease: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,162 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+/**
+ * Fills a curve measured with a power of static + dyn * f^3 W, -1 J if the
+ * energy is not measured.
+ */
+static int fill_curve(dvfs_profile_curve *curve, const dvfs_unit *unit, double static_w, double dyn_w)
+{
+   const dvfs_core *core = unit->cores[0];
+   unsigned int i;
+
+   curve->points = malloc(core->nb_freqs * sizeof(*curve->points));
+   if (curve->points == NULL) {
+      return -1;
+   }
+
+   curve->nb_points = core->nb_freqs;
+   for (i = 0; i < core->nb_freqs; i++) {
+      double ghz = core->freqs[i] / 1e6;
+
+      curve->points[i].freq = core->freqs[i];
+      curve->points[i].time = 1e-3 / ghz;
+      curve->points[i].energy = static_w < 0 ? -1 : (static_w + dyn_w * ghz * ghz * ghz) * curve->points[i].time;
+      curve->points[i].eff_freq = core->freqs[i];
+   }
+   return 0;
+}
+
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_model *model = NULL, *small = NULL;
+   dvfs_profile *profile = NULL;
+   dvfs_model_prediction predictions[8];
+   const dvfs_unit *unit = NULL, *other = NULL;
+   unsigned int freq, nb, i, best = 0;
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_get_unit_by_id(ctx, &other, 1) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_model_open(&model, ctx->nb_units) == DVFS_SUCCESS, "Open model");
+   CHECK(!model->coeffs[0].calibrated, "Default coefficients");
+
+   // unit 0 with measures, unit 1 without energy
+   CHECK(dvfs_profile_create(&profile, ctx->nb_units) == DVFS_SUCCESS, "Create profile");
+   CHECK(fill_curve(&profile->curves[DVFS_KERNEL_COMPUTE], unit, 5, 2) == 0, "Compute curve");
+   CHECK(fill_curve(&profile->curves[DVFS_KERNEL_DRAM], unit, 5, 1) == 0, "DRAM curve");
+   CHECK(fill_curve(&profile->curves[DVFS_KERNEL_NB + DVFS_KERNEL_COMPUTE], other, -1, 0) == 0, "Curve without energy");
+   CHECK(dvfs_model_calibrate(model, profile, &nb) == DVFS_SUCCESS && nb == 1, "Calibrate");
+   CHECK(dvfs_profile_free(profile) == DVFS_SUCCESS, "Free profile");
+
+   CHECK(model->coeffs[0].calibrated && !model->coeffs[1].calibrated, "Calibrated units");
+   CHECK(fabs(model->coeffs[0].static_w - 5) < 1e-6, "Static power");
+   CHECK(fabs(model->coeffs[0].dyn_w - 2) < 1e-6, "Dynamic power");
+   CHECK(fabs(model->coeffs[0].stall_ratio - 0.5) < 1e-6, "Stall ratio");
+
+   // compute-bound: 1 ms at 1.7 GHz
+   dvfs_model_sample sample = { .freq = 1700000, .cycles = 1.7e6, .stalls = 0 };
+   CHECK(dvfs_model_predict(model, unit, &sample, predictions) == DVFS_SUCCESS, "Predict");
+   CHECK(predictions[0].freq == 1000000 && predictions[7].freq == 1700000, "Frequencies");
+   CHECK(fabs(predictions[7].time - 1e-3) < 1e-12 && fabs(predictions[0].time - 1.7e-3) < 1e-12, "Time scaled");
+   CHECK(fabs(predictions[7].energy - (5 + 2 * 1.7 * 1.7 * 1.7) * 1e-3) < 1e-12, "Energy");
+
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_TIME, &freq) == DVFS_SUCCESS && freq == 1700000, "Fastest");
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_ENERGY, &freq) == DVFS_SUCCESS && freq == 1100000, "Lowest energy");
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_EDP, &freq) == DVFS_SUCCESS && freq == 1700000, "Lowest EDP");
+
+   // memory-bound: the time does not depend on the frequency
+   sample.stalls = sample.cycles;
+   CHECK(dvfs_model_predict(model, unit, &sample, predictions) == DVFS_SUCCESS, "Predict");
+   CHECK(fabs(predictions[0].time - predictions[7].time) < 1e-12, "Constant time");
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_TIME, &freq) == DVFS_SUCCESS && freq == 1000000, "Ties go low");
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_ED2P, &freq) == DVFS_SUCCESS && freq == 1000000, "Lowest ED2P");
+
+   // mixed: the selection matches the predictions
+   sample.freq = 1300000, sample.cycles = 1e6, sample.stalls = 4e5;
+   CHECK(dvfs_model_predict(model, unit, &sample, predictions) == DVFS_SUCCESS, "Predict");
+   for (i = 1; i < 8; i++) {
+      if (predictions[i].energy * predictions[i].time < predictions[best].energy * predictions[best].time) {
+         best = i;
+      }
+   }
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_EDP, &freq) == DVFS_SUCCESS, "Best EDP");
+   CHECK(freq == predictions[best].freq, "Best EDP predicted");
+
+   // samples from the counters, stalls estimated from the misses
+   dvfs_counters_sample prev = { .values = { 0 } }, cur = { .values = { 0 } };
+   cur.values[DVFS_COUNTER_CYCLES] = 2000000;
+   cur.values[DVFS_COUNTER_LLC_MISSES] = 1000;
+   CHECK(dvfs_model_sample_from_counters(&prev, &cur, 1000000, &sample) == DVFS_SUCCESS, "Sample from counters");
+   CHECK(sample.cycles == 2e6 && fabs(sample.stalls - 8e4) < 1e-6, "Stalls from misses");
+   cur.values[DVFS_COUNTER_STALLS] = 3000000;
+   CHECK(dvfs_model_sample_from_counters(&prev, &cur, 1000000, &sample) == DVFS_SUCCESS, "Sample from counters");
+   CHECK(sample.stalls == sample.cycles, "Stalls bounded");
+
+   // errors
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_NB, &freq) == DVFS_ERROR_INVALID_ARG, "Unknown objective");
+   sample.freq = 0;
+   CHECK(dvfs_unit_best_freq(model, unit, &sample, DVFS_OBJ_TIME, &freq) == DVFS_ERROR_INVALID_ARG, "No frequency");
+   sample.freq = 1000000;
+   CHECK(dvfs_model_open(&small, 1) == DVFS_SUCCESS, "Open model");
+   CHECK(dvfs_model_predict(small, other, &sample, predictions) == DVFS_ERROR_INVALID_INDEX, "Unit out of the model");
+   CHECK(dvfs_model_close(small) == DVFS_SUCCESS, "Close model");
+
+   CHECK(dvfs_model_close(model) == DVFS_SUCCESS, "Close model");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_model: OK\n");
+   }
+   return ret;
+}
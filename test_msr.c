@@ -0,0 +1,136 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+
+#include "libdvfs.h"
+#include "dvfs_msr.h"
+
+#define CPUFREQ "/devices/system/cpu/cpu0/cpufreq"
+#define MSR_FILE "/msr/cpu0"
+
+static void write_msr(uint32_t reg, uint64_t val)
+{
+   char path[512];
+
+   snprintf(path, sizeof(path), "%s" MSR_FILE, fake_root);
+   int fd = open(path, O_WRONLY | O_CREAT, 0644);
+   if (fd >= 0) {
+      dvfs_msr_write(fd, reg, val);
+      close(fd);
+   }
+}
+
+static uint64_t read_msr(uint32_t reg)
+{
+   char path[512];
+   uint64_t val = 0;
+
+   snprintf(path, sizeof(path), "%s" MSR_FILE, fake_root);
+   int fd = open(path, O_RDONLY);
+   if (fd >= 0) {
+      dvfs_msr_read(fd, reg, &val);
+      close(fd);
+   }
+   return val;
+}
+
+static int run(void)
+{
+   char pattern[512];
+   dvfs_core *core = NULL;
+   unsigned int freq = 0;
+   dvfs_features features;
+
+   snprintf(pattern, sizeof(pattern), "%s/msr/cpu%%u", fake_root);
+   setenv(DVFS_MSR_PATH_ENV, pattern, 1);
+
+   fake_write(CPUFREQ "/scaling_governor", "userspace\n");
+   fake_write("/msr/cpu0", "");
+
+   // ratios 8 to 24, 30 in turbo, HWP disabled
+   write_msr(DVFS_MSR_PLATFORM_INFO, (8ULL << 40) | (24ULL << 8));
+   write_msr(DVFS_MSR_TURBO_RATIO_LIMIT, 30);
+   write_msr(DVFS_MSR_IA32_PM_ENABLE, 0);
+   // in a regular file, the registers at consecutive addresses overlap: the
+   // low byte of PERF_CTL is the ratio field of PERF_STATUS (16)
+   write_msr(DVFS_MSR_IA32_PERF_CTL, 0x100001810ULL);
+
+   FAKE_CHECK(dvfs_core_open_backend(&core, 0, false, &dvfs_backend_msr) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(core->nb_freqs == 18, "Ratio table size");
+   FAKE_CHECK(core->freqs[0] == 800000 && core->freqs[16] == 2400000, "Non-turbo ratios");
+   FAKE_CHECK(core->freqs[17] == 3000000, "Turbo ratio");
+   FAKE_CHECK(strcmp(core->init_gov, "userspace") == 0 && core->init_freq == 2400000, "Initial state kept in the core");
+
+   FAKE_CHECK(dvfs_core_get_current_freq(core, &freq) == DVFS_SUCCESS && freq == 1600000, "Current ratio");
+
+   FAKE_CHECK(dvfs_core_set_freq(core, 1200000) == DVFS_SUCCESS, "Set frequency");
+   FAKE_CHECK(read_msr(DVFS_MSR_IA32_PERF_CTL) == 0x100000C10ULL, "Ratio written, other bits kept");
+   FAKE_CHECK(dvfs_core_set_freq(core, 1250000) == DVFS_ERROR_INVALID_FREQ, "Unknown frequency");
+
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+   FAKE_CHECK(read_msr(DVFS_MSR_IA32_PERF_CTL) == 0x100001810ULL, "Request restored");
+
+   // the register is ignored when HWP is enabled, the enable bit is only
+   // read when the processor supports HWP
+   write_msr(DVFS_MSR_IA32_PM_ENABLE, 1);
+   FAKE_CHECK(dvfs_features_detect(&features) == DVFS_SUCCESS, "Detect features");
+   features.hwp = false;
+   FAKE_CHECK(dvfs_features_override(&features) == DVFS_SUCCESS, "Processor without HWP");
+   FAKE_CHECK(dvfs_core_open_backend(&core, 0, false, &dvfs_backend_msr) == DVFS_SUCCESS, "Enable bit not read");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+   features.hwp = true;
+   FAKE_CHECK(dvfs_features_override(&features) == DVFS_SUCCESS, "Processor with HWP");
+   FAKE_CHECK(dvfs_core_open_backend(&core, 0, false, &dvfs_backend_msr) == DVFS_ERROR_HWP_ACTIVE, "HWP refused");
+
+   // the pattern is not a format
+   int fd;
+   setenv(DVFS_MSR_PATH_ENV, "/tmp/%s/msr%u", 1);
+   FAKE_CHECK(dvfs_msr_open(0, O_RDONLY, &fd) == DVFS_ERROR_INVALID_ARG, "Other conversion");
+   setenv(DVFS_MSR_PATH_ENV, "/tmp/cpu%u/msr%u", 1);
+   FAKE_CHECK(dvfs_msr_open(0, O_RDONLY, &fd) == DVFS_ERROR_INVALID_ARG, "Two conversions");
+   setenv(DVFS_MSR_PATH_ENV, "/tmp/msr", 1);
+   FAKE_CHECK(dvfs_msr_open(0, O_RDONLY, &fd) == DVFS_ERROR_INVALID_ARG, "No conversion");
+   setenv(DVFS_MSR_PATH_ENV, pattern, 1);
+   FAKE_CHECK(dvfs_msr_open(0, O_RDONLY, &fd) == DVFS_SUCCESS, "Single conversion");
+   FAKE_CHECK((fcntl(fd, F_GETFD) & FD_CLOEXEC) != 0, "Close on exec");
+   close(fd);
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_msr: OK\n");
+   }
+   return ret;
+}
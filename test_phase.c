@@ -0,0 +1,265 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+// Synthetic recording: 1 ms periods of a single core at 1.7 GHz
+#define TRACE_FREQ 1700000
+#define TRACE_PERIOD 1000000ULL
+#define SEGMENT 20
+
+/**
+ * Cumulative counts of a synthetic unit.
+ */
+typedef struct {
+   unsigned long long time, cycles, instructions, misses, stalls;
+} trace_unit;
+
+/**
+ * Appends a segment of samples of the given activity and stall ratio to a
+ * trace, with a small deterministic noise.
+ */
+static void write_segment(FILE *trace, unsigned int id, trace_unit *t, double activity, double stall_ratio)
+{
+   unsigned int i;
+
+   for (i = 0; i < SEGMENT; i++)
+   {
+      double noise = ((int) ((i * 7 + id) % 5) - 2) * 0.01;
+      unsigned long long cycles = (activity + noise) * TRACE_PERIOD * TRACE_FREQ / 1000000;
+
+      t->time += TRACE_PERIOD;
+      t->cycles += cycles;
+      t->instructions += cycles;
+      t->misses += cycles / 100;
+      t->stalls += cycles * (stall_ratio + noise);
+      fprintf(trace, "%u %u %llu %llu %llu %llu %llu\n", id, TRACE_FREQ, t->time, t->cycles, t->instructions, t->misses, t->stalls);
+   }
+}
+
+static unsigned int unit_freq(const dvfs_unit *unit)
+{
+   unsigned int freq = 0;
+
+   dvfs_unit_get_freq(unit, &freq);
+   return freq;
+}
+
+static int test_replay(dvfs_ctx *ctx, const char *path, dvfs_mock_config *mock)
+{
+   dvfs_phase *phase = NULL;
+   dvfs_phase_stats stats;
+   const dvfs_unit *unit0 = NULL, *unit1 = NULL;
+   trace_unit t0, t1;
+   FILE *trace;
+   dvfs_phase_config config = {
+      .freqs = { 1700000, 1200000, 1000000 },
+      .idle_threshold = 0.2,
+      .memory_threshold = 0.4,
+      .drift = 0.1,
+      .limit = 1.0,
+      .period_ms = 0,
+      .record_path = NULL,
+   };
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit0, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_get_unit_by_id(ctx, &unit1, 1) == DVFS_SUCCESS, "Get unit");
+   config.idle_threshold = 0;
+   CHECK(dvfs_phase_open(&phase, ctx, NULL, &config) == DVFS_ERROR_INVALID_ARG, "Invalid threshold");
+   config.idle_threshold = 0.2;
+
+   // the frequencies would not be applied without the governor
+   mock->error_period = 1;
+   dvfs_mock_configure(mock);
+   CHECK(dvfs_phase_open(&phase, ctx, NULL, &config) == DVFS_ERROR_FILE_ERROR, "Governor not set");
+   mock->error_period = 0;
+   dvfs_mock_configure(mock);
+
+   CHECK(dvfs_phase_open(&phase, ctx, NULL, &config) == DVFS_SUCCESS, "Open detector");
+   CHECK(dvfs_phase_step(phase) == DVFS_ERROR_INVALID_ARG, "Step without counters");
+   CHECK(dvfs_phase_start(phase) == DVFS_ERROR_INVALID_ARG, "Thread without counters");
+
+   // compute then memory-bound on unit 0, compute-bound all along on unit 1
+   memset(&t0, 0, sizeof(t0));
+   memset(&t1, 0, sizeof(t1));
+   trace = fopen(path, "w");
+   CHECK(trace != NULL, "Create trace");
+   fprintf(trace, "dvfs_phase_trace stalls=1\n");
+   write_segment(trace, 0, &t0, 0.9, 0.1);
+   write_segment(trace, 1, &t1, 0.9, 0.1);
+   write_segment(trace, 0, &t0, 0.8, 0.7);
+   write_segment(trace, 1, &t1, 0.9, 0.1);
+   fclose(trace);
+
+   CHECK(dvfs_phase_replay(phase, path) == DVFS_SUCCESS, "Replay");
+   CHECK(dvfs_phase_get_stats(phase, unit0, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.current == DVFS_PHASE_MEMORY && unit_freq(unit0) == 1200000, "Memory-bound phase");
+   CHECK(stats.nb_samples == 2 * SEGMENT - 1 && stats.nb_change_points == 1, "Change point");
+
+   // then idle and compute-bound again, the counts go on
+   trace = fopen(path, "w");
+   CHECK(trace != NULL, "Create trace");
+   fprintf(trace, "dvfs_phase_trace stalls=1\n");
+   write_segment(trace, 0, &t0, 0.05, 0.1);
+   write_segment(trace, 1, &t1, 0.9, 0.1);
+   write_segment(trace, 0, &t0, 0.9, 0.1);
+   write_segment(trace, 1, &t1, 0.9, 0.1);
+   fclose(trace);
+
+   CHECK(dvfs_phase_replay(phase, path) == DVFS_SUCCESS, "Replay");
+   CHECK(dvfs_phase_get_stats(phase, unit0, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.current == DVFS_PHASE_COMPUTE && unit_freq(unit0) == 1700000, "Compute-bound phase");
+   CHECK(stats.nb_samples == 4 * SEGMENT - 1, "Samples");
+   CHECK(stats.nb_change_points == 3 && stats.nb_switches == 4 && stats.nb_freq_changes == 4, "Phases detected");
+   CHECK(stats.residency[DVFS_PHASE_MEMORY] >= SEGMENT - 3 && stats.residency[DVFS_PHASE_IDLE] >= SEGMENT - 3, "Residency");
+   CHECK(stats.last_status == DVFS_SUCCESS, "Frequency changes");
+
+   CHECK(dvfs_phase_get_stats(phase, unit1, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.current == DVFS_PHASE_COMPUTE && stats.residency[DVFS_PHASE_COMPUTE] == 4 * SEGMENT - 1, "Stable unit");
+   CHECK(stats.nb_change_points == 0 && stats.nb_switches == 1 && stats.nb_freq_changes == 1, "Noise ignored");
+
+   // malformed traces
+   trace = fopen(path, "w");
+   CHECK(trace != NULL, "Create trace");
+   fprintf(trace, "dvfs_phase_trace stalls=1\n99 1700000 1 1 1 1 1\n");
+   fclose(trace);
+   CHECK(dvfs_phase_replay(phase, path) == DVFS_ERROR_INVALID_INDEX, "Unknown unit");
+   trace = fopen(path, "w");
+   CHECK(trace != NULL, "Create trace");
+   fprintf(trace, "not a trace\n");
+   fclose(trace);
+   CHECK(dvfs_phase_replay(phase, path) == DVFS_ERROR_FILE_ERROR, "Malformed trace");
+
+   CHECK(dvfs_phase_close(phase) == DVFS_SUCCESS, "Close detector");
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Records the samples of the sampling thread and checks that replaying them
+ * gives the same decisions.
+ */
+static int test_record(dvfs_ctx *ctx, const char *path)
+{
+   dvfs_counters *counters = NULL;
+   dvfs_phase *live = NULL, *replay = NULL;
+   dvfs_phase_stats live_stats, replay_stats;
+   const dvfs_unit *unit = NULL;
+   // software events standing for the default ones
+   const dvfs_counters_event events[] = {
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+      { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+   };
+   dvfs_phase_config config = {
+      .freqs = { 1700000, 1200000, 1000000 },
+      .idle_threshold = 0.2,
+      .memory_threshold = 0.4,
+      .drift = 0.1,
+      .limit = 1.0,
+      .period_ms = 5,
+      .record_path = path,
+   };
+
+   if (dvfs_counters_open(&counters, ctx, events, 4) != DVFS_SUCCESS)
+   {
+      printf("test_phase: perf_event_open not allowed, recording skipped\n");
+      return EXIT_SUCCESS;
+   }
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_phase_open(&live, ctx, counters, &config) == DVFS_SUCCESS, "Open detector");
+   CHECK(dvfs_phase_start(live) == DVFS_SUCCESS, "Start thread");
+   CHECK(dvfs_phase_start(live) == DVFS_ERROR_INVALID_ARG, "Thread already running");
+   usleep(100000);
+   CHECK(dvfs_phase_stop(live) == DVFS_SUCCESS, "Stop thread");
+   CHECK(dvfs_phase_step(live) == DVFS_SUCCESS, "Step");
+   CHECK(dvfs_phase_get_stats(live, unit, &live_stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(live_stats.nb_samples > 0, "Samples classified");
+   CHECK(dvfs_phase_close(live) == DVFS_SUCCESS, "Close detector");
+
+   config.record_path = NULL;
+   CHECK(dvfs_phase_open(&replay, ctx, NULL, &config) == DVFS_SUCCESS, "Open detector");
+   CHECK(dvfs_phase_replay(replay, path) == DVFS_SUCCESS, "Replay recording");
+   CHECK(dvfs_phase_get_stats(replay, unit, &replay_stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(replay_stats.nb_samples == live_stats.nb_samples, "Same samples");
+   CHECK(replay_stats.nb_change_points == live_stats.nb_change_points, "Same change points");
+   CHECK(replay_stats.nb_switches == live_stats.nb_switches && replay_stats.current == live_stats.current, "Same classes");
+   CHECK(memcmp(replay_stats.residency, live_stats.residency, sizeof(live_stats.residency)) == 0, "Same residency");
+   CHECK(dvfs_phase_close(replay) == DVFS_SUCCESS, "Close detector");
+
+   CHECK(dvfs_counters_close(counters) == DVFS_SUCCESS, "Close counters");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   char path[64];
+   long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   // the replay needs two units, the recording counts the real cores
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   snprintf(path, sizeof(path), "/tmp/test_phase.%d", (int) getpid());
+   int ret = test_replay(ctx, path, &config);
+   dvfs_stop(ctx);
+
+   config.nb_cores = nb_cpus >= 2 ? 2 : 1;
+   if (ret == EXIT_SUCCESS)
+   {
+      if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+          || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+         return EXIT_FAILURE;
+      }
+      ret = test_record(ctx, path);
+      dvfs_stop(ctx);
+   }
+   unlink(path);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_phase: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,157 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define RAPL0 "/class/powercap/intel-rapl:0"
+#define RAPL1 "/class/powercap/intel-rapl:1"
+
+#define PERIOD_US 100000
+#define RANGE_UJ 1000000000ULL
+
+/**
+ * Simulated power of a package: a static part and a part growing with the
+ * square of the frequency of its units.
+ */
+static unsigned int package_power(const dvfs_ctx *ctx, unsigned int first_unit)
+{
+   unsigned int freq, i;
+   double power = 5000;
+
+   for (i = first_unit; i < first_unit + 2; i++) {
+      // the unit reports the highest of its cores and of the given value
+      freq = 0;
+      dvfs_unit_get_freq(ctx->units[i], &freq);
+      power += 2000 * (freq / 1e6) * (freq / 1e6);
+   }
+   return power;
+}
+
+/**
+ * Advances the energy counters of the fake tree by one period.
+ */
+static void simulate(const dvfs_ctx *ctx, unsigned long long *energies)
+{
+   energies[0] = (energies[0] + package_power(ctx, 0) * (PERIOD_US / 1000ULL)) % RANGE_UJ;
+   energies[1] = (energies[1] + package_power(ctx, 2) * (PERIOD_US / 1000ULL)) % RANGE_UJ;
+   fake_write(RAPL0 "/energy_uj", "%llu\n", energies[0]);
+   fake_write(RAPL1 "/energy_uj", "%llu\n", energies[1]);
+}
+
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_powercap *cap = NULL;
+   dvfs_powercap_stats stats;
+   // the second counter wraps around during the test
+   unsigned long long energies[2] = { 0, RANGE_UJ - 10000 };
+   unsigned int power = 0, freq_high = 0, freq_low = 0, i;
+   int converged = -1;
+   dvfs_powercap_config config = {
+      .target_mw = 35000,
+      .tolerance_mw = 2000,
+      .period_ms = 100,
+      .nb_periods = 8,
+   };
+
+   fake_write(RAPL0 "/max_energy_range_uj", "%llu\n", RANGE_UJ);
+   fake_write(RAPL1 "/max_energy_range_uj", "%llu\n", RANGE_UJ);
+   fake_write(RAPL0 "/energy_uj", "%llu\n", energies[0]);
+   fake_write(RAPL1 "/energy_uj", "%llu\n", energies[1]);
+
+   FAKE_CHECK(dvfs_powercap_open(&cap, ctx, &config) == DVFS_SUCCESS, "Open controller");
+   FAKE_CHECK(cap->nb_domains == 2, "Package domains");
+
+   // the memory-bound units (odd ones) are lowered first
+   for (i = 0; i < ctx->nb_units; i++) {
+      FAKE_CHECK(dvfs_powercap_set_priority(cap, ctx->units[i], i % 2 == 0 ? 2 : 1) == DVFS_SUCCESS, "Set priority");
+   }
+
+   // starting from the lowest frequencies, then the target is lowered
+   for (i = 0; i < 6 * config.nb_periods; i++) {
+      if (i == 3 * config.nb_periods) {
+         FAKE_CHECK(converged >= 0, "Converged upward");
+         FAKE_CHECK(dvfs_powercap_set_target(cap, 25000) == DVFS_SUCCESS, "Lower target");
+         config.target_mw = 25000;
+         converged = -1;
+      }
+
+      simulate(ctx, energies);
+      FAKE_CHECK(dvfs_powercap_step(cap, PERIOD_US, &power) == DVFS_SUCCESS, "Step");
+
+      bool within = power <= config.target_mw && power + config.tolerance_mw >= config.target_mw;
+      if (within && converged < 0) {
+         converged = i % (3 * config.nb_periods);
+      } else if (!within) {
+         converged = -1;
+      }
+   }
+   FAKE_CHECK(converged >= 0 && converged <= (int) (2 * config.nb_periods), "Converged downward");
+
+   dvfs_unit_get_freq(ctx->units[0], &freq_high);
+   dvfs_unit_get_freq(ctx->units[1], &freq_low);
+   FAKE_CHECK(freq_high > freq_low, "Priorities respected");
+
+   FAKE_CHECK(dvfs_powercap_get_stats(cap, &stats) == DVFS_SUCCESS, "Get stats");
+   FAKE_CHECK(stats.nb_steps == 6 * config.nb_periods && stats.nb_changes > 0 && stats.mw_per_step > 0, "Counters");
+   FAKE_CHECK(dvfs_powercap_close(cap) == DVFS_SUCCESS, "Close controller");
+
+   // no package domain
+   fake_write(RAPL0 "/energy_uj", "");
+   FAKE_CHECK(dvfs_powercap_open(&cap, ctx, &config) == DVFS_ERROR_POWERCAP_UNAVAILABLE, "Unreadable domain");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 4,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 200000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      fake_root_remove();
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+   dvfs_stop(ctx);
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_powercap: OK\n");
+   }
+   return ret;
+}
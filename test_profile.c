@@ -0,0 +1,218 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test_fakesys.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "libdvfs.h"
+#include "dvfs_msr.h"
+
+#define CACHE0 "/devices/system/cpu/cpu0/cache/index0"
+#define RAPL0 "/class/powercap/intel-rapl:0"
+#define CPU1 "/devices/system/cpu/cpu1/cpufreq"
+
+static int same(double a, double b)
+{
+   return fabs(a - b) <= 1e-6 * fabs(a);
+}
+
+static int run(dvfs_ctx *ctx, const char *path, dvfs_mock_config *mock)
+{
+   char gov[128];
+   dvfs_profile *profile = NULL, *loaded = NULL;
+   const dvfs_profile_curve *curve = NULL, *loaded_curve = NULL;
+   const dvfs_unit *unit = NULL;
+   unsigned int i, k;
+   FILE *f;
+   dvfs_profile_config config = {
+      .kernels = (1U << DVFS_KERNEL_COMPUTE) | (1U << DVFS_KERNEL_L1) | (1U << DVFS_KERNEL_USER),
+      .warmup = 1,
+      .repetitions = 3,
+      .duration_us = 2000,
+      .user_kernel = "./test_kernel.so",
+   };
+
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   FAKE_CHECK(dvfs_profile_create(&profile, ctx->nb_units) == DVFS_SUCCESS, "Create profile");
+   FAKE_CHECK(profile->machine[0] != '\0', "Machine");
+
+   config.repetitions = 0;
+   FAKE_CHECK(dvfs_profile_characterize(ctx, unit, &config, profile) == DVFS_ERROR_INVALID_ARG, "No repetition");
+   config.repetitions = 3;
+   config.user_kernel = "./no_such_kernel.so";
+   FAKE_CHECK(dvfs_profile_characterize(ctx, unit, &config, profile) == DVFS_ERROR_FILE_ERROR, "Missing user kernel");
+   config.user_kernel = "./test_kernel.so";
+
+   // nothing is measured when the governor cannot be set
+   mock->error_period = 1;
+   dvfs_mock_configure(mock);
+   FAKE_CHECK(dvfs_profile_characterize(ctx, unit, &config, profile) == DVFS_ERROR_FILE_ERROR, "Governor not set");
+   mock->error_period = 0;
+   dvfs_mock_configure(mock);
+   FAKE_CHECK(dvfs_profile_get_curve(profile, 0, DVFS_KERNEL_COMPUTE, &curve) == DVFS_SUCCESS && curve->nb_points == 0, "Nothing measured");
+
+   FAKE_CHECK(dvfs_profile_characterize(ctx, unit, &config, profile) == DVFS_SUCCESS, "Characterize");
+   FAKE_CHECK(dvfs_core_get_gov(unit->cores[0], gov, sizeof(gov)) == DVFS_SUCCESS && strcmp(gov, "ondemand") == 0, "Governor restored");
+   for (k = 0; k < DVFS_KERNEL_NB; k++)
+   {
+      FAKE_CHECK(dvfs_profile_get_curve(profile, 0, k, &curve) == DVFS_SUCCESS, "Get curve");
+      if ((config.kernels & (1U << k)) == 0)
+      {
+         FAKE_CHECK(curve->nb_points == 0, "Kernel not run");
+         continue;
+      }
+
+      FAKE_CHECK(curve->nb_points == unit->cores[0]->nb_freqs, "A point per frequency");
+      for (i = 0; i < curve->nb_points; i++)
+      {
+         FAKE_CHECK(curve->points[i].freq == unit->cores[0]->freqs[i], "Frequencies");
+         FAKE_CHECK(curve->points[i].time > 0, "Time measured");
+         // the fake energy counter does not move, the MSR devices do not exist
+         FAKE_CHECK(curve->points[i].energy == 0, "Energy measured");
+         FAKE_CHECK(curve->points[i].eff_freq == 0, "No effective frequency");
+      }
+   }
+   FAKE_CHECK(dvfs_profile_get_curve(profile, 1, DVFS_KERNEL_COMPUTE, &curve) == DVFS_SUCCESS && curve->nb_points == 0, "Unit not characterized");
+   FAKE_CHECK(dvfs_profile_get_curve(profile, ctx->nb_units, DVFS_KERNEL_COMPUTE, &curve) == DVFS_ERROR_INVALID_INDEX, "Unknown unit");
+   FAKE_CHECK(dvfs_profile_get_curve(profile, 0, DVFS_KERNEL_NB, &curve) == DVFS_ERROR_INVALID_INDEX, "Unknown kernel");
+   FAKE_CHECK(strcmp(dvfs_profile_kernel_name(DVFS_KERNEL_DRAM), "dram") == 0, "Kernel name");
+
+   // the default path comes from the environment
+   setenv(DVFS_PROFILE_PATH_ENV, path, 1);
+   FAKE_CHECK(dvfs_profile_save(profile, NULL) == DVFS_SUCCESS, "Save profile");
+   FAKE_CHECK(dvfs_profile_load(&loaded, NULL) == DVFS_SUCCESS, "Load profile");
+   FAKE_CHECK(strcmp(loaded->machine, profile->machine) == 0 && loaded->nb_units == profile->nb_units, "Same machine");
+   for (k = 0; k < DVFS_KERNEL_NB; k++)
+   {
+      dvfs_profile_get_curve(profile, 0, k, &curve);
+      dvfs_profile_get_curve(loaded, 0, k, &loaded_curve);
+      FAKE_CHECK(curve->nb_points == loaded_curve->nb_points, "Same curves");
+      for (i = 0; i < curve->nb_points; i++)
+      {
+         FAKE_CHECK(curve->points[i].freq == loaded_curve->points[i].freq, "Same frequencies");
+         FAKE_CHECK(same(curve->points[i].time, loaded_curve->points[i].time), "Same times");
+         FAKE_CHECK(curve->points[i].energy == loaded_curve->points[i].energy, "Same energies");
+      }
+   }
+   FAKE_CHECK(dvfs_profile_free(loaded) == DVFS_SUCCESS, "Free profile");
+   FAKE_CHECK(dvfs_profile_free(profile) == DVFS_SUCCESS, "Free profile");
+
+   f = fopen(path, "w");
+   FAKE_CHECK(f != NULL, "Create profile file");
+   fprintf(f, "dvfs_profile 1\nmachine test\nunits 1\ncurve 0 compute 2\n1000000 0.1 -1 0\n");
+   fclose(f);
+   FAKE_CHECK(dvfs_profile_load(&loaded, path) == DVFS_ERROR_FILE_ERROR && loaded == NULL, "Truncated profile");
+   unlink(path);
+   FAKE_CHECK(dvfs_profile_load(&loaded, path) == DVFS_ERROR_FILE_ERROR, "Missing profile");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Characterization of a core controlled by its limits: the limits set before
+ * are restored.
+ */
+static int run_minmax(void)
+{
+   dvfs_profile *profile = NULL;
+   dvfs_unit *unit = NULL;
+   dvfs_profile_config config = {
+      .kernels = 1U << DVFS_KERNEL_COMPUTE,
+      .warmup = 1,
+      .repetitions = 1,
+      .duration_us = 1000,
+      .user_kernel = NULL,
+   };
+
+   // intel_pstate in active mode: no userspace governor, no frequency list
+   fake_write(CPU1 "/scaling_governor", "powersave\n");
+   fake_write(CPU1 "/scaling_available_governors", "performance powersave\n");
+   fake_write(CPU1 "/scaling_cur_freq", "1234567\n");
+   fake_write(CPU1 "/cpuinfo_min_freq", "800000\n");
+   fake_write(CPU1 "/cpuinfo_max_freq", "3000000\n");
+   fake_write(CPU1 "/scaling_min_freq", "800000\n");
+   fake_write(CPU1 "/scaling_max_freq", "3000000\n");
+
+   dvfs_core **cores = malloc(sizeof(*cores));
+   FAKE_CHECK(cores != NULL, "Allocate cores");
+   FAKE_CHECK(dvfs_core_open_step(&cores[0], 1, false, &dvfs_backend_sysfs, 1000000) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(cores[0]->ctrl == DVFS_CTRL_MINMAX, "Limits pinning selected");
+   FAKE_CHECK(dvfs_unit_open(&unit, 1, cores, 0) == DVFS_SUCCESS, "Open unit");
+   dvfs_ctx ctx = { .backend = &dvfs_backend_sysfs, .nb_units = 1, .units = &unit };
+
+   FAKE_CHECK(dvfs_core_set_limits(cores[0], 1000000, 2000000) == DVFS_SUCCESS, "Set limits");
+   FAKE_CHECK(dvfs_profile_create(&profile, 1) == DVFS_SUCCESS, "Create profile");
+   FAKE_CHECK(dvfs_profile_characterize(&ctx, unit, &config, profile) == DVFS_SUCCESS, "Characterize");
+   FAKE_CHECK(fake_read_uint(CPU1 "/scaling_min_freq") == 1000000, "Lower limit restored");
+   FAKE_CHECK(fake_read_uint(CPU1 "/scaling_max_freq") == 2000000, "Upper limit restored");
+   FAKE_CHECK(fake_gov_is(1, "powersave"), "Governor kept");
+
+   FAKE_CHECK(dvfs_profile_free(profile) == DVFS_SUCCESS, "Free profile");
+   FAKE_CHECK(dvfs_unit_close(unit) == DVFS_SUCCESS, "Close unit");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   char path[64];
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 3,
+      .min_freq = 1000000,
+      .freq_step = 500000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+   fake_write(CACHE0 "/level", "1\n");
+   fake_write(CACHE0 "/type", "Data\n");
+   fake_write(CACHE0 "/size", "16K\n");
+   fake_write("/devices/system/cpu/cpu0/topology/physical_package_id", "0\n");
+   fake_write(RAPL0 "/energy_uj", "1000\n");
+   fake_write(RAPL0 "/max_energy_range_uj", "1000000\n");
+   setenv(DVFS_MSR_PATH_ENV, "/nonexistent/cpu%u/msr", 1);
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      fake_root_remove();
+      return EXIT_FAILURE;
+   }
+
+   snprintf(path, sizeof(path), "/tmp/test_profile.%d", (int) getpid());
+   int ret = run(ctx, path, &config);
+   dvfs_stop(ctx);
+   if (ret == EXIT_SUCCESS) {
+      ret = run_minmax();
+   }
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_profile: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,92 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define CPUFREQ "/devices/system/cpu/cpu0/cpufreq"
+
+static int run(void)
+{
+   dvfs_core *core = NULL;
+
+   // intel_pstate in active mode: no userspace governor, no frequency list
+   fake_write(CPUFREQ "/scaling_governor", "powersave\n");
+   fake_write(CPUFREQ "/scaling_available_governors", "performance powersave\n");
+   fake_write(CPUFREQ "/scaling_cur_freq", "1234567\n");
+   fake_write(CPUFREQ "/cpuinfo_min_freq", "800000\n");
+   fake_write(CPUFREQ "/cpuinfo_max_freq", "3050000\n");
+   fake_write(CPUFREQ "/base_frequency", "2150000\n");
+   fake_write(CPUFREQ "/scaling_min_freq", "800000\n");
+   fake_write(CPUFREQ "/scaling_max_freq", "3050000\n");
+
+   FAKE_CHECK(dvfs_core_open_step(&core, 0, false, &dvfs_backend_sysfs, 0) == DVFS_ERROR_INVALID_ARG, "Null step");
+   FAKE_CHECK(dvfs_core_open(&core, 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(core->ctrl == DVFS_CTRL_MINMAX, "Limits pinning selected");
+
+   // 800 MHz to 3 GHz by 100 MHz, plus the base and maximal frequencies
+   FAKE_CHECK(core->nb_freqs == 25, "Synthesized table size");
+   FAKE_CHECK(core->freqs[0] == 800000, "Lowest frequency");
+   FAKE_CHECK(core->freqs[13] == 2100000 && core->freqs[14] == 2150000 && core->freqs[15] == 2200000, "Base frequency");
+   FAKE_CHECK(core->freqs[24] == 3050000, "Highest frequency");
+
+   FAKE_CHECK(dvfs_core_set_gov(core, "userspace") == DVFS_SUCCESS, "Userspace governor accepted");
+
+   FAKE_CHECK(dvfs_core_set_freq(core, 1200000) == DVFS_SUCCESS, "Set frequency down");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_min_freq") == 1200000, "Lower limit pinned");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_max_freq") == 1200000, "Upper limit pinned");
+
+   FAKE_CHECK(dvfs_core_set_freq(core, 2150000) == DVFS_SUCCESS, "Set frequency up");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_min_freq") == 2150000, "Lower limit moved");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_max_freq") == 2150000, "Upper limit moved");
+
+   FAKE_CHECK(dvfs_core_set_freq(core, 2150001) == DVFS_ERROR_INVALID_FREQ, "Unknown frequency");
+
+   // closing restores the initial limits
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_min_freq") == 800000, "Lower limit restored");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_max_freq") == 3050000, "Upper limit restored");
+
+   // 800 MHz to 3050 MHz by 250 MHz, plus the base frequency
+   FAKE_CHECK(dvfs_core_open_step(&core, 0, false, &dvfs_backend_sysfs, 250000) == DVFS_SUCCESS, "Open core with a step");
+   FAKE_CHECK(core->nb_freqs == 11, "Table size of the step");
+   FAKE_CHECK(core->freqs[5] == 2050000 && core->freqs[6] == 2150000 && core->freqs[7] == 2300000, "Base frequency with the step");
+   FAKE_CHECK(core->freqs[10] == 3050000, "Highest frequency with the step");
+   FAKE_CHECK(dvfs_core_close(core) == DVFS_SUCCESS, "Close core");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_pstate: OK\n");
+   }
+   return ret;
+}
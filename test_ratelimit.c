@@ -0,0 +1,157 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+static unsigned int unit_freq(const dvfs_unit *unit)
+{
+   unsigned int freq = 0;
+
+   dvfs_unit_get_freq(unit, &freq);
+   return freq;
+}
+
+/**
+ * Dwell window long enough for the timer thread to never expire it.
+ */
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_ratelimit *limit = NULL;
+   dvfs_ratelimit_stats stats;
+   dvfs_mock_stats mock;
+   const dvfs_unit *unit = NULL;
+   dvfs_ratelimit_config config = {
+      .min_dwell_us = 60000000,
+      .up_threshold = 150000,
+      .down_threshold = 250000,
+   };
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_ratelimit_open(&limit, unit, &config) == DVFS_SUCCESS, "Open limiter");
+   dvfs_mock_reset_stats();
+
+   // no transition yet, applied immediately
+   CHECK(dvfs_ratelimit_set_freq(limit, 1500000) == DVFS_SUCCESS, "First request");
+   CHECK(unit_freq(unit) == 1500000, "First request applied");
+
+   CHECK(dvfs_ratelimit_set_freq(limit, 1600000) == DVFS_SUCCESS, "Small increase");
+   CHECK(dvfs_ratelimit_set_freq(limit, 1050000) == DVFS_ERROR_INVALID_FREQ, "Unknown frequency");
+
+   // within the dwell window, only the last request is applied
+   CHECK(dvfs_ratelimit_set_freq(limit, 1000000) == DVFS_SUCCESS, "Deferred request");
+   CHECK(dvfs_ratelimit_set_freq(limit, 1200000) == DVFS_SUCCESS, "Replacing request");
+   CHECK(unit_freq(unit) == 1500000, "Requests deferred");
+   CHECK(dvfs_ratelimit_flush(limit) == DVFS_SUCCESS, "Flush");
+   CHECK(unit_freq(unit) == 1200000, "Last request applied by the flush");
+
+   CHECK(dvfs_ratelimit_set_freq(limit, 1000000) == DVFS_SUCCESS, "Small decrease");
+   CHECK(dvfs_ratelimit_flush(limit) == DVFS_SUCCESS, "Flush without pending request");
+   CHECK(unit_freq(unit) == 1200000, "Small decrease suppressed");
+
+   CHECK(dvfs_ratelimit_set_freq(limit, 1700000) == DVFS_SUCCESS, "Large increase");
+   CHECK(unit_freq(unit) == 1200000, "Large increase deferred");
+
+   CHECK(dvfs_ratelimit_get_stats(limit, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.nb_requests == 6 && stats.nb_writes == 2 && stats.nb_deferred == 0, "Transition counters");
+   CHECK(stats.nb_suppressed == 3 && stats.last_status == DVFS_SUCCESS, "Suppressed writes");
+
+   // the pending request is applied by the close
+   CHECK(dvfs_ratelimit_close(limit) == DVFS_SUCCESS, "Close limiter");
+   CHECK(unit_freq(unit) == 1700000, "Pending request applied at close");
+   CHECK(dvfs_mock_get_stats(&mock) == DVFS_SUCCESS && mock.nb_set_freq == 3, "Writes reaching the backend");
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Short dwell window expired by the timer thread.
+ */
+static int run_timer(dvfs_ctx *ctx)
+{
+   dvfs_ratelimit *limit = NULL;
+   dvfs_ratelimit_stats stats;
+   const dvfs_unit *unit = NULL;
+   dvfs_ratelimit_config config = {
+      .min_dwell_us = 20000,
+      .up_threshold = 0,
+      .down_threshold = 0,
+   };
+   unsigned int i;
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 1) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_ratelimit_open(&limit, unit, &config) == DVFS_SUCCESS, "Open limiter");
+
+   // the unit starts at the lowest frequency
+   CHECK(dvfs_ratelimit_set_freq(limit, 1300000) == DVFS_SUCCESS, "First request");
+   CHECK(dvfs_ratelimit_set_freq(limit, 1500000) == DVFS_SUCCESS, "Second request");
+
+   // applied at once or when the window expires, without any flush
+   for (i = 0; i < 500 && unit_freq(unit) != 1500000; i++) {
+      usleep(10000);
+   }
+   CHECK(unit_freq(unit) == 1500000, "Second request applied");
+
+   CHECK(dvfs_ratelimit_get_stats(limit, &stats) == DVFS_SUCCESS, "Get stats");
+   CHECK(stats.nb_writes == 2 && stats.last_status == DVFS_SUCCESS, "Transition counters");
+
+   CHECK(dvfs_ratelimit_close(limit) == DVFS_SUCCESS, "Close limiter");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS
+       || dvfs_set_gov(ctx, "userspace") != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+   if (ret == EXIT_SUCCESS) {
+      ret = run_timer(ctx);
+   }
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_ratelimit: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,142 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+#define CORES_PER_UNIT 2
+
+static bool pin(int cpu)
+{
+   cpu_set_t set;
+
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return sched_setaffinity(0, sizeof(set), &set) == 0 && sched_getcpu() == cpu;
+}
+
+static bool unit_has_core(const dvfs_unit *unit, int cpu)
+{
+   unsigned int i;
+
+   for (i = 0; i < unit->nb_cores; i++) {
+      if (unit->cores[i]->id == (unsigned int) cpu) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * First core the thread may run on, from the given one.
+ */
+static int next_allowed(const cpu_set_t *allowed, int from)
+{
+   int cpu = from;
+
+   while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, allowed)) {
+      cpu++;
+   }
+   return cpu;
+}
+
+static int run(const cpu_set_t *allowed)
+{
+   dvfs_ctx *a = NULL, *b = NULL;
+   const dvfs_unit *unit = NULL, *cached = NULL;
+   dvfs_mock_stats stats;
+   unsigned int freq = 0;
+   int cpu, other;
+
+   cpu = next_allowed(allowed, 0);
+   CHECK(cpu < CPU_SETSIZE && pin(cpu), "Pin the thread");
+
+   CHECK(dvfs_start_backend(&a, false, &dvfs_backend_mock) == DVFS_SUCCESS, "Start first context");
+   CHECK(dvfs_start_backend(&b, false, &dvfs_backend_mock) == DVFS_SUCCESS, "Start second context");
+   CHECK(a->generation != b->generation, "Distinct generations");
+
+   CHECK(dvfs_self_get_unit(a, &unit) == DVFS_SUCCESS, "Get own unit");
+   CHECK(unit == a->units[unit->id] && unit_has_core(unit, cpu), "Unit of the core");
+   CHECK(dvfs_self_get_unit(a, &cached) == DVFS_SUCCESS && cached == unit, "Cached unit");
+
+   CHECK(dvfs_set_gov(a, "userspace") == DVFS_SUCCESS, "Set governor");
+   dvfs_mock_reset_stats();
+   CHECK(dvfs_self_set_freq(a, 1200000) == DVFS_SUCCESS, "Set own frequency");
+   CHECK(dvfs_unit_get_freq(unit, &freq) == DVFS_SUCCESS && freq == 1200000, "Own unit changed");
+   CHECK(dvfs_mock_get_stats(&stats) == DVFS_SUCCESS && stats.nb_set_freq == unit->nb_cores, "Only the own unit changed");
+
+   // the cache of the first context is not served to the second one
+   CHECK(dvfs_self_get_unit(b, &cached) == DVFS_SUCCESS, "Get own unit in the second context");
+   CHECK(cached == b->units[unit->id] && cached != unit, "Unit of the second context");
+   CHECK(dvfs_self_get_unit(a, &cached) == DVFS_SUCCESS && cached == unit, "Back to the first context");
+
+   // a migration to another unit is noticed
+   other = next_allowed(allowed, cpu + CORES_PER_UNIT - cpu % CORES_PER_UNIT);
+   if (other < CPU_SETSIZE && pin(other)) {
+      CHECK(dvfs_self_get_unit(a, &cached) == DVFS_SUCCESS && cached != unit && unit_has_core(cached, other), "Unit after migration");
+   }
+
+   CHECK(dvfs_stop(b) == DVFS_SUCCESS, "Stop second context");
+   CHECK(dvfs_stop(a) == DVFS_SUCCESS, "Stop first context");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   cpu_set_t allowed;
+   long nb_cpus = sysconf(_SC_NPROCESSORS_CONF);
+   dvfs_mock_config config = {
+      .nb_cores = 0,
+      .cores_per_unit = CORES_PER_UNIT,
+      .nb_freqs = 4,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   // every core the thread may run on must exist in the mock
+   if (nb_cpus <= 0 || sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return EXIT_FAILURE;
+   }
+   config.nb_cores = (nb_cpus + CORES_PER_UNIT - 1) / CORES_PER_UNIT * CORES_PER_UNIT;
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(&allowed);
+   sched_setaffinity(0, sizeof(allowed), &allowed);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_self: OK\n");
+   }
+   return ret;
+}
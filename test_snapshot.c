@@ -0,0 +1,257 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include <pthread.h>
+
+#include "libdvfs.h"
+#include "dvfs_parallel.h"
+
+#define CPUFREQ "/devices/system/cpu/cpu0/cpufreq"
+
+/**
+ * Snapshots of simulated cores: governors and frequencies.
+ */
+static int run_mock(void)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_snapshot *snap = NULL;
+   dvfs_snapshot *copy = NULL;
+   const dvfs_unit *unit = NULL;
+   unsigned int i, nb_changed = 0, freq = 0;
+   size_t len = 0;
+   char gov[128];
+   dvfs_mock_config config = {
+      .nb_cores = 8,
+      .cores_per_unit = 2,
+      .nb_freqs = 4,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   FAKE_CHECK(dvfs_mock_configure(&config) == DVFS_SUCCESS, "Configure mock");
+   FAKE_CHECK(dvfs_start_backend(&ctx, false, &dvfs_backend_mock) == DVFS_SUCCESS, "Start");
+
+   FAKE_CHECK(dvfs_set_gov(ctx, "userspace") == DVFS_SUCCESS, "Set governor");
+   FAKE_CHECK(dvfs_set_freq(ctx, 1200000) == DVFS_SUCCESS, "Set frequency");
+   FAKE_CHECK(dvfs_snapshot_take(ctx, &snap) == DVFS_SUCCESS, "Take snapshot");
+   FAKE_CHECK(snap->nb_cores == 8, "All the cores");
+   for (i = 0; i < snap->nb_cores; i++) {
+      FAKE_CHECK(strcmp(snap->states[i].gov, "userspace") == 0, "Governor captured");
+      FAKE_CHECK(snap->states[i].freq == 1200000, "Frequency captured");
+      FAKE_CHECK(snap->states[i].epp[0] == '\0', "No preference on simulated cores");
+   }
+
+   // nothing to do when the state already matches
+   FAKE_CHECK(dvfs_snapshot_restore(ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 0, "Matching state");
+
+   // change two units out of four
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit, 1) == DVFS_SUCCESS, "Get unit");
+   FAKE_CHECK(dvfs_unit_set_freq(unit, 1300000) == DVFS_SUCCESS, "Change frequency");
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit, 3) == DVFS_SUCCESS, "Get unit");
+   FAKE_CHECK(dvfs_unit_set_gov(unit, "ondemand") == DVFS_SUCCESS, "Change governor");
+
+   FAKE_CHECK(dvfs_snapshot_restore(ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 4, "Changed cores only");
+   for (i = 0; i < ctx->nb_units; i++) {
+      FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit, i) == DVFS_SUCCESS, "Get unit");
+      FAKE_CHECK(dvfs_core_get_gov(unit->cores[1], gov, sizeof(gov)) == DVFS_SUCCESS && strcmp(gov, "userspace") == 0, "Governor restored");
+      FAKE_CHECK(dvfs_core_get_current_freq(unit->cores[1], &freq) == DVFS_SUCCESS && freq == 1200000, "Frequency restored");
+   }
+
+   // round trip through a blob
+   FAKE_CHECK(dvfs_snapshot_serialize(snap, NULL, 0, &len) == DVFS_ERROR_BUFFER_TOO_SHORT, "Size of the blob");
+   FAKE_CHECK(len == 16 + 8 * 64, "Compact blob");
+   char *blob = malloc(len);
+   FAKE_CHECK(blob != NULL, "Allocate blob");
+   FAKE_CHECK(dvfs_snapshot_serialize(snap, blob, len, &len) == DVFS_SUCCESS, "Serialize");
+   FAKE_CHECK(dvfs_snapshot_deserialize(&copy, blob, len - 1) == DVFS_ERROR_INVALID_ARG, "Truncated blob");
+   FAKE_CHECK(dvfs_snapshot_deserialize(&copy, blob, len) == DVFS_SUCCESS, "Deserialize");
+   FAKE_CHECK(copy->nb_cores == 8 && memcmp(copy->states, snap->states, 8 * sizeof(*copy->states)) == 0, "Same states");
+   blob[0] = 'X';
+   FAKE_CHECK(dvfs_snapshot_deserialize(&snap, blob, len) == DVFS_ERROR_INVALID_ARG, "Bad magic");
+   free(blob);
+
+   FAKE_CHECK(dvfs_set_freq(ctx, 1300000) == DVFS_SUCCESS, "Change all frequencies");
+   FAKE_CHECK(dvfs_snapshot_restore(ctx, copy, &nb_changed) == DVFS_SUCCESS && nb_changed == 8, "Restore the copy");
+
+   FAKE_CHECK(dvfs_snapshot_free(snap) == DVFS_SUCCESS, "Free snapshot");
+   FAKE_CHECK(dvfs_snapshot_free(copy) == DVFS_SUCCESS, "Free copy");
+   FAKE_CHECK(dvfs_stop(ctx) == DVFS_SUCCESS, "Stop");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Snapshots of a core controlled by its limits: limits and preference.
+ */
+static int run_pstate(void)
+{
+   dvfs_unit *unit = NULL;
+   dvfs_snapshot *snap = NULL;
+   unsigned int nb_changed = 0;
+   char epp[64];
+
+   fake_write(CPUFREQ "/scaling_governor", "powersave\n");
+   fake_write(CPUFREQ "/scaling_available_governors", "performance powersave\n");
+   fake_write(CPUFREQ "/scaling_cur_freq", "1200000\n");
+   fake_write(CPUFREQ "/cpuinfo_min_freq", "800000\n");
+   fake_write(CPUFREQ "/cpuinfo_max_freq", "3000000\n");
+   fake_write(CPUFREQ "/scaling_min_freq", "800000\n");
+   fake_write(CPUFREQ "/scaling_max_freq", "3000000\n");
+   fake_write(CPUFREQ "/energy_performance_preference", "balance_power\n");
+
+   dvfs_core **cores = malloc(sizeof(*cores));
+   FAKE_CHECK(cores != NULL, "Allocate cores");
+   FAKE_CHECK(dvfs_core_open(&cores[0], 0, false) == DVFS_SUCCESS, "Open core");
+   FAKE_CHECK(dvfs_unit_open(&unit, 1, cores, 0) == DVFS_SUCCESS, "Open unit");
+
+   // only the units are used by the snapshots
+   dvfs_ctx ctx = { .backend = &dvfs_backend_sysfs, .nb_units = 1, .units = &unit };
+
+   FAKE_CHECK(dvfs_core_set_limits(cores[0], 1000000, 2000000) == DVFS_SUCCESS, "Set limits");
+   FAKE_CHECK(dvfs_core_set_limits(cores[0], 2000000, 1000000) == DVFS_ERROR_INVALID_ARG, "Inverted limits");
+   FAKE_CHECK(dvfs_snapshot_take(&ctx, &snap) == DVFS_SUCCESS, "Take snapshot");
+   FAKE_CHECK(snap->states[0].min_freq == 1000000 && snap->states[0].max_freq == 2000000, "Limits captured");
+   FAKE_CHECK(strcmp(snap->states[0].epp, "balance_power") == 0, "Preference captured");
+   FAKE_CHECK(strcmp(snap->states[0].gov, "powersave") == 0, "Governor captured");
+
+   FAKE_CHECK(dvfs_core_set_freq(cores[0], 2500000) == DVFS_SUCCESS, "Pin frequency");
+   FAKE_CHECK(dvfs_core_set_epp(cores[0], "performance") == DVFS_SUCCESS, "Set preference");
+
+   FAKE_CHECK(dvfs_snapshot_restore(&ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 1, "Restore");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_min_freq") == 1000000, "Lower limit restored");
+   FAKE_CHECK(fake_read_uint(CPUFREQ "/scaling_max_freq") == 2000000, "Upper limit restored");
+   FAKE_CHECK(dvfs_core_get_epp(cores[0], epp, sizeof(epp)) == DVFS_SUCCESS && strcmp(epp, "balance_power") == 0, "Preference restored");
+
+   FAKE_CHECK(dvfs_snapshot_restore(&ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 0, "Nothing left to restore");
+
+   FAKE_CHECK(dvfs_snapshot_free(snap) == DVFS_SUCCESS, "Free snapshot");
+   FAKE_CHECK(dvfs_unit_close(unit) == DVFS_SUCCESS, "Close unit");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Snapshots of a core controlled through scaling_setspeed, running at a
+ * measured frequency that is not in its table.
+ */
+static int run_setspeed(void)
+{
+   dvfs_unit *unit = NULL;
+   dvfs_snapshot *snap = NULL;
+   unsigned int nb_changed = 0;
+
+   fake_core(1, "userspace", "ondemand userspace", "1200000 2000000", 1234567);
+
+   dvfs_core **cores = malloc(sizeof(*cores));
+   FAKE_CHECK(cores != NULL, "Allocate cores");
+   FAKE_CHECK(dvfs_core_open(&cores[0], 1, false) == DVFS_SUCCESS, "Open core");
+   // opening the regular file for writing emptied it, unlike sysfs
+   fake_write("/devices/system/cpu/cpu1/cpufreq/scaling_setspeed", "1200000\n");
+   FAKE_CHECK(dvfs_unit_open(&unit, 1, cores, 0) == DVFS_SUCCESS, "Open unit");
+   dvfs_ctx ctx = { .backend = &dvfs_backend_sysfs, .nb_units = 1, .units = &unit };
+
+   FAKE_CHECK(dvfs_snapshot_take(&ctx, &snap) == DVFS_SUCCESS, "Take snapshot");
+   FAKE_CHECK(snap->states[0].freq == 1200000, "Requested frequency captured");
+   FAKE_CHECK(dvfs_snapshot_restore(&ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 0, "Matching state");
+
+   FAKE_CHECK(dvfs_core_set_freq(cores[0], 2000000) == DVFS_SUCCESS, "Change frequency");
+   FAKE_CHECK(dvfs_snapshot_restore(&ctx, snap, &nb_changed) == DVFS_SUCCESS && nb_changed == 1, "Restore");
+   FAKE_CHECK(fake_setspeed(1) == 1200000, "Frequency restored");
+
+   FAKE_CHECK(dvfs_snapshot_free(snap) == DVFS_SUCCESS, "Free snapshot");
+   FAKE_CHECK(dvfs_unit_close(unit) == DVFS_SUCCESS, "Close unit");
+
+   return EXIT_SUCCESS;
+}
+
+#define NB_JOBS 8
+
+struct jobs
+{
+   pthread_t threads[NB_JOBS];
+   unsigned int runs[NB_JOBS];
+};
+
+/**
+ * Records the thread running each index.
+ */
+static int record_thread(unsigned int idx, void *arg)
+{
+   struct jobs *jobs = arg;
+   jobs->threads[idx] = pthread_self();
+   jobs->runs[idx]++;
+   return DVFS_SUCCESS;
+}
+
+/**
+ * Parallel runs, with and without helper threads.
+ */
+static int run_parallel(void)
+{
+   struct jobs jobs;
+   unsigned int i;
+
+   memset(&jobs, 0, sizeof(jobs));
+   FAKE_CHECK(dvfs_parallel_run(NB_JOBS, record_thread, &jobs) == DVFS_SUCCESS, "Parallel run");
+   for (i = 0; i < NB_JOBS; i++) {
+      FAKE_CHECK(jobs.runs[i] == 1, "Index run once");
+   }
+
+   memset(&jobs, 0, sizeof(jobs));
+   setenv(DVFS_THREADS_ENV, "1", 1);
+   int ret = dvfs_parallel_run(NB_JOBS, record_thread, &jobs);
+   unsetenv(DVFS_THREADS_ENV);
+   FAKE_CHECK(ret == DVFS_SUCCESS, "Sequential run");
+   for (i = 0; i < NB_JOBS; i++) {
+      FAKE_CHECK(jobs.runs[i] == 1 && pthread_equal(jobs.threads[i], pthread_self()), "Index run by the caller");
+   }
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run_parallel();
+   if (ret == EXIT_SUCCESS) {
+      ret = run_mock();
+   }
+   if (ret == EXIT_SUCCESS) {
+      ret = run_pstate();
+   }
+   if (ret == EXIT_SUCCESS) {
+      ret = run_setspeed();
+   }
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_snapshot: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,157 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+#define NB_READERS 2
+#define NB_WRITES 100000
+
+typedef struct {
+   const dvfs_unit *unit;
+   unsigned int lo, hi;
+   volatile bool done;
+   unsigned long long nb_reads;
+   bool failed;
+} race;
+
+static void *reader_main(void *arg)
+{
+   race *r = arg;
+   uint64_t last = 0;
+   unsigned long long nb = 0;
+   dvfs_unit_state state;
+
+   while (!r->done) {
+      if (dvfs_unit_read_state(r->unit, &state) != DVFS_SUCCESS
+          || (state.target != r->lo && state.target != r->hi) || state.timestamp_ns < last) {
+         r->failed = true;
+         break;
+      }
+      last = state.timestamp_ns;
+      nb++;
+   }
+   __atomic_fetch_add(&r->nb_reads, nb, __ATOMIC_RELAXED);
+   return NULL;
+}
+
+static int run(dvfs_ctx *ctx)
+{
+   dvfs_state *state = NULL, *other = NULL;
+   dvfs_state_config config = {
+      .period_us = 1000,
+   };
+   dvfs_unit_state ustate;
+   const dvfs_unit *unit = NULL;
+   const char *name = NULL;
+   unsigned int i;
+
+   CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_ERROR_INVALID_ARG, "Not published");
+   CHECK(dvfs_state_open(&state, ctx, &config) == DVFS_SUCCESS, "Open state");
+   CHECK(dvfs_state_open(&other, ctx, &config) == DVFS_ERROR_INVALID_ARG, "Already published");
+
+   // sampled when opening
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_SUCCESS, "Read state");
+   CHECK(ustate.target == 0 && ustate.freq == 1000000 && ustate.timestamp_ns != 0, "Initial state");
+   CHECK(dvfs_gov_get_name(ustate.gov_id, &name) == DVFS_SUCCESS && strcmp(name, "ondemand") == 0, "Initial governor");
+
+   // published by the writers
+   CHECK(dvfs_set_gov(ctx, "userspace") == DVFS_SUCCESS, "Set governor");
+   CHECK(dvfs_state_sample(state) == DVFS_SUCCESS, "Sample");
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_SUCCESS, "Read state");
+   CHECK(dvfs_gov_get_name(ustate.gov_id, &name) == DVFS_SUCCESS && strcmp(name, "userspace") == 0, "Governor sampled");
+   uint64_t sampled_ns = ustate.timestamp_ns;
+   CHECK(dvfs_unit_set_freq(unit, 1300000) == DVFS_SUCCESS, "Set frequency");
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_SUCCESS, "Read state");
+   CHECK(ustate.target == 1300000 && ustate.freq == 1000000, "Target published");
+   CHECK(ustate.timestamp_ns > sampled_ns, "Timestamp updated");
+
+   // changes on the cores are published as well, the frequency with the samples
+   CHECK(dvfs_core_set_freq(unit->cores[0], 1500000) == DVFS_SUCCESS, "Set core frequency");
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_SUCCESS, "Read state");
+   CHECK(ustate.target == 1500000 && ustate.freq == 1000000, "Core target published");
+   CHECK(dvfs_state_start(state) == DVFS_SUCCESS, "Start sampling");
+   CHECK(dvfs_state_start(state) == DVFS_ERROR_INVALID_ARG, "Already started");
+   usleep(50000);
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_SUCCESS, "Read state");
+   CHECK(ustate.target == 1500000 && ustate.freq == 1500000, "Frequency sampled");
+   CHECK(state->nb_samples >= 10 && state->last_status == DVFS_SUCCESS, "Samples");
+
+   // readers always see a complete record
+   race r = { .unit = unit, .lo = 1100000, .hi = 1300000 };
+   pthread_t readers[NB_READERS];
+   for (i = 0; i < NB_READERS; i++) {
+      CHECK(pthread_create(&readers[i], NULL, reader_main, &r) == 0, "Start reader");
+   }
+   for (i = 0; i < NB_WRITES; i++) {
+      CHECK(dvfs_unit_set_freq(unit, (i & 1) ? r.hi : r.lo) == DVFS_SUCCESS, "Set frequency");
+   }
+   r.done = true;
+   for (i = 0; i < NB_READERS; i++) {
+      pthread_join(readers[i], NULL);
+   }
+   CHECK(!r.failed && r.nb_reads > 0, "Consistent reads");
+
+   CHECK(dvfs_state_stop(state) == DVFS_SUCCESS, "Stop sampling");
+   CHECK(dvfs_state_close(state) == DVFS_SUCCESS, "Close state");
+   CHECK(dvfs_unit_read_state(unit, &ustate) == DVFS_ERROR_INVALID_ARG, "No more published");
+   CHECK(dvfs_unit_set_freq(unit, 1000000) == DVFS_SUCCESS, "Set frequency once closed");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_ctx *ctx = NULL;
+   dvfs_mock_config config = {
+      .nb_cores = 2,
+      .cores_per_unit = 1,
+      .nb_freqs = 8,
+      .min_freq = 1000000,
+      .freq_step = 100000,
+      .latency_ns = 0,
+      .error_period = 0,
+      .error_code = DVFS_ERROR_FILE_ERROR,
+   };
+
+   (void) argc;
+   (void) argv;
+
+   if (dvfs_mock_configure(&config) != DVFS_SUCCESS
+       || dvfs_start_backend(&ctx, false, &dvfs_backend_mock) != DVFS_SUCCESS) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run(ctx);
+   dvfs_stop(ctx);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_state: OK\n");
+   }
+   return ret;
+}
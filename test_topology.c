@@ -0,0 +1,156 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define CPU "/devices/system/cpu/cpu%u"
+
+/**
+ * Fakes a core. The topology files are only written when the id is not
+ * DVFS_TOPO_UNKNOWN_ID, as when the kernel does not provide them.
+ */
+static void fake_topo_core(unsigned int id, unsigned int package, unsigned int die, unsigned int node, unsigned int l3)
+{
+   char rel[256];
+
+   fake_core(id, "ondemand", "ondemand userspace", "1200000 2000000", 1200000);
+
+   if (package != DVFS_TOPO_UNKNOWN_ID) {
+      snprintf(rel, sizeof(rel), CPU "/topology/physical_package_id", id);
+      fake_write(rel, "%u\n", package);
+   }
+   if (die != DVFS_TOPO_UNKNOWN_ID) {
+      snprintf(rel, sizeof(rel), CPU "/topology/die_id", id);
+      fake_write(rel, "%u\n", die);
+   }
+   if (node != DVFS_TOPO_UNKNOWN_ID) {
+      // the link toward the node only matters by its name
+      snprintf(rel, sizeof(rel), CPU "/node%u", id, node);
+      fake_write(rel, "");
+   }
+   if (l3 != DVFS_TOPO_UNKNOWN_ID) {
+      snprintf(rel, sizeof(rel), CPU "/cache/index0/level", id);
+      fake_write(rel, "1\n");
+      snprintf(rel, sizeof(rel), CPU "/cache/index1/level", id);
+      fake_write(rel, "2\n");
+      snprintf(rel, sizeof(rel), CPU "/cache/index2/level", id);
+      fake_write(rel, "3\n");
+      snprintf(rel, sizeof(rel), CPU "/cache/index2/id", id);
+      fake_write(rel, "%u\n", l3);
+   }
+}
+
+static int run(dvfs_unit **units, dvfs_topology *topo)
+{
+   const dvfs_topo_node *root, *package, *node, *ancestor;
+   unsigned int nb = 0;
+
+   FAKE_CHECK(dvfs_topo_get_root(topo, &root) == DVFS_SUCCESS, "Root");
+   FAKE_CHECK(dvfs_topo_get_nb_children(root, &nb) == DVFS_SUCCESS && nb == 2, "Two packages");
+   FAKE_CHECK(root->nb_units == 3, "All the units below the root");
+
+   // the cores of the first unit share every level
+   FAKE_CHECK(dvfs_topo_get_core_node(topo, &node, 1) == DVFS_SUCCESS, "Core node");
+   FAKE_CHECK(node->unit == units[0] && node->parent->level == DVFS_TOPO_UNIT, "Core below its unit");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_L3, &ancestor) == DVFS_SUCCESS && ancestor->id == 4, "L3 group");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_NUMA_NODE, &ancestor) == DVFS_SUCCESS && ancestor->id == 0, "NUMA node");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_PACKAGE, &package) == DVFS_SUCCESS && package->id == 0, "Package");
+   FAKE_CHECK(package->nb_units == 1, "One unit in the first package");
+
+   // the second package holds a known die and the die of a core without the
+   // topology files, which is not mistaken for the die 0
+   FAKE_CHECK(dvfs_topo_get_core_node(topo, &node, 3) == DVFS_SUCCESS, "Core node");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_PACKAGE, &package) == DVFS_SUCCESS && package->id == 1, "Package");
+   FAKE_CHECK(package->nb_units == 2, "Two units in the second package");
+   FAKE_CHECK(dvfs_topo_get_nb_children(package, &nb) == DVFS_SUCCESS && nb == 2, "Two dies");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_DIE, &ancestor) == DVFS_SUCCESS && ancestor->id == DVFS_TOPO_UNKNOWN_ID, "Unknown die");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_NUMA_NODE, &ancestor) == DVFS_SUCCESS && ancestor->id == DVFS_TOPO_UNKNOWN_ID, "Unknown NUMA node");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_L3, &ancestor) == DVFS_SUCCESS && ancestor->id == DVFS_TOPO_UNKNOWN_ID, "Unknown L3 group");
+   FAKE_CHECK(dvfs_topo_get_core_node(topo, &node, 2) == DVFS_SUCCESS, "Core node");
+   FAKE_CHECK(dvfs_topo_get_ancestor(node, DVFS_TOPO_NUMA_NODE, &ancestor) == DVFS_SUCCESS && ancestor->id == 1, "Known NUMA node");
+   FAKE_CHECK(dvfs_topo_get_core_node(topo, &node, 4) == DVFS_ERROR_INVALID_CORE_ID, "Core outside the topology");
+
+   // a node applies the changes to all its units, and only to them
+   FAKE_CHECK(dvfs_topo_set_gov(package, "userspace") == DVFS_SUCCESS, "Set governor on a package");
+   FAKE_CHECK(fake_gov_is(2, "userspace") && fake_gov_is(3, "userspace"), "Governor set below the package");
+   FAKE_CHECK(fake_gov_is(0, "ondemand") && fake_gov_is(1, "ondemand"), "Other package untouched");
+   FAKE_CHECK(dvfs_topo_set_freq(package, 2000000) == DVFS_SUCCESS, "Set frequency on a package");
+   FAKE_CHECK(fake_setspeed(2) == 2000000 && fake_setspeed(3) == 2000000, "Frequency set below the package");
+   FAKE_CHECK(fake_setspeed(0) == 0 && fake_setspeed(1) == 0, "Other package untouched");
+
+   // a core node only changes its core
+   FAKE_CHECK(dvfs_topo_get_core_node(topo, &node, 0) == DVFS_SUCCESS, "Core node");
+   FAKE_CHECK(dvfs_topo_set_gov(node, "userspace") == DVFS_SUCCESS, "Set governor on a core");
+   FAKE_CHECK(fake_gov_is(0, "userspace") && fake_gov_is(1, "ondemand"), "Only the core changed");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_topology *topo = NULL;
+   dvfs_unit *units[3];
+   dvfs_core **cores[3];
+   unsigned int i;
+
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   fake_topo_core(0, 0, 0, 0, 4);
+   fake_topo_core(1, 0, 0, 0, 4);
+   fake_topo_core(2, 1, 0, 1, 5);
+   fake_topo_core(3, 1, DVFS_TOPO_UNKNOWN_ID, DVFS_TOPO_UNKNOWN_ID, DVFS_TOPO_UNKNOWN_ID);
+
+   // the cores 0 and 1 share a unit, the others have their own
+   for (i = 0; i < 3; i++) {
+      unsigned int nb = i == 0 ? 2 : 1;
+      unsigned int j;
+
+      cores[i] = malloc(nb * sizeof(*cores[i]));
+      for (j = 0; j < nb; j++) {
+         if (cores[i] == NULL || dvfs_core_open(&cores[i][j], i == 0 ? j : i + 1, false) != DVFS_SUCCESS) {
+            fake_root_remove();
+            return EXIT_FAILURE;
+         }
+      }
+      if (dvfs_unit_open(&units[i], nb, cores[i], i) != DVFS_SUCCESS) {
+         fake_root_remove();
+         return EXIT_FAILURE;
+      }
+   }
+
+   int ret = dvfs_topology_open(&topo, 3, units) == DVFS_SUCCESS ? run(units, topo) : EXIT_FAILURE;
+
+   if (topo != NULL) {
+      dvfs_topology_close(topo);
+   }
+   for (i = 0; i < 3; i++) {
+      dvfs_unit_close(units[i]);
+   }
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_topology: OK\n");
+   }
+   return ret;
+}
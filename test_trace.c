@@ -0,0 +1,152 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libdvfs.h"
+
+#define CHECK(cond,message) { if (!(cond)) { \
+        printf("%s:%d: %s\n", __FILE__, __LINE__, message); \
+        return EXIT_FAILURE; \
+    }}
+
+#define NB_CORES 3
+#define NB_SAMPLES 100
+#define INTERVAL_NS 1000000ULL
+
+static long file_size(const char *path)
+{
+   struct stat st;
+   return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+static unsigned int expected_freq(unsigned int s, unsigned int c)
+{
+   // a change every 10 samples, a core going down
+   return c == 2 ? 3000000 - (s / 10) * 100000 : 1200000 + (s / 10) * 100000 * c;
+}
+
+static int run(const char *path)
+{
+   unsigned int core_ids[NB_CORES] = { 0, 2, 5 };
+   unsigned int freqs[NB_CORES], gov_ids[NB_CORES], eff_freqs[NB_CORES];
+   uint64_t energies[1];
+   dvfs_trace_header header = {
+      .flags = DVFS_TRACE_EFF_FREQ | DVFS_TRACE_ENERGY,
+      .interval_ns = INTERVAL_NS,
+      .start_ns = 1234567890123456789ULL,
+      .nb_cores = NB_CORES,
+      .core_ids = core_ids,
+      .nb_packages = 1,
+   };
+   dvfs_trace_sample sample = {
+      .freqs = freqs,
+      .gov_ids = gov_ids,
+      .eff_freqs = eff_freqs,
+      .energies = energies,
+   };
+   const dvfs_trace_sample *read;
+   dvfs_trace *trace = NULL;
+   unsigned int userspace, powersave, s, c;
+   long size;
+
+   CHECK(dvfs_gov_intern("userspace", &userspace) == DVFS_SUCCESS, "Intern governor");
+   CHECK(dvfs_gov_intern("powersave", &powersave) == DVFS_SUCCESS, "Intern governor");
+
+   CHECK(dvfs_trace_create(&trace, path, &header) == DVFS_SUCCESS, "Create trace");
+   CHECK(dvfs_trace_read(trace, &read) == DVFS_ERROR_INVALID_ARG, "Read while writing");
+   for (s = 0; s < NB_SAMPLES; s++) {
+      // jitter around the interval
+      sample.time_ns = (s + 1) * INTERVAL_NS + (s % 3) * 1000;
+      for (c = 0; c < NB_CORES; c++) {
+         freqs[c] = expected_freq(s, c);
+         gov_ids[c] = c == 1 && s >= 50 ? powersave : c == 0 && s < 5 ? DVFS_TRACE_NO_GOV : userspace;
+         eff_freqs[c] = freqs[c] - c * 1000;
+      }
+      energies[0] = 20000 + s;
+      CHECK(dvfs_trace_write(trace, &sample) == DVFS_SUCCESS, "Write sample");
+   }
+   CHECK(dvfs_trace_close(trace) == DVFS_SUCCESS, "Close trace");
+
+   // a third of the size of fixed-size samples (time, 3 values per core, energy)
+   size = file_size(path);
+   CHECK(size > 0 && size * 3 < NB_SAMPLES * (8 + 12 * NB_CORES + 8), "Compact trace");
+
+   CHECK(dvfs_trace_open(&trace, path) == DVFS_SUCCESS, "Open trace");
+   CHECK(trace->header.flags == header.flags && trace->header.interval_ns == INTERVAL_NS, "Header");
+   CHECK(trace->header.start_ns == header.start_ns && trace->header.nb_packages == 1, "Header");
+   CHECK(trace->header.nb_cores == NB_CORES && trace->header.core_ids[2] == 5, "Cores");
+   for (s = 0; s < NB_SAMPLES; s++) {
+      CHECK(dvfs_trace_read(trace, &read) == DVFS_SUCCESS && read != NULL, "Read sample");
+      CHECK(read->time_ns == (s + 1) * INTERVAL_NS + (s % 3) * 1000, "Time");
+      for (c = 0; c < NB_CORES; c++) {
+         CHECK(read->freqs[c] == expected_freq(s, c), "Frequency");
+         CHECK(read->eff_freqs[c] == expected_freq(s, c) - c * 1000, "Effective frequency");
+      }
+      CHECK(read->energies[0] == 20000 + s, "Energy");
+      CHECK(strcmp(dvfs_trace_gov_name(trace, read->gov_ids[1]), s >= 50 ? "powersave" : "userspace") == 0, "Governor");
+      CHECK((s < 5) == (read->gov_ids[0] == DVFS_TRACE_NO_GOV), "Unknown governor");
+   }
+   CHECK(dvfs_trace_read(trace, &read) == DVFS_SUCCESS && read == NULL, "End of the trace");
+   CHECK(dvfs_trace_gov_name(trace, DVFS_TRACE_NO_GOV) == NULL, "No name");
+   CHECK(dvfs_trace_close(trace) == DVFS_SUCCESS, "Close trace");
+
+   // a monitor killed while writing leaves a cut record
+   CHECK(truncate(path, size - 2) == 0, "Cut the trace");
+   CHECK(dvfs_trace_open(&trace, path) == DVFS_SUCCESS, "Open cut trace");
+   s = 0;
+   while (dvfs_trace_read(trace, &read) == DVFS_SUCCESS && read != NULL) {
+      s++;
+   }
+   CHECK(s == NB_SAMPLES - 1, "Samples before the cut");
+   CHECK(dvfs_trace_close(trace) == DVFS_SUCCESS, "Close trace");
+
+   // not a trace
+   CHECK(truncate(path, 4) == 0, "Cut the header");
+   CHECK(dvfs_trace_open(&trace, path) == DVFS_ERROR_FILE_ERROR, "Not a trace");
+
+   header.nb_cores = 0;
+   CHECK(dvfs_trace_create(&trace, path, &header) == DVFS_ERROR_INVALID_ARG, "No core");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   char path[] = "/tmp/test_trace.XXXXXX";
+   int fd;
+
+   (void) argc;
+   (void) argv;
+
+   fd = mkstemp(path);
+   if (fd == -1) {
+      return EXIT_FAILURE;
+   }
+   close(fd);
+
+   int ret = run(path);
+   unlink(path);
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_trace: OK\n");
+   }
+   return ret;
+}
@@ -0,0 +1,110 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define NO_TURBO "/devices/system/cpu/intel_pstate/no_turbo"
+#define BOOST0 "/devices/system/cpu/cpu0/cpufreq/boost"
+#define BOOST1 "/devices/system/cpu/cpu1/cpufreq/boost"
+
+static int run(dvfs_unit **units)
+{
+   dvfs_turbo *turbo = NULL;
+   bool enabled = false;
+   char path[512];
+
+   // intel_pstate: system wide, inverted setting
+   fake_write(NO_TURBO, "0\n");
+   fake_write(BOOST0, "1\n");
+   fake_write(BOOST1, "1\n");
+
+   FAKE_CHECK(dvfs_turbo_open(&turbo, 2, units) == DVFS_SUCCESS, "Open intel_pstate control");
+   FAKE_CHECK(turbo->ctrl == DVFS_TURBO_CTRL_INTEL_PSTATE, "intel_pstate selected");
+   FAKE_CHECK(dvfs_turbo_get(turbo, &enabled) == DVFS_SUCCESS && enabled, "Turbo enabled");
+   FAKE_CHECK(dvfs_turbo_set(turbo, false) == DVFS_SUCCESS, "Disable turbo");
+   FAKE_CHECK(fake_read_uint(NO_TURBO) == 1, "no_turbo written");
+   FAKE_CHECK(dvfs_turbo_set_unit(turbo, units[0], true) == DVFS_ERROR_TURBO_UNAVAILABLE, "No per unit control");
+   FAKE_CHECK(dvfs_turbo_close(turbo) == DVFS_SUCCESS, "Close control");
+   FAKE_CHECK(fake_read_uint(NO_TURBO) == 0, "no_turbo restored");
+
+   // per policy boost files
+   snprintf(path, sizeof(path), "%s" NO_TURBO, fake_root);
+   remove(path);
+
+   FAKE_CHECK(dvfs_turbo_open(&turbo, 2, units) == DVFS_SUCCESS, "Open policy control");
+   FAKE_CHECK(turbo->ctrl == DVFS_TURBO_CTRL_POLICY_BOOST, "Per policy boost selected");
+   FAKE_CHECK(dvfs_turbo_set_unit(turbo, units[1], false) == DVFS_SUCCESS, "Disable turbo on a unit");
+   FAKE_CHECK(fake_read_uint(BOOST0) == 1 && fake_read_uint(BOOST1) == 0, "Only one policy changed");
+   FAKE_CHECK(dvfs_turbo_get_unit(turbo, units[1], &enabled) == DVFS_SUCCESS && !enabled, "Unit setting");
+   FAKE_CHECK(dvfs_turbo_get(turbo, &enabled) == DVFS_SUCCESS && enabled, "Enabled on one unit");
+   units[0]->cores[0]->fenced = true;
+   FAKE_CHECK(dvfs_turbo_set_unit(turbo, units[0], false) == DVFS_ERROR_NOT_LEASED, "Fenced unit");
+   FAKE_CHECK(fake_read_uint(BOOST0) == 1, "Fenced policy untouched");
+   units[0]->cores[0]->fenced = false;
+   FAKE_CHECK(dvfs_turbo_set(turbo, false) == DVFS_SUCCESS, "Disable turbo everywhere");
+   FAKE_CHECK(dvfs_turbo_get(turbo, &enabled) == DVFS_SUCCESS && !enabled, "Disabled everywhere");
+   FAKE_CHECK(dvfs_turbo_close(turbo) == DVFS_SUCCESS, "Close control");
+   FAKE_CHECK(fake_read_uint(BOOST0) == 1 && fake_read_uint(BOOST1) == 1, "Policies restored");
+
+   // nothing to control
+   snprintf(path, sizeof(path), "%s" BOOST1, fake_root);
+   remove(path);
+   FAKE_CHECK(dvfs_turbo_open(&turbo, 2, units) == DVFS_SUCCESS, "Open without control");
+   FAKE_CHECK(dvfs_turbo_set(turbo, true) == DVFS_ERROR_TURBO_UNAVAILABLE, "No control");
+   FAKE_CHECK(dvfs_turbo_close(turbo) == DVFS_SUCCESS, "Close control");
+
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   dvfs_unit *units[2];
+   unsigned int i;
+
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   // the cores only provide their ids, use the mock backend
+   for (i = 0; i < 2; i++) {
+      dvfs_core **cores = malloc(sizeof(*cores));
+      if (cores == NULL
+          || dvfs_core_open_backend(&cores[0], i, false, &dvfs_backend_mock) != DVFS_SUCCESS
+          || dvfs_unit_open(&units[i], 1, cores, i) != DVFS_SUCCESS) {
+         fake_root_remove();
+         return EXIT_FAILURE;
+      }
+   }
+
+   int ret = run(units);
+   fake_root_remove();
+
+   for (i = 0; i < 2; i++) {
+      dvfs_unit_close(units[i]);
+   }
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_turbo: OK\n");
+   }
+   return ret;
+}
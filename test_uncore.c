@@ -0,0 +1,180 @@
+/*
+ * libdvfs - A light library to set CPU governor and frequency
+ * Copyright (C) 2013-2014 Universite de Versailles
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_fakesys.h"
+
+#include "libdvfs.h"
+
+#define DOMAIN "/devices/system/cpu/intel_uncore_frequency/package_00_die_00"
+#define BROKEN_DOMAIN "/devices/system/cpu/intel_uncore_frequency/package_01_die_00"
+#define CPU "/devices/system/cpu/cpu%u"
+#define CPU0_SETSPEED "/devices/system/cpu/cpu0/cpufreq/scaling_setspeed"
+
+static int run(void)
+{
+   dvfs_uncore *uncore = NULL;
+   unsigned int min = 0, max = 0;
+
+   fake_write(DOMAIN "/initial_min_freq_khz", "800000\n");
+   fake_write(DOMAIN "/initial_max_freq_khz", "2400000\n");
+   fake_write(DOMAIN "/min_freq_khz", "1000000\n");
+   fake_write(DOMAIN "/max_freq_khz", "2200000\n");
+   fake_write(DOMAIN "/current_freq_khz", "1600000\n");
+
+   FAKE_CHECK(dvfs_uncore_open(&uncore, 0, 0) == DVFS_SUCCESS, "Open uncore domain");
+   FAKE_CHECK(uncore->hw_min_freq == 800000 && uncore->hw_max_freq == 2400000, "Hardware range");
+
+   unsigned int cur = 0;
+   FAKE_CHECK(dvfs_uncore_get_current_freq(uncore, &cur) == DVFS_SUCCESS && cur == 1600000, "Current frequency");
+
+   // moving up: the upper limit is raised first
+   FAKE_CHECK(dvfs_uncore_set_freq(uncore, 2400000) == DVFS_SUCCESS, "Pin to maximal frequency");
+   FAKE_CHECK(dvfs_uncore_get_limits(uncore, &min, &max) == DVFS_SUCCESS, "Get limits");
+   FAKE_CHECK(min == 2400000 && max == 2400000, "Pinned limits");
+
+   FAKE_CHECK(dvfs_uncore_set_limits(uncore, 800000, 1200000) == DVFS_SUCCESS, "Set range");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/min_freq_khz") == 800000, "Lower limit written");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/max_freq_khz") == 1200000, "Upper limit written");
+
+   FAKE_CHECK(dvfs_uncore_set_freq(uncore, 3000000) == DVFS_ERROR_INVALID_FREQ, "Out of range frequency");
+   FAKE_CHECK(dvfs_uncore_set_limits(uncore, 2000000, 1000000) == DVFS_ERROR_INVALID_ARG, "Empty range");
+
+   // a domain shared with units leased by another context is left alone
+   uncore->fenced = true;
+   FAKE_CHECK(dvfs_uncore_set_limits(uncore, 1000000, 2000000) == DVFS_ERROR_NOT_LEASED, "Fenced limits");
+   FAKE_CHECK(dvfs_uncore_set_freq(uncore, 1000000) == DVFS_ERROR_NOT_LEASED, "Fenced frequency");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/max_freq_khz") == 1200000, "Fenced domain untouched");
+   uncore->fenced = false;
+
+   // closing restores the initial limits
+   FAKE_CHECK(dvfs_uncore_close(uncore) == DVFS_SUCCESS, "Close uncore domain");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/min_freq_khz") == 1000000, "Lower limit restored");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/max_freq_khz") == 2200000, "Upper limit restored");
+
+   FAKE_CHECK(dvfs_uncore_open(&uncore, 1, 0) == DVFS_ERROR_FILE_ERROR, "Missing domain");
+
+   return EXIT_SUCCESS;
+}
+
+/**
+ * Fakes the online cores in a single unit of package 0, running close to 2 GHz
+ * (the measured frequency is not in the table).
+ */
+static void fake_cores(unsigned int nb_cores)
+{
+   char rel[256];
+   unsigned int i;
+
+   for (i = 0; i < nb_cores; i++) {
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/scaling_governor", i);
+      fake_write(rel, "userspace\n");
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/scaling_available_governors", i);
+      fake_write(rel, "ondemand userspace\n");
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/scaling_available_frequencies", i);
+      fake_write(rel, "1200000 2000000\n");
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/scaling_setspeed", i);
+      fake_write(rel, "1200000\n");
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/scaling_cur_freq", i);
+      fake_write(rel, "1987654\n");
+      snprintf(rel, sizeof(rel), CPU "/cpufreq/related_cpus", i);
+      fake_write(rel, "0-%u\n", nb_cores - 1);
+      snprintf(rel, sizeof(rel), CPU "/topology/core_siblings_list", i);
+      fake_write(rel, "0-%u\n", nb_cores - 1);
+      snprintf(rel, sizeof(rel), CPU "/topology/physical_package_id", i);
+      fake_write(rel, "0\n");
+      snprintf(rel, sizeof(rel), CPU "/topology/die_id", i);
+      fake_write(rel, "0\n");
+   }
+}
+
+static int run_context(void)
+{
+   dvfs_ctx *ctx = NULL;
+   const dvfs_uncore *uncore = NULL;
+   const dvfs_unit *unit = NULL;
+   char path[512];
+
+   fake_cores(sysconf(_SC_NPROCESSORS_ONLN));
+   fake_write(DOMAIN "/min_freq_khz", "1000000\n");
+   fake_write(DOMAIN "/max_freq_khz", "2200000\n");
+   // a domain without its files does not prevent the context from starting
+   fake_write(BROKEN_DOMAIN "/current_freq_khz", "1600000\n");
+   snprintf(path, sizeof(path), "%s/journal", fake_root);
+   setenv(DVFS_JOURNAL_PATH_ENV, path, 1);
+
+   FAKE_CHECK(dvfs_start(&ctx, false) == DVFS_SUCCESS, "Start with a broken domain");
+   FAKE_CHECK(ctx->nb_uncores == 1, "Broken domain skipped");
+   FAKE_CHECK(dvfs_get_unit_by_id(ctx, &unit, 0) == DVFS_SUCCESS, "Get unit");
+   FAKE_CHECK(dvfs_get_uncore_by_unit(ctx, unit, &uncore) == DVFS_SUCCESS, "Uncore of the unit");
+   FAKE_CHECK(uncore->package_id == 0 && uncore->die_id == 0, "Uncore of the package die");
+
+   FAKE_CHECK(dvfs_set_unit_and_uncore_freq(ctx, unit, 2000000, 1200000) == DVFS_SUCCESS, "Set both frequencies");
+   FAKE_CHECK(fake_read_uint(CPU0_SETSPEED) == 2000000, "Core frequency written");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/min_freq_khz") == 1200000 && fake_read_uint(DOMAIN "/max_freq_khz") == 1200000, "Uncore pinned");
+
+   // nothing changes for an uncore frequency out of range
+   FAKE_CHECK(dvfs_set_unit_and_uncore_freq(ctx, unit, 1200000, 3000000) == DVFS_ERROR_INVALID_FREQ, "Uncore frequency out of range");
+   FAKE_CHECK(fake_read_uint(CPU0_SETSPEED) == 2000000, "Core frequency untouched");
+
+   // the core frequency is rolled back when the uncore write fails
+   snprintf(path, sizeof(path), "%s" DOMAIN "/max_freq_khz", fake_root);
+   unlink(path);
+   FAKE_CHECK(dvfs_set_unit_and_uncore_freq(ctx, unit, 1200000, 1600000) == DVFS_ERROR_FILE_ERROR, "Uncore write failure");
+   FAKE_CHECK(fake_read_uint(CPU0_SETSPEED) == 2000000, "Core frequency rolled back");
+   fake_write(DOMAIN "/max_freq_khz", "1200000\n");
+
+   // the domain of a unit leased by another context is fenced
+   dvfs_ctx *other = NULL;
+   snprintf(path, sizeof(path), "%s/leases", fake_root);
+   setenv(DVFS_LEASE_PATH_ENV, path, 1);
+   FAKE_CHECK(dvfs_start(&other, false) == DVFS_SUCCESS, "Start another context");
+   FAKE_CHECK(dvfs_lease_acquire(ctx, "job", 1, &unit) == DVFS_SUCCESS, "Lease unit");
+   FAKE_CHECK(!ctx->uncores[0]->fenced, "Domain of the lease");
+   const dvfs_unit *other_unit = other->units[0];
+   FAKE_CHECK(dvfs_lease_acquire(other, "other", 1, &other_unit) == DVFS_ERROR_LEASE_HELD, "Unit already leased");
+   FAKE_CHECK(other->uncores[0]->fenced, "Domain fenced");
+   FAKE_CHECK(dvfs_set_unit_and_uncore_freq(other, other_unit, 2000000, 1600000) == DVFS_ERROR_NOT_LEASED, "Both frequencies refused");
+   FAKE_CHECK(dvfs_uncore_set_freq(other->uncores[0], 1600000) == DVFS_ERROR_NOT_LEASED, "Uncore frequency refused");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/max_freq_khz") == 1200000, "Domain untouched");
+   FAKE_CHECK(dvfs_stop(other) == DVFS_SUCCESS, "Stop the other context");
+   FAKE_CHECK(fake_read_uint(DOMAIN "/max_freq_khz") == 1200000, "Fenced domain not restored");
+
+   FAKE_CHECK(dvfs_stop(ctx) == DVFS_SUCCESS, "Stop");
+   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   if (fake_root_create() != 0) {
+      return EXIT_FAILURE;
+   }
+
+   int ret = run();
+   if (ret == EXIT_SUCCESS) {
+      ret = run_context();
+   }
+   fake_root_remove();
+
+   if (ret == EXIT_SUCCESS) {
+      printf("test_uncore: OK\n");
+   }
+   return ret;
+}